@@ -39,12 +39,15 @@
 #include "fft/fft.h"
 #include "hypergraph/hypergraph.h"
 #include "shapes/shapes.h"
+#include "utils/bitimage.h"
 #include "utils/bitmap.h"
 #include "utils/polygon.h"
 #include "utils/processimage.h"
+#include "utils/thresholding.h"
 #include "platedetection/platedetection.h"
 #include "platedetection/platereader.h"
 #include "platedetection/anpr.h"
+#include "platedetection/anprengine.h"
 
 #include "cppunitlite/TestHarness.h"
 
@@ -166,26 +169,22 @@ TEST (FindPlatesTest, MyTest)
 	    	{
 				std::string char_filename = "";
 				std::stringstream s_char_filename;
-				s_char_filename << "plate_" << p << "_char" << c << ".ppm";
+				s_char_filename << "plate_" << p << "_char" << c << ".pgm";
 				s_char_filename >> char_filename;
 
 				int char_image_width = chars_dimensions[c*2];
 				int char_image_height = chars_dimensions[(c*2)+1];
-				Bitmap *bmp_plate = new Bitmap(chars[c], char_image_width, char_image_height, 1);
-				bmp_plate->SavePPM(char_filename.c_str());
-				delete bmp_plate;
+				Bitmap::SavePGM(char_filename.c_str(), chars[c], char_image_width, char_image_height);
 	    	}
 
 	    	for (int c = 0; c < (int)resampled_chars.size(); c++)
 	    	{
 				std::string char_filename = "";
 				std::stringstream s_char_filename;
-				s_char_filename << "plate_" << p << "_char_small" << c << ".ppm";
+				s_char_filename << "plate_" << p << "_char_small" << c << ".pgm";
 				s_char_filename >> char_filename;
 
-				Bitmap *bmp_plate = new Bitmap(resampled_chars[c], resampled_width, resampled_height, 1);
-				bmp_plate->SavePPM(char_filename.c_str());
-				delete bmp_plate;
+				Bitmap::SavePGM(char_filename.c_str(), resampled_chars[c], resampled_width, resampled_height);
 	    	}
 
 	    	for (int c = 0; c < (int)resampled_chars.size(); c++)
@@ -204,13 +203,10 @@ TEST (FindPlatesTest, MyTest)
 	    {
 	        std::string plate_filename = "";
 	        std::stringstream s_plate_filename;
-	        s_plate_filename << "plate_" << p << ".ppm";
+	        s_plate_filename << "plate_" << p << ".pgm";
 	        s_plate_filename >> plate_filename;
 
-	        //Bitmap *bmp_plate = new Bitmap(plate_images[p], plate_image_width, plate_image_height[p], 1);
-	        Bitmap *bmp_plate = new Bitmap(binary_images[p], plate_image_width, plate_image_height[p], 1);
-	        bmp_plate->SavePPM(plate_filename.c_str());
-            delete bmp_plate;
+	        Bitmap::SavePGM(plate_filename.c_str(), binary_images[p], plate_image_width, plate_image_height[p]);
 	    }
     }
 
@@ -250,6 +246,821 @@ TEST (FindPlatesTest, MyTest)
 
 
 
+TEST (DetectionContextTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    DetectionContext *context = new DetectionContext();
+
+    bool debug = false;
+    std::vector<unsigned char*> debug_images;
+    int debug_image_width = 0;
+    int debug_image_height = 0;
+    std::vector<polygon2D*> plates0;
+    std::vector<polygon2D*> plates1;
+
+    platedetection::Find(
+        raw_image2, image_width, image_height,
+        plates0, debug, debug_images,
+        debug_image_width, debug_image_height,
+        "", context);
+
+    // the second frame of the same size should reuse the same buffers and worker
+    unsigned char* filtered = context->filtered;
+    ThreadPool* pass_pool = context->pass_pool;
+    CHECK(pass_pool != NULL);
+
+    platedetection::Find(
+        raw_image2, image_width, image_height,
+        plates1, debug, debug_images,
+        debug_image_width, debug_image_height,
+        "", context);
+
+    // the plate colour passes run one after the other should give the same result
+    std::vector<polygon2D*> plates2;
+    context->concurrent_passes = false;
+    platedetection::Find(
+        raw_image2, image_width, image_height,
+        plates2, debug, debug_images,
+        debug_image_width, debug_image_height,
+        "", context);
+
+    CHECK(filtered == context->filtered);
+    CHECK(pass_pool == context->pass_pool);
+    CHECK_INTS_EQUAL((int)plates0.size(), (int)plates1.size());
+    CHECK_INTS_EQUAL((int)plates0.size(), (int)plates2.size());
+    for (int i = 0; i < (int)plates0.size(); i++)
+    {
+    	for (int vertex = 0; vertex < 4; vertex++)
+    	{
+    		CHECK(plates0[i]->x_points[vertex] == plates1[i]->x_points[vertex]);
+    		CHECK(plates0[i]->y_points[vertex] == plates1[i]->y_points[vertex]);
+    		CHECK(plates0[i]->x_points[vertex] == plates2[i]->x_points[vertex]);
+    		CHECK(plates0[i]->y_points[vertex] == plates2[i]->y_points[vertex]);
+    	}
+    }
+
+    for (int i = 0; i < (int)plates0.size(); i++) delete plates0[i];
+    for (int i = 0; i < (int)plates1.size(); i++) delete plates1[i];
+    for (int i = 0; i < (int)plates2.size(); i++) delete plates2[i];
+    delete context;
+}
+
+TEST (DetectionWidthTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+
+    // area averaging preserves the colour of uniform regions
+    unsigned char* uniform = new unsigned char[image_width * image_height * 3];
+    for (int i = 0; i < image_width * image_height * 3; i += 3)
+    {
+    	uniform[i] = 10;
+    	uniform[i + 1] = 120;
+    	uniform[i + 2] = 250;
+    }
+    unsigned char* reduced = new unsigned char[300 * 225 * 3];
+    int* sums = new int[image_width * 3];
+    processimage::downSample(imageview::Create(uniform, image_width, image_height, 3), 300, 225, sums, reduced);
+    int differences = 0;
+    for (int i = 0; i < 300 * 225 * 3; i += 3)
+    	if ((reduced[i] != 10) || (reduced[i + 1] != 120) || (reduced[i + 2] != 250)) differences++;
+    CHECK_INTS_EQUAL(0, differences);
+    delete[] sums;
+    delete[] reduced;
+    delete[] uniform;
+
+    // plates found at the detection width are returned in full resolution
+    // coordinates, close to those found by filtering at full resolution
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    for (int test = 0; test < 4; test++)
+    {
+    	std::vector<unsigned char*> debug_images;
+    	int debug_image_width = 0;
+    	int debug_image_height = 0;
+    	std::vector<polygon2D*> plates, plates2;
+    	DetectionContext *context = new DetectionContext();
+    	DetectionContext *context2 = new DetectionContext();
+    	CHECK_INTS_EQUAL(0, context->detection_width);
+    	context2->detection_width = 320;
+    	platedetection::Find(images[test], image_width, image_height, plates, false, debug_images, debug_image_width, debug_image_height, "", context);
+    	platedetection::Find(images[test], image_width, image_height, plates2, false, debug_images, debug_image_width, debug_image_height, "", context2);
+    	CHECK((int)plates.size() > 0);
+    	CHECK((int)plates2.size() > 0);
+    	if (((int)plates.size() > 0) && ((int)plates2.size() > 0))
+    	{
+    		float tx = 0, ty = 0, bx = 0, by = 0;
+    		float tx2 = 0, ty2 = 0, bx2 = 0, by2 = 0;
+    		plates[0]->BoundingBox(tx, ty, bx, by);
+    		plates2[0]->BoundingBox(tx2, ty2, bx2, by2);
+    		CHECK(ABS(tx - tx2) < 8);
+    		CHECK(ABS(ty - ty2) < 8);
+    		CHECK(ABS(bx - bx2) < 8);
+    		CHECK(ABS(by - by2) < 8);
+    	}
+    	for (int p = 0; p < (int)plates.size(); p++) delete plates[p];
+    	for (int p = 0; p < (int)plates2.size(); p++) delete plates2[p];
+    	delete context;
+    	delete context2;
+    }
+}
+
+TEST (FrameStreamTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    int image_bytes = image_width * image_height * 3;
+
+    // two raw BGR frames
+    FILE* f = fopen("framestream_test.bgr", "wb");
+    fwrite(raw_image2, 1, image_bytes, f);
+    fwrite(raw_image2, 1, image_bytes, f);
+    fclose(f);
+
+    FrameStream *stream = new FrameStream();
+    CHECK(stream->Open("framestream_test.bgr", image_width, image_height));
+    int frames = 0;
+    while (stream->ReadFrame())
+    {
+    	CHECK(memcmp(stream->Data, raw_image2, image_bytes) == 0);
+    	frames++;
+    }
+    CHECK_INTS_EQUAL(2, frames);
+    stream->Close();
+    remove("framestream_test.bgr");
+
+    // a single greyscale y4m frame
+    f = fopen("framestream_test.y4m", "wb");
+    fprintf(f, "YUV4MPEG2 W4 H2 F25:1 Ip A1:1 Cmono\nFRAME\n");
+    unsigned char luma[8] = { 0, 16, 32, 64, 128, 200, 235, 255 };
+    fwrite(luma, 1, 8, f);
+    fclose(f);
+
+    CHECK(stream->Open("framestream_test.y4m", 0, 0));
+    CHECK_INTS_EQUAL(4, stream->Width);
+    CHECK_INTS_EQUAL(2, stream->Height);
+    CHECK(stream->ReadFrame());
+    CHECK_INTS_EQUAL(128, (int)stream->Data[4*3]);
+    CHECK(!stream->ReadFrame());
+
+    // frames too large to allocate are rejected in both formats
+    f = fopen("framestream_test.y4m", "wb");
+    fprintf(f, "YUV4MPEG2 W50000 H50000 C444\nFRAME\n");
+    fclose(f);
+    CHECK(!stream->Open("framestream_test.y4m", 0, 0));
+    CHECK(!stream->Open("framestream_test.y4m", 50000, 50000));
+    delete stream;
+    remove("framestream_test.y4m");
+}
+
+TEST (NetpbmTest, MyTest)
+{
+    // colour images are written as RGB
+    unsigned char bgr[6] = { 10, 20, 30, 40, 50, 60 };
+    CHECK(Bitmap::SavePPM("netpbm_test.ppm", bgr, 2, 1));
+
+    unsigned char file_data[32];
+    FILE* f = fopen("netpbm_test.ppm", "rb");
+    int bytes = (int)fread(file_data, 1, 32, f);
+    fclose(f);
+    remove("netpbm_test.ppm");
+    CHECK_INTS_EQUAL(17, bytes);
+    CHECK(memcmp(file_data, "P6\n2 1\n255\n", 11) == 0);
+    CHECK_INTS_EQUAL(30, (int)file_data[11]);
+    CHECK_INTS_EQUAL(10, (int)file_data[13]);
+    CHECK_INTS_EQUAL(40, (int)file_data[16]);
+
+    // grey images keep a single channel
+    unsigned char grey[4] = { 0, 85, 170, 255 };
+    CHECK(Bitmap::SavePGM("netpbm_test.pgm", grey, 2, 2));
+
+    f = fopen("netpbm_test.pgm", "rb");
+    bytes = (int)fread(file_data, 1, 32, f);
+    fclose(f);
+    remove("netpbm_test.pgm");
+    CHECK_INTS_EQUAL(15, bytes);
+    CHECK(memcmp(file_data, "P5\n2 2\n255\n", 11) == 0);
+    CHECK(memcmp(&file_data[11], grey, 4) == 0);
+}
+
+TEST (BitmapFromFileTest, MyTest)
+{
+    // 2x2 24 bit bitmap, bottom row first with rows padded to 8 bytes
+    unsigned char file_data[90];
+    memset(file_data, 0, 90);
+    int offset = 54, header_size = 40, width = 2, height = 2;
+    unsigned short planes = 1, bpp = 24;
+    file_data[0] = 'B';
+    file_data[1] = 'M';
+    memcpy(&file_data[10], &offset, 4);
+    memcpy(&file_data[14], &header_size, 4);
+    memcpy(&file_data[18], &width, 4);
+    memcpy(&file_data[22], &height, 4);
+    memcpy(&file_data[26], &planes, 2);
+    memcpy(&file_data[28], &bpp, 2);
+    for (int i = 0; i < 6; i++)
+    {
+    	file_data[54 + i] = (unsigned char)(10 + i);
+    	file_data[62 + i] = (unsigned char)(20 + i);
+    }
+
+    FILE* f = fopen("bitmap_test.bmp", "wb");
+    fwrite(file_data, 1, 70, f);
+    fclose(f);
+    Bitmap *bmp = new Bitmap();
+    CHECK(bmp->FromFile("bitmap_test.bmp"));
+    CHECK_INTS_EQUAL(2, bmp->Width);
+    CHECK_INTS_EQUAL(2, bmp->Height);
+    CHECK_INTS_EQUAL(20, (int)bmp->Data[0]);
+    CHECK_INTS_EQUAL(15, (int)bmp->Data[11]);
+    delete bmp;
+
+    // dimensions whose pixel data could not fit within the file are rejected
+    width = height = 65536;
+    memcpy(&file_data[18], &width, 4);
+    memcpy(&file_data[22], &height, 4);
+    f = fopen("bitmap_test.bmp", "wb");
+    fwrite(file_data, 1, 90, f);
+    fclose(f);
+    bmp = new Bitmap();
+    CHECK(!bmp->FromFile("bitmap_test.bmp"));
+    delete bmp;
+    remove("bitmap_test.bmp");
+}
+
+TEST (ImagePrefetcherTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    unsigned char* raw_images[] = { raw_image1, raw_image2, raw_image3 };
+
+    std::vector<std::string> filenames;
+    for (int i = 0; i < 4; i++)
+    {
+    	std::stringstream s_filename;
+    	s_filename << "prefetch_test_" << i << ".bmp";
+    	filenames.push_back(s_filename.str());
+    	if (i < 3)
+    	{
+    		Bitmap *bmp = new Bitmap(raw_images[i], image_width, image_height, 3);
+    		bmp->Save(filenames[i].c_str());
+    		delete bmp;
+    	}
+    }
+
+    // the last file does not exist
+    ImagePrefetcher *prefetcher = new ImagePrefetcher(filenames, 2, 2);
+    for (int i = 0; i < 4; i++)
+    {
+    	prefetch_slot* slot = prefetcher->Next();
+    	CHECK(slot != NULL);
+    	CHECK_INTS_EQUAL(i, slot->index);
+    	if (i < 3)
+    	{
+    		CHECK(slot->loaded);
+    		CHECK_INTS_EQUAL(image_width, slot->bmp->Width);
+    		CHECK(memcmp(slot->bmp->Data, raw_images[i], image_width * image_height * 3) == 0);
+    	}
+    	else CHECK(!slot->loaded);
+    	prefetcher->Release(slot);
+    }
+    CHECK(prefetcher->Next() == NULL);
+    delete prefetcher;
+
+    for (int i = 0; i < 3; i++)
+    	remove(filenames[i].c_str());
+}
+
+TEST (DirectoryWatcherTest, MyTest)
+{
+    // files already present before the watch starts
+    const char* existing[] = { "watch_test/b.bmp", "watch_test/a.jpg", "watch_test/notes.txt", "watch_test/2009/c.BMP" };
+    mkdir("watch_test", 0755);
+    mkdir("watch_test/2009", 0755);
+    for (int i = 0; i < 4; i++)
+    	fclose(fopen(existing[i], "wb"));
+
+    std::vector<std::string> filenames;
+    CHECK(imagefiles::List("watch_test", false, filenames));
+    CHECK_INTS_EQUAL(2, (int)filenames.size());
+    CHECK(filenames[0] == "a.jpg");
+    CHECK(filenames[1] == "b.bmp");
+    CHECK(imagefiles::List("watch_test", true, filenames));
+    CHECK_INTS_EQUAL(3, (int)filenames.size());
+    CHECK(filenames[0] == "2009/c.BMP");
+    CHECK(!imagefiles::List("watch_test/missing", true, filenames));
+
+    // only images written after the watch starts are returned
+    DirectoryWatcher *watcher = new DirectoryWatcher();
+    CHECK(watcher->Start("watch_test", true));
+    CHECK(watcher->Next(filenames, 0));
+    CHECK_INTS_EQUAL(0, (int)filenames.size());
+
+    fclose(fopen("watch_test/d.bmp", "wb"));
+    fclose(fopen("watch_test/2009/e.jpeg", "wb"));
+    fclose(fopen("watch_test/f.txt", "wb"));
+    CHECK(watcher->Next(filenames, 1000));
+    CHECK_INTS_EQUAL(2, (int)filenames.size());
+    CHECK(filenames[0] == "d.bmp");
+    CHECK(filenames[1] == "2009/e.jpeg");
+
+    // images within new subdirectories, including those written before they were watched
+    mkdir("watch_test/2010", 0755);
+    fclose(fopen("watch_test/2010/g.bmp", "wb"));
+    std::vector<std::string> arrived;
+    for (int i = 0; i < 10; i++)
+    {
+    	CHECK(watcher->Next(filenames, 100));
+    	arrived.insert(arrived.end(), filenames.begin(), filenames.end());
+    }
+    CHECK_INTS_EQUAL(1, (int)arrived.size());
+    if ((int)arrived.size() > 0) CHECK(arrived[0] == "2010/g.bmp");
+
+    // an image still being written when its subdirectory is listed is returned again once closed
+    mkdir("watch_test/2011", 0755);
+    FILE *partial = fopen("watch_test/2011/h.jpg", "wb");
+    fwrite("abcd", 1, 4, partial);
+    fflush(partial);
+    arrived.clear();
+    for (int i = 0; i < 10; i++)
+    {
+    	CHECK(watcher->Next(filenames, 100));
+    	arrived.insert(arrived.end(), filenames.begin(), filenames.end());
+    }
+    CHECK_INTS_EQUAL(1, (int)arrived.size());
+    fwrite("efgh", 1, 4, partial);
+    fclose(partial);
+    arrived.clear();
+    for (int i = 0; i < 10; i++)
+    {
+    	CHECK(watcher->Next(filenames, 100));
+    	arrived.insert(arrived.end(), filenames.begin(), filenames.end());
+    }
+    CHECK_INTS_EQUAL(1, (int)arrived.size());
+    if ((int)arrived.size() > 0) CHECK(arrived[0] == "2011/h.jpg");
+
+    // listed images are forgotten once they are removed, or their subdirectory is
+    int listed = watcher->Listed();
+    mkdir("watch_test_2012", 0755);
+    fclose(fopen("watch_test_2012/i.bmp", "wb"));
+    fclose(fopen("watch_test_2012/j.bmp", "wb"));
+    rename("watch_test_2012", "watch_test/2012");
+    arrived.clear();
+    for (int i = 0; i < 10; i++)
+    {
+    	CHECK(watcher->Next(filenames, 100));
+    	arrived.insert(arrived.end(), filenames.begin(), filenames.end());
+    }
+    CHECK_INTS_EQUAL(2, (int)arrived.size());
+    CHECK_INTS_EQUAL(listed + 2, watcher->Listed());
+    remove("watch_test/2012/i.bmp");
+    CHECK(watcher->Next(filenames, 100));
+    CHECK_INTS_EQUAL(listed + 1, watcher->Listed());
+    remove("watch_test/2012/j.bmp");
+    rmdir("watch_test/2012");
+    mkdir("watch_test/2013", 0755);
+    fclose(fopen("watch_test/2013/k.bmp", "wb"));
+    arrived.clear();
+    for (int i = 0; i < 10; i++)
+    {
+    	CHECK(watcher->Next(filenames, 100));
+    	arrived.insert(arrived.end(), filenames.begin(), filenames.end());
+    }
+    CHECK_INTS_EQUAL(1, (int)arrived.size());
+    remove("watch_test/2013/k.bmp");
+    rmdir("watch_test/2013");
+    for (int i = 0; i < 10; i++)
+    	CHECK(watcher->Next(filenames, 100));
+    CHECK_INTS_EQUAL(listed, watcher->Listed());
+
+    delete watcher;
+
+    const char* created[] = { "watch_test/d.bmp", "watch_test/f.txt", "watch_test/2009/e.jpeg", "watch_test/2010/g.bmp", "watch_test/2011/h.jpg" };
+    for (int i = 0; i < 4; i++) remove(existing[i]);
+    for (int i = 0; i < 5; i++) remove(created[i]);
+    rmdir("watch_test/2009");
+    rmdir("watch_test/2010");
+    rmdir("watch_test/2011");
+    rmdir("watch_test");
+}
+
+/*!
+ * \brief counts the debugging images it receives
+ */
+class CountingDebugSink : public DebugSink
+{
+public:
+	int images;
+	int width;
+	CountingDebugSink() { images = 0; width = 0; }
+	bool Accepting() { return(true); }
+	void Add(unsigned char* img, int w, int /*h*/, int /*channels*/, std::string /*name*/)
+	{
+		images++;
+		width = w;
+		delete[] img;
+	}
+};
+
+TEST (DebugSinkTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    unsigned char* mono = new unsigned char[image_width * image_height];
+    processimage::monoImage(raw_image2, image_width, image_height, 1, mono);
+
+    // decimated images are written in the background
+    DebugImageWriter *writer = new DebugImageWriter("debugsink_test_", 2, 0, 4);
+    writer->Copy(mono, image_width, image_height, 1, "mono");
+    unsigned char* colour = new unsigned char[image_width * image_height * 3];
+    memcpy(colour, raw_image2, image_width * image_height * 3);
+    writer->Add(colour, image_width, image_height, 3, "colour");
+    writer->Flush();
+    CHECK_INTS_EQUAL(2, writer->Written());
+    struct stat file_status;
+    CHECK(stat("debugsink_test_000000_mono.pgm", &file_status) == 0);
+    CHECK_INTS_EQUAL(15 + (320 * 240), (int)file_status.st_size);
+    CHECK(stat("debugsink_test_000001_colour.ppm", &file_status) == 0);
+    CHECK_INTS_EQUAL(15 + (320 * 240 * 3), (int)file_status.st_size);
+    delete writer;
+    remove("debugsink_test_000000_mono.pgm");
+    remove("debugsink_test_000001_colour.ppm");
+
+    // images beyond the rate limit are discarded
+    writer = new DebugImageWriter("debugsink_test_", 8, 2, 8);
+    for (int i = 0; i < 5; i++)
+    	writer->Copy(mono, image_width, image_height, 1, "rate");
+    writer->Flush();
+    CHECK(writer->Dropped() > 0);
+    CHECK_INTS_EQUAL(5, writer->Written() + writer->Dropped());
+    delete writer;
+    for (int i = 0; i < 5; i++)
+    {
+    	std::stringstream s_filename;
+    	s_filename << "debugsink_test_00000" << i << "_rate.pgm";
+    	remove(s_filename.str().c_str());
+    }
+
+    // detection sends its debugging images to the installed sink rather than returning them
+    CountingDebugSink *sink = new CountingDebugSink();
+    DebugSink::Set(sink);
+    std::vector<polygon2D*> plates;
+    std::vector<unsigned char*> debug_images;
+    int debug_image_width = 0;
+    int debug_image_height = 0;
+    platedetection::Find(raw_image2, image_width, image_height, plates, true, debug_images, debug_image_width, debug_image_height, "");
+    DebugSink::Set(NULL);
+    CHECK(sink->images > 0);
+    CHECK_INTS_EQUAL(0, (int)debug_images.size());
+    for (int i = 0; i < (int)plates.size(); i++)
+    	delete plates[i];
+
+    delete sink;
+    delete[] mono;
+}
+
+TEST (ProfilerTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    bool debug = false;
+    std::vector<unsigned char*> debug_images;
+    int debug_image_width = 0;
+    int debug_image_height = 0;
+    std::vector<polygon2D*> plates;
+
+    profiler::Clear();
+    profiler::Enable(true);
+    platedetection::Find(
+        raw_image2, image_width, image_height,
+        plates, debug, debug_images,
+        debug_image_width, debug_image_height,
+        "");
+    profiler::Enable(false);
+
+    CHECK_INTS_EQUAL(1, profiler::Samples(PROFILE_COLOUR_FILTER));
+    CHECK(profiler::Samples(PROFILE_CANNY) > 0);
+    CHECK(profiler::Samples(PROFILE_GROUPS) > 0);
+    CHECK(profiler::Percentile(PROFILE_CANNY, 50) > 0);
+    CHECK(profiler::Percentile(PROFILE_CANNY, 50) <= profiler::Percentile(PROFILE_CANNY, 99));
+
+    // nothing is recorded while disabled
+    int samples = profiler::Samples(PROFILE_CANNY);
+    double start_time = profiler::Start();
+    profiler::Stop(PROFILE_CANNY, start_time);
+    CHECK_INTS_EQUAL(samples, profiler::Samples(PROFILE_CANNY));
+    profiler::Clear();
+
+    // beyond the reservoir every call is counted, and the percentiles
+    // are estimated from a uniform sample of durations from 1 to 3000 mS
+    profiler::Enable(true);
+    for (int i = 1; i <= 3000; i++)
+    	profiler::Stop(PROFILE_OCR, profiler::Start() - i);
+    profiler::Enable(false);
+    CHECK_INTS_EQUAL(3000, profiler::Samples(PROFILE_OCR));
+    float p50 = profiler::Percentile(PROFILE_OCR, 50);
+    CHECK((p50 > 1200) && (p50 < 1800));
+    CHECK(profiler::Percentile(PROFILE_OCR, 99) > 2800);
+    profiler::Clear();
+    CHECK_INTS_EQUAL(0, profiler::Samples(PROFILE_OCR));
+
+    for (int i = 0; i < (int)plates.size(); i++) delete plates[i];
+}
+
+TEST (AnprEngineTest, MyTest)
+{
+    // a set of arbitrary character models, so that every character gets a label
+    int model_image_width = ANPRENGINE_MODEL_WIDTH;
+    int model_image_height = ANPRENGINE_MODEL_HEIGHT;
+    std::vector<float*> models;
+    float* average_model = new float[model_image_width * model_image_height];
+    for (int m = 0; m < 36; m++)
+    {
+    	float* model = new float[model_image_width * model_image_height];
+    	for (int i = 0; i < model_image_width * model_image_height; i++)
+    		model[i] = (float)((i * (m + 1)) % 256);
+    	models.push_back(model);
+    }
+    ocr::CreateCharacterEigenModels(model_image_width, model_image_height, models, average_model);
+    ocr::SaveCharacterModels("engine_test_model.dat", model_image_width, model_image_height, models, average_model);
+
+    AnprEngine *engine = new AnprEngine("engine_test_model.dat");
+    CHECK(engine->ModelsLoaded());
+
+    FrameView frame;
+    frame.data = raw_image2;
+    frame.width = 640;
+    frame.height = 480;
+
+    AnprResult result = engine->Process(frame);
+    CHECK((int)result.plates.size() > 0);
+    int total_characters = 0;
+    for (int p = 0; p < (int)result.plates.size(); p++)
+    {
+    	CHECK_INTS_EQUAL(4, (int)result.plates[p].perimeter.x_points.size());
+    	CHECK_INTS_EQUAL((int)result.plates[p].text.size(), (int)result.plates[p].character_scores.size());
+    	total_characters += (int)result.plates[p].text.size();
+    }
+    CHECK(total_characters > 0);
+
+    // the same engine gives the same result on the next frame
+    AnprResult result2;
+    engine->Process(frame, result2);
+    CHECK_INTS_EQUAL((int)result.plates.size(), (int)result2.plates.size());
+    for (int p = 0; p < (int)result.plates.size(); p++)
+    	CHECK(result.plates[p].text == result2.plates[p].text);
+
+    delete engine;
+    remove("engine_test_model.dat");
+    for (int m = 0; m < (int)models.size(); m++) delete[] models[m];
+    delete[] average_model;
+}
+
+TEST (ImageViewTest, MyTest)
+{
+    int image_width = 640;
+    int image_height = 480;
+    int row_bytes = image_width * 3;
+
+    // a padded bottom up copy of the image, as stored in a bitmap file
+    int stride = row_bytes + 16;
+    unsigned char* padded = new unsigned char[stride * image_height];
+    memset(padded, 0, stride * image_height);
+    for (int y = 0; y < image_height; y++)
+    	memcpy(&padded[(image_height - 1 - y) * stride], &raw_image2[y * row_bytes], row_bytes);
+    image_view view = imageview::Create(padded, image_width, image_height, stride, 3, IMAGE_VIEW_BOTTOM_UP);
+    CHECK(memcmp(imageview::Row(view, 10), &raw_image2[10 * row_bytes], row_bytes) == 0);
+
+    // regions are views into the same memory
+    image_view region = imageview::SubImage(view, 100, 50, 300, 150);
+    CHECK_INTS_EQUAL(200, region.width);
+    CHECK_INTS_EQUAL(100, region.height);
+    CHECK(imageview::Row(region, 0) == imageview::Row(view, 50) + (100 * 3));
+    unsigned char* crop = new unsigned char[200 * 100 * 3];
+    unsigned char* crop2 = new unsigned char[200 * 100 * 3];
+    processimage::cropImage(view, 100, 50, 300, 150, crop);
+    processimage::cropImage(raw_image2, image_width, image_height, 3, 100, 50, 300, 150, crop2);
+    CHECK(memcmp(crop, crop2, 200 * 100 * 3) == 0);
+
+    // plates detected within the view are the same as those in the packed image
+    std::vector<unsigned char*> debug_images;
+    int debug_image_width = 0;
+    int debug_image_height = 0;
+    std::vector<polygon2D*> plates, plates2;
+    DetectionContext *context = new DetectionContext();
+    platedetection::Find(raw_image2, image_width, image_height, plates, false, debug_images, debug_image_width, debug_image_height, "", context);
+    platedetection::Find(view, plates2, false, debug_images, debug_image_width, debug_image_height, "", context);
+    CHECK((int)plates.size() > 0);
+    CHECK_INTS_EQUAL((int)plates.size(), (int)plates2.size());
+    for (int p = 0; p < (int)plates.size(); p++)
+    {
+    	for (int v = 0; v < 4; v++)
+    	{
+    		CHECK(plates[p]->x_points[v] == plates2[p]->x_points[v]);
+    		CHECK(plates[p]->y_points[v] == plates2[p]->y_points[v]);
+    	}
+    	delete plates[p];
+    	delete plates2[p];
+    }
+    delete context;
+
+    // edges of a mono region are the same as those of a packed copy
+    unsigned char* mono = new unsigned char[image_width * image_height];
+    processimage::monoImage(view, 1, mono);
+    image_view mono_region = imageview::SubImage(imageview::Create(mono, image_width, image_height, 1), 100, 50, 300, 150);
+    unsigned char* mono_crop = new unsigned char[200 * 100];
+    processimage::cropImage(mono_region, 0, 0, 200, 100, mono_crop);
+
+    CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+    CannyEdgeDetector *edge_detector2 = new CannyEdgeDetector();
+    edge_detector->Update(mono_region);
+    edge_detector2->Update(mono_crop, 200, 100, 1);
+    CHECK((int)edge_detector->edges.size() > 0);
+    CHECK(edge_detector->edges == edge_detector2->edges);
+
+    delete edge_detector;
+    delete edge_detector2;
+    delete[] mono_crop;
+    delete[] mono;
+    delete[] crop2;
+    delete[] crop;
+    delete[] padded;
+}
+
+TEST (BitImageTest, MyTest)
+{
+    // row and column occupancy of a packed image is the same as counting bytes
+    int image_width = 201;
+    int image_height = 77;
+    unsigned char* mono = new unsigned char[image_width * image_height];
+    srand(19);
+    for (int i = 0; i < image_width * image_height; i++)
+    	mono[i] = (rand() % 3 == 0) ? 255 : 0;
+
+    bit_image* packed = bitimage::Pack(mono, image_width, image_height);
+    for (int i = 0; i < 500; i++)
+    {
+    	int y = rand() % image_height;
+    	int start_x = rand() % image_width;
+    	int end_x = start_x + (rand() % (image_width + 1 - start_x));
+    	int occupancy = 0;
+    	for (int x = start_x; x < end_x; x++)
+    		if (mono[(y * image_width) + x] != 0) occupancy++;
+    	CHECK_INTS_EQUAL(occupancy, bitimage::CountRow(*packed, y, start_x, end_x));
+
+    	int x = rand() % image_width;
+    	int start_y = rand() % image_height;
+    	int end_y = start_y + (rand() % (image_height + 1 - start_y));
+    	occupancy = 0;
+    	for (int yy = start_y; yy < end_y; yy++)
+    		if (mono[(yy * image_width) + x] != 0) occupancy++;
+    	CHECK_INTS_EQUAL(occupancy, bitimage::CountColumn(*packed, x, start_y, end_y));
+    }
+
+    unsigned char* unpacked = new unsigned char[image_width * image_height];
+    bitimage::Unpack(*packed, 0, 0, image_width, image_height, unpacked);
+    CHECK(memcmp(mono, unpacked, image_width * image_height) == 0);
+    bitimage::Free(packed);
+
+    // binarising directly into packed images gives the same plates
+    std::vector<int> plate_image_height;
+    std::vector<unsigned char*> plate_images;
+    plate_image_height.push_back(image_height);
+    plate_images.push_back(new unsigned char[image_width * image_height]);
+    for (int i = 0; i < image_width * image_height; i++)
+    	plate_images[0][i] = (unsigned char)(rand() % 256);
+    std::vector<unsigned char*> binary_images;
+    std::vector<bit_image*> packed_images;
+    platereader::Binarise(image_width, plate_image_height, plate_images, binary_images);
+    platereader::Binarise(image_width, plate_image_height, plate_images, packed_images);
+    bitimage::Unpack(*packed_images[0], 0, 0, image_width, image_height, unpacked);
+    CHECK(memcmp(binary_images[0], unpacked, image_width * image_height) == 0);
+
+    delete[] plate_images[0];
+    delete[] binary_images[0];
+    bitimage::Free(packed_images[0]);
+    delete[] unpacked;
+    delete[] mono;
+}
+
+TEST (JpegDecoderTest, MyTest)
+{
+    // 32x16 baseline jpeg, red on the left and blue on the right
+    static const unsigned char jpeg_file[] = {
+	    0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01, 0x01, 0x00, 0x00, 0x01,
+	    0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03,
+	    0x03, 0x03, 0x03, 0x04, 0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07,
+	    0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d, 0x0e, 0x12, 0x10, 0x0d,
+	    0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10, 0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f,
+	    0x17, 0x18, 0x16, 0x14, 0x18, 0x12, 0x14, 0x15, 0x14, 0xff, 0xdb, 0x00, 0x43, 0x01, 0x03, 0x04,
+	    0x04, 0x05, 0x04, 0x05, 0x09, 0x05, 0x05, 0x09, 0x14, 0x0d, 0x0b, 0x0d, 0x14, 0x14, 0x14, 0x14,
+	    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14,
+	    0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0x14, 0xff, 0xc0,
+	    0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x20, 0x03, 0x01, 0x11, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11,
+	    0x01, 0xff, 0xc4, 0x00, 0x15, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07, 0xff, 0xc4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00,
+	    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xc4,
+	    0x00, 0x17, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	    0x00, 0x00, 0x00, 0x00, 0x08, 0x09, 0x07, 0xff, 0xc4, 0x00, 0x14, 0x11, 0x01, 0x00, 0x00, 0x00,
+	    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xda, 0x00,
+	    0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00, 0x8a, 0x39, 0xba, 0xd5, 0x01,
+	    0x2f, 0x68, 0xea, 0x07, 0x01, 0x50, 0x67, 0x12, 0xf8, 0x01, 0x2f, 0x68, 0xea, 0x07, 0x01, 0xff,
+	    0xd9
+    };
+    int jpeg_file_length = (int)sizeof(jpeg_file);
+
+    CHECK(JpegDecoder::IsJpeg(jpeg_file, jpeg_file_length));
+    CHECK(!JpegDecoder::IsJpeg(raw_image2, 640 * 480 * 3));
+
+    JpegDecoder *jpeg = new JpegDecoder();
+    CHECK(jpeg->Load(jpeg_file, jpeg_file_length));
+    CHECK_INTS_EQUAL(32, jpeg->Width);
+    CHECK_INTS_EQUAL(16, jpeg->Height);
+    CHECK_INTS_EQUAL(2, jpeg->ScaleForWidth(16));
+    CHECK_INTS_EQUAL(8, jpeg->ScaleForWidth(1));
+
+    unsigned char* full = new unsigned char[32 * 16 * 3];
+    CHECK(jpeg->Decode(1, full));
+
+    for (int scale = 1; scale <= 8; scale *= 2)
+    {
+    	int width = 0, height = 0;
+    	jpeg->ScaledSize(scale, width, height);
+    	CHECK_INTS_EQUAL(32 / scale, width);
+    	CHECK_INTS_EQUAL(16 / scale, height);
+
+    	unsigned char* img = new unsigned char[width * height * 3];
+    	CHECK(jpeg->Decode(scale, img));
+    	for (int y = 0; y < height; y++)
+    	{
+    		for (int x = 0; x < width; x++)
+    		{
+    			int n = ((y * width) + x) * 3;
+    			int red = 200, blue = 40;
+    			if (x >= width / 2)
+    			{
+    				red = 40;
+    				blue = 200;
+    			}
+    			CHECK(ABS(img[n] - blue) < 8);
+    			CHECK(ABS(img[n + 1] - 40) < 8);
+    			CHECK(ABS(img[n + 2] - red) < 8);
+    		}
+    	}
+    	delete[] img;
+    }
+
+    // a region is identical to the same part of the whole image
+    unsigned char* region = new unsigned char[13 * 6 * 3];
+    CHECK(jpeg->Decode(1, 10, 5, 23, 11, region));
+    for (int y = 0; y < 6; y++)
+    	CHECK(memcmp(&region[y * 13 * 3], &full[(((y + 5) * 32) + 10) * 3], 13 * 3) == 0);
+
+    delete[] region;
+    delete[] full;
+
+    // frames too large to allocate and corrupt magnitude categories are rejected
+    unsigned char* damaged = new unsigned char[jpeg_file_length];
+    int frame_header = 0;
+    int dc_table = 0;
+    for (int i = 0; i < jpeg_file_length - 4; i++)
+    {
+    	if ((jpeg_file[i] == 0xff) && (jpeg_file[i + 1] == 0xc0) && (frame_header == 0))
+    		frame_header = i;
+    	if ((jpeg_file[i] == 0xff) && (jpeg_file[i + 1] == 0xc4) && (jpeg_file[i + 4] == 0x00) && (dc_table == 0))
+    		dc_table = i;
+    }
+    CHECK(frame_header > 0);
+    CHECK(dc_table > 0);
+
+    memcpy(damaged, jpeg_file, jpeg_file_length);
+    for (int i = 5; i < 9; i++) damaged[frame_header + i] = 0xff;
+    CHECK(!jpeg->Load(damaged, jpeg_file_length));
+
+    memcpy(damaged, jpeg_file, jpeg_file_length);
+    damaged[dc_table + 5 + 16] = 15;
+    CHECK(!jpeg->Load(damaged, jpeg_file_length));
+    delete[] damaged;
+
+    // a huffman table with more one bit codes than can exist, inserted after the SOI marker
+    unsigned char huffman_table[221];
+    memset(huffman_table, 0, 221);
+    huffman_table[0] = 0xff;
+    huffman_table[1] = 0xc4;
+    huffman_table[3] = 219;
+    huffman_table[4] = 0x13;
+    huffman_table[5] = 200;
+    for (int i = 0; i < 200; i++) huffman_table[21 + i] = (unsigned char)i;
+    damaged = new unsigned char[jpeg_file_length + 221];
+    memcpy(damaged, jpeg_file, 2);
+    memcpy(&damaged[2], huffman_table, 221);
+    memcpy(&damaged[223], &jpeg_file[2], jpeg_file_length - 2);
+    CHECK(!jpeg->Load(damaged, jpeg_file_length + 221));
+
+    delete jpeg;
+}
+
 TEST (rectanglesTest, MyTest)
 {
 	unsigned char* test_image = raw_image1;
@@ -305,14 +1116,11 @@ TEST (rectanglesTest, MyTest)
     std::vector<float> orientation;
     std::vector<std::vector<int> > dominant_edges;
     std::vector<std::vector<std::vector<int> > > side_edges;
-    unsigned char* edges_image = new unsigned char[image.Width * image.Height];
     int edges_image_width = 0;
     int edges_image_height = 0;
     std::vector<polygon2D*> rectangles;
     std::vector<unsigned char*> debug_images;
     unsigned char* erosion_dilation_buffer = new unsigned char[image.Width * image.Height];
-    int* downsampling_buffer0 = new int[image.Width * image.Height];
-    int* downsampling_buffer1 = new int[image.Width * image.Height];
 
     shapes::DetectRectangles(
         mono_img, image.Width, image.Height, 1,
@@ -340,15 +1148,12 @@ TEST (rectanglesTest, MyTest)
     	orientation,
     	dominant_edges,
     	side_edges,
-    	edges_image,
     	edges_image_width,
     	edges_image_height,
     	edge_detector,
     	rectangles,
     	debug_images,
-    	erosion_dilation_buffer,
-    	downsampling_buffer0,
-    	downsampling_buffer1);
+    	erosion_dilation_buffer);
 
     // save the debug images
     std::string debug_filename;
@@ -401,10 +1206,7 @@ TEST (rectanglesTest, MyTest)
 	delete edge_detector;
 	delete[] mono_img;
 	delete[] filtered;
-    delete[] edges_image;
     delete[] erosion_dilation_buffer;
-    delete[] downsampling_buffer0;
-    delete[] downsampling_buffer1;
 
 }
 
@@ -449,7 +1251,7 @@ TEST (edgesTest, MyTest)
 
     //CHECK(average_time < 500);
 
-    Bitmap *bmp = new Bitmap(edge_detector->edgesImage, image.Width, image.Height, image.BytesPerPixel);
+    Bitmap *bmp = new Bitmap(edge_detector->EdgesImage(), image.Width, image.Height, image.BytesPerPixel);
 
     bmp->SavePPM("canny_edges.ppm");
 
@@ -480,6 +1282,68 @@ TEST (ColourFilterTest, MyTest)
 }
 
 
+TEST (ColourFilterPlanarTest, MyTest)
+{
+    // random images with odd widths exercise the scalar tails of the vectorised rows
+    int random_width = 333;
+    int random_height = 77;
+    unsigned char* random_img = new unsigned char[random_width * random_height * 4];
+    srand(100);
+    for (int i = 0; i < random_width * random_height * 4; i++)
+    	random_img[i] = (unsigned char)(rand() % 256);
+
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4, random_img, random_img };
+    int widths[] = { 640, 640, 640, 640, random_width, random_width };
+    int heights[] = { 480, 480, 480, 480, random_height, random_height };
+    int channels[] = { 3, 3, 3, 3, 3, 4 };
+    int* histogram = new int[256];
+    for (int test = 0; test < 6; test++)
+    {
+    	image_view img = imageview::Create(images[test], widths[test], heights[test], channels[test]);
+    	int pixels = img.width * img.height;
+    	unsigned char* yellow = new unsigned char[pixels];
+    	unsigned char* white = new unsigned char[pixels];
+    	platedetection::ColourFilter(img, yellow, white);
+
+    	// reference: yellow filter followed by a separate white pass
+    	unsigned char* filtered = new unsigned char[pixels * 3];
+    	memset(histogram, 0, 256*sizeof(int));
+    	for (int i = 0; i < pixels; i++)
+    		histogram[images[test][i]]++;
+    	float MeanDark = 0, MeanLight = 0, DarkRatio = 0;
+    	float threshold =
+    		thresholding::GetGlobalThreshold(histogram, 255, MeanDark, MeanLight, DarkRatio);
+    	float threshold_upper = MeanLight - ((MeanLight - threshold)* 0.2f);
+    	processimage::yellowFilter(img, filtered);
+    	for (int i = 0; i < pixels; i++)
+    	{
+    		unsigned char* p = &images[test][i * img.channels];
+    		if (p[0] > threshold_upper)
+    		{
+    			int b = p[0], g = p[1], r = p[2];
+    			int v = ((r+g+b)/3) - b - r - ((ABS(r - g) - ABS(r - b) - ABS(g - b))*10);
+    			if (v <= 0) filtered[(i * 3) + 1] = (unsigned char)r;
+    		}
+    	}
+
+    	int yellow_differences = 0, white_differences = 0;
+    	for (int i = 0; i < pixels; i++)
+    	{
+    		if (yellow[i] != filtered[i * 3]) yellow_differences++;
+    		if (white[i] != filtered[(i * 3) + 1]) white_differences++;
+    	}
+    	CHECK_INTS_EQUAL(0, yellow_differences);
+    	CHECK_INTS_EQUAL(0, white_differences);
+
+    	delete[] filtered;
+    	delete[] yellow;
+    	delete[] white;
+    }
+    delete[] histogram;
+    delete[] random_img;
+}
+
+
 TEST (detectLinesTest, MyTest)
 {
     int img_width = 640;
@@ -819,6 +1683,105 @@ TEST (colourToMonoTest, MyTest)
     delete[] colour_img;
 }
 
+TEST (thresholdingTest, MyTest)
+{
+    // two equal peaks are separated halfway between them
+    int histogram[256];
+    memset(histogram, 0, 256 * sizeof(int));
+    histogram[50] = 100;
+    histogram[200] = 100;
+    float MeanDark = 0, MeanLight = 0, DarkRatio = 0;
+    float threshold = thresholding::GetGlobalThreshold(histogram, 256, MeanDark, MeanLight, DarkRatio);
+    CHECK(threshold == 125);
+    CHECK(MeanDark == 50);
+    CHECK(MeanLight == 200);
+    CHECK(DarkRatio == 50);
+
+    // compare with the mean and variance of each class summed in single precision
+    // at every grey level.  This is exact for the small random histograms.  The last
+    // are whole frame histograms, far beyond 2^24 in total, where the means are
+    // within the documented tolerance.
+    srand(81);
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    float float_histogram[300];
+    int buffer[300];
+    for (int i = 0; i < 204; i++)
+    {
+    	bool whole_frame = (i >= 200);
+    	int histogram_length = 256;
+    	if (whole_frame)
+    	{
+    		memset(buffer, 0, 256 * sizeof(int));
+    		for (int n = 0; n < 640 * 480 * 3; n += 3)
+    			buffer[images[i - 200][n + 1]]++;
+    		for (int h = 0; h < histogram_length; h++)
+    			float_histogram[h] = (float)buffer[h];
+    	}
+    	else
+    	{
+    		histogram_length = 2 + (rand() % 298);
+    		for (int h = 0; h < histogram_length; h++)
+    		{
+    			buffer[h] = (rand() % 3 == 0) ? rand() % 200 : 0;
+    			float_histogram[h] = (float)buffer[h];
+    		}
+    	}
+
+    	float Tmin = 0, Tmax = 0, MinVariance = 999999;
+    	float ExpectedMeanDark = 0, ExpectedMeanLight = 0;
+    	for (int grey_level = 255; grey_level >= 0; grey_level--)
+    	{
+    		float DarkHits = 0, LightHits = 0, SumDark = 0, SumLight = 0, VarianceDark = 0, VarianceLight = 0;
+    		for (int h = histogram_length - 1; h >= 0; h--)
+    		{
+    			if (h < grey_level)
+    			{
+    				SumDark += h * float_histogram[h];
+    				VarianceDark += (grey_level - h) * float_histogram[h];
+    				DarkHits += float_histogram[h];
+    			}
+    			else
+    			{
+    				SumLight += h * float_histogram[h];
+    				VarianceLight += (grey_level - h) * float_histogram[h];
+    				LightHits += float_histogram[h];
+    			}
+    		}
+    		if (DarkHits > 0) { SumDark /= DarkHits; VarianceDark /= DarkHits; }
+    		if (LightHits > 0) { SumLight /= LightHits; VarianceLight /= LightHits; }
+    		float Variance = VarianceDark + VarianceLight;
+    		if (Variance < 0) Variance = -Variance;
+    		if (Variance < MinVariance)
+    		{
+    			MinVariance = Variance;
+    			Tmin = grey_level;
+    			ExpectedMeanDark = SumDark;
+    			ExpectedMeanLight = SumLight;
+    		}
+    		if ((int)(Variance * 1000) == (int)(MinVariance * 1000))
+    		{
+    			Tmax = grey_level;
+    			ExpectedMeanLight = SumLight;
+    		}
+    	}
+
+    	threshold = thresholding::GetGlobalThreshold(buffer, histogram_length, MeanDark, MeanLight, DarkRatio);
+    	CHECK(threshold == (Tmin + Tmax) / 2);
+    	if (whole_frame)
+    	{
+    		CHECK(ABS(MeanDark - ExpectedMeanDark) < 0.001f);
+    		CHECK(ABS(MeanLight - ExpectedMeanLight) < 0.001f);
+    	}
+    	else
+    	{
+    		CHECK(MeanDark == ExpectedMeanDark);
+    		CHECK(MeanLight == ExpectedMeanLight);
+    	}
+    	threshold = thresholding::GetGlobalThreshold(float_histogram, histogram_length, MeanDark, MeanLight, DarkRatio);
+    	CHECK(threshold == (Tmin + Tmax) / 2);
+    }
+}
+
 TEST (dilateTest, MyTest)
 {
 	int image_width = 6;
@@ -877,6 +1840,331 @@ TEST (erodeTest, MyTest)
     delete[] buffer;
 }
 
+/*!
+ * \brief compares erosion, dilation, opening and closing with a brute force
+ *        search of the clipped square window, including in place filtering
+ */
+TEST (rankFilterTest, MyTest)
+{
+	// single rows and columns have windows clipped on both sides
+	int widths[] = { 67, 1, 9 };
+	int heights[] = { 43, 9, 1 };
+	for (int size = 0; size < 3; size++)
+	{
+		int image_width = widths[size];
+		int image_height = heights[size];
+		int pixels = image_width * image_height;
+		unsigned char *mono_img = new unsigned char[pixels];
+		unsigned char *buffer = new unsigned char[pixels];
+		unsigned char *result = new unsigned char[pixels];
+		unsigned char *in_place = new unsigned char[pixels];
+		unsigned char *expected = new unsigned char[pixels];
+
+		srand(42);
+		for (int i = 0; i < pixels; i++)
+			mono_img[i] = (unsigned char)(rand() % 256);
+
+		int radii[] = { 1, 2, 3, 7, 25, 50 };
+		for (int r = 0; r < 6; r++)
+		{
+			int radius = radii[r];
+			for (int maximum = 0; maximum < 2; maximum++)
+			{
+				for (int y = 0; y < image_height; y++)
+				{
+					for (int x = 0; x < image_width; x++)
+					{
+						int v = maximum ? 0 : 255;
+						for (int yy = y - radius; yy <= y + radius; yy++)
+						{
+							if ((yy < 0) || (yy >= image_height)) continue;
+							for (int xx = x - radius; xx <= x + radius; xx++)
+							{
+								if ((xx < 0) || (xx >= image_width)) continue;
+								int p = mono_img[(yy * image_width) + xx];
+								if (maximum ? (p > v) : (p < v)) v = p;
+							}
+						}
+						expected[(y * image_width) + x] = (unsigned char)v;
+					}
+				}
+
+				memcpy(in_place, mono_img, pixels);
+				if (maximum)
+				{
+					processimage::Dilate(mono_img, image_width, image_height, buffer, radius, result);
+					processimage::Dilate(in_place, image_width, image_height, buffer, radius, in_place);
+				}
+				else
+				{
+					processimage::Erode(mono_img, image_width, image_height, buffer, radius, result);
+					processimage::Erode(in_place, image_width, image_height, buffer, radius, in_place);
+				}
+				CHECK(memcmp(result, expected, pixels) == 0);
+				CHECK(memcmp(in_place, expected, pixels) == 0);
+			}
+
+			// opening is an erosion followed by a dilation, and closing the reverse
+			processimage::Erode(mono_img, image_width, image_height, buffer, radius, expected);
+			processimage::Dilate(expected, image_width, image_height, buffer, radius, expected);
+			processimage::Opening(mono_img, image_width, image_height, buffer, radius, result);
+			CHECK(memcmp(result, expected, pixels) == 0);
+			processimage::Dilate(mono_img, image_width, image_height, buffer, radius, expected);
+			processimage::Erode(expected, image_width, image_height, buffer, radius, expected);
+			processimage::Closing(mono_img, image_width, image_height, buffer, radius, result);
+			CHECK(memcmp(result, expected, pixels) == 0);
+		}
+
+		delete[] expected;
+		delete[] in_place;
+		delete[] result;
+		delete[] buffer;
+		delete[] mono_img;
+	}
+}
+
+
+TEST (vectorKernelsTest, MyTest)
+{
+    // odd sizes exercise the scalar tails of the vectorised rows
+    int image_width = 341;
+    int image_height = 123;
+    unsigned char* img = new unsigned char[image_width * image_height * 4];
+    srand(200);
+    for (int i = 0; i < image_width * image_height * 4; i++)
+    	img[i] = (unsigned char)(rand() % 256);
+    memcpy(img, raw_image3, image_width * image_height * 3);
+    unsigned char* result = new unsigned char[image_width * image_height * 4];
+    unsigned char* expected = new unsigned char[image_width * image_height * 4];
+
+    for (int channels = 3; channels <= 4; channels++)
+    {
+    	for (int conversion_type = 0; conversion_type < 2; conversion_type++)
+    	{
+    		image_view view = imageview::Create(img, image_width, image_height, channels);
+    		processimage::monoImage(view, conversion_type, false, expected);
+    		processimage::monoImage(view, conversion_type, true, result);
+    		CHECK(memcmp(result, expected, image_width * image_height) == 0);
+    	}
+    }
+
+    for (int bytes_per_pixel = 1; bytes_per_pixel <= 4; bytes_per_pixel++)
+    {
+    	for (int factor = 2; factor <= 5; factor++)
+    	{
+    		// the last row and column are not written, so both start the same
+    		memset(expected, 7, image_width * image_height * 4);
+    		memset(result, 7, image_width * image_height * 4);
+    		processimage::downSample(img, image_width, image_height, bytes_per_pixel, factor, false, expected);
+    		processimage::downSample(img, image_width, image_height, bytes_per_pixel, factor, true, result);
+    		CHECK(memcmp(result, expected, image_width * image_height * 4) == 0);
+    	}
+    }
+
+    // each output is the truncated mean of its block
+    processimage::downSample(img, image_width, image_height, 3, 4, result);
+    int x = 17, y = 9, col = 2, v = 0;
+    for (int yy = 0; yy < 4; yy++)
+    	for (int xx = 0; xx < 4; xx++)
+    		v += img[((((y * 4) + yy) * image_width) + (x * 4) + xx) * 3 + col];
+    CHECK_INTS_EQUAL(v / 16, (int)result[(((y * (image_width / 4)) + x) * 3) + col]);
+
+    // edges from the vectorised gaussian and gradient passes are identical
+    CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+    for (int bytes_per_pixel = 1; bytes_per_pixel <= 3; bytes_per_pixel += 2)
+    {
+    	edge_detector->vector_kernels = false;
+    	edge_detector->Update(img, image_width, image_height, bytes_per_pixel);
+    	std::vector<int> expected_edges = edge_detector->edges;
+    	edge_detector->vector_kernels = true;
+    	edge_detector->Update(img, image_width, image_height, bytes_per_pixel);
+    	CHECK((int)expected_edges.size() > 0);
+    	CHECK(edge_detector->edges == expected_edges);
+    }
+    delete edge_detector;
+
+    delete[] expected;
+    delete[] result;
+    delete[] img;
+}
+
+TEST (cannyThreadsTest, MyTest)
+{
+    // edges found over bands on several threads are the same as from a single thread
+    int image_width = 341;
+    int image_height = 123;
+    unsigned char* img = new unsigned char[image_width * image_height * 3];
+    memcpy(img, raw_image3, image_width * image_height * 3);
+    unsigned char* expected = new unsigned char[image_width * image_height * 3];
+
+    CannyEdgeDetector *serial = new CannyEdgeDetector();
+    CannyEdgeDetector *banded = new CannyEdgeDetector();
+    for (int bytes_per_pixel = 1; bytes_per_pixel <= 3; bytes_per_pixel += 2)
+    {
+    	serial->Update(img, image_width, image_height, bytes_per_pixel);
+    	memcpy(expected, serial->EdgesImage(), image_width * image_height * bytes_per_pixel);
+    	CHECK((int)serial->edges.size() > 0);
+    	for (int no_of_threads = 2; no_of_threads <= 8; no_of_threads *= 2)
+    	{
+    		banded->no_of_threads = no_of_threads;
+    		banded->Update(img, image_width, image_height, bytes_per_pixel);
+    		unsigned char* result = banded->EdgesImage();
+    		CHECK(banded->edges == serial->edges);
+    		CHECK(memcmp(result, expected, image_width * image_height * bytes_per_pixel) == 0);
+    	}
+    }
+
+    // images with fewer rows than bands
+    banded->no_of_threads = 8;
+    serial->Update(img, image_width, 5, 1);
+    banded->Update(img, image_width, 5, 1);
+    CHECK(banded->edges == serial->edges);
+
+    delete serial;
+    delete banded;
+    delete[] expected;
+    delete[] img;
+}
+
+TEST (cannyHysteresisTest, MyTest)
+{
+    // a weak vertical edge continues on from a strong one, and
+    // a second weak edge of the same contrast stands alone
+    int image_width = 200;
+    int image_height = 100;
+    unsigned char* img = new unsigned char[image_width * image_height];
+    for (int y = 0; y < image_height; y++)
+    {
+    	for (int x = 0; x < image_width; x++)
+    	{
+    		int v = 50;
+    		if ((x >= 50) && (x < 100)) v = (y < 40) ? 250 : 104;
+    		if (x >= 150) v = 104;
+    		img[(y * image_width) + x] = (unsigned char)v;
+    	}
+    }
+
+    CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+    for (int no_of_threads = 1; no_of_threads <= 4; no_of_threads += 3)
+    {
+    	edge_detector->no_of_threads = no_of_threads;
+    	edge_detector->Update(img, image_width, image_height, 1);
+    	int connected = 0, isolated = 0;
+    	for (int i = 0; i < (int)edge_detector->edges.size(); i += 2)
+    	{
+    		int x = edge_detector->edges[i];
+    		int y = edge_detector->edges[i + 1];
+    		if ((y >= 60) && (y < 80))
+    		{
+    			if ((x >= 45) && (x < 55)) connected++;
+    			if ((x >= 145) && (x < 155)) isolated++;
+    		}
+    	}
+    	CHECK_INTS_EQUAL(20, connected);
+    	CHECK_INTS_EQUAL(0, isolated);
+    }
+    delete edge_detector;
+    delete[] img;
+}
+
+TEST (cannyFixedPointTest, MyTest)
+{
+    // edges from the fixed point version are compared against those from
+    // the floating point version.  On these images around 99% are identical,
+    // and at least 99% lie within a pixel of an edge from the other version.
+    int image_width = 640;
+    int image_height = 480;
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    unsigned char* nearby = new unsigned char[image_width * image_height];
+    CannyEdgeDetector *floating = new CannyEdgeDetector();
+    CannyEdgeDetector *fixed = new CannyEdgeDetector();
+    fixed->fixed_point = true;
+    for (int test = 0; test < 4; test++)
+    {
+    	floating->Update(images[test], image_width, image_height, 3);
+    	fixed->Update(images[test], image_width, image_height, 3);
+    	int floating_edges = (int)floating->edges.size() / 2;
+    	int fixed_edges = (int)fixed->edges.size() / 2;
+    	CHECK(floating_edges > 0);
+
+    	// mark pixels within one pixel of a floating point edge
+    	memset(nearby, 0, image_width * image_height);
+    	for (int i = 0; i < (int)floating->edges.size(); i += 2)
+    	{
+    		int x = floating->edges[i];
+    		int y = floating->edges[i + 1];
+    		nearby[(y * image_width) + x] |= 2;
+    		for (int yy = y - 1; yy <= y + 1; yy++)
+    			for (int xx = x - 1; xx <= x + 1; xx++)
+    				nearby[(yy * image_width) + xx] |= 1;
+    	}
+    	int identical = 0, near = 0;
+    	for (int i = 0; i < (int)fixed->edges.size(); i += 2)
+    	{
+    		unsigned char v = nearby[(fixed->edges[i + 1] * image_width) + fixed->edges[i]];
+    		if (v & 2) identical++;
+    		if (v & 1) near++;
+    	}
+    	CHECK(identical * 100 >= fixed_edges * 97);
+    	CHECK(near * 100 >= fixed_edges * 99);
+    	CHECK(fixed_edges * 100 >= floating_edges * 98);
+    	CHECK(fixed_edges * 100 <= floating_edges * 102);
+
+    	// integer arithmetic gives the same edges with or without vectors or threads
+    	std::vector<int> expected_edges = fixed->edges;
+    	fixed->vector_kernels = false;
+    	fixed->Update(images[test], image_width, image_height, 3);
+    	fixed->vector_kernels = true;
+    	CHECK(fixed->edges == expected_edges);
+    	fixed->no_of_threads = 3;
+    	fixed->Update(images[test], image_width, image_height, 3);
+    	fixed->no_of_threads = 1;
+    	CHECK(fixed->edges == expected_edges);
+    }
+    delete floating;
+    delete fixed;
+    delete[] nearby;
+}
+
+TEST (cannySparseEdgesTest, MyTest)
+{
+    // the edges image is drawn from the sparse edges when requested,
+    // and edges left from one update do not affect the next
+    int image_width = 640;
+    int image_height = 480;
+    CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+    edge_detector->Update(raw_image1, image_width, image_height, 3);
+    std::vector<int> expected_edges = edge_detector->edges;
+    CHECK((int)expected_edges.size() > 0);
+
+    edge_detector->Update(raw_image2, image_width, 100, 1);
+    edge_detector->Update(raw_image1, image_width, image_height, 3);
+    CHECK(edge_detector->edges == expected_edges);
+
+    unsigned char* edges_image = edge_detector->EdgesImage();
+    int dark = 0;
+    for (int i = 0; i < image_width * image_height * 3; i++)
+    	if (edges_image[i] == 0) dark++;
+    CHECK_INTS_EQUAL((int)expected_edges.size() / 2 * 3, dark);
+    int not_drawn = 0;
+    for (int i = 0; i < (int)expected_edges.size(); i += 2)
+    {
+    	int n = ((expected_edges[i + 1] * image_width) + expected_edges[i]) * 3;
+    	if ((edges_image[n] != 0) || (edges_image[n + 1] != 0) || (edges_image[n + 2] != 0)) not_drawn++;
+    }
+    CHECK_INTS_EQUAL(0, not_drawn);
+
+    // edges are in raster order, last pixel first
+    int out_of_order = 0;
+    for (int i = 2; i < (int)expected_edges.size(); i += 2)
+    {
+    	int previous = (expected_edges[i - 1] * image_width) + expected_edges[i - 2];
+    	int current = (expected_edges[i + 1] * image_width) + expected_edges[i];
+    	if (current >= previous) out_of_order++;
+    }
+    CHECK_INTS_EQUAL(0, out_of_order);
+    delete edge_detector;
+}
 
 TEST (downSampleMonoTest, MyTest)
 {
@@ -990,6 +2278,121 @@ TEST (AnprReadTest, MyTest)
     delete[] average_model;
 }
 
+TEST (AnprReadDirectoryTest, MyTest)
+{
+    // a directory read with several threads reports the same results, in the same order, as one
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    mkdir("read_directory_test", 0755);
+    for (int i = 0; i < 4; i++)
+    {
+    	std::stringstream s_filename;
+    	s_filename << "read_directory_test/" << i << ".bmp";
+    	Bitmap *bmp = new Bitmap(images[i], 640, 480, 3);
+    	bmp->Save(s_filename.str().c_str());
+    	delete bmp;
+    }
+
+    int model_image_width = 20;
+    int model_image_height = 20;
+    std::vector<float*> models;
+    float* average_model = new float[model_image_width * model_image_height];
+
+    std::string output[3];
+    std::vector<std::string> numbers[3];
+    int threads[] = { 1, 3, 3 };
+    int prefetch_depth[] = { 0, 0, ANPR_PREFETCH_DEPTH };
+    std::streambuf* console = cout.rdbuf();
+    for (int run = 0; run < 3; run++)
+    {
+    	std::stringstream log;
+    	cout.rdbuf(log.rdbuf());
+    	anpr::ReadDirectory("read_directory_test", false, numbers[run], false,
+    	                    model_image_width, model_image_height, models, average_model,
+    	                    threads[run], prefetch_depth[run], 1);
+    	cout.rdbuf(console);
+    	output[run] = log.str();
+    }
+
+    CHECK(output[0].find("3.bmp") != std::string::npos);
+    for (int run = 1; run < 3; run++)
+    {
+    	CHECK(output[run] == output[0]);
+    	CHECK(numbers[run] == numbers[0]);
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+    	std::stringstream s_filename;
+    	s_filename << "read_directory_test/" << i << ".bmp";
+    	remove(s_filename.str().c_str());
+    }
+    rmdir("read_directory_test");
+    delete[] average_model;
+}
+
+TEST (AnprCharactersTest, MyTest)
+{
+    // number of characters separated from the plates of each test image,
+    // after stragglers are removed, as anpr::Read would recognise them
+    unsigned char* images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    int expected_characters[] = { 13, 13, 17, 9 };
+
+    for (int img = 0; img < 4; img++)
+    {
+        std::vector<polygon2D*> plates;
+        std::vector<unsigned char*> debug_images;
+        int debug_image_width = 0;
+        int debug_image_height = 0;
+        platedetection::Find(
+            images[img], 640, 480,
+            plates, false, debug_images,
+            debug_image_width, debug_image_height,
+            "");
+
+        int plate_image_width = 200;
+        std::vector<int> plate_image_height;
+        std::vector<unsigned char*> plate_images;
+        platedetection::ExtractPlateImages(
+            imageview::Create(images[img], 640, 480, 3),
+            plates,
+            plate_image_width,
+            plate_image_height,
+            plate_images);
+
+        std::vector<bit_image*> binary_images;
+        platereader::Binarise(plate_image_width, plate_image_height, plate_images, binary_images);
+
+        std::vector<std::vector<unsigned char*> > characters;
+        std::vector<std::vector<int> > characters_dimensions;
+        std::vector<std::vector<int> > characters_positions;
+        platereader::SeparateCharacters(
+            2.5f,
+            plate_image_width,
+            plate_image_height,
+            binary_images,
+            characters,
+            characters_dimensions,
+            characters_positions);
+
+        int total = 0;
+        for (int p = 0; p < (int)characters.size(); p++)
+        {
+        	platereader::RemoveStragglers(characters_dimensions[p], characters_positions[p], characters[p]);
+        	total += (int)characters[p].size();
+        	for (int c = 0; c < (int)characters[p].size(); c++)
+        		delete[] characters[p][c];
+        }
+        CHECK_INTS_EQUAL(expected_characters[img], total);
+
+        for (int i = 0; i < (int)plate_images.size(); i++)
+        	delete[] plate_images[i];
+        for (int i = 0; i < (int)binary_images.size(); i++)
+        	bitimage::Free(binary_images[i]);
+        for (int i = 0; i < (int)plates.size(); i++)
+        	delete plates[i];
+    }
+}
+
 #endif
 
 #endif
@@ -0,0 +1,340 @@
+/*
+    throughput and latency benchmark
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+
+/*!
+ * \brief returns the monotonic clock time in milliseconds
+ */
+double benchmark::Time()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return((now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0));
+}
+
+/*!
+ * \brief returns the peak resident set size of this process in kilobytes
+ */
+long benchmark::PeakRSS()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return(usage.ru_maxrss);
+}
+
+/*!
+ * \brief writes one line of latency statistics
+ * \param name name of the pipeline or kernel
+ * \param latency per call durations in milliseconds
+ * \param out stream to write to
+ */
+void benchmark::ReportLatency(
+    std::string name,
+    std::vector<float> &latency,
+    std::ostream &out)
+{
+	double total = 0;
+	for (int i = 0; i < (int)latency.size(); i++)
+		total += latency[i];
+
+	float fps = 0;
+	if (total > 0) fps = (float)(latency.size() * 1000.0 / total);
+
+	char line[128];
+	sprintf(line, "%-20s %8d %10.2f %10.3f %10.3f %10.3f %10.3f",
+	        name.c_str(), (int)latency.size(), fps,
+	        total / latency.size(),
+	        profiler::Percentile(latency, 50),
+	        profiler::Percentile(latency, 95),
+	        profiler::Percentile(latency, 99));
+	out << line << endl;
+}
+
+/*!
+ * \brief times the complete anpr::Read pipeline on every frame
+ * \param frames images to be processed
+ * \param iterations number of timed passes over all frames
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param out stream to write to
+ */
+void benchmark::Pipeline(
+    std::vector<benchmark_frame> &frames,
+    int iterations,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::ostream &out)
+{
+	DetectionContext *context = new DetectionContext();
+	std::vector<float> latency;
+	int character_index = 0;
+
+	// the first pass warms up caches and sizes the context buffers
+	for (int iteration = -1; iteration < iterations; iteration++)
+	{
+		for (int f = 0; f < (int)frames.size(); f++)
+		{
+			std::vector<polygon2D*> plates;
+			std::vector<std::string> numbers;
+			std::stringstream log;
+
+			double start_time = Time();
+			anpr::Read(
+			    frames[f].data,
+			    frames[f].width, frames[f].height,
+			    plates,
+			    numbers,
+			    false,
+			    character_index,
+			    model_image_width,
+			    model_image_height,
+			    models,
+			    average_model,
+			    "",
+			    context,
+			    log);
+			if (iteration > -1) latency.push_back((float)(Time() - start_time));
+
+			for (int i = 0; i < (int)plates.size(); i++)
+				delete plates[i];
+		}
+	}
+
+	ReportLatency("anpr::Read", latency, out);
+	delete context;
+}
+
+/*!
+ * \brief times the major image processing kernels individually on every frame
+ * \param frames images to be processed
+ * \param iterations number of timed passes over all frames
+ * \param out stream to write to
+ */
+void benchmark::Kernels(
+    std::vector<benchmark_frame> &frames,
+    int iterations,
+    std::ostream &out)
+{
+	const char* kernel_names[] = {
+		"ColourFilter", "monoImage", "downSample", "Erode", "Dilate", "Canny"
+	};
+	std::vector<float> latency[BENCHMARK_KERNELS];
+
+	int max_pixels = 0;
+	for (int f = 0; f < (int)frames.size(); f++)
+		if (frames[f].width * frames[f].height > max_pixels)
+			max_pixels = frames[f].width * frames[f].height;
+
+	unsigned char* colour_buffer = new unsigned char[max_pixels * 3];
+	unsigned char* mono = new unsigned char[max_pixels];
+	unsigned char* mono_buffer = new unsigned char[max_pixels];
+	unsigned char* result = new unsigned char[max_pixels];
+	CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+
+	for (int iteration = -1; iteration < iterations; iteration++)
+	{
+		for (int f = 0; f < (int)frames.size(); f++)
+		{
+			unsigned char* img = frames[f].data;
+			int w = frames[f].width;
+			int h = frames[f].height;
+			double t[BENCHMARK_KERNELS + 1];
+
+			t[0] = Time();
+			platedetection::ColourFilter(
+				imageview::Create(img, w, h, 3), colour_buffer, colour_buffer + max_pixels);
+			t[1] = Time();
+			processimage::monoImage(img, w, h, 1, mono);
+			t[2] = Time();
+			processimage::downSample(img, w, h, 3, 2, colour_buffer);
+			t[3] = Time();
+			processimage::Erode(mono, w, h, mono_buffer, 3, result);
+			t[4] = Time();
+			processimage::Dilate(mono, w, h, mono_buffer, 3, result);
+			t[5] = Time();
+			edge_detector->Update(mono, w, h, 1);
+			t[6] = Time();
+
+			if (iteration > -1)
+				for (int k = 0; k < BENCHMARK_KERNELS; k++)
+					latency[k].push_back((float)(t[k + 1] - t[k]));
+		}
+	}
+
+	for (int k = 0; k < BENCHMARK_KERNELS; k++)
+		ReportLatency(kernel_names[k], latency[k], out);
+
+	delete edge_detector;
+	delete[] result;
+	delete[] mono_buffer;
+	delete[] mono;
+	delete[] colour_buffer;
+}
+
+/*!
+ * \brief compares the scalar and vectorised mono conversion and downsampling
+ *        kernels on a 1080p frame enlarged from the given image
+ * \param frame image to be enlarged
+ * \param iterations number of timed calls of each kernel
+ * \param out stream to write to
+ */
+void benchmark::Resampling(
+    benchmark_frame &frame,
+    int iterations,
+    std::ostream &out)
+{
+	const char* kernel_names[] = {
+		"monoImage 3", "monoImage 4", "downSample 1 x2", "downSample 3 x2", "downSample 1 x4", "downSample 3 x4"
+	};
+	int w = BENCHMARK_HD_WIDTH;
+	int h = BENCHMARK_HD_HEIGHT;
+	int pixels = w * h;
+
+	unsigned char* colour = new unsigned char[pixels * 3];
+	unsigned char* colour4 = new unsigned char[pixels * 4];
+	unsigned char* mono = new unsigned char[pixels];
+	unsigned char* result = new unsigned char[pixels * 4];
+	processimage::downSample(frame.data, frame.width, frame.height, 3, w, h, 3, colour);
+	for (int i = 0; i < pixels; i++)
+	{
+		memcpy(&colour4[i * 4], &colour[i * 3], 3);
+		colour4[(i * 4) + 3] = 255;
+	}
+	processimage::monoImage(colour, w, h, 0, mono);
+
+	double mean[2][BENCHMARK_RESAMPLING];
+	for (int vectorised = 0; vectorised < 2; vectorised++)
+	{
+		bool vectorise = (vectorised == 1);
+		for (int k = 0; k < BENCHMARK_RESAMPLING; k++)
+		{
+			double start_time = 0;
+			for (int iteration = -1; iteration < iterations; iteration++)
+			{
+				// the first call warms up the caches
+				if (iteration == 0) start_time = Time();
+				switch (k)
+				{
+				    case 0: { processimage::monoImage(imageview::Create(colour, w, h, 3), 1, vectorise, result); break; }
+				    case 1: { processimage::monoImage(imageview::Create(colour4, w, h, 4), 1, vectorise, result); break; }
+				    case 2: { processimage::downSample(mono, w, h, 1, 2, vectorise, result); break; }
+				    case 3: { processimage::downSample(colour, w, h, 3, 2, vectorise, result); break; }
+				    case 4: { processimage::downSample(mono, w, h, 1, 4, vectorise, result); break; }
+				    case 5: { processimage::downSample(colour, w, h, 3, 4, vectorise, result); break; }
+				}
+			}
+			mean[vectorised][k] = (Time() - start_time) / iterations;
+		}
+	}
+
+	char line[128];
+	sprintf(line, "%-20s %10s %10s %10s", "1080p (mSec)", "scalar", "vector", "speedup");
+	out << line << endl;
+	for (int k = 0; k < BENCHMARK_RESAMPLING; k++)
+	{
+		float speedup = 0;
+		if (mean[1][k] > 0) speedup = (float)(mean[0][k] / mean[1][k]);
+		sprintf(line, "%-20s %10.3f %10.3f %9.2fx", kernel_names[k], mean[0][k], mean[1][k], speedup);
+		out << line << endl;
+	}
+
+	delete[] result;
+	delete[] mono;
+	delete[] colour4;
+	delete[] colour;
+}
+
+/*!
+ * \brief runs the benchmark and writes the results
+ * \param frames images to be processed, such as the built in test images
+ * \param directory optional directory of bitmaps to be added to the frames
+ * \param iterations number of timed passes over all frames, after one warm up pass
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param out stream to write to
+ */
+void benchmark::Run(
+    std::vector<benchmark_frame> &frames,
+    std::string directory,
+    int iterations,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::ostream &out)
+{
+	std::vector<Bitmap*> bitmaps;
+	std::vector<benchmark_frame> all_frames = frames;
+
+	if (directory != "")
+	{
+		std::vector<std::string> filenames;
+		anpr::GetFilesInDirectory(directory, filenames);
+		for (int i = 0; i < (int)filenames.size(); i++)
+		{
+			Bitmap *bmp = new Bitmap();
+			if ((bmp->FromFile(directory + "/" + filenames[i])) &&
+				(bmp->bytes_per_pixel == 3))
+			{
+				benchmark_frame frame;
+				frame.name = filenames[i];
+				frame.data = bmp->Data;
+				frame.width = bmp->Width;
+				frame.height = bmp->Height;
+				all_frames.push_back(frame);
+				bitmaps.push_back(bmp);
+			}
+			else
+			{
+				out << "Cannot load " << filenames[i] << endl;
+				delete bmp;
+			}
+		}
+	}
+
+	if ((int)all_frames.size() == 0)
+	{
+		out << "No images to benchmark" << endl;
+		return;
+	}
+
+	out << "Benchmark: " << (int)all_frames.size() << " images, " <<
+	       iterations << " iterations" << endl;
+
+	char line[128];
+	sprintf(line, "%-20s %8s %10s %10s %10s %10s %10s",
+	        "latency (mSec)", "calls", "fps", "mean", "p50", "p95", "p99");
+	out << line << endl;
+
+	Pipeline(all_frames, iterations, model_image_width, model_image_height, models, average_model, out);
+	Kernels(all_frames, iterations, out);
+	if (iterations > 0) Resampling(all_frames[0], iterations, out);
+
+	out << "Peak RSS: " << PeakRSS() << " KB" << endl;
+
+	for (int i = 0; i < (int)bitmaps.size(); i++)
+		delete bitmaps[i];
+}
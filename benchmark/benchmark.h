@@ -0,0 +1,109 @@
+/*
+    throughput and latency benchmark
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../utils/bitmap.h"
+#include "../utils/processimage.h"
+#include "../utils/profiler.h"
+#include "../edgedetection/CannyEdgeDetector.h"
+#include "../platedetection/platedetection.h"
+#include "../platedetection/anpr.h"
+
+// individually timed kernels
+#define BENCHMARK_COLOUR_FILTER   0
+#define BENCHMARK_MONO            1
+#define BENCHMARK_DOWNSAMPLE      2
+#define BENCHMARK_ERODE           3
+#define BENCHMARK_DILATE          4
+#define BENCHMARK_CANNY           5
+#define BENCHMARK_KERNELS         6
+
+// size of the frame used to compare the scalar and vectorised resampling kernels
+#define BENCHMARK_HD_WIDTH     1920
+#define BENCHMARK_HD_HEIGHT    1080
+#define BENCHMARK_RESAMPLING      6
+
+/*!
+ * \brief a single image used by the benchmark
+ */
+struct benchmark_frame
+{
+	std::string name;
+	unsigned char* data;
+	int width;
+	int height;
+};
+
+/*!
+ * \brief measures frames per second and per frame latency of the whole
+ *        anpr::Read pipeline and of its major kernels
+ */
+class benchmark
+{
+private:
+	static double Time();
+
+	static void ReportLatency(
+	    std::string name,
+	    std::vector<float> &latency,
+	    std::ostream &out);
+
+	static void Pipeline(
+	    std::vector<benchmark_frame> &frames,
+	    int iterations,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::ostream &out);
+
+	static void Kernels(
+	    std::vector<benchmark_frame> &frames,
+	    int iterations,
+	    std::ostream &out);
+
+	static void Resampling(
+	    benchmark_frame &frame,
+	    int iterations,
+	    std::ostream &out);
+
+public:
+	static long PeakRSS();
+
+	static void Run(
+	    std::vector<benchmark_frame> &frames,
+	    std::string directory,
+	    int iterations,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::ostream &out);
+};
+
+#endif /* BENCHMARK_H_ */
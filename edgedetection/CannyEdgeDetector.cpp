@@ -36,6 +36,8 @@ CannyEdgeDetector::CannyEdgeDetector()
 	image.Width = 0;
 	image.Height = 0;
 	image.BytesPerPixel = 0;
+	image.Data = NULL;
+	source = imageview::Create(NULL, 0, 0, 0);
 	kernel.Size = 0;
 	diffKernel.Size = 0;
 	picSize = 0;
@@ -56,9 +58,31 @@ CannyEdgeDetector::CannyEdgeDetector()
 	yGradient		 = NULL;
 	kernel.Data		 = NULL;
 	diffKernel.Data	 = NULL;
-    edge_pixel_index = NULL;
     edge_magnitude   = NULL;
     edgesImage       = NULL;
+    edges_image_size = 0;
+    edges_image_drawn = false;
+
+	edge_state		 = NULL;
+	edge_state_size	 = 0;
+	kernel_fixed	 = NULL;
+	diff_kernel_fixed = NULL;
+	fixed_gradient_scale = 1;
+	luminance		 = NULL;
+	xConvFixed		 = NULL;
+	yConvFixed		 = NULL;
+	xGradientFixed	 = NULL;
+	yGradientFixed	 = NULL;
+	fixed_point		 = false;
+	vector_kernels	 = true;
+	low_magnitude	 = 0;
+	high_magnitude	 = 0;
+
+	no_of_threads	 = 1;
+	pool			 = NULL;
+	bands			 = NULL;
+	no_of_bands		 = 0;
+	stage			 = 0;
 
 	// Initalise kernel size's to be zero
 	kernel.Size = 0;
@@ -70,7 +94,7 @@ CannyEdgeDetector::CannyEdgeDetector()
  * \param image_width width of the image
  * \param image_height height of the image
  */
-unsigned char* CannyEdgeDetector::Update(
+void CannyEdgeDetector::Update(
     unsigned char* data,
     int image_width,
     int image_height,
@@ -83,8 +107,6 @@ unsigned char* CannyEdgeDetector::Update(
 	img.BytesPerPixel = bytes_per_pixel;
 
 	Update(img);
-
-	return(edgesImage);
 }
 
 /*! \brief The main update routine
@@ -92,15 +114,23 @@ unsigned char* CannyEdgeDetector::Update(
  */
 void CannyEdgeDetector::Update(Image sourceImage)
 {
-	bool reinitialise = false;
-	if ((sourceImage.Width != image.Width) ||
-		(sourceImage.Height != image.Height))
-		reinitialise = true;
-
-	image = sourceImage;
-	int low = 0;
-	int high = 0;
+	Update(imageview::Create(sourceImage.Data, sourceImage.Width, sourceImage.Height, sourceImage.BytesPerPixel));
+}
 
+/*! \brief The main update routine for images which may be padded, bottom up or part of a larger image.
+ *         The followed edges are returned in edges, and an image of them by EdgesImage.
+ * \param sourceImage The image to be processed, with one byte per pixel or three or more in BGR order
+ */
+void CannyEdgeDetector::Update(const image_view &sourceImage)
+{
+	// clear the edges of the previous update while the image size is unchanged
+	ClearEdges();
+
+	source = sourceImage;
+	image.Data = sourceImage.data;
+	image.Width = sourceImage.width;
+	image.Height = sourceImage.height;
+	image.BytesPerPixel = sourceImage.channels;
 	// Adjust thresholds automatically
 	if(automaticThresholds)
 	{
@@ -109,36 +139,137 @@ void CannyEdgeDetector::Update(Image sourceImage)
 
 	picSize = image.Width * image.Height;
 
-	initArrays();
-	ReadLuminance();
-	int no_of_edges = ComputeGradients(gaussianKernelRadius, gaussianKernelWidth);
+	low_magnitude = (int)roundf(lowThreshold * MAGNITUDE_SCALE);
+	high_magnitude = (int)roundf(highThreshold * MAGNITUDE_SCALE);
+	if (fixed_point)
+	{
+		low_magnitude = FixedThreshold(low_magnitude);
+		high_magnitude = FixedThreshold(high_magnitude);
+	}
 
-	low = (int)roundf(lowThreshold * MAGNITUDE_SCALE);
-	high = (int)roundf(highThreshold * MAGNITUDE_SCALE);
+	if (no_of_threads > 1)
+	{
+		UpdateBands();
+
+		// gather the edges in the same order as a single band
+		int no_of_edges = 0;
+		for (int b = 0; b < no_of_bands; b++)
+			no_of_edges += (int)bands[b].suppressed.size();
+		followed_edges.reserve(no_of_edges);
+		edges.reserve(no_of_edges * 2);
+		for (int b = no_of_bands - 1; b >= 0; b--)
+			GatherEdges(bands[b].suppressed);
+	}
+	else
+	{
+		initArrays();
+		ReadLuminance();
+		ComputeGradients(gaussianKernelRadius, gaussianKernelWidth);
+		PerformHysteresis(suppressed, 0, image.Height, follow_stack, NULL);
+		followed_edges.reserve(suppressed.size());
+		edges.reserve(suppressed.size() * 2);
+		GatherEdges(suppressed);
+	}
+}
 
-	PerformHysteresis(low, high, data, no_of_edges);
-	thresholdEdges();
+/*! \brief runs each stage of the update over bands of rows on the thread pool,
+ *         leaving the followed edges in the CANNY_STATE_EDGE state
+ */
+void CannyEdgeDetector::UpdateBands()
+{
+	if ((pool == NULL) || (pool->Threads() != no_of_threads))
+	{
+		if (pool != NULL) delete pool;
+		pool = new ThreadPool(no_of_threads);
+	}
 
-    // create an image showing the edges
-    int pixels = image.Width * image.Height * image.BytesPerPixel;
+	int bands_needed = no_of_threads * CANNY_BANDS_PER_THREAD;
+	if (bands_needed > (int)image.Height) bands_needed = image.Height;
+	if (bands_needed < 1) bands_needed = 1;
+	if (bands_needed != no_of_bands)
+	{
+		if (bands != NULL) delete[] bands;
+		bands = new canny_band[bands_needed];
+		no_of_bands = bands_needed;
+	}
+	for (int b = 0; b < no_of_bands; b++)
+	{
+		bands[b].start_y = b * (int)image.Height / no_of_bands;
+		bands[b].end_y = (b + 1) * (int)image.Height / no_of_bands;
+		bands[b].suppressed.reserve((bands[b].end_y - bands[b].start_y) * image.Width / CANNY_SUPPRESSED_RESERVE);
+	}
 
-    if ((edgesImage == NULL) || (reinitialise))
-    {
-    	if (edgesImage != NULL) delete[] edgesImage;
-        edgesImage = new unsigned char[pixels];
-    }
+	allocateArrays();
+	CreateMasks(gaussianKernelRadius, gaussianKernelWidth);
 
-    for (int i = pixels-1; i >= 0; i--) edgesImage[i] = 255;
+	// each stage reads rows written by neighbouring bands in the previous stage
+	for (stage = CANNY_STAGE_LUMINANCE; stage <= CANNY_STAGE_SUPPRESS; stage++)
+		pool->Run(no_of_bands, UpdateBand, this);
 
-    for (int i = 0; i < (int)edges.size(); i += 2)
-    {
-        int x = edges[i];
-        int y = edges[i + 1];
+	// follow edges within each band, then continue following those
+	// which cross into neighbouring bands
+	stage = CANNY_STAGE_HYSTERESIS;
+	pool->Run(no_of_bands, UpdateBand, this);
+	for (int b = 0; b < no_of_bands; b++)
+	{
+		std::vector<int> &crossings = bands[b].crossings;
+		for (int i = (int)crossings.size() - 1; i >= 0; i--)
+		{
+			if (edge_state[crossings[i]] == CANNY_STATE_CANDIDATE)
+				Follow(crossings[i], 0, picSize, follow_stack, NULL);
+		}
+	}
+}
 
-        int n = ((y * image.Width) + x) * image.BytesPerPixel;
-        for (int col = 0; col < image.BytesPerPixel; col++)
-            edgesImage[n + col] = 0;
-    }
+/*! \brief runs the current stage of a multi-threaded update on one band
+ * \param detector edge detector being updated
+ * \param band index of the band
+ */
+void CannyEdgeDetector::UpdateBand(void *detector, int band)
+{
+	CannyEdgeDetector *canny = (CannyEdgeDetector*)detector;
+	canny_band &b = canny->bands[band];
+
+	switch(canny->stage)
+	{
+		case CANNY_STAGE_LUMINANCE:
+		{
+			canny->clearArrays(b.start_y, b.end_y);
+			canny->ReadLuminance(b.start_y, b.end_y);
+			break;
+		}
+		case CANNY_STAGE_CONVOLVE:
+		{
+			if (canny->fixed_point)
+				canny->ConvolveFixed(b.start_y, b.end_y);
+			else
+				canny->Convolve(b.start_y, b.end_y);
+			break;
+		}
+		case CANNY_STAGE_DIFFERENTIATE:
+		{
+			if (canny->fixed_point)
+				canny->DifferentiateFixed(b.start_y, b.end_y);
+			else
+				canny->Differentiate(b.start_y, b.end_y);
+			break;
+		}
+		case CANNY_STAGE_SUPPRESS:
+		{
+			b.suppressed.clear();
+			if (canny->fixed_point)
+				canny->SuppressFixed(b.start_y, b.end_y, b.suppressed);
+			else
+				canny->Suppress(b.start_y, b.end_y, b.suppressed);
+			break;
+		}
+		case CANNY_STAGE_HYSTERESIS:
+		{
+			b.crossings.clear();
+			canny->PerformHysteresis(b.suppressed, b.start_y, b.end_y, b.stack, &b.crossings);
+			break;
+		}
+	}
 }
 
 /*! \brief Automatically discover appropriate high and low thresholds
@@ -158,18 +289,20 @@ void CannyEdgeDetector::AutoThreshold(int samplingStepSize)
 
 	for(unsigned int y = ty; y <= by; y += samplingStepSize)
 	{
-		unsigned int n = (y * image.Width) + tx;
+		unsigned char* row = imageview::Row(source, y);
+		unsigned int n = tx;
 
+		// consecutive pixels are sampled, one for each step along the row
 		if(image.BytesPerPixel == 1)
 		{
 			for (unsigned int x = tx; x <= bx; x += samplingStepSize, n++)
-				histogram[image.Data[n]]++;
+				histogram[row[n]]++;
 		}
 		else
 		{
 			n *= image.BytesPerPixel;
 			for (unsigned int x = tx; x <= bx; x += samplingStepSize, n += image.BytesPerPixel)
-				histogram[image.Data[n + 2]]++;
+				histogram[row[n + 2]]++;
 		}
 	}
 
@@ -309,26 +442,44 @@ unsigned char CannyEdgeDetector::Luminance(unsigned char r, unsigned char g, uns
 /*! \brief Converts an RGB image to a luminence image */
 void CannyEdgeDetector::ReadLuminance()
 {
-	unsigned char	*pixels	= image.Data;
-	int				offset	= picSize - 1;
+	ReadLuminance(0, source.height);
+}
+
+/*! \brief Converts rows of an RGB image to luminence
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::ReadLuminance(int start_y, int end_y)
+{
+	int n = start_y * source.width;
+	int channels = source.channels;
 
-	if(picSize == image.Width * image.Height * 3)
+	for (int y = start_y; y < end_y; y++)
 	{
+		unsigned char* row = imageview::Row(source, y);
 
-		int n = (image.Width * image.Height) - 1;
-		for(int i = picSize - 2; i >= 0; i -= 3)
+		if (fixed_point)
+		{
+			if (channels == 1)
+			{
+				memcpy(&luminance[n], row, source.width);
+				n += source.width;
+			}
+			else
+			{
+				for (int x = 0; x < source.width * channels; x += channels)
+					luminance[n++] = Luminance(row[x + 2], row[x + 1], row[x]);
+			}
+		}
+		else if (channels == 1)
 		{
-			unsigned char r = pixels[offset--] & 0xFF;
-			unsigned char g = pixels[offset--] & 0xFF;
-			unsigned char b = pixels[offset--] & 0xFF;
-			data[n--] = Luminance(r, g, b);
+			for (int x = 0; x < source.width; x++)
+				data[n++] = row[x];
 		}
-	}
-	else
-	{
-		for(int i = picSize - 1; i >= 0; i--)
+		else
 		{
-			data[i] = pixels[offset--] & 0xFF;
+			for (int x = 0; x < source.width * channels; x += channels)
+				data[n++] = Luminance(row[x + 2], row[x + 1], row[x]);
 		}
 	}
 }
@@ -337,27 +488,79 @@ void CannyEdgeDetector::ReadLuminance()
  * \param kernelRadius radius of the gaussian
  * \param kernelWidth width of the convolution kernel in pixels
  */
-int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelWidth)
+void CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelWidth)
 {
-	int initX = 0;
-	int maxX = 0;
-	int initY = 0;
-	int maxY = 0;
-	int no_of_edges = 0;
-
 	// Create gaussian convolution masks
 	CreateMasks(kernelRadius, kernelWidth);
 
-	initX = kwidth - 1;
-	maxX = image.Width - (kwidth - 1);
-	initY = image.Width * (kwidth - 1);
-	maxY = image.Width * (image.Height - (kwidth - 1));
-    int w = image.Width;
+	suppressed.clear();
+	suppressed.reserve(picSize / CANNY_SUPPRESSED_RESERVE);
+	if (fixed_point)
+	{
+		ConvolveFixed(0, image.Height);
+		DifferentiateFixed(0, image.Height);
+		SuppressFixed(0, image.Height, suppressed);
+	}
+	else
+	{
+		Convolve(0, image.Height);
+		Differentiate(0, image.Height);
+		Suppress(0, image.Height, suppressed);
+	}
+}
 
-	// Perform convolution in x and y directions
+/*! \brief convolve rows of the luminance image with the gaussian in the x and y directions
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::Convolve(int start_y, int end_y)
+{
+    int w = image.Width;
+	int first_row = kwidth - 1;
+	int last_row = (int)image.Height - (int)(kwidth - 1);
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
+
+	int initX = kwidth - 1;
+	int maxX = w - (int)(kwidth - 1);
+	int initY = w * first_row;
+	int maxY = w * last_row;
+
+	// Perform convolution in x and y directions.  This and the gradient passes
+	// run along rows, so that vertical taps read consecutive memory, and groups
+	// of pixels are vectorised with the same order of arithmetic as the scalar version.
+	bool vectorise = vector_kernels;
 	for(int y = initY; y < maxY; y+= w)
 	{
-		for(int x = initX; x < maxX; x++)
+		int x = initX;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			__m128 k0 = _mm_set1_ps(kernel.Data[0]);
+			for (; x + 4 <= maxX; x += 4)
+			{
+				int index = x + y;
+				__m128 sumX = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((__m128i*)&data[index])), k0);
+				__m128 sumY = sumX;
+				int yOffset = w;
+				for (unsigned int xOffset = 1; xOffset < kwidth; xOffset++, yOffset += w)
+				{
+					__m128 k = _mm_set1_ps(kernel.Data[xOffset]);
+					__m128i vertical = _mm_add_epi32(
+					    _mm_loadu_si128((__m128i*)&data[index - yOffset]),
+					    _mm_loadu_si128((__m128i*)&data[index + yOffset]));
+					__m128i horizontal = _mm_add_epi32(
+					    _mm_loadu_si128((__m128i*)&data[index - xOffset]),
+					    _mm_loadu_si128((__m128i*)&data[index + xOffset]));
+					sumY = _mm_add_ps(sumY, _mm_mul_ps(k, _mm_cvtepi32_ps(vertical)));
+					sumX = _mm_add_ps(sumX, _mm_mul_ps(k, _mm_cvtepi32_ps(horizontal)));
+				}
+				_mm_storeu_ps(&yConv[index], sumY);
+				_mm_storeu_ps(&xConv[index], sumX);
+			}
+		}
+#endif
+		for(; x < maxX; x++)
 		{
 			int index = x + y;
 			float sumX = data[index] * kernel.Data[0];
@@ -383,11 +586,45 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
 			xConv[index] = sumX;
 		}
 	}
+}
+
+/*! \brief differentiate rows of the gaussian convolutions in the x and y directions
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::Differentiate(int start_y, int end_y)
+{
+    int w = image.Width;
+	int first_row = kwidth - 1;
+	int last_row = (int)image.Height - (int)(kwidth - 1);
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
+
+	int initX = kwidth - 1;
+	int maxX = w - (int)(kwidth - 1);
+	int initY = w * first_row;
+	int maxY = w * last_row;
+	bool vectorise = vector_kernels;
 
 	float *kern = diffKernel.Data;
-	for(int x = initX; x < maxX; x++)
+	for(int y = initY; y < maxY; y += w)
 	{
-		for(int y = initY; y < maxY; y += w)
+		int x = initX;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			for (; x + 4 <= maxX; x += 4)
+			{
+				int index = x + y;
+				__m128 sum = _mm_setzero_ps();
+				for(unsigned int i = 1; i < kwidth; i++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kern[i]),
+					    _mm_sub_ps(_mm_loadu_ps(&yConv[index - i]), _mm_loadu_ps(&yConv[index + i]))));
+				_mm_storeu_ps(&xGradient[index], sum);
+			}
+		}
+#endif
+		for(; x < maxX; x++)
 		{
 			float sum = 0.0f;
 			int index = x + y;
@@ -400,9 +637,25 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
 		}
 	}
 
-	for(unsigned int x = kwidth; x < w - kwidth; x++)
+	for (int y = initY; y < maxY; y += w)
 	{
-		for (int y = initY; y < maxY; y += w)
+		int x = kwidth;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			for (; x + 4 <= w - (int)kwidth; x += 4)
+			{
+				int index = x + y;
+				__m128 sum = _mm_setzero_ps();
+				int yOffset = w;
+				for(unsigned int i = 1; i < kwidth; i++, yOffset += w)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kern[i]),
+					    _mm_sub_ps(_mm_loadu_ps(&xConv[index - yOffset]), _mm_loadu_ps(&xConv[index + yOffset]))));
+				_mm_storeu_ps(&yGradient[index], sum);
+			}
+		}
+#endif
+		for(; x < w - (int)kwidth; x++)
 		{
 			float sum = 0.0f;
 			int index = x + y;
@@ -416,11 +669,25 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
 			yGradient[index] = sum;
 		}
 	}
+}
+
+/*! \brief perform non-maximal supression on rows of the gradients
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ * \param edge_index pixel indexes of the edges, to which those found are appended in order
+ */
+void CannyEdgeDetector::Suppress(int start_y, int end_y, std::vector<int> &edge_index)
+{
+    int w = image.Width;
+	int first_row = kwidth;
+	int last_row = (int)image.Height - (int)kwidth;
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
 
-	initX = kwidth;
-	maxX = image.Width - kwidth;
-	initY = image.Width * kwidth;
-	maxY = image.Width * (image.Height - kwidth);
+	int initX = kwidth;
+	int maxX = w - (int)kwidth;
+	int initY = w * first_row;
+	int maxY = w * last_row;
 
 	for (int y = initY; y < maxY; y += image.Width)
 	{
@@ -436,16 +703,16 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
 			//perform non-maximal supression
 			float tmp = 0;
 
-            float xGrad_abs = ABS(xGrad);
-            float yGrad_abs = ABS(yGrad);
-
-            bool is_edge = false;
-            if (xGrad * yGrad <= 0.0f)
+            float xGrad_abs = ABS(xGrad);
+            float yGrad_abs = ABS(yGrad);
+
+            bool is_edge = false;
+            if (xGrad * yGrad <= 0.0f)
             {
                 int indexNE = index - w + 1;
                 float neMag = SQUARE_MAG(xGradient[indexNE], yGradient[indexNE]);
-	            float sumGrad = xGrad + yGrad;
-                if (xGrad_abs >= yGrad_abs)
+	            float sumGrad = xGrad + yGrad;
+                if (xGrad_abs >= yGrad_abs)
                 {
                     int indexE = index + 1;
                     float eMag = SQUARE_MAG(xGradient[indexE], yGradient[indexE]);
@@ -454,12 +721,12 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
                         int indexSW = index + w - 1;
                         int indexW = index - 1;
                         float swMag = SQUARE_MAG(xGradient[indexSW], yGradient[indexSW]);
-                        float wMag = SQUARE_MAG(xGradient[indexW], yGradient[indexW]);
-                        if (tmp > ABS((yGrad * swMag) - (sumGrad * wMag)))
+                        float wMag = SQUARE_MAG(xGradient[indexW], yGradient[indexW]);
+                        if (tmp > ABS((yGrad * swMag) - (sumGrad * wMag)))
                             is_edge = true;
-                    }
+                    }
                 }
-                else
+                else
                 {
                     int indexN = index - w;
                     float nMag = SQUARE_MAG(xGradient[indexN], yGradient[indexN]);
@@ -468,17 +735,17 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
                         int indexS = index + w;
                         int indexSW = indexS - 1;
                         float swMag = SQUARE_MAG(xGradient[indexSW], yGradient[indexSW]);
-                        float sMag = SQUARE_MAG(xGradient[indexS], yGradient[indexS]);
-                        if (tmp > ABS((xGrad * swMag) - (sumGrad * sMag)))
+                        float sMag = SQUARE_MAG(xGradient[indexS], yGradient[indexS]);
+                        if (tmp > ABS((xGrad * swMag) - (sumGrad * sMag)))
                             is_edge = true;
-                    }
-                }
-            }
-            else
+                    }
+                }
+            }
+            else
             {
-                int indexSE = index + w + 1;
+                int indexSE = index + w + 1;
                 float seMag = SQUARE_MAG(xGradient[indexSE], yGradient[indexSE]);
-                if (xGrad_abs >= yGrad_abs)
+                if (xGrad_abs >= yGrad_abs)
                 {
                     int indexE = index + 1;
                     float eMag = SQUARE_MAG(xGradient[indexE], yGradient[indexE]);
@@ -487,12 +754,12 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
                         int indexNW = index - w - 1;
                         int indexW = index - 1;
                         float nwMag = SQUARE_MAG(xGradient[indexNW], yGradient[indexNW]);
-                        float wMag = SQUARE_MAG(xGradient[indexW], yGradient[indexW]);
-                        if (tmp > ABS((yGrad * nwMag) + ((xGrad - yGrad) * wMag)))
+                        float wMag = SQUARE_MAG(xGradient[indexW], yGradient[indexW]);
+                        if (tmp > ABS((yGrad * nwMag) + ((xGrad - yGrad) * wMag)))
                             is_edge = true;
-                    }
-                }
-                else
+                    }
+                }
+                else
                 {
                     int indexS = index + w;
                     float sMag = SQUARE_MAG(xGradient[indexS], yGradient[indexS]);
@@ -502,22 +769,22 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
                         int indexNW = indexN - 1;
                         float nwMag = SQUARE_MAG(xGradient[indexNW], yGradient[indexNW]);
                         float nMag = SQUARE_MAG(xGradient[indexN], yGradient[indexN]);
-                        if (tmp > ABS((xGrad * nwMag) + ((yGrad - xGrad) * nMag)))
+                        if (tmp > ABS((xGrad * nwMag) + ((yGrad - xGrad) * nMag)))
                             is_edge = true;
-                    }
-                }
-            }
-
-            if (is_edge)
+                    }
+                }
+            }
+
+            if (is_edge)
             {
 	            // record the squared magnitude
                 if (gradMag >= MAGNITUDE_LIMIT_SQR)
-                    edge_magnitude[index] = -1;
+                    edge_magnitude[index] = -1;
                 else
                     edge_magnitude[index] = gradMag;
 
                 // record the edge position
-                edge_pixel_index[no_of_edges++] = index;
+                edge_index.push_back(index);
 
                 if (gradMag < 0)
                     magnitude[index] = MAGNITUDE_MAX;
@@ -526,8 +793,282 @@ int CannyEdgeDetector::ComputeGradients(float kernelRadius, unsigned int kernelW
             }
 		}
 	}
-
-	return(no_of_edges);
+}
+
+/*! \brief convolve rows of the luminance image with the fixed point gaussian in the x and y directions.
+ *         The kernel sums to 1 << CANNY_FIXED_SMOOTH_BITS, so no sum can exceed 16 bits.
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::ConvolveFixed(int start_y, int end_y)
+{
+    int w = image.Width;
+	int first_row = kwidth - 1;
+	int last_row = (int)image.Height - (int)(kwidth - 1);
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
+
+	int initX = kwidth - 1;
+	int maxX = w - (int)(kwidth - 1);
+	int initY = w * first_row;
+	int maxY = w * last_row;
+
+	// integer sums are exact, so vectorised groups match the scalar version
+	bool vectorise = vector_kernels;
+	for(int y = initY; y < maxY; y+= w)
+	{
+		int x = initX;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			__m128i zero = _mm_setzero_si128();
+			__m128i k0 = _mm_set1_epi16(kernel_fixed[0]);
+			for (; x + 8 <= maxX; x += 8)
+			{
+				int index = x + y;
+				__m128i sumX = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&luminance[index]), zero), k0);
+				__m128i sumY = sumX;
+				int yOffset = w;
+				for (unsigned int xOffset = 1; xOffset < kwidth; xOffset++, yOffset += w)
+				{
+					__m128i k = _mm_set1_epi16(kernel_fixed[xOffset]);
+					__m128i vertical = _mm_add_epi16(
+					    _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&luminance[index - yOffset]), zero),
+					    _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&luminance[index + yOffset]), zero));
+					__m128i horizontal = _mm_add_epi16(
+					    _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&luminance[index - xOffset]), zero),
+					    _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&luminance[index + xOffset]), zero));
+					sumY = _mm_add_epi16(sumY, _mm_mullo_epi16(k, vertical));
+					sumX = _mm_add_epi16(sumX, _mm_mullo_epi16(k, horizontal));
+				}
+				_mm_storeu_si128((__m128i*)&yConvFixed[index], sumY);
+				_mm_storeu_si128((__m128i*)&xConvFixed[index], sumX);
+			}
+		}
+#endif
+		for(; x < maxX; x++)
+		{
+			int index = x + y;
+			int sumX = luminance[index] * kernel_fixed[0];
+			int sumY = sumX;
+			int yOffset = w;
+			for (unsigned int xOffset = 1; xOffset < kwidth; xOffset++, yOffset += w)
+			{
+				int k = kernel_fixed[xOffset];
+				sumY += k * (luminance[index - yOffset] + luminance[index + yOffset]);
+				sumX += k * (luminance[index - xOffset] + luminance[index + xOffset]);
+			}
+
+			yConvFixed[index] = (short)sumY;
+			xConvFixed[index] = (short)sumX;
+		}
+	}
+}
+
+/*! \brief differentiate rows of the fixed point convolutions in the x and y directions.
+ *         Each product keeps its upper 16 bits, as _mm_mulhi_epi16 does.
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::DifferentiateFixed(int start_y, int end_y)
+{
+    int w = image.Width;
+	int first_row = kwidth - 1;
+	int last_row = (int)image.Height - (int)(kwidth - 1);
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
+
+	int initX = kwidth - 1;
+	int maxX = w - (int)(kwidth - 1);
+	int initY = w * first_row;
+	int maxY = w * last_row;
+	bool vectorise = vector_kernels;
+
+	short *kern = diff_kernel_fixed;
+	for(int y = initY; y < maxY; y += w)
+	{
+		int x = initX;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			for (; x + 8 <= maxX; x += 8)
+			{
+				int index = x + y;
+				__m128i sum = _mm_setzero_si128();
+				for(unsigned int i = 1; i < kwidth; i++)
+					sum = _mm_add_epi16(sum, _mm_mulhi_epi16(_mm_set1_epi16(kern[i]),
+					    _mm_sub_epi16(_mm_loadu_si128((__m128i*)&yConvFixed[index + i]), _mm_loadu_si128((__m128i*)&yConvFixed[index - i]))));
+				_mm_storeu_si128((__m128i*)&xGradientFixed[index], sum);
+			}
+		}
+#endif
+		for(; x < maxX; x++)
+		{
+			int sum = 0;
+			int index = x + y;
+			for(unsigned int i = 1; i < kwidth; i++)
+				sum += (kern[i] * (yConvFixed[index + i] - yConvFixed[index - i])) >> 16;
+
+			xGradientFixed[index] = (short)sum;
+		}
+	}
+
+	for (int y = initY; y < maxY; y += w)
+	{
+		int x = kwidth;
+#ifdef __SSE2__
+		if (vectorise)
+		{
+			for (; x + 8 <= w - (int)kwidth; x += 8)
+			{
+				int index = x + y;
+				__m128i sum = _mm_setzero_si128();
+				int yOffset = w;
+				for(unsigned int i = 1; i < kwidth; i++, yOffset += w)
+					sum = _mm_add_epi16(sum, _mm_mulhi_epi16(_mm_set1_epi16(kern[i]),
+					    _mm_sub_epi16(_mm_loadu_si128((__m128i*)&xConvFixed[index + yOffset]), _mm_loadu_si128((__m128i*)&xConvFixed[index - yOffset]))));
+				_mm_storeu_si128((__m128i*)&yGradientFixed[index], sum);
+			}
+		}
+#endif
+		for(; x < w - (int)kwidth; x++)
+		{
+			int sum = 0;
+			int index = x + y;
+			int yOffset = w;
+			for(unsigned int i = 1; i < kwidth; i++, yOffset += w)
+				sum += (kern[i] * (xConvFixed[index + yOffset] - xConvFixed[index - yOffset])) >> 16;
+
+			yGradientFixed[index] = (short)sum;
+		}
+	}
+}
+
+/*! \brief perform non-maximal supression on rows of the fixed point gradients.
+ *         The same comparisons of squared magnitudes are made as in Suppress,
+ *         using 64 bit integers, and the squared magnitude of each edge is
+ *         stored for hysteresis.
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ * \param edge_index pixel indexes of the edges, to which those found are appended in order
+ */
+void CannyEdgeDetector::SuppressFixed(int start_y, int end_y, std::vector<int> &edge_index)
+{
+    int w = image.Width;
+	int first_row = kwidth;
+	int last_row = (int)image.Height - (int)kwidth;
+	if (first_row < start_y) first_row = start_y;
+	if (last_row > end_y) last_row = end_y;
+
+	int initX = kwidth;
+	int maxX = w - (int)kwidth;
+	int initY = w * first_row;
+	int maxY = w * last_row;
+
+	for (int y = initY; y < maxY; y += image.Width)
+	{
+		for (int x = initX; x < maxX; x++)
+		{
+			int index = x + y;
+
+			int xGrad = xGradientFixed[index];
+			int yGrad = yGradientFixed[index];
+			int gradMag = SQUARE_MAG(xGrad, yGrad);
+
+			long long tmp = 0;
+			long long xGrad_abs = ABS(xGrad);
+			long long yGrad_abs = ABS(yGrad);
+
+			bool is_edge = false;
+			if (xGrad * yGrad <= 0)
+			{
+				int indexNE = index - w + 1;
+				long long neMag = SQUARE_MAG(xGradientFixed[indexNE], yGradientFixed[indexNE]);
+				long long sumGrad = xGrad + yGrad;
+				if (xGrad_abs >= yGrad_abs)
+				{
+					int indexE = index + 1;
+					long long eMag = SQUARE_MAG(xGradientFixed[indexE], yGradientFixed[indexE]);
+					if ((tmp = xGrad_abs * gradMag) >= ABS((yGrad * neMag) - (sumGrad * eMag)))
+					{
+						int indexSW = index + w - 1;
+						int indexW = index - 1;
+						long long swMag = SQUARE_MAG(xGradientFixed[indexSW], yGradientFixed[indexSW]);
+						long long wMag = SQUARE_MAG(xGradientFixed[indexW], yGradientFixed[indexW]);
+						if (tmp > ABS((yGrad * swMag) - (sumGrad * wMag)))
+							is_edge = true;
+					}
+				}
+				else
+				{
+					int indexN = index - w;
+					long long nMag = SQUARE_MAG(xGradientFixed[indexN], yGradientFixed[indexN]);
+					if ((tmp = yGrad_abs * gradMag) >= ABS((xGrad * neMag) - (sumGrad * nMag)))
+					{
+						int indexS = index + w;
+						int indexSW = indexS - 1;
+						long long swMag = SQUARE_MAG(xGradientFixed[indexSW], yGradientFixed[indexSW]);
+						long long sMag = SQUARE_MAG(xGradientFixed[indexS], yGradientFixed[indexS]);
+						if (tmp > ABS((xGrad * swMag) - (sumGrad * sMag)))
+							is_edge = true;
+					}
+				}
+			}
+			else
+			{
+				int indexSE = index + w + 1;
+				long long seMag = SQUARE_MAG(xGradientFixed[indexSE], yGradientFixed[indexSE]);
+				if (xGrad_abs >= yGrad_abs)
+				{
+					int indexE = index + 1;
+					long long eMag = SQUARE_MAG(xGradientFixed[indexE], yGradientFixed[indexE]);
+					if ((tmp = xGrad_abs * gradMag) >= ABS((yGrad * seMag) + ((long long)(xGrad - yGrad) * eMag)))
+					{
+						int indexNW = index - w - 1;
+						int indexW = index - 1;
+						long long nwMag = SQUARE_MAG(xGradientFixed[indexNW], yGradientFixed[indexNW]);
+						long long wMag = SQUARE_MAG(xGradientFixed[indexW], yGradientFixed[indexW]);
+						if (tmp > ABS((yGrad * nwMag) + ((long long)(xGrad - yGrad) * wMag)))
+							is_edge = true;
+					}
+				}
+				else
+				{
+					int indexS = index + w;
+					long long sMag = SQUARE_MAG(xGradientFixed[indexS], yGradientFixed[indexS]);
+					if ((tmp = yGrad_abs * gradMag) >= ABS((xGrad * seMag) + ((long long)(yGrad - xGrad) * sMag)))
+					{
+						int indexN = index - w;
+						int indexNW = indexN - 1;
+						long long nwMag = SQUARE_MAG(xGradientFixed[indexNW], yGradientFixed[indexNW]);
+						long long nMag = SQUARE_MAG(xGradientFixed[indexN], yGradientFixed[indexN]);
+						if (tmp > ABS((xGrad * nwMag) + ((long long)(yGrad - xGrad) * nMag)))
+							is_edge = true;
+					}
+				}
+			}
+
+			if (is_edge)
+			{
+				edge_index.push_back(index);
+				magnitude[index] = gradMag;
+			}
+		}
+	}
+}
+
+/*! \brief converts a hysteresis threshold into the squared fixed point gradient
+ *         magnitude at or above which the floating point magnitude would reach it
+ * \param threshold threshold on the scaled floating point magnitude
+ * \return threshold on the squared fixed point magnitude
+ */
+int CannyEdgeDetector::FixedThreshold(int threshold)
+{
+	CreateMasks(gaussianKernelRadius, gaussianKernelWidth);
+	double t = threshold / (MAGNITUDE_SCALE * fixed_gradient_scale);
+	t = ceil(t * t);
+	if (t > 2147483647.0) t = 2147483647.0;
+	return((int)t);
 }
 
 /*! \brief creates convolution masks
@@ -559,151 +1100,175 @@ void CannyEdgeDetector::CreateMasks(float kernelRadius, unsigned int kernelWidth
 			kernel.Data[kwidth] = ((g1 + g2 + g3) / 3.0) / (2.0 * (float)PI * kernelRadius * kernelRadius);
 			diffKernel.Data[kwidth] = g3 - g2;
 		}
+
+		// fixed point kernels, with the gaussian normalised so that smoothing
+		// a uniform region returns the luminance shifted up by CANNY_FIXED_SMOOTH_BITS
+		kernel_fixed = (short*) realloc(kernel_fixed, kernelWidth*sizeof(short));
+		diff_kernel_fixed = (short*) realloc(diff_kernel_fixed, kernelWidth*sizeof(short));
+		float kernel_sum = kernel.Data[0];
+		float diff_sum = 0;
+		for (unsigned int i = 1; i < kwidth; i++)
+		{
+			kernel_sum += 2 * kernel.Data[i];
+			diff_sum -= diffKernel.Data[i];
+		}
+		int fixed_sum = 0;
+		float ramp = 0, ramp_fixed = 0;
+		diff_kernel_fixed[0] = 0;
+		for (unsigned int i = 1; i < kwidth; i++)
+		{
+			kernel_fixed[i] = (short)roundf(kernel.Data[i] * (1 << CANNY_FIXED_SMOOTH_BITS) / kernel_sum);
+			fixed_sum += 2 * kernel_fixed[i];
+			diff_kernel_fixed[i] = (short)roundf(-diffKernel.Data[i] * CANNY_FIXED_DIFF_SUM / diff_sum);
+			ramp -= diffKernel.Data[i] * 2 * i;
+			ramp_fixed += diff_kernel_fixed[i] * 2 * i;
+		}
+		kernel_fixed[0] = (short)((1 << CANNY_FIXED_SMOOTH_BITS) - fixed_sum);
+
+		// ratio between the floating point and fixed point gradients of a luminance ramp
+		ramp_fixed *= (1 << CANNY_FIXED_SMOOTH_BITS) / 65536.0f;
+		if (ramp_fixed > 0) fixed_gradient_scale = kernel_sum * ramp / ramp_fixed;
 	}
 }
 
-/*! \brief hysteresis
- * \param low low threshold
- * \param high high threshold
- * \param followedEdges list of pixel indexes for edges followed
+/*! \brief hysteresis.  Edges from non-maximal suppression with a magnitude of at least
+ *         the low threshold become candidates, and all candidates which are 8-connected
+ *         to an edge with a magnitude of at least the high threshold are marked as edges.
+ *         The result does not depend upon the order in which edges are visited.
+ * \param edge_list pixel indexes of the edges found by non-maximal suppression
+ * \param start_y first row containing the edges
+ * \param end_y last row containing the edges (exclusive)
+ * \param stack pixels waiting to be followed
+ * \param crossings returned neighbours outside of the rows, or NULL if the rows are the whole image
  */
-void CannyEdgeDetector::PerformHysteresis(int low, int high, int *followedEdges, int no_of_edges)
+void CannyEdgeDetector::PerformHysteresis(const std::vector<int> &edge_list, int start_y, int end_y,
+                                          std::vector<int> &stack, std::vector<int> *crossings)
 {
-	int imageSize = image.Width * image.Height;
-    int offset = imageSize - 1;
-
-	// clear array containing followed edges
-	for(int i = offset; i >= 0; i--)
-	{
-		followedEdges[i] = 0;
-	}
-
-    int w = image.Width;
-    int h = image.Height;
+    int no_of_edges = (int)edge_list.size();
+    int start_index = start_y * image.Width;
+    int end_index = end_y * image.Width;
 
-    for (int i = no_of_edges - 1; i >= 0; i--)
+    for (int i = 0; i < no_of_edges; i++)
     {
-	    int index = edge_pixel_index[i];
+	    int index = edge_list[i];
+	    if (magnitude[index] >= low_magnitude)
+	        edge_state[index] = CANNY_STATE_CANDIDATE;
+    }
 
-	    if (followedEdges[index] == 0)
+    for (int i = 0; i < no_of_edges; i++)
+    {
+	    int index = edge_list[i];
+	    if ((magnitude[index] >= high_magnitude) &&
+	        (edge_state[index] != CANNY_STATE_EDGE))
 	    {
-	        if (magnitude[index] >= high)
-    		{
-    			int y = index % w;
-    			int x = index - (y * w);
-    			Follow2(x,y,index,&low,followedEdges,&w,&h);
-    		}
+	        Follow(index, start_index, end_index, stack, crossings);
 	    }
     }
 }
 
-/*! \brief recursively follow an edge until a minimum magnitude is reached
- * \param x1 current x coordinate
- * \param y1 current y coordinate
- * \param il current pixel index
- * \param threshold minimum gradient magnitude threshold
- * \param followedEdges list of pixel indexes for edges followed
+/*! \brief marks a pixel as an edge, together with all candidates 8-connected to it.
+ *         Each pixel is pushed onto the stack at most once.  Edges found by non-maximal
+ *         suppression lie at least one pixel inside the image, so their neighbours need
+ *         no bounds checks.
+ * \param index pixel index
+ * \param start_index first pixel index which may be followed
+ * \param end_index last pixel index which may be followed (exclusive)
+ * \param stack pixels waiting to be followed
+ * \param crossings returned neighbours outside of the followed range, or NULL
  */
-void CannyEdgeDetector::Follow(unsigned int x1, unsigned int y1, unsigned int i1, int *threshold, int *followedEdges,
-                               int *width, int *height)
+void CannyEdgeDetector::Follow(int index, int start_index, int end_index,
+                               std::vector<int> &stack, std::vector<int> *crossings)
 {
-	unsigned int x0 = x1 == 0 ? x1 : x1 - 1;
-	unsigned int x2 = x1 == (unsigned int)*width - 1 ? x1 : x1 + 1;
-	unsigned int y0 = y1 == 0 ? y1 : y1 - 1;
-	unsigned int y2 = y1 == (unsigned int)*height - 1 ? y1 : y1 + 1;
-
-	followedEdges[i1] = magnitude[i1];
-
-	for(unsigned int y = y0; y <= y2; y++)
-	{
-		unsigned int i2 = y * *width;
-        unsigned int i3 = i2 + x0;
-
-		for(unsigned int x = x0; x <= x2; x++, i3++)
-		{
-			if (followedEdges[i3] == 0)        // hasn't been followed
-		        if(magnitude[i3] >= *threshold) // with sufficient magnitude
-			    {
-				    Follow(x, y, i3, threshold, followedEdges, width, height);
-				    return;
-			    }
-		}
-	}
-}
+    int w = image.Width;
+    int neighbour[8] = { -w - 1, -w, -w + 1, -1, 1, w - 1, w, w + 1 };
 
-/*! \brief follow an edge until a minimum magnitude is reached
- * \param x1 current x coordinate
- * \param y1 current y coordinate
- * \param il current pixel index
- * \param threshold minimum gradient magnitude threshold
- * \param followedEdges list of pixel indexes for edges followed
- */
-void CannyEdgeDetector::Follow2(unsigned int x1, unsigned int y1, unsigned int i1, int *threshold, int *followedEdges,
-                                int *width, int *height)
-{
-    bool following = true;
-    while (following)
+    edge_state[index] = CANNY_STATE_EDGE;
+    stack.push_back(index);
+    while (!stack.empty())
     {
-        following = false;
-
-        unsigned int x0 = x1 == 0 ? x1 : x1 - 1;
-        unsigned int x2 = x1 == (unsigned int)*width - 1 ? x1 : x1 + 1;
-        unsigned int y0 = y1 == 0 ? y1 : y1 - 1;
-        unsigned int y2 = y1 == (unsigned int)*height - 1 ? y1 : y1 + 1;
-
-        followedEdges[i1] = magnitude[i1];
-
-        unsigned int y = y0;
-        while ((y <= y2) && (!following))
+        int i = stack.back();
+        stack.pop_back();
+        for (int n = 0; n < 8; n++)
         {
-            unsigned int i2 = y * *width;
-            unsigned int i3 = i2 + x0;
-
-            unsigned int x = x0;
-            while ((x <= x2) && (!following))
+            int j = i + neighbour[n];
+            if ((j < start_index) || (j >= end_index))
             {
-                if (followedEdges[i3] == 0)        // hasn't been followed
-                    if(magnitude[i3] >= *threshold) // with sufficient magnitude
-                    {
-                        i1 = i3;
-                        x1 = x;
-                        y1 = y;
-                        following = true;
-                    }
-                x++;
-                i3++;
+                // belongs to another band, which may still be following its own edges
+                if (crossings != NULL) crossings->push_back(j);
+            }
+            else
+            {
+                if (edge_state[j] == CANNY_STATE_CANDIDATE)
+                {
+                    edge_state[j] = CANNY_STATE_EDGE;
+                    stack.push_back(j);
+                }
             }
-            y++;
         }
     }
 }
 
-/*! \brief binarise edge values to 0 and 255 */
-void CannyEdgeDetector::thresholdEdges()
+/*! \brief appends the followed edges from a list of edges found by non-maximal
+ *         suppression to followed_edges and edges, last pixel first, and clears
+ *         the states of the others
+ * \param edge_list pixel indexes of the edges found by non-maximal suppression
+ */
+void CannyEdgeDetector::GatherEdges(const std::vector<int> &edge_list)
 {
-	edges.clear();
-	int x = image.Width-1;
-	int y = image.Height-1;
-	for (int i = (image.Width * image.Height) - 1; i >= 0; i--)
+	int w = image.Width;
+	for (int i = (int)edge_list.size() - 1; i >= 0; i--)
 	{
-		if (data[i] != 0)
+		int index = edge_list[i];
+		if (edge_state[index] == CANNY_STATE_EDGE)
 		{
-		    data[i] = 0;
-		    edges.push_back(x);
-		    edges.push_back(y);
+			followed_edges.push_back(index);
+			int y = index / w;
+			edges.push_back(index - (y * w));
+			edges.push_back(y);
 		}
 		else
 		{
-		    data[i] = 255;
-	    }
+			edge_state[index] = CANNY_STATE_NONE;
+		}
+	}
+}
 
-	    x--;
-	    if (x < 0)
-	    {
-		    x += image.Width;
-		    y--;
-	    }
-    }
+/*! \brief clears the followed edges of the previous update */
+void CannyEdgeDetector::ClearEdges()
+{
+	for (int i = (int)followed_edges.size() - 1; i >= 0; i--)
+		edge_state[followed_edges[i]] = CANNY_STATE_NONE;
+	followed_edges.clear();
+	edges.clear();
+	edges_image_drawn = false;
+}
+
+/*! \brief returns an image of the followed edges from the last update, with the
+ *         same number of bytes per pixel as the source, in which edges are 0 and
+ *         other pixels are 255.  This is drawn on the first call after each update.
+ */
+unsigned char* CannyEdgeDetector::EdgesImage()
+{
+	if (!edges_image_drawn)
+	{
+		int bytes_per_pixel = image.BytesPerPixel;
+		int pixels = picSize * bytes_per_pixel;
+		if (pixels != edges_image_size)
+		{
+			if (edgesImage != NULL) delete[] edgesImage;
+			edgesImage = new unsigned char[pixels];
+			edges_image_size = pixels;
+		}
+		memset(edgesImage, 255, pixels);
+		for (int i = (int)followed_edges.size() - 1; i >= 0; i--)
+		{
+			int n = followed_edges[i] * bytes_per_pixel;
+			for (int col = 0; col < bytes_per_pixel; col++)
+				edgesImage[n + col] = 0;
+		}
+		edges_image_drawn = true;
+	}
+	return(edgesImage);
 }
 
 /*! \brief gaussian function
@@ -718,27 +1283,82 @@ float CannyEdgeDetector::Gaussian(float x, float sigma)
 /*! \brief initialise arrays */
 void CannyEdgeDetector::initArrays()
 {
-	data		= (int*)	realloc(data,picSize*sizeof(int));
+	allocateArrays();
+	clearArrays(0, image.Height);
+}
+
+/*! \brief resize arrays to the current image */
+void CannyEdgeDetector::allocateArrays()
+{
 	magnitude	= (int*)	realloc(magnitude,picSize*sizeof(int));
-	xConv		= (float*)	realloc(xConv,picSize*sizeof(float));
-	yConv		= (float*)	realloc(yConv,picSize*sizeof(float));
-	xGradient	= (float*)	realloc(xGradient,picSize*sizeof(float));
-	yGradient	= (float*)	realloc(yGradient,picSize*sizeof(float));
-    edge_pixel_index = (int*) realloc(edge_pixel_index,picSize*sizeof(int));
-    edge_magnitude = (float*) realloc(edge_magnitude, picSize*sizeof(float));
-
-	for(unsigned int i = 0; i < picSize; i++)
+
+    // only the arrays used by the current mode are kept
+    if (fixed_point)
+    {
+    	luminance	= (unsigned char*) realloc(luminance,picSize*sizeof(unsigned char));
+    	xConvFixed	= (short*)	realloc(xConvFixed,picSize*sizeof(short));
+    	yConvFixed	= (short*)	realloc(yConvFixed,picSize*sizeof(short));
+    	xGradientFixed = (short*) realloc(xGradientFixed,picSize*sizeof(short));
+    	yGradientFixed = (short*) realloc(yGradientFixed,picSize*sizeof(short));
+    	free(data);			data = NULL;
+    	free(xConv);		xConv = NULL;
+    	free(yConv);		yConv = NULL;
+    	free(xGradient);	xGradient = NULL;
+    	free(yGradient);	yGradient = NULL;
+    	free(edge_magnitude); edge_magnitude = NULL;
+    }
+    else
+    {
+    	data		= (int*)	realloc(data,picSize*sizeof(int));
+    	xConv		= (float*)	realloc(xConv,picSize*sizeof(float));
+    	yConv		= (float*)	realloc(yConv,picSize*sizeof(float));
+    	xGradient	= (float*)	realloc(xGradient,picSize*sizeof(float));
+    	yGradient	= (float*)	realloc(yGradient,picSize*sizeof(float));
+    	edge_magnitude = (float*) realloc(edge_magnitude, picSize*sizeof(float));
+    	free(luminance);		luminance = NULL;
+    	free(xConvFixed);		xConvFixed = NULL;
+    	free(yConvFixed);		yConvFixed = NULL;
+    	free(xGradientFixed);	xGradientFixed = NULL;
+    	free(yGradientFixed);	yGradientFixed = NULL;
+    }
+
+    // states are only cleared where they were set, so start from a cleared array
+    if (edge_state_size != picSize)
+    {
+    	free(edge_state);
+    	edge_state = (unsigned char*) calloc(picSize, sizeof(unsigned char));
+    	edge_state_size = picSize;
+    }
+}
+
+/*! \brief clear rows of the arrays
+ * \param start_y first row
+ * \param end_y last row (exclusive)
+ */
+void CannyEdgeDetector::clearArrays(int start_y, int end_y)
+{
+	int start = start_y * image.Width;
+	int pixels = (end_y - start_y) * image.Width;
+	memset(&magnitude[start], 0, pixels * sizeof(int));
+	if (fixed_point)
 	{
-		data[i] = 0;
-		magnitude[i] = 0;
-		xConv[i] = 0;
-		yConv[i] = 0;
-		xGradient[i] = 0;
-		yGradient[i] = 0;
-		edge_pixel_index[i] = 0;
-		edge_magnitude[i] = 0;
+		memset(&xConvFixed[start], 0, pixels * sizeof(short));
+		memset(&yConvFixed[start], 0, pixels * sizeof(short));
+		memset(&xGradientFixed[start], 0, pixels * sizeof(short));
+		memset(&yGradientFixed[start], 0, pixels * sizeof(short));
+	}
+	else
+	{
+		for(int i = start; i < start + pixels; i++)
+		{
+			data[i] = 0;
+			xConv[i] = 0;
+			yConv[i] = 0;
+			xGradient[i] = 0;
+			yGradient[i] = 0;
+			edge_magnitude[i] = 0;
+		}
 	}
-
 }
 
 
@@ -763,7 +1383,7 @@ void CannyEdgeDetector::GetCorners(int width, int height,
             {
                 for (int xx = x - 1; xx <= x + 1; xx++)
                 {
-                    if (edgesImage[n] == 0)
+                    if (edge_state[n / image.BytesPerPixel] == CANNY_STATE_EDGE)
                     {
                         adjacent_edges++;
                         if (adjacent_edges > 2)
@@ -853,8 +1473,17 @@ CannyEdgeDetector::~CannyEdgeDetector()
     	free(yGradient);
     	free(kernel.Data);
     	free(diffKernel.Data);
-    	free(edge_pixel_index);
     	free(edge_magnitude);
     }
+    free(edge_state);
+    free(kernel_fixed);
+    free(diff_kernel_fixed);
+    free(luminance);
+    free(xConvFixed);
+    free(yConvFixed);
+    free(xGradientFixed);
+    free(yGradientFixed);
     delete[] edgesImage;
+    if (pool != NULL) delete pool;
+    if (bands != NULL) delete[] bands;
 }
@@ -35,6 +35,11 @@
 #include <vector>
 #include "../common.h"
 #include "../utils/Image.h"
+#include "../utils/imageview.h"
+#include "../utils/threadpool.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #ifndef PI
     #define PI 3.14159265358979323846264338327950288419716939937510
@@ -45,6 +50,51 @@ struct Kernel {
 	float			*Data;
 };
 
+// stages of a multi-threaded update, each of which runs over bands of rows
+#define CANNY_STAGE_LUMINANCE       0
+#define CANNY_STAGE_CONVOLVE        1
+#define CANNY_STAGE_DIFFERENTIATE   2
+#define CANNY_STAGE_SUPPRESS        3
+#define CANNY_STAGE_HYSTERESIS      4
+
+// number of bands given to each thread, which evens out the load
+#define CANNY_BANDS_PER_THREAD      4
+
+// space for edges from non-maximal suppression is reserved for one in
+// this many pixels, which is more than are usually found
+#define CANNY_SUPPRESSED_RESERVE    4
+
+// states of each pixel during hysteresis.  Between updates only the
+// followed edges are in the CANNY_STATE_EDGE state.
+#define CANNY_STATE_NONE            0
+#define CANNY_STATE_CANDIDATE       1
+#define CANNY_STATE_EDGE            2
+
+// the fixed point gaussian sums to 1 << CANNY_FIXED_SMOOTH_BITS, so that
+// smoothed luminance fits within 16 bits
+#define CANNY_FIXED_SMOOTH_BITS     7
+
+// the fixed point derivative kernel sums to this, and each product is
+// shifted down by 16 bits, so that gradients fit within 16 bits
+#define CANNY_FIXED_DIFF_SUM        32767
+
+/*!
+ * \brief rows of the image processed by one job of a multi-threaded update.
+ *        Each stage reads rows beyond the band, up to the kernel width,
+ *        which were written by neighbouring bands during the previous stage.
+ */
+struct canny_band {
+	int					start_y;
+	int					end_y;
+
+	// pixel indexes of the edges found by non-maximal suppression, in order
+	std::vector<int>	suppressed;
+
+	// pixels waiting to be followed, and neighbours in other bands reached while following
+	std::vector<int>	stack;
+	std::vector<int>	crossings;
+};
+
 class CannyEdgeDetector
 {
 private:
@@ -60,6 +110,7 @@ private:
 	unsigned int		gaussianKernelWidth;
 	unsigned int		kwidth;
 	Image	image;
+	image_view source;
 	Kernel	kernel;
 	Kernel	diffKernel;
 	unsigned int		picSize;
@@ -72,27 +123,71 @@ private:
 	float	*xGradient;
 	float	*yGradient;
 
-    int     *edge_pixel_index;
     float   *edge_magnitude;
 
+	// pixel indexes of the edges found by non-maximal suppression, in order
+	std::vector<int> suppressed;
+
+	// pixel indexes of the followed edges, last pixel first
+	std::vector<int> followed_edges;
+
+	// image of the followed edges, which is drawn when first requested after an update
+	unsigned char*   edgesImage;
+	int              edges_image_size;
+	bool             edges_image_drawn;
+
+	// fixed point kernels, luminance, convolutions and gradients
+	short	*kernel_fixed;
+	short	*diff_kernel_fixed;
+	float	fixed_gradient_scale;
+	unsigned char *luminance;
+	short	*xConvFixed;
+	short	*yConvFixed;
+	short	*xGradientFixed;
+	short	*yGradientFixed;
+
+	// hysteresis state of each pixel
+	unsigned char	*edge_state;
+	unsigned int	edge_state_size;
+	std::vector<int> follow_stack;
+	int		low_magnitude;
+	int		high_magnitude;
+
+	ThreadPool	*pool;
+	canny_band	*bands;
+	int			no_of_bands;
+	int			stage;
+
 	void			GetThresholds(unsigned int histogram[], float *meanDark, float *meanLight);
 	void			AutoThreshold(int samplingStepSize);
 	unsigned char	Luminance(unsigned char r, unsigned char g, unsigned char b);
 	void			ReadLuminance();
-	int 			ComputeGradients(float kernelRadius, unsigned int kernelWidth);
+	void			ReadLuminance(int start_y, int end_y);
+	void 			ComputeGradients(float kernelRadius, unsigned int kernelWidth);
+	void			Convolve(int start_y, int end_y);
+	void			Differentiate(int start_y, int end_y);
+	void			Suppress(int start_y, int end_y, std::vector<int> &edge_index);
+	void			ConvolveFixed(int start_y, int end_y);
+	void			DifferentiateFixed(int start_y, int end_y);
+	void			SuppressFixed(int start_y, int end_y, std::vector<int> &edge_index);
+	int				FixedThreshold(int threshold);
+	void			UpdateBands();
+	static void		UpdateBand(void *detector, int band);
 	void			CreateMasks(float kernelRadius, unsigned int kernelWidth);
-	void			PerformHysteresis(int low, int high, int *followedEdges, int no_of_edges);
-    void            Follow(unsigned int x1, unsigned int y1, unsigned int i1, int *threshold, int *followedEdges, int *width, int *height);
-    void            Follow2(unsigned int x1, unsigned int y1, unsigned int i1, int *threshold, int *followedEdges, int *width, int *height);
-	void			thresholdEdges();
+	void			PerformHysteresis(const std::vector<int> &edge_list, int start_y, int end_y, std::vector<int> &stack, std::vector<int> *crossings);
+	void			Follow(int index, int start_index, int end_index, std::vector<int> &stack, std::vector<int> *crossings);
+	void			GatherEdges(const std::vector<int> &edge_list);
+	void			ClearEdges();
 	float			Gaussian(float x, float sigma);
 	void			initArrays();
+	void			allocateArrays();
+	void			clearArrays(int start_y, int end_y);
     void            GetCorners(int width, int height, int bytes_per_pixel, std::vector<int> &corners);
 
 public:
 	bool	         automaticThresholds;
+	// coordinates of the followed edges as x,y pairs, last pixel first
 	std::vector<int> edges;
-	unsigned char*   edgesImage;
 
 	float contrast_multiplier;
 	float lowThresholdOffset;
@@ -100,12 +195,28 @@ public:
 	float highhresholdOffset;
 	float highhresholdMultiplier;
 
+	// number of threads used by Update, which are started on the first
+	// update after this is changed.  Results are the same for any number.
+	int no_of_threads;
+
+	// use 16 bit fixed point smoothing and gradients in place of floats.
+	// Besides the lists of edges this needs 14 bytes of scratch memory per
+	// pixel rather than 29, and edges on the RawImage test images are within
+	// a pixel of those from the floating point version (see cannyFixedPointTest).
+	bool fixed_point;
+
+	// use the vectorised convolution and gradient passes.  These give the
+	// same edges as the scalar passes, which are kept for comparison.
+	bool vector_kernels;
+
 	CannyEdgeDetector();
 	~CannyEdgeDetector();
 
 	void	         Update(Image sourceImage);
-	unsigned char*   Update(unsigned char* data, int image_width, int image_height,
+	void             Update(const image_view &sourceImage);
+	void             Update(unsigned char* data, int image_width, int image_height,
                             int bytes_per_pixel);
+	unsigned char*   EdgesImage();
 
     void             ConnectBrokenEdges(int maximum_separation, int width, int height, int bytes_per_pixel);
 };
@@ -38,6 +38,9 @@
 #include "UnitTests.h"
 #include "utils/bitmap.h"
 #include "platedetection/ocr.h"
+#include "utils/profiler.h"
+#include "utils/debugsink.h"
+#include "benchmark/benchmark.h"
 
 using namespace std;
 
@@ -73,40 +76,6 @@ bool FileExists(std::string filename)
 }
 
 
-/*!
- * \brief returns a list of all filenames within a directory
- * \param dir directory
- * \param filenames list of filenames
- */
-void GetFilesInDirectory(std::string dir, std::vector<std::string> &filenames)
-{
-	filenames.clear();
-
-    DIR *dp;
-    struct dirent *dirp;
-    if ((dp = opendir(dir.c_str())) == NULL)
-    {
-    	cout << "Error " << errno << " opening " << dir << endl;
-    	return;
-    }
-
-    while ((dirp = readdir(dp)) != NULL)
-    {
-    	std::string filename = dirp->d_name;
-    	if (filename.size() > 3)
-    	{
-    		if ((filename.substr(filename.size()-3,3) == "bmp") ||
-    		    (filename.substr(filename.size()-3,3) == "BMP"))
-    		{
-    		    //cout << "filename: " << filename << endl;
-                filenames.push_back(filename);
-    		}
-    	}
-    }
-    std::sort(filenames.begin(), filenames.end());
-    closedir(dp);
-}
-
 /*!
  * \brief attempt to detect a number plate
  * \param filename filename
@@ -160,14 +129,9 @@ std::string Detect(
 		    s_debug_filename << "debug_" << i << ".ppm";
 		    s_debug_filename >> debug_filename;
 
-		    // create a bitmap object
-		    Bitmap *bmp_debug = new Bitmap(debug_images[i], debug_image_width, debug_image_height, 3);
-
-		    // save the bitmap object
+		    // save the image
 		    printf("Saving debug image %s\n", debug_filename.c_str());
-		    bmp_debug->SavePPM(debug_filename.c_str());
-
-		    delete bmp_debug;
+		    Bitmap::SavePPM(debug_filename.c_str(), debug_images[i], debug_image_width, debug_image_height);
 		}
 
 		if (license_plate_text != "")
@@ -213,10 +177,25 @@ void Run( int argc, char* argv[], float VERSION )
     opt->addUsage( " -h  --help                 Prints this help " );
     opt->addUsage( " -f  --filename img1.bmp    Image file to be analysed " );
     opt->addUsage( " -d  --dir                  Directory containing images to be analysed " );
+    opt->addUsage( "     --recursive            Also process images within subdirectories of --dir " );
+    opt->addUsage( "     --watch                Process images as they are written into --dir " );
+    opt->addUsage( "     --threads <value>      Number of threads used to process a directory " );
+    opt->addUsage( "     --prefetch <value>     Number of images loaded ahead when processing a directory (0 = none) " );
+    opt->addUsage( "     --readers <value>      Number of threads loading images when prefetching " );
+    opt->addUsage( "     --stream <filename>    Read a continuous stream of y4m or raw BGR frames (- for stdin) " );
+    opt->addUsage( "     --width <value>        Width of raw BGR frames within the stream " );
+    opt->addUsage( "     --height <value>       Height of raw BGR frames within the stream " );
+    opt->addUsage( "     --detectionwidth <value> Colour filter large images at this width (0 = full resolution) " );
+    opt->addUsage( "     --edgethreads <value>    Number of threads used by each edge detector " );
+    opt->addUsage( "     --fixededges           Detect edges using 16 bit fixed point arithmetic " );
     opt->addUsage( "     --minvol <value>       Minimum volume of the license plate as a % of the image " );
     opt->addUsage( "     --maxvol <value>       Maximum volume of the license plate as a % of the image " );
     opt->addUsage( "     --test                 Run unit tests " );
     opt->addUsage( "     --debug                Save debugging info " );
+    opt->addUsage( "     --debugscale <value>   Keep every nth pixel of the debugging images " );
+    opt->addUsage( "     --debugrate <value>    Maximum number of debugging images saved per second " );
+    opt->addUsage( "     --profile              Show the time taken by each processing stage " );
+    opt->addUsage( "     --benchmark <value>    Time the given number of iterations over the test images and --dir " );
     opt->addUsage( " -c  --chars                Save characters " );
     opt->addUsage( " -m  --model <filename>     Use the given character model " );
     opt->addUsage( " -l  --learn <directory>    Learn character model " );
@@ -226,10 +205,25 @@ void Run( int argc, char* argv[], float VERSION )
     opt->setFlag(  "help", 'h' );       // a flag (takes no argument), supporting long and short form
     opt->setOption(  "filename", 'f' ); // an option (takes an argument), filename to search
     opt->setOption(  "dir", 'd' );      // an option (takes an argument), directory to search
+    opt->setFlag(  "recursive" );       // a flag (takes no argument) used to include subdirectories
+    opt->setFlag(  "watch" );           // a flag (takes no argument) used to wait for new images
+    opt->setOption(  "threads" );       // number of threads used when processing a directory
+    opt->setOption(  "prefetch" );      // number of images loaded ahead when processing a directory
+    opt->setOption(  "readers" );       // number of threads loading images when prefetching
+    opt->setOption(  "stream" );        // file, named pipe or stdin from which frames are read
+    opt->setOption(  "width" );         // width of raw frames within the stream
+    opt->setOption(  "height" );        // height of raw frames within the stream
+    opt->setOption(  "detectionwidth" ); // width to which images are reduced before colour filtering
+    opt->setOption(  "edgethreads" ); // number of threads used by each edge detector
+    opt->setFlag(  "fixededges" );      // a flag (takes no argument) used to detect edges in fixed point
     opt->setOption(  "minvol" );        // minimum volume of the license plate as a percent of the image volume
     opt->setOption(  "maxvol" );        // maximum volume of the license plate as a percent of the image volume
     opt->setFlag(  "test", 't' );       // a flag (takes no argument) used to run unit tests
     opt->setFlag(  "debug" );           // a flag (takes no argument) used to save debugging images
+    opt->setOption(  "debugscale" );    // decimation of debugging images
+    opt->setOption(  "debugrate" );     // maximum debugging images per second
+    opt->setFlag(  "profile" );         // a flag (takes no argument) used to time each stage of processing
+    opt->setOption(  "benchmark" );     // number of benchmark iterations
     opt->setFlag(  "chars", 'c' );
     opt->setOption(  "model", 'm' );
     opt->setOption(  "learn", 'l' );
@@ -267,6 +261,23 @@ void Run( int argc, char* argv[], float VERSION )
     if( opt->getFlag( "debug" ) )
         debug = true;
 
+    // debugging images are written in the background so that they do not hold up detection
+    DebugImageWriter *debug_writer = NULL;
+    if (debug)
+    {
+    	int debug_decimation = 1;
+    	if( opt->getValue( "debugscale" ) != NULL ) debug_decimation = atoi(opt->getValue("debugscale"));
+    	int debug_rate = 0;
+    	if( opt->getValue( "debugrate" ) != NULL ) debug_rate = atoi(opt->getValue("debugrate"));
+    	debug_writer = new DebugImageWriter("debug_", debug_decimation, debug_rate, DEBUG_SINK_QUEUE_LENGTH);
+    	DebugSink::Set(debug_writer);
+    }
+
+    bool profile = false;
+    if( opt->getFlag( "profile" ) )
+        profile = true;
+    profiler::Enable(profile);
+
     int minimum_volume_percent = 10;
     if( opt->getValue( "minvol" ) != NULL  )
     {
@@ -280,6 +291,46 @@ void Run( int argc, char* argv[], float VERSION )
         if (maximum_volume_percent > 100) maximum_volume_percent = 100;
     }
 
+    int no_of_threads = 1;
+    if( opt->getValue( "threads" ) != NULL  )
+    {
+    	no_of_threads = atoi(opt->getValue("threads"));
+        if (no_of_threads < 1) no_of_threads = 1;
+    }
+
+    int prefetch_depth = ANPR_PREFETCH_DEPTH;
+    if( opt->getValue( "prefetch" ) != NULL  )
+    {
+    	prefetch_depth = atoi(opt->getValue("prefetch"));
+        if (prefetch_depth < 0) prefetch_depth = 0;
+    }
+
+    int no_of_readers = 1;
+    if( opt->getValue( "readers" ) != NULL  )
+    {
+    	no_of_readers = atoi(opt->getValue("readers"));
+        if (no_of_readers < 1) no_of_readers = 1;
+    }
+
+    if( opt->getValue( "detectionwidth" ) != NULL  )
+    {
+    	int detection_width = atoi(opt->getValue("detectionwidth"));
+        if (detection_width < 0) detection_width = 0;
+        DetectionContext::SetDefaultDetectionWidth(detection_width);
+    }
+
+    if( opt->getValue( "edgethreads" ) != NULL  )
+    {
+    	int edge_threads = atoi(opt->getValue("edgethreads"));
+        if (edge_threads < 1) edge_threads = 1;
+        DetectionContext::SetDefaultEdgeThreads(edge_threads);
+    }
+
+    if( opt->getFlag( "fixededges" ) )
+    {
+        DetectionContext::SetDefaultFixedPointEdges(true);
+    }
+
 	int model_image_width = 20;
 	int model_image_height = 20;
     float* average_model = new float[model_image_width * model_image_height];
@@ -341,11 +392,64 @@ void Run( int argc, char* argv[], float VERSION )
     }
 
 
-    if( opt->getValue( "dir" ) != NULL || opt->getValue( 'd' ) != NULL  )
+    if( opt->getValue( "benchmark" ) != NULL )
+    {
+    	int iterations = atoi(opt->getValue("benchmark"));
+    	if (iterations < 1) iterations = 1;
+
+    	std::string directory = "";
+    	if( opt->getValue( "dir" ) != NULL ) directory = opt->getValue("dir");
+
+    	// the built in test images
+    	unsigned char* raw_images[] = { raw_image1, raw_image2, raw_image3, raw_image4 };
+    	std::vector<benchmark_frame> frames;
+    	for (int i = 0; i < 4; i++)
+    	{
+    		benchmark_frame frame;
+    		std::stringstream s_name;
+    		s_name << "raw_image" << (i + 1);
+    		frame.name = s_name.str();
+    		frame.data = raw_images[i];
+    		frame.width = 640;
+    		frame.height = 480;
+    		frames.push_back(frame);
+    	}
+
+    	benchmark::Run(frames, directory, iterations, model_image_width, model_image_height, models, average_model, cout);
+    }
+    else if( opt->getValue( "dir" ) != NULL || opt->getValue( 'd' ) != NULL  )
     {
     	std::string directory = opt->getValue("dir");
+    	bool recursive = opt->getFlag( "recursive" );
+    	if (opt->getFlag( "watch" ))
+    	{
+    		anpr::WatchDirectory(directory, recursive, save_characters, model_image_width, model_image_height, models, average_model);
+    	}
+    	else
+    	{
+    	    std::vector<std::string> numbers;
+    	    anpr::ReadDirectory(directory, recursive, numbers, save_characters, model_image_width, model_image_height, models, average_model, no_of_threads, prefetch_depth, no_of_readers);
+    	}
+    }
+
+    if( opt->getValue( "stream" ) != NULL )
+    {
+    	std::string stream_filename = opt->getValue("stream");
+    	int frame_width = 0;
+    	int frame_height = 0;
+    	if( opt->getValue( "width" ) != NULL ) frame_width = atoi(opt->getValue("width"));
+    	if( opt->getValue( "height" ) != NULL ) frame_height = atoi(opt->getValue("height"));
     	std::vector<std::string> numbers;
-    	anpr::ReadDirectory(directory, numbers, save_characters, model_image_width, model_image_height, models, average_model);
+    	anpr::ReadStream(stream_filename, frame_width, frame_height, numbers, save_characters, model_image_width, model_image_height, models, average_model);
+    }
+
+    if (profile)
+    	profiler::Report(cout);
+
+    if (debug_writer != NULL)
+    {
+    	DebugSink::Set(NULL);
+    	delete debug_writer;
     }
 
     for (int i = 0; i < (int)models.size(); i++)
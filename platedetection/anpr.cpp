@@ -20,63 +20,164 @@
 #include "anpr.h"
 
 /*!
- * \brief returns a list of all filenames within a directory
+ * \brief returns a sorted list of the images within a directory
  * \param dir directory
- * \param filenames list of filenames
+ * \param filenames list of filenames, relative to the directory
  */
 void anpr::GetFilesInDirectory(std::string dir, std::vector<std::string> &filenames)
 {
-	filenames.clear();
+	imagefiles::List(dir, false, filenames);
+}
+
+/*!
+ * \brief state shared between the worker threads used by ReadDirectory
+ */
+struct anpr_directory_job
+{
+	std::string directory;
+	std::vector<std::string> filenames;
+	bool save_characters;
+	int model_image_width;
+	int model_image_height;
+	std::vector<float*> *models;
+	float* average_model;
+
+	// index of the next file to be processed
+	int next_file;
+
+	// loads files ahead of the workers, or NULL if each worker loads its own
+	ImagePrefetcher* prefetcher;
+
+	// results for each file, in filename order
+	std::vector<std::string> output;
+	std::vector<std::vector<std::string> > numbers;
+	std::vector<int> completed;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t file_completed;
+};
 
-    DIR *dp;
-    struct dirent *dirp;
-    if ((dp = opendir(dir.c_str())) == NULL)
+/*!
+ * \brief a worker thread within ReadDirectory
+ */
+struct anpr_directory_worker
+{
+	anpr_directory_job* job;
+	int thread_index;
+	pthread_t thread;
+};
+
+/*!
+ * \brief reads number plates from a single file within a directory
+ * \param filename name of the image file
+ * \param numbers returned number plate text
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param context buffers reused between images
+ * \param log stream to which progress and results are written
+ */
+void anpr::ReadDirectoryFile(
+    std::string filename,
+    std::vector<std::string> &numbers,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    DetectionContext *context,
+    std::ostream &log)
+{
+    Bitmap *bmp = new Bitmap();
+    JpegDecoder *jpeg = NULL;
+    bool loaded = false;
+    if (JpegDecoder::IsJpeg(filename))
     {
-    	cout << "Error opening " << dir << endl;
-    	return;
+    	jpeg = new JpegDecoder();
+    	loaded = jpeg->Load(filename);
     }
-
-    while ((dirp = readdir(dp)) != NULL)
+    else
     {
-    	std::string filename = dirp->d_name;
-    	if (filename.size() > 3)
-    	{
-    		if ((filename.substr(filename.size()-3,3) == "bmp") ||
-    		    (filename.substr(filename.size()-3,3) == "BMP"))
-    		{
-    		    //cout << "filename: " << filename << endl;
-                filenames.push_back(filename);
-    		}
-    	}
+        loaded = bmp->FromFile(filename, context->frame_buffer, context->frame_buffer_size);
     }
-    std::sort(filenames.begin(), filenames.end());
-    closedir(dp);
+    ReadDirectoryImage(
+        filename,
+        bmp,
+        jpeg,
+        loaded,
+        numbers,
+        save_characters,
+        character_index,
+        model_image_width,
+        model_image_height,
+        models,
+        average_model,
+        context,
+        log);
+    if (jpeg != NULL) delete jpeg;
+    delete bmp;
 }
 
-void anpr::ReadDirectory(
-    std::string directory,
+/*!
+ * \brief reads number plates from an image which has already been loaded from a directory
+ * \param filename name of the image file
+ * \param bmp the loaded image
+ * \param jpeg the loaded jpeg image, which is used in place of bmp, or NULL
+ * \param loaded false if the image could not be loaded
+ * \param numbers returned number plate text
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param context buffers reused between images
+ * \param log stream to which progress and results are written
+ */
+void anpr::ReadDirectoryImage(
+    std::string filename,
+    Bitmap *bmp,
+    JpegDecoder *jpeg,
+    bool loaded,
     std::vector<std::string> &numbers,
     bool save_characters,
+    int &character_index,
     int model_image_width,
     int model_image_height,
     std::vector<float*> &models,
-    float* average_model)
+    float* average_model,
+    DetectionContext *context,
+    std::ostream &log)
 {
-	int character_index = 0;
+	log << filename << "...";
 
-	std::vector<std::string> filenames;
-	GetFilesInDirectory(directory, filenames);
-	for (int i = 0; i < (int)filenames.size(); i++)
-	{
-		std::string filename = directory + "/" + filenames[i];
-
-		cout << filename << "...";
-
-        Bitmap *bmp = new Bitmap();
-        if (bmp->FromFile(filename))
+    if (loaded)
+    {
+        std::vector<polygon2D*> plates;
+        std::vector<std::string> temp_numbers;
+        if (jpeg != NULL)
+        {
+        	std::vector<std::vector<float> > character_scores;
+        	Read(jpeg,
+        		 plates,
+        		 temp_numbers,
+        		 character_scores,
+        		 save_characters,
+        		 character_index,
+        	     model_image_width,
+        	     model_image_height,
+        	     models,
+        	     average_model,
+        	     "",
+        	     context,
+        	     log);
+        }
+        else
         {
-            std::vector<polygon2D*> plates;
-            std::vector<std::string> temp_numbers;
         	Read(bmp->Data,
         		 bmp->Width, bmp->Height,
         		 plates,
@@ -87,25 +188,399 @@ void anpr::ReadDirectory(
         	     model_image_height,
         	     models,
         	     average_model,
-        	     "");
+        	     "",
+        	     context,
+        	     log);
+        }
 
-        	if ((int)temp_numbers.size() > 0)
-        	{
-        	    for (int p = 0; p < (int)temp_numbers.size(); p++)
-        	    {
-        	    	numbers.push_back(temp_numbers[p]);
-        	    	cout << temp_numbers[p] << " ";
-        	    }
-        	    cout << endl;
-        	}
-        	else
-        	{
-        		cout << "No plates found" << endl;
-        	}
+    	if ((int)temp_numbers.size() > 0)
+    	{
+    	    for (int p = 0; p < (int)temp_numbers.size(); p++)
+    	    {
+    	    	numbers.push_back(temp_numbers[p]);
+    	    	log << temp_numbers[p] << " ";
+    	    }
+    	    log << endl;
+    	}
+    	else
+    	{
+    		log << "No plates found" << endl;
+    	}
+
+        for (int i = 0; i < (int)plates.size(); i++)
+        {
+        	delete plates[i];
+        	plates[i] = NULL;
         }
+    }
+}
+
+/*!
+ * \brief worker thread which takes files from the job until none remain
+ * \param job the anpr_directory_worker for this thread
+ */
+void* anpr::ReadDirectoryThread(void* worker_ptr)
+{
+	anpr_directory_worker* worker = (anpr_directory_worker*)worker_ptr;
+	anpr_directory_job* job = worker->job;
+
+	DetectionContext *context = new DetectionContext();
+	int character_index = worker->thread_index * ANPR_CHARACTER_INDEX_RANGE;
+
+	// the cores are already occupied by the other directory workers
+	context->concurrent_passes = false;
+
+	bool finished = false;
+	while (!finished)
+	{
+		int i = 0;
+		prefetch_slot* slot = NULL;
+		if (job->prefetcher != NULL)
+		{
+			slot = job->prefetcher->Next();
+			if (slot != NULL)
+				i = slot->index;
+			else
+				finished = true;
+		}
+		else
+		{
+			pthread_mutex_lock(&job->mutex);
+			i = job->next_file;
+			if (i < (int)job->filenames.size())
+				job->next_file++;
+			else
+				finished = true;
+			pthread_mutex_unlock(&job->mutex);
+		}
+
+		if (!finished)
+		{
+			std::stringstream log;
+			std::vector<std::string> numbers;
+			if (slot != NULL)
+			{
+				ReadDirectoryImage(
+				    job->directory + "/" + job->filenames[i],
+				    slot->bmp,
+				    slot->is_jpeg ? slot->jpeg : NULL,
+				    slot->loaded,
+				    numbers,
+				    job->save_characters,
+				    character_index,
+				    job->model_image_width,
+				    job->model_image_height,
+				    *job->models,
+				    job->average_model,
+				    context,
+				    log);
+				job->prefetcher->Release(slot);
+			}
+			else
+			{
+				ReadDirectoryFile(
+				    job->directory + "/" + job->filenames[i],
+				    numbers,
+				    job->save_characters,
+				    character_index,
+				    job->model_image_width,
+				    job->model_image_height,
+				    *job->models,
+				    job->average_model,
+				    context,
+				    log);
+			}
+
+			pthread_mutex_lock(&job->mutex);
+			job->output[i] = log.str();
+			job->numbers[i] = numbers;
+			job->completed[i] = 1;
+			pthread_cond_broadcast(&job->file_completed);
+			pthread_mutex_unlock(&job->mutex);
+		}
+	}
+
+	delete context;
+	return(NULL);
+}
+
+/*!
+ * \brief reads number plates from all images within a directory
+ * \param directory directory containing images
+ * \param recursive also read images within subdirectories
+ * \param numbers returned number plate text
+ * \param save_characters save individual character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param no_of_threads number of worker threads.  Results are always reported in filename order.
+ * \param prefetch_depth number of images loaded ahead of those being processed, or zero to load each image when it is needed
+ * \param no_of_readers number of threads loading images when prefetching
+ */
+void anpr::ReadDirectory(
+    std::string directory,
+    bool recursive,
+    std::vector<std::string> &numbers,
+    bool save_characters,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    int no_of_threads,
+    int prefetch_depth,
+    int no_of_readers)
+{
+	std::vector<std::string> filenames;
+	imagefiles::List(directory, recursive, filenames);
+
+	if (no_of_threads > (int)filenames.size()) no_of_threads = (int)filenames.size();
+
+	// each worker holds one image while it is being processed
+	ImagePrefetcher* prefetcher = NULL;
+	if ((prefetch_depth > 0) && ((int)filenames.size() > 0))
+	{
+		std::vector<std::string> paths;
+		for (int i = 0; i < (int)filenames.size(); i++)
+			paths.push_back(directory + "/" + filenames[i]);
+		int workers = no_of_threads;
+		if (workers < 1) workers = 1;
+		prefetcher = new ImagePrefetcher(paths, prefetch_depth + workers, no_of_readers);
+	}
+
+	if (no_of_threads <= 1)
+	{
+		int character_index = 0;
+		DetectionContext *context = new DetectionContext();
+
+		for (int i = 0; i < (int)filenames.size(); i++)
+		{
+			if (prefetcher != NULL)
+			{
+				prefetch_slot* slot = prefetcher->Next();
+				ReadDirectoryImage(
+				    directory + "/" + filenames[i],
+				    slot->bmp,
+				    slot->is_jpeg ? slot->jpeg : NULL,
+				    slot->loaded,
+				    numbers,
+				    save_characters,
+				    character_index,
+				    model_image_width,
+				    model_image_height,
+				    models,
+				    average_model,
+				    context,
+				    cout);
+				prefetcher->Release(slot);
+			}
+			else
+			{
+				ReadDirectoryFile(
+				    directory + "/" + filenames[i],
+				    numbers,
+				    save_characters,
+				    character_index,
+				    model_image_width,
+				    model_image_height,
+				    models,
+				    average_model,
+				    context,
+				    cout);
+			}
+		}
+
+		delete context;
+	}
+	else
+	{
+		anpr_directory_job job;
+		job.directory = directory;
+		job.filenames = filenames;
+		job.save_characters = save_characters;
+		job.model_image_width = model_image_width;
+		job.model_image_height = model_image_height;
+		job.models = &models;
+		job.average_model = average_model;
+		job.next_file = 0;
+		job.prefetcher = prefetcher;
+		job.output.resize(filenames.size());
+		job.numbers.resize(filenames.size());
+		job.completed.resize(filenames.size(), 0);
+		pthread_mutex_init(&job.mutex, NULL);
+		pthread_cond_init(&job.file_completed, NULL);
+
+		// the workers take files as they become free, so those which
+		// start share the files of any which could not
+		anpr_directory_worker* workers = new anpr_directory_worker[no_of_threads];
+		int started = 0;
+		for (int t = 0; t < no_of_threads; t++)
+		{
+			workers[started].job = &job;
+			workers[started].thread_index = started;
+			if (pthread_create(&workers[started].thread, NULL, ReadDirectoryThread, &workers[started]) == 0)
+				started++;
+		}
+
+		// if no thread could be started then read every file in this one
+		if (started == 0)
+			ReadDirectoryThread(&workers[0]);
+
+		// report results in filename order as they become available
+		for (int i = 0; i < (int)filenames.size(); i++)
+		{
+			pthread_mutex_lock(&job.mutex);
+			while (job.completed[i] == 0)
+				pthread_cond_wait(&job.file_completed, &job.mutex);
+			std::string output = job.output[i];
+			job.output[i] = "";
+			pthread_mutex_unlock(&job.mutex);
+
+			cout << output;
+			for (int p = 0; p < (int)job.numbers[i].size(); p++)
+				numbers.push_back(job.numbers[i][p]);
+		}
+
+		for (int t = 0; t < started; t++)
+			pthread_join(workers[t].thread, NULL);
+
+		delete[] workers;
+		pthread_cond_destroy(&job.file_completed);
+		pthread_mutex_destroy(&job.mutex);
+	}
+
+	if (prefetcher != NULL) delete prefetcher;
+}
+
+/*!
+ * \brief reads number plates from images as they are written into a directory,
+ *        until the directory is removed.  Images already present are ignored.
+ * \param directory directory to be watched
+ * \param recursive also watch subdirectories, including those created later
+ * \param save_characters save individual character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ */
+void anpr::WatchDirectory(
+    std::string directory,
+    bool recursive,
+    bool save_characters,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model)
+{
+	DirectoryWatcher *watcher = new DirectoryWatcher();
+	if (watcher->Start(directory, recursive))
+	{
+		int character_index = 0;
+		DetectionContext *context = new DetectionContext();
+		std::vector<std::string> filenames;
+		std::vector<std::string> numbers;
+
+		cout << "Watching " << directory << endl;
+		while (watcher->Next(filenames, -1))
+		{
+			for (int i = 0; i < (int)filenames.size(); i++)
+			{
+				ReadDirectoryFile(
+				    directory + "/" + filenames[i],
+				    numbers,
+				    save_characters,
+				    character_index,
+				    model_image_width,
+				    model_image_height,
+				    models,
+				    average_model,
+				    context,
+				    cout);
+			}
+			numbers.clear();
+		}
+
+		delete context;
+	}
+	delete watcher;
+}
+
+/*!
+ * \brief reads number plates from a continuous stream of frames, printing one line per frame
+ * \param filename file or named pipe containing the frames, or "-" for stdin
+ * \param frame_width width of raw BGR frames, or zero for a y4m stream
+ * \param frame_height height of raw BGR frames, or zero for a y4m stream
+ * \param numbers returned number plate text
+ * \param save_characters save individual character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ */
+void anpr::ReadStream(
+    std::string filename,
+    int frame_width,
+    int frame_height,
+    std::vector<std::string> &numbers,
+    bool save_characters,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model)
+{
+	FrameStream *stream = new FrameStream();
+	if (stream->Open(filename, frame_width, frame_height))
+	{
+		int character_index = 0;
+		DetectionContext *context = new DetectionContext();
+
+		int frame_number = 0;
+		while (stream->ReadFrame())
+		{
+	        std::vector<polygon2D*> plates;
+	        std::vector<std::string> temp_numbers;
+	        std::stringstream log;
+	    	Read(stream->Data,
+	    		 stream->Width, stream->Height,
+	    		 plates,
+	    		 temp_numbers,
+	    		 save_characters,
+	    		 character_index,
+	    	     model_image_width,
+	    	     model_image_height,
+	    	     models,
+	    	     average_model,
+	    	     "",
+	    	     context,
+	    	     log);
+
+	    	cout << "frame " << frame_number << "...";
+	    	if ((int)temp_numbers.size() > 0)
+	    	{
+	    	    for (int p = 0; p < (int)temp_numbers.size(); p++)
+	    	    {
+	    	    	numbers.push_back(temp_numbers[p]);
+	    	    	cout << temp_numbers[p] << " ";
+	    	    }
+	    	}
+	    	else
+	    	{
+	    		cout << "No plates found";
+	    	}
+	    	// flush after every frame so that downstream processes see results immediately
+	    	cout << endl;
+
+	        for (int i = 0; i < (int)plates.size(); i++)
+	        {
+	        	delete plates[i];
+	        	plates[i] = NULL;
+	        }
+	        frame_number++;
+		}
 
-        delete bmp;
+		delete context;
 	}
+	delete stream;
 }
 
 void anpr::ReadFile(
@@ -169,133 +644,327 @@ void anpr::Read(
     float* average_model,
     std::string filtered_image_filename)
 {
-    bool debug = false;
+	DetectionContext *context = new DetectionContext();
+	Read(img_colour,
+		 img_width, img_height,
+		 plates,
+		 numbers,
+		 save_characters,
+		 character_index,
+		 model_image_width,
+		 model_image_height,
+		 models,
+		 average_model,
+		 filtered_image_filename,
+		 context,
+		 cout);
+	delete context;
+}
+
+void anpr::Read(
+    unsigned char* img_colour,
+    int img_width,
+    int img_height,
+    std::vector<polygon2D*> &plates,
+    std::vector<std::string> &numbers,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::string filtered_image_filename,
+    DetectionContext *context,
+    std::ostream &log)
+{
+	std::vector<std::vector<float> > character_scores;
+	Read(img_colour,
+		 img_width, img_height,
+		 plates,
+		 numbers,
+		 character_scores,
+		 save_characters,
+		 character_index,
+		 model_image_width,
+		 model_image_height,
+		 models,
+		 average_model,
+		 filtered_image_filename,
+		 context,
+		 log);
+}
+
+/*!
+ * \brief reads number plates from the given colour image
+ * \param img_colour colour image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param plates returned number plate perimeters
+ * \param numbers returned text for each plate
+ * \param character_scores returned difference between each character and its best fitting model (smaller is better)
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param filtered_image_filename optional filename to save the colour filtered image
+ * \param context buffers reused between images
+ * \param log stream to which progress is written
+ */
+void anpr::Read(
+    unsigned char* img_colour,
+    int img_width,
+    int img_height,
+    std::vector<polygon2D*> &plates,
+    std::vector<std::string> &numbers,
+    std::vector<std::vector<float> > &character_scores,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::string filtered_image_filename,
+    DetectionContext *context,
+    std::ostream &log)
+{
+	Read(imageview::Create(img_colour, img_width, img_height, 3),
+		 plates,
+		 numbers,
+		 character_scores,
+		 save_characters,
+		 character_index,
+		 model_image_width,
+		 model_image_height,
+		 models,
+		 average_model,
+		 filtered_image_filename,
+		 context,
+		 log);
+}
+
+/*!
+ * \brief reads number plates from the given colour image
+ * \param img colour image with three or more bytes per pixel in BGR order, which may be padded, bottom up or part of a larger image
+ * \param plates returned number plate perimeters
+ * \param numbers returned text for each plate
+ * \param character_scores returned difference between each character and its best fitting model (smaller is better)
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param filtered_image_filename optional filename to save the colour filtered image
+ * \param context buffers reused between images
+ * \param log stream to which progress is written
+ */
+void anpr::Read(
+    const image_view &img,
+    std::vector<polygon2D*> &plates,
+    std::vector<std::string> &numbers,
+    std::vector<std::vector<float> > &character_scores,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::string filtered_image_filename,
+    DetectionContext *context,
+    std::ostream &log)
+{
+    // debugging images are only produced when there is a sink to receive them
+    bool debug = (DebugSink::Current() != NULL);
     std::vector<unsigned char*> debug_images;
     int debug_image_width = 0;
     int debug_image_height = 0;
 
+    double read_start = profiler::Start();
+    double stage_start = read_start;
     platedetection::Find(
-        img_colour,
-        img_width, img_height,
+        img,
         plates,
         debug,
         debug_images,
         debug_image_width,
         debug_image_height,
-        filtered_image_filename);
+        filtered_image_filename,
+        context);
+    profiler::Stop(PROFILE_FIND, stage_start);
 
-    cout << "plates: " << (int)plates.size() << endl;
+    log << "plates: " << (int)plates.size() << endl;
 
     std::vector<unsigned char*> plate_images;
-    std::vector<unsigned char*> binary_images;
     if ((int)plates.size() > 0)
     {
         int plate_image_width = 200;
         std::vector<int> plate_image_height;
+        stage_start = profiler::Start();
 	    platedetection::ExtractPlateImages(
-	        img_colour,
-	        img_width, img_height,
+	        img,
 	        plates,
 	        plate_image_width,
 	        plate_image_height,
 	        plate_images);
+	    profiler::Stop(PROFILE_EXTRACT, stage_start);
 
-	    platereader::Binarise(
-	    	plate_image_width,
-	    	plate_image_height,
+	    ReadPlateImages(
+	        plate_image_width,
+	        plate_image_height,
 	        plate_images,
-	        binary_images);
-
-	    float minimum_character_width_percent = 2.5f;
-	    std::vector<std::vector<unsigned char*> > characters;
-	    std::vector<std::vector<int> > characters_dimensions;
-	    std::vector<std::vector<int> > characters_positions;
-	    platereader::SeparateCharacters(
-	    	minimum_character_width_percent,
-	    	plate_image_width,
-	    	plate_image_height,
-	        binary_images,
-	        characters,
-	        characters_dimensions,
-	        characters_positions);
-
-	    for (int p = 0; p < (int)plates.size(); p++)
-	    {
-	    	std::vector<unsigned char*> chars = characters[p];
-	    	std::vector<unsigned char*> resampled_chars;
-	    	std::vector<int> chars_positions = characters_positions[p];
-	    	std::vector<int> chars_dimensions = characters_dimensions[p];
-
-	    	platereader::RemoveStragglers(
-	    	    chars_dimensions,
-	    	    chars_positions,
-	    	    chars);
-
-	    	// resample to a fixed resolution
-	    	int resampled_width = 20;
-	    	int resampled_height = 20;
-	    	platereader::Resample(
-	    	    chars_dimensions,
-	            chars,
-	    	    resampled_width,
-	    	    resampled_height,
-	            resampled_chars);
-
-	    	if (save_characters)
-	    	{
+	        numbers,
+	        character_scores,
+	        save_characters,
+	        character_index,
+	        model_image_width,
+	        model_image_height,
+	        models,
+	        average_model,
+	        context,
+	        log);
+    }
+
+    profiler::Stop(PROFILE_READ, read_start);
+
+}
+
+/*!
+ * \brief reads the characters from extracted number plate images
+ * \param plate_image_width width of the plate images
+ * \param plate_image_height height of each plate image
+ * \param plate_images mono plate images, which are deallocated
+ * \param numbers returned text for each plate
+ * \param character_scores returned difference between each character and its best fitting model (smaller is better)
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param context buffers reused between images
+ * \param log stream to which progress is written
+ */
+void anpr::ReadPlateImages(
+    int plate_image_width,
+    std::vector<int> &plate_image_height,
+    std::vector<unsigned char*> &plate_images,
+    std::vector<std::string> &numbers,
+    std::vector<std::vector<float> > &character_scores,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    DetectionContext *context,
+    std::ostream &log)
+{
+    double stage_start;
+    std::vector<bit_image*> binary_images;
+
+    stage_start = profiler::Start();
+    platereader::Binarise(
+    	plate_image_width,
+    	plate_image_height,
+        plate_images,
+        binary_images);
+    profiler::Stop(PROFILE_BINARISE, stage_start);
+
+    float minimum_character_width_percent = 2.5f;
+    std::vector<std::vector<unsigned char*> > characters;
+    std::vector<std::vector<int> > characters_dimensions;
+    std::vector<std::vector<int> > characters_positions;
+    stage_start = profiler::Start();
+    platereader::SeparateCharacters(
+    	minimum_character_width_percent,
+    	plate_image_width,
+    	plate_image_height,
+        binary_images,
+        characters,
+        characters_dimensions,
+        characters_positions);
+    profiler::Stop(PROFILE_SEPARATE, stage_start);
+
+    for (int p = 0; p < (int)plate_images.size(); p++)
+    {
+    	std::vector<unsigned char*> chars = characters[p];
+    	std::vector<unsigned char*> resampled_chars;
+    	std::vector<int> chars_positions = characters_positions[p];
+    	std::vector<int> chars_dimensions = characters_dimensions[p];
+
+    	stage_start = profiler::Start();
+    	platereader::RemoveStragglers(
+    	    chars_dimensions,
+    	    chars_positions,
+    	    chars);
+    	profiler::Stop(PROFILE_STRAGGLERS, stage_start);
+
+    	// resample to a fixed resolution
+    	int resampled_width = 20;
+    	int resampled_height = 20;
+    	stage_start = profiler::Start();
+    	platereader::Resample(
+    	    chars_dimensions,
+            chars,
+    	    resampled_width,
+    	    resampled_height,
+            resampled_chars);
+    	profiler::Stop(PROFILE_RESAMPLE, stage_start);
+
+    	if (save_characters)
+    	{
 		    	for (int c = 0; c < (int)resampled_chars.size(); c++)
 		    	{
 					std::string char_filename = "";
 					std::stringstream s_char_filename;
-					s_char_filename << "char" << character_index << ".ppm";
+					s_char_filename << "char" << character_index << ".pgm";
 					s_char_filename >> char_filename;
 
-					cout << "Saving " << char_filename << endl;
+					log << "Saving " << char_filename << endl;
 
-					Bitmap *bmp_plate = new Bitmap(resampled_chars[c], resampled_width, resampled_height, 1);
-					//bmp_plate->Save(char_filename.c_str());
-					bmp_plate->SavePPM(char_filename.c_str());
-					delete bmp_plate;
+					Bitmap::SavePGM(char_filename.c_str(), resampled_chars[c], resampled_width, resampled_height);
 					character_index++;
 		    	}
-	    	}
+    	}
 
-	    	// recognise chars
-	    	std::string plate_number = "";
-	    	if ((int)models.size() > 0)
-	    	{
-	    		std::string plate_number =
-	    			ocr::RecognizeCharacters(
-	                    resampled_width,
-	    		        resampled_height,
-	    		        resampled_chars,
-	    		        models,
-	    		        average_model);
-	    	}
+    	// recognise chars
+    	std::string plate_number = "";
+    	std::vector<float> scores;
+    	if ((int)models.size() > 0)
+    	{
+    		context->AllocateOCR(resampled_width, resampled_height);
+    		stage_start = profiler::Start();
+    		plate_number =
+    			ocr::RecognizeCharacters(
+                    resampled_width,
+    		        resampled_height,
+    		        resampled_chars,
+    		        models,
+    		        average_model,
+    		        context->eigen_observation,
+    		        scores);
+    		profiler::Stop(PROFILE_OCR, stage_start);
+    	}
 
-	    	numbers.push_back(plate_number);
+    	numbers.push_back(plate_number);
+    	character_scores.push_back(scores);
 
-	    	for (int c = 0; c < (int)resampled_chars.size(); c++)
-	    	{
-	    		delete[] resampled_chars[c];
-	    		resampled_chars[c] = NULL;
-	    	}
-
-	    	for (int c = 0; c < (int)chars.size(); c++)
-	    	{
-	    		delete[] chars[c];
-	    		chars[c] = NULL;
-	    	}
-	    }
+    	for (int c = 0; c < (int)resampled_chars.size(); c++)
+    	{
+    		delete[] resampled_chars[c];
+    		resampled_chars[c] = NULL;
+    	}
 
+    	for (int c = 0; c < (int)chars.size(); c++)
+    	{
+    		delete[] chars[c];
+    		chars[c] = NULL;
+    	}
     }
-/*
-    for (int i = 0; i < (int)plates.size(); i++)
-    {
-    	delete plates[i];
-    	plates[i] = NULL;
-    }
-*/
+
+
     for (int i = 0; i < (int)plate_images.size(); i++)
     {
     	delete[] plate_images[i];
@@ -304,9 +973,161 @@ void anpr::Read(
 
     for (int i = 0; i < (int)binary_images.size(); i++)
     {
-    	delete[] binary_images[i];
+    	bitimage::Free(binary_images[i]);
     	binary_images[i] = NULL;
     }
-
 }
 
+/*!
+ * \brief reads number plates from a jpeg image.  Plates are detected within
+ *        an image decoded at reduced scale in the DCT domain, and only the
+ *        regions containing candidate plates are decoded at full resolution.
+ * \param jpeg decoder into which the image has been loaded
+ * \param plates returned number plate perimeters, in full resolution image coordinates
+ * \param numbers returned text for each plate
+ * \param character_scores returned difference between each character and its best fitting model (smaller is better)
+ * \param save_characters save individual character images
+ * \param character_index index used when saving character images
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ * \param models character eigenmodels
+ * \param average_model average character model
+ * \param filtered_image_filename optional filename to save the colour filtered image
+ * \param context buffers reused between images
+ * \param log stream to which progress is written
+ */
+void anpr::Read(
+    JpegDecoder *jpeg,
+    std::vector<polygon2D*> &plates,
+    std::vector<std::string> &numbers,
+    std::vector<std::vector<float> > &character_scores,
+    bool save_characters,
+    int &character_index,
+    int model_image_width,
+    int model_image_height,
+    std::vector<float*> &models,
+    float* average_model,
+    std::string filtered_image_filename,
+    DetectionContext *context,
+    std::ostream &log)
+{
+    // debugging images are only produced when there is a sink to receive them
+    bool debug = (DebugSink::Current() != NULL);
+    std::vector<unsigned char*> debug_images;
+    int debug_image_width = 0;
+    int debug_image_height = 0;
+
+    double read_start = profiler::Start();
+
+    // decode at the smallest scale which still provides the resolution used for detection
+    double stage_start = read_start;
+    int scale = jpeg->ScaleForWidth(ANPR_JPEG_DETECTION_WIDTH);
+    int detection_width = 0;
+    int detection_height = 0;
+    jpeg->ScaledSize(scale, detection_width, detection_height);
+    if (context->frame_buffer_size < detection_width * detection_height * 3)
+    {
+    	if (context->frame_buffer != NULL) delete[] context->frame_buffer;
+    	context->frame_buffer_size = detection_width * detection_height * 3;
+    	context->frame_buffer = new unsigned char[context->frame_buffer_size];
+    }
+    jpeg->Decode(scale, context->frame_buffer);
+    profiler::Stop(PROFILE_DECODE, stage_start);
+
+    stage_start = profiler::Start();
+    platedetection::Find(
+        imageview::Create(context->frame_buffer, detection_width, detection_height, 3),
+        plates,
+        debug,
+        debug_images,
+        debug_image_width,
+        debug_image_height,
+        filtered_image_filename,
+        context);
+    profiler::Stop(PROFILE_FIND, stage_start);
+
+    log << "plates: " << (int)plates.size() << endl;
+
+    // return the plates in full resolution coordinates
+    if (scale > 1)
+    {
+        for (int p = 0; p < (int)plates.size(); p++)
+        {
+        	polygon2D* scaled = plates[p]->Scale(
+        	    detection_width, detection_height,
+        	    detection_width * scale, detection_height * scale);
+        	delete plates[p];
+        	plates[p] = scaled;
+        }
+    }
+
+    std::vector<unsigned char*> plate_images;
+    if ((int)plates.size() > 0)
+    {
+        int plate_image_width = 200;
+        std::vector<int> plate_image_height;
+        for (int p = 0; p < (int)plates.size(); p++)
+        {
+        	// decode the region around the plate at full resolution
+        	stage_start = profiler::Start();
+        	float left = 0, top = 0, right = 0, bottom = 0;
+        	plates[p]->BoundingBox(left, top, right, bottom);
+        	int tx = (int)left - ANPR_JPEG_PLATE_MARGIN;
+        	int ty = (int)top - ANPR_JPEG_PLATE_MARGIN;
+        	int bx = (int)right + 1 + ANPR_JPEG_PLATE_MARGIN;
+        	int by = (int)bottom + 1 + ANPR_JPEG_PLATE_MARGIN;
+        	if (tx < 0) tx = 0;
+        	if (ty < 0) ty = 0;
+        	if (bx > jpeg->Width) bx = jpeg->Width;
+        	if (by > jpeg->Height) by = jpeg->Height;
+        	if ((bx <= tx) || (by <= ty))
+        	{
+        		tx = ty = 0;
+        		bx = by = 1;
+        	}
+        	int region_width = bx - tx;
+        	int region_height = by - ty;
+        	unsigned char* region = new unsigned char[region_width * region_height * 3];
+        	jpeg->Decode(1, tx, ty, bx, by, region);
+        	profiler::Stop(PROFILE_DECODE, stage_start);
+
+        	// perimeter relative to the region
+        	std::vector<polygon2D*> region_plate;
+        	region_plate.push_back(plates[p]->Copy());
+        	for (int i = 0; i < (int)region_plate[0]->x_points.size(); i++)
+        	{
+        		region_plate[0]->x_points[i] -= tx;
+        		region_plate[0]->y_points[i] -= ty;
+        	}
+
+        	stage_start = profiler::Start();
+        	platedetection::ExtractPlateImages(
+        	    imageview::Create(region, region_width, region_height, 3),
+        	    region_plate,
+        	    plate_image_width,
+        	    plate_image_height,
+        	    plate_images);
+        	profiler::Stop(PROFILE_EXTRACT, stage_start);
+
+        	delete region_plate[0];
+        	delete[] region;
+        }
+
+        ReadPlateImages(
+            plate_image_width,
+            plate_image_height,
+            plate_images,
+            numbers,
+            character_scores,
+            save_characters,
+            character_index,
+            model_image_width,
+            model_image_height,
+            models,
+            average_model,
+            context,
+            log);
+    }
+
+    profiler::Stop(PROFILE_READ, read_start);
+}
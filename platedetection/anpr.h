@@ -25,32 +25,124 @@
 #endif
 
 #include <math.h>
+#include <pthread.h>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <cstdlib>
 #include <vector>
 #include "../common.h"
 #include "../utils/Image.h"
+#include "../utils/imageview.h"
 #include "../utils/polygon.h"
 #include "../shapes/shapes.h"
 #include "platedetection.h"
 #include "platereader.h"
 #include "ocr.h"
+#include "../utils/framestream.h"
+#include "../utils/imageprefetcher.h"
+#include "../utils/jpegdecoder.h"
+#include "../utils/imagefiles.h"
+#include "../utils/directorywatcher.h"
+#include "../utils/profiler.h"
+
+// number of character image indexes reserved for each worker thread
+// when saving characters from a directory with multiple threads
+#define ANPR_CHARACTER_INDEX_RANGE  1000000
+
+// default number of images loaded ahead of those being processed within a directory
+#define ANPR_PREFETCH_DEPTH         2
+
+// jpeg images are decoded at the smallest scale which is at least this wide
+// for plate detection, which downsamples to this width in any case
+#define ANPR_JPEG_DETECTION_WIDTH   320
+
+// border in pixels decoded at full resolution around each detected plate
+#define ANPR_JPEG_PLATE_MARGIN      4
 
 class anpr {
 private:
+	static void ReadDirectoryFile(
+	    std::string filename,
+	    std::vector<std::string> &numbers,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+	static void ReadDirectoryImage(
+	    std::string filename,
+	    Bitmap *bmp,
+	    JpegDecoder *jpeg,
+	    bool loaded,
+	    std::vector<std::string> &numbers,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+	static void* ReadDirectoryThread(void* job);
+
+	static void ReadPlateImages(
+	    int plate_image_width,
+	    std::vector<int> &plate_image_height,
+	    std::vector<unsigned char*> &plate_images,
+	    std::vector<std::string> &numbers,
+	    std::vector<std::vector<float> > &character_scores,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+public:
 	static void GetFilesInDirectory(
 	    std::string dir,
 	    std::vector<std::string> &filenames);
 
-public:
 	static void ReadDirectory(
 	    std::string directory,
+	    bool recursive,
 	    std::vector<std::string> &numbers,
 	    bool save_characters,
         int model_image_width,
         int model_image_height,
         std::vector<float*> &models,
-        float* average_model);
+        float* average_model,
+        int no_of_threads,
+        int prefetch_depth,
+        int no_of_readers);
+
+	static void WatchDirectory(
+	    std::string directory,
+	    bool recursive,
+	    bool save_characters,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model);
+
+	static void ReadStream(
+	    std::string filename,
+	    int frame_width,
+	    int frame_height,
+	    std::vector<std::string> &numbers,
+	    bool save_characters,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model);
 
 	static void ReadFile(
 	    std::string filename,
@@ -79,6 +171,69 @@ public:
 	    float* average_model,
 	    std::string filtered_image_filename);
 
+	static void Read(
+	    unsigned char* img_colour,
+	    int img_width,
+	    int img_height,
+	    std::vector<polygon2D*> &plates,
+	    std::vector<std::string> &numbers,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::string filtered_image_filename,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+	static void Read(
+	    unsigned char* img_colour,
+	    int img_width,
+	    int img_height,
+	    std::vector<polygon2D*> &plates,
+	    std::vector<std::string> &numbers,
+	    std::vector<std::vector<float> > &character_scores,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::string filtered_image_filename,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+	static void Read(
+	    const image_view &img,
+	    std::vector<polygon2D*> &plates,
+	    std::vector<std::string> &numbers,
+	    std::vector<std::vector<float> > &character_scores,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::string filtered_image_filename,
+	    DetectionContext *context,
+	    std::ostream &log);
+
+	static void Read(
+	    JpegDecoder *jpeg,
+	    std::vector<polygon2D*> &plates,
+	    std::vector<std::string> &numbers,
+	    std::vector<std::vector<float> > &character_scores,
+	    bool save_characters,
+	    int &character_index,
+	    int model_image_width,
+	    int model_image_height,
+	    std::vector<float*> &models,
+	    float* average_model,
+	    std::string filtered_image_filename,
+	    DetectionContext *context,
+	    std::ostream &log);
+
 };
 
 #endif /* ANPR_H_ */
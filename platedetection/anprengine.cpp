@@ -0,0 +1,153 @@
+/*
+    embeddable number plate recognition engine
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "anprengine.h"
+
+AnprEngine::AnprEngine()
+{
+	model_image_width = ANPRENGINE_MODEL_WIDTH;
+	model_image_height = ANPRENGINE_MODEL_HEIGHT;
+	average_model = new float[model_image_width * model_image_height];
+	memset(average_model, 0, model_image_width * model_image_height * sizeof(float));
+	context = new DetectionContext();
+	character_index = 0;
+	save_characters = false;
+}
+
+/*!
+ * \brief creates an engine and loads the given character models
+ * \param model_filename character models saved by ocr::SaveCharacterModels
+ */
+AnprEngine::AnprEngine(std::string model_filename)
+{
+	model_image_width = ANPRENGINE_MODEL_WIDTH;
+	model_image_height = ANPRENGINE_MODEL_HEIGHT;
+	average_model = new float[model_image_width * model_image_height];
+	memset(average_model, 0, model_image_width * model_image_height * sizeof(float));
+	context = new DetectionContext();
+	character_index = 0;
+	save_characters = false;
+	LoadModels(model_filename);
+}
+
+AnprEngine::~AnprEngine()
+{
+	FreeModels();
+	delete[] average_model;
+	delete context;
+}
+
+/*!
+ * \brief releases any loaded character models
+ */
+void AnprEngine::FreeModels()
+{
+	for (int i = 0; i < (int)models.size(); i++)
+		delete[] models[i];
+	models.clear();
+}
+
+/*!
+ * \brief loads character models, replacing any which were previously loaded
+ * \param model_filename character models saved by ocr::SaveCharacterModels
+ * \return true if models were loaded
+ */
+bool AnprEngine::LoadModels(std::string model_filename)
+{
+	FreeModels();
+	ocr::LoadCharacterModels(model_filename, model_image_width, model_image_height, models, average_model);
+	return(ModelsLoaded());
+}
+
+/*!
+ * \brief returns true if character models are available for recognition
+ */
+bool AnprEngine::ModelsLoaded()
+{
+	return((int)models.size() > 0);
+}
+
+/*!
+ * \brief detects and reads the number plates within the given frame
+ * \param frame colour image
+ * \param result returned plates
+ */
+void AnprEngine::Process(
+    const FrameView &frame,
+    AnprResult &result)
+{
+	Process(imageview::Create(frame.data, frame.width, frame.height, 3), result);
+}
+
+/*!
+ * \brief detects and reads the number plates within the given frame without copying it
+ * \param frame colour image with three or more bytes per pixel in BGR order,
+ *        such as a padded camera buffer or a region of a larger image
+ * \param result returned plates
+ */
+void AnprEngine::Process(
+    const image_view &frame,
+    AnprResult &result)
+{
+	std::vector<polygon2D*> plates;
+	std::vector<std::string> numbers;
+	std::vector<std::vector<float> > character_scores;
+	std::stringstream log;
+
+	result.plates.clear();
+
+	anpr::Read(
+	    frame,
+	    plates,
+	    numbers,
+	    character_scores,
+	    save_characters,
+	    character_index,
+	    model_image_width,
+	    model_image_height,
+	    models,
+	    average_model,
+	    "",
+	    context,
+	    log);
+
+	for (int p = 0; p < (int)plates.size(); p++)
+	{
+		AnprPlate plate;
+		plate.perimeter = *plates[p];
+		if (p < (int)numbers.size()) plate.text = numbers[p];
+		if (p < (int)character_scores.size()) plate.character_scores = character_scores[p];
+		result.plates.push_back(plate);
+
+		delete plates[p];
+		plates[p] = NULL;
+	}
+}
+
+/*!
+ * \brief detects and reads the number plates within the given frame
+ * \param frame colour image
+ * \return detected plates
+ */
+AnprResult AnprEngine::Process(const FrameView &frame)
+{
+	AnprResult result;
+	Process(frame, result);
+	return(result);
+}
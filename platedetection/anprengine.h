@@ -0,0 +1,105 @@
+/*
+    embeddable number plate recognition engine
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANPRENGINE_H_
+#define ANPRENGINE_H_
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../utils/polygon.h"
+#include "../utils/imageview.h"
+#include "detectioncontext.h"
+#include "anpr.h"
+#include "ocr.h"
+
+#define ANPRENGINE_MODEL_WIDTH   20
+#define ANPRENGINE_MODEL_HEIGHT  20
+
+/*!
+ * \brief a colour image to be processed, in the same layout as Bitmap::Data
+ *        (3 bytes per pixel, BGR, top row first)
+ */
+struct FrameView
+{
+	unsigned char* data;
+	int width;
+	int height;
+};
+
+/*!
+ * \brief a number plate detected within a frame
+ */
+struct AnprPlate
+{
+	// perimeter of the plate in image coordinates
+	polygon2D perimeter;
+
+	// recognised text, which is empty if no character models are loaded
+	std::string text;
+
+	// difference between each character and its best fitting model (smaller is better)
+	std::vector<float> character_scores;
+};
+
+/*!
+ * \brief results of processing a single frame
+ */
+struct AnprResult
+{
+	std::vector<AnprPlate> plates;
+};
+
+/*!
+ * \brief long lived recognition engine
+ *
+ * Character models are loaded once, and scratch memory is kept between
+ * frames, so that repeated calls to Process avoid the start up costs of
+ * anpr::ReadFile.  An engine must not be shared between threads.
+ */
+class AnprEngine
+{
+private:
+	DetectionContext *context;
+	std::vector<float*> models;
+	float* average_model;
+	int model_image_width;
+	int model_image_height;
+	int character_index;
+
+	void FreeModels();
+
+public:
+	// save each character image as charN.pgm
+	bool save_characters;
+
+	AnprEngine();
+	AnprEngine(std::string model_filename);
+	~AnprEngine();
+
+	bool LoadModels(std::string model_filename);
+	bool ModelsLoaded();
+
+	void Process(const FrameView &frame, AnprResult &result);
+	void Process(const image_view &frame, AnprResult &result);
+	AnprResult Process(const FrameView &frame);
+};
+
+#endif /* ANPRENGINE_H_ */
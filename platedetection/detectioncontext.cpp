@@ -0,0 +1,174 @@
+/*
+    reusable buffers for number plate detection
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "detectioncontext.h"
+
+int DetectionContext::default_detection_width = 0;
+int DetectionContext::default_edge_threads = 1;
+bool DetectionContext::default_fixed_point_edges = false;
+
+DetectionContext::DetectionContext()
+{
+	pixels_allocated = 0;
+	filtered = NULL;
+	for (int pass = 0; pass < DETECTION_PASSES; pass++)
+	{
+		mono_img[pass] = NULL;
+		erosion_dilation_buffer[pass] = NULL;
+		edge_detector[pass] = new CannyEdgeDetector();
+		edge_detector[pass]->no_of_threads = default_edge_threads;
+		edge_detector[pass]->fixed_point = default_fixed_point_edges;
+	}
+	concurrent_passes = true;
+	pass_pool = NULL;
+	detection_width = default_detection_width;
+	detection_frame = NULL;
+	detection_frame_size = 0;
+	detection_sums = NULL;
+	detection_sums_length = 0;
+	eigen_observation = NULL;
+	eigen_observation_length = 0;
+	frame_buffer = NULL;
+	frame_buffer_size = 0;
+}
+
+DetectionContext::~DetectionContext()
+{
+	FreeMemory();
+	if (eigen_observation != NULL) delete[] eigen_observation;
+	if (frame_buffer != NULL) delete[] frame_buffer;
+	if (detection_frame != NULL) delete[] detection_frame;
+	if (detection_sums != NULL) delete[] detection_sums;
+	if (pass_pool != NULL) delete pass_pool;
+	for (int pass = 0; pass < DETECTION_PASSES; pass++)
+		delete edge_detector[pass];
+}
+
+/*!
+ * \brief sets the detection width given to contexts created after this call
+ * \param width maximum width at which colour filtering takes place (0 = full resolution)
+ */
+void DetectionContext::SetDefaultDetectionWidth(
+    int width)
+{
+	default_detection_width = width;
+}
+
+/*!
+ * \brief sets the number of threads used by the edge detectors of contexts created after this call
+ * \param no_of_threads number of threads over which bands of each image are spread
+ */
+void DetectionContext::SetDefaultEdgeThreads(
+    int no_of_threads)
+{
+	default_edge_threads = no_of_threads;
+}
+
+/*!
+ * \brief sets whether the edge detectors of contexts created after this call use fixed point arithmetic
+ * \param fixed_point use 16 bit fixed point smoothing and gradients
+ */
+void DetectionContext::SetDefaultFixedPointEdges(
+    bool fixed_point)
+{
+	default_fixed_point_edges = fixed_point;
+}
+
+/*!
+ * \brief ensures that the buffers are large enough for an image of the given size
+ * \param img_width width of the image
+ * \param img_height height of the image
+ */
+void DetectionContext::Allocate(
+    int img_width,
+    int img_height)
+{
+	int pixels = img_width * img_height;
+	if (pixels > pixels_allocated)
+	{
+		FreeMemory();
+		filtered = new unsigned char[pixels * 3];
+		for (int pass = 0; pass < DETECTION_PASSES; pass++)
+		{
+			mono_img[pass] = new unsigned char[pixels];
+			erosion_dilation_buffer[pass] = new unsigned char[pixels];
+		}
+		pixels_allocated = pixels;
+	}
+}
+
+/*!
+ * \brief clears the buffers and edge detector results left over from a previous frame
+ *
+ * Each detection pass then starts from the same state as it would
+ * with freshly allocated buffers, so results do not depend upon what
+ * was processed before.  The mono image is left alone, since the
+ * colour filter has already written this frame into it.
+ * \param pass index of the plate colour pass
+ * \param img_width width of the image
+ * \param img_height height of the image
+ */
+void DetectionContext::Clear(
+    int pass,
+    int img_width,
+    int img_height)
+{
+	int pixels = img_width * img_height;
+	memset(erosion_dilation_buffer[pass], 0, pixels);
+	edge_detector[pass]->edges.clear();
+	edges[pass].clear();
+	orientation[pass].clear();
+	dominant_edges[pass].clear();
+	side_edges[pass].clear();
+}
+
+/*!
+ * \brief ensures that the character recognition buffer is large enough for the given model size
+ * \param model_image_width width of the character models
+ * \param model_image_height height of the character models
+ */
+void DetectionContext::AllocateOCR(
+    int model_image_width,
+    int model_image_height)
+{
+	int length = model_image_width * model_image_height;
+	if (length > eigen_observation_length)
+	{
+		if (eigen_observation != NULL) delete[] eigen_observation;
+		eigen_observation = new float[length];
+		eigen_observation_length = length;
+	}
+}
+
+/*!
+ * \brief releases the image buffers
+ */
+void DetectionContext::FreeMemory()
+{
+	if (filtered != NULL) delete[] filtered;
+	filtered = NULL;
+	for (int pass = 0; pass < DETECTION_PASSES; pass++)
+	{
+		if (mono_img[pass] != NULL) delete[] mono_img[pass];
+		if (erosion_dilation_buffer[pass] != NULL) delete[] erosion_dilation_buffer[pass];
+		mono_img[pass] = NULL;
+		erosion_dilation_buffer[pass] = NULL;
+	}
+	pixels_allocated = 0;
+}
@@ -0,0 +1,105 @@
+/*
+    reusable buffers for number plate detection
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DETECTIONCONTEXT_H_
+#define DETECTIONCONTEXT_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../common.h"
+#include "../edgedetection/CannyEdgeDetector.h"
+#include "../utils/threadpool.h"
+
+// number of plate colour passes (yellow and white), each of which
+// has its own scratch buffers so that the passes can run concurrently
+#define DETECTION_PASSES  2
+
+/*!
+ * \brief scratch memory used by platedetection::Find
+ *
+ * Buffers are sized lazily to the largest frame seen so far, so that
+ * repeated calls on frames of the same size do not reallocate.
+ * A context must not be shared between threads, so each worker
+ * thread should own its own.  The per-pass arrays are indexed by
+ * plate colour (PLATE_YELLOW, PLATE_WHITE).
+ */
+class DetectionContext
+{
+private:
+	int pixels_allocated;
+	int eigen_observation_length;
+	static int default_detection_width;
+	static int default_edge_threads;
+	static bool default_fixed_point_edges;
+
+	// not copyable, since the buffers are owned by the context
+	DetectionContext(const DetectionContext &context);
+	DetectionContext &operator=(const DetectionContext &context);
+
+public:
+	unsigned char* filtered;
+	unsigned char* mono_img[DETECTION_PASSES];
+	unsigned char* erosion_dilation_buffer[DETECTION_PASSES];
+	CannyEdgeDetector* edge_detector[DETECTION_PASSES];
+
+	// run the plate colour passes in separate threads
+	bool concurrent_passes;
+
+	// worker which runs one of the passes, started on first use
+	ThreadPool* pass_pool;
+
+	// when non-zero, colour images wider than this are reduced to this
+	// width before colour filtering, so that detection never touches the
+	// full resolution image after the first pass over it
+	int detection_width;
+
+	// colour image reduced to the detection width, and the row totals used to reduce it
+	unsigned char* detection_frame;
+	int detection_frame_size;
+	int* detection_sums;
+	int detection_sums_length;
+
+	// scratch space used by ocr::RecognizeCharacters
+	float* eigen_observation;
+
+	// decoded image, reused by Bitmap::FromFile when reading a sequence of files
+	unsigned char* frame_buffer;
+	int frame_buffer_size;
+
+	// results of shape detection, kept here so that their capacity is reused
+	std::vector<int> edges[DETECTION_PASSES];
+	std::vector<float> orientation[DETECTION_PASSES];
+	std::vector<std::vector<int> > dominant_edges[DETECTION_PASSES];
+	std::vector<std::vector<std::vector<int> > > side_edges[DETECTION_PASSES];
+
+	DetectionContext();
+	~DetectionContext();
+
+	static void SetDefaultDetectionWidth(int width);
+	static void SetDefaultEdgeThreads(int no_of_threads);
+	static void SetDefaultFixedPointEdges(bool fixed_point);
+
+	void Allocate(int img_width, int img_height);
+	void AllocateOCR(int model_image_width, int model_image_height);
+	void Clear(int pass, int img_width, int img_height);
+	void FreeMemory();
+};
+
+#endif /* DETECTIONCONTEXT_H_ */
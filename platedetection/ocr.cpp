@@ -82,8 +82,71 @@ std::string ocr::RecognizeCharacters(
 	std::vector<unsigned char*> observation,
 	std::vector<float*> &models,
 	float* average_model)
+{
+	float* eigen_observation = new float[model_image_width * model_image_height];
+	string result =
+	    RecognizeCharacters(
+	        model_image_width,
+	        model_image_height,
+	        observation,
+	        models,
+	        average_model,
+	        eigen_observation);
+	delete[] eigen_observation;
+	return(result);
+}
+
+/*!
+ * \brief recognizes a sequence of characters
+ * \param model_image_width width of the model
+ * \param model_image_height height of the model
+ * \param observation observed character images
+ * \param models eigenmodels for each character
+ * \param average_model average character model
+ * \param eigen_observation buffer of model_image_width * model_image_height used to store the eigen image of each observation
+ * \return recognised characters
+ */
+std::string ocr::RecognizeCharacters(
+    int model_image_width,
+	int model_image_height,
+	std::vector<unsigned char*> observation,
+	std::vector<float*> &models,
+	float* average_model,
+	float* eigen_observation)
+{
+	std::vector<float> similarities;
+	return(RecognizeCharacters(
+	    model_image_width,
+	    model_image_height,
+	    observation,
+	    models,
+	    average_model,
+	    eigen_observation,
+	    similarities));
+}
+
+/*!
+ * \brief recognizes a sequence of characters
+ * \param model_image_width width of the model
+ * \param model_image_height height of the model
+ * \param observation observed character images
+ * \param models eigenmodels for each character
+ * \param average_model average character model
+ * \param eigen_observation buffer of model_image_width * model_image_height used to store the eigen image of each observation
+ * \param similarities returned difference between each observation and its best fitting eigenmodel (smaller is better)
+ * \return recognised characters
+ */
+std::string ocr::RecognizeCharacters(
+    int model_image_width,
+	int model_image_height,
+	std::vector<unsigned char*> observation,
+	std::vector<float*> &models,
+	float* average_model,
+	float* eigen_observation,
+	std::vector<float> &similarities)
 {
 	string result = "";
+	similarities.clear();
 	for (int i = 0; i < (int)observation.size(); i++)
 	{
 		float similarity = 0;
@@ -93,8 +156,10 @@ std::string ocr::RecognizeCharacters(
 	    	observation[i],
 	    	models,
 	    	average_model,
+	    	eigen_observation,
 	    	similarity);
 	    result += c;
+	    similarities.push_back(similarity);
 	}
 	return(result);
 }
@@ -116,11 +181,44 @@ char ocr::RecognizeCharacter(
 	std::vector<float*> &models,
 	float* average_model,
 	float &similarity)
+{
+	float* eigen_observation = new float[model_image_width * model_image_height];
+	char result =
+	    RecognizeCharacter(
+	        model_image_width,
+	        model_image_height,
+	        observation,
+	        models,
+	        average_model,
+	        eigen_observation,
+	        similarity);
+	delete[] eigen_observation;
+	return(result);
+}
+
+/*!
+ * \brief recognizes an individual character from the given observation
+ * \param model_image_width width of the model
+ * \param model_image_height height of the model
+ * \param observation observed character image
+ * \param models eigenmodels for each character
+ * \param average_model average character model
+ * \param eigen_observation buffer of model_image_width * model_image_height used to store the eigen image of the observation
+ * \param similarity returned difference between the observation and the best fitting eigenmodel
+ * \return recognised character
+ */
+char ocr::RecognizeCharacter(
+    int model_image_width,
+	int model_image_height,
+	unsigned char* observation,
+	std::vector<float*> &models,
+	float* average_model,
+	float* eigen_observation,
+	float &similarity)
 {
 	char result = ' ';
 
 	// create an eigen image of the observation
-	float* eigen_observation = new float[model_image_width * model_image_height];
 	for (int i = (model_image_width * model_image_height)-1; i >= 0; i--)
         eigen_observation[i] = (float)observation[i] - average_model[i];
 
@@ -147,7 +245,6 @@ char ocr::RecognizeCharacter(
 	    	result = (char)(winner - 26 + 48);
 	}
 
-	delete[] eigen_observation;
 	return(result);
 }
 
@@ -237,7 +334,7 @@ void ocr::CreateCharacterModel(
 	int model_hits = 0;
 
 	std::vector<std::string> filenames;
-	GetFilesInDirectory(character_directory, filenames);
+	imagefiles::List(character_directory, false, filenames);
 	for (int i = 0; i < (int)filenames.size(); i++)
 	{
 		std::string filename = character_directory + "/" + filenames[i];
@@ -260,37 +357,3 @@ void ocr::CreateCharacterModel(
     	    model[i] /= model_hits;
 	}
 }
-
-/*!
- * \brief returns a list of all filenames within a directory
- * \param dir directory
- * \param filenames list of filenames
- */
-void ocr::GetFilesInDirectory(std::string dir, std::vector<std::string> &filenames)
-{
-	filenames.clear();
-
-    DIR *dp;
-    struct dirent *dirp;
-    if ((dp = opendir(dir.c_str())) == NULL)
-    {
-    	cout << "Error opening " << dir << endl;
-    	return;
-    }
-
-    while ((dirp = readdir(dp)) != NULL)
-    {
-    	std::string filename = dirp->d_name;
-    	if (filename.size() > 3)
-    	{
-    		if ((filename.substr(filename.size()-3,3) == "bmp") ||
-    		    (filename.substr(filename.size()-3,3) == "BMP"))
-    		{
-    		    //cout << "filename: " << filename << endl;
-                filenames.push_back(filename);
-    		}
-    	}
-    }
-    std::sort(filenames.begin(), filenames.end());
-    closedir(dp);
-}
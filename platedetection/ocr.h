@@ -15,12 +15,9 @@
 #include "../shapes/shapes.h"
 #include "platedetection.h"
 #include "platereader.h"
+#include "../utils/imagefiles.h"
 
 class ocr {
-private:
-	static void GetFilesInDirectory(
-	    std::string dir,
-	    std::vector<std::string> &filenames);
 public:
 	static void LoadCharacterModels(
 	    std::string filename,
@@ -43,12 +40,38 @@ public:
 		std::vector<float*> &models,
 		float* average_model);
 
+	static std::string RecognizeCharacters(
+	    int model_image_width,
+		int model_image_height,
+		std::vector<unsigned char*> observation,
+		std::vector<float*> &models,
+		float* average_model,
+		float* eigen_observation);
+
+	static std::string RecognizeCharacters(
+	    int model_image_width,
+		int model_image_height,
+		std::vector<unsigned char*> observation,
+		std::vector<float*> &models,
+		float* average_model,
+		float* eigen_observation,
+		std::vector<float> &similarities);
+
+	static char RecognizeCharacter(
+	    int model_image_width,
+		int model_image_height,
+		unsigned char* observation,
+		std::vector<float*> &models,
+		float* average_model,
+		float &similarity);
+
 	static char RecognizeCharacter(
 	    int model_image_width,
 		int model_image_height,
 		unsigned char* observation,
 		std::vector<float*> &models,
 		float* average_model,
+		float* eigen_observation,
 		float &similarity);
 
 	static void CreateCharacterEigenModels(
@@ -24,39 +24,395 @@ void platedetection::ColourFilter(
     int img_width, int img_height,
     unsigned char* filtered)
 {
-	int* histogram = new int[256];
-	int* temp_histogram = new int[256];
+	ColourFilter(imageview::Create(img_colour, img_width, img_height, 3), filtered);
+}
+
+/*!
+ * \brief applies yellow and white colour filters
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param filtered returned filtered image, tightly packed with three bytes per pixel.
+ *        The first byte of each pixel is the yellow response, the second the white
+ *        response and the third repeats the yellow response.
+ */
+void platedetection::ColourFilter(
+    const image_view &img,
+    unsigned char* filtered)
+{
+	int pixels = img.width * img.height;
+	unsigned char* yellow = new unsigned char[pixels];
+	unsigned char* white = new unsigned char[pixels];
+	ColourFilter(img, yellow, white);
+
+	for (int i = 0, n = 0; i < pixels; i++, n += 3)
+	{
+		filtered[n] = yellow[i];
+		filtered[n + 1] = white[i];
+		filtered[n + 2] = yellow[i];
+	}
+
+	delete[] yellow;
+	delete[] white;
+}
+
+#ifdef __SSE2__
+/*!
+ * \brief absolute difference between unsigned bytes
+ */
+static inline __m128i AbsDiffSSE2(__m128i a, __m128i b)
+{
+	return(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)));
+}
+
+/*!
+ * \brief yellow response and white plate test for eight pixels held as 16 bit values
+ * \param white_hit returned all ones for pixels which pass the white test, apart from the blue threshold
+ * \return yellow response, which may be negative or above 255
+ */
+static inline __m128i ColourResponseSSE2(
+    __m128i b, __m128i g, __m128i r,
+    __m128i d_rg, __m128i d_rb, __m128i d_gb,
+    __m128i &white_hit)
+{
+	// (r + g) - ((b + |r - g|) * 2)
+	__m128i rg = _mm_add_epi16(r, g);
+	__m128i yellow = _mm_sub_epi16(rg, _mm_slli_epi16(_mm_add_epi16(b, d_rg), 1));
+
+	// ((r + g + b) / 3) - b - r - ((|r - g| - |r - b| - |g - b|) * 10) <= 0
+	// the multiplication by 21846 / 65536 is an exact division by three for sums up to 765
+	__m128i mean = _mm_mulhi_epu16(_mm_add_epi16(rg, b), _mm_set1_epi16(21846));
+	__m128i colour = _mm_mullo_epi16(_mm_sub_epi16(_mm_sub_epi16(d_rg, d_rb), d_gb), _mm_set1_epi16(10));
+	__m128i v = _mm_sub_epi16(_mm_sub_epi16(_mm_sub_epi16(mean, b), r), colour);
+	white_hit = _mm_cmplt_epi16(v, _mm_set1_epi16(1));
+	return(yellow);
+}
+
+/*!
+ * \brief yellow and white responses for sixteen pixels supplied as planes
+ */
+static inline void ColourFilterSSE2(
+    __m128i b, __m128i g, __m128i r,
+    __m128i white_minimum_blue,
+    __m128i white_blue_mask,
+    __m128i &yellow,
+    __m128i &white)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i d_rg = AbsDiffSSE2(r, g);
+	__m128i d_rb = AbsDiffSSE2(r, b);
+	__m128i d_gb = AbsDiffSSE2(g, b);
+
+	__m128i hit_lo, hit_hi;
+	__m128i yellow_lo = ColourResponseSSE2(
+	    _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(r, zero),
+	    _mm_unpacklo_epi8(d_rg, zero), _mm_unpacklo_epi8(d_rb, zero), _mm_unpacklo_epi8(d_gb, zero),
+	    hit_lo);
+	__m128i yellow_hi = ColourResponseSSE2(
+	    _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(r, zero),
+	    _mm_unpackhi_epi8(d_rg, zero), _mm_unpackhi_epi8(d_rb, zero), _mm_unpackhi_epi8(d_gb, zero),
+	    hit_hi);
+
+	// saturation clamps the yellow response to the range 0-255
+	yellow = _mm_packus_epi16(yellow_lo, yellow_hi);
+
+	__m128i hit = _mm_packs_epi16(hit_lo, hit_hi);
+	__m128i bright = _mm_cmpeq_epi8(_mm_max_epu8(b, white_minimum_blue), b);
+	hit = _mm_and_si128(hit, _mm_and_si128(bright, white_blue_mask));
+	white = _mm_or_si128(_mm_and_si128(hit, r), _mm_andnot_si128(hit, yellow));
+}
+#endif
+
+#ifdef __AVX2__
+static inline __m256i AbsDiffAVX2(__m256i a, __m256i b)
+{
+	return(_mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a)));
+}
+
+static inline __m256i ColourResponseAVX2(
+    __m256i b, __m256i g, __m256i r,
+    __m256i d_rg, __m256i d_rb, __m256i d_gb,
+    __m256i &white_hit)
+{
+	__m256i rg = _mm256_add_epi16(r, g);
+	__m256i yellow = _mm256_sub_epi16(rg, _mm256_slli_epi16(_mm256_add_epi16(b, d_rg), 1));
+	__m256i mean = _mm256_mulhi_epu16(_mm256_add_epi16(rg, b), _mm256_set1_epi16(21846));
+	__m256i colour = _mm256_mullo_epi16(_mm256_sub_epi16(_mm256_sub_epi16(d_rg, d_rb), d_gb), _mm256_set1_epi16(10));
+	__m256i v = _mm256_sub_epi16(_mm256_sub_epi16(_mm256_sub_epi16(mean, b), r), colour);
+	white_hit = _mm256_cmpgt_epi16(_mm256_set1_epi16(1), v);
+	return(yellow);
+}
+
+/*!
+ * \brief yellow and white responses for thirty two pixels supplied as planes.
+ *        Unpacking and packing operate within each 128 bit lane, so the
+ *        pixel order is preserved.
+ */
+static inline void ColourFilterAVX2(
+    __m256i b, __m256i g, __m256i r,
+    __m256i white_minimum_blue,
+    __m256i white_blue_mask,
+    __m256i &yellow,
+    __m256i &white)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i d_rg = AbsDiffAVX2(r, g);
+	__m256i d_rb = AbsDiffAVX2(r, b);
+	__m256i d_gb = AbsDiffAVX2(g, b);
+
+	__m256i hit_lo, hit_hi;
+	__m256i yellow_lo = ColourResponseAVX2(
+	    _mm256_unpacklo_epi8(b, zero), _mm256_unpacklo_epi8(g, zero), _mm256_unpacklo_epi8(r, zero),
+	    _mm256_unpacklo_epi8(d_rg, zero), _mm256_unpacklo_epi8(d_rb, zero), _mm256_unpacklo_epi8(d_gb, zero),
+	    hit_lo);
+	__m256i yellow_hi = ColourResponseAVX2(
+	    _mm256_unpackhi_epi8(b, zero), _mm256_unpackhi_epi8(g, zero), _mm256_unpackhi_epi8(r, zero),
+	    _mm256_unpackhi_epi8(d_rg, zero), _mm256_unpackhi_epi8(d_rb, zero), _mm256_unpackhi_epi8(d_gb, zero),
+	    hit_hi);
+
+	yellow = _mm256_packus_epi16(yellow_lo, yellow_hi);
+
+	__m256i hit = _mm256_packs_epi16(hit_lo, hit_hi);
+	__m256i bright = _mm256_cmpeq_epi8(_mm256_max_epu8(b, white_minimum_blue), b);
+	hit = _mm256_and_si256(hit, _mm256_and_si256(bright, white_blue_mask));
+	white = _mm256_or_si256(_mm256_and_si256(hit, r), _mm256_andnot_si256(hit, yellow));
+}
+#endif
+
+/*!
+ * \brief yellow and white plate responses for one row of the image
+ * \param row first byte of the row, in BGR order
+ * \param width number of pixels in the row
+ * \param channels bytes per pixel
+ * \param white_minimum_blue smallest blue value which may be part of a white plate, or 256 for none
+ * \param yellow returned yellow response for each pixel, before thresholding
+ * \param white returned red value for pixels which pass the white test, otherwise the yellow response
+ * \param yellow_histogram histogram of yellow responses, to which the row is added.
+ *        Zero responses are also counted, so the first bin should be cleared afterwards.
+ */
+void platedetection::ColourFilterRow(
+    const unsigned char* row,
+    int width,
+    int channels,
+    int white_minimum_blue,
+    unsigned char* yellow,
+    unsigned char* white,
+    int* yellow_histogram)
+{
+	int x = 0;
+
+	if (channels == 3)
+	{
+		// blocks of 32 pixels are separated into planes by five rounds of
+		// byte interleaving between registers holding bytes i and i + 48
+#ifdef __AVX2__
+		__m256i minimum_blue = _mm256_set1_epi8((char)((white_minimum_blue > 255) ? 255 : white_minimum_blue));
+		__m256i blue_mask = _mm256_set1_epi8((char)((white_minimum_blue > 255) ? 0 : 0xff));
+		for (; x + 64 <= width; x += 64)
+		{
+			const unsigned char* p = &row[x * 3];
+			__m256i c[6];
+			for (int k = 0; k < 6; k++)
+				c[k] = _mm256_inserti128_si256(
+				    _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p + (k * 16)))),
+				    _mm_loadu_si128((const __m128i*)(p + 96 + (k * 16))), 1);
+			for (int round = 0; round < 5; round++)
+			{
+				__m256i d[6];
+				for (int k = 0; k < 3; k++)
+				{
+					d[k * 2] = _mm256_unpacklo_epi8(c[k], c[k + 3]);
+					d[(k * 2) + 1] = _mm256_unpackhi_epi8(c[k], c[k + 3]);
+				}
+				for (int k = 0; k < 6; k++) c[k] = d[k];
+			}
+
+			// c[0..1] blue, c[2..3] green, c[4..5] red, with the low lanes
+			// holding the first 32 pixels and the high lanes the next 32
+			__m256i y[2], w[2];
+			for (int k = 0; k < 2; k++)
+				ColourFilterAVX2(c[k], c[k + 2], c[k + 4], minimum_blue, blue_mask, y[k], w[k]);
+
+			__m256i y0 = _mm256_permute2x128_si256(y[0], y[1], 0x20);
+			__m256i y1 = _mm256_permute2x128_si256(y[0], y[1], 0x31);
+			__m256i w0 = _mm256_permute2x128_si256(w[0], w[1], 0x20);
+			__m256i w1 = _mm256_permute2x128_si256(w[0], w[1], 0x31);
+			_mm256_storeu_si256((__m256i*)&yellow[x], y0);
+			_mm256_storeu_si256((__m256i*)&yellow[x + 32], y1);
+			_mm256_storeu_si256((__m256i*)&white[x], w0);
+			_mm256_storeu_si256((__m256i*)&white[x + 32], w1);
+
+			for (int i = 0; i < 64; i++)
+				yellow_histogram[yellow[x + i]]++;
+		}
+#endif
+#ifdef __SSE2__
+		__m128i minimum_blue_sse2 = _mm_set1_epi8((char)((white_minimum_blue > 255) ? 255 : white_minimum_blue));
+		__m128i blue_mask_sse2 = _mm_set1_epi8((char)((white_minimum_blue > 255) ? 0 : 0xff));
+		for (; x + 32 <= width; x += 32)
+		{
+			const unsigned char* p = &row[x * 3];
+			__m128i c[6];
+			for (int k = 0; k < 6; k++)
+				c[k] = _mm_loadu_si128((const __m128i*)(p + (k * 16)));
+			for (int round = 0; round < 5; round++)
+			{
+				__m128i d[6];
+				for (int k = 0; k < 3; k++)
+				{
+					d[k * 2] = _mm_unpacklo_epi8(c[k], c[k + 3]);
+					d[(k * 2) + 1] = _mm_unpackhi_epi8(c[k], c[k + 3]);
+				}
+				for (int k = 0; k < 6; k++) c[k] = d[k];
+			}
+
+			// c[0..1] blue, c[2..3] green, c[4..5] red
+			for (int k = 0; k < 2; k++)
+			{
+				__m128i y, w;
+				ColourFilterSSE2(c[k], c[k + 2], c[k + 4], minimum_blue_sse2, blue_mask_sse2, y, w);
+				_mm_storeu_si128((__m128i*)&yellow[x + (k * 16)], y);
+				_mm_storeu_si128((__m128i*)&white[x + (k * 16)], w);
+			}
+
+			for (int i = 0; i < 32; i++)
+				yellow_histogram[yellow[x + i]]++;
+		}
+#endif
+	}
+
+	for (const unsigned char* p = &row[x * channels]; x < width; x++, p += channels)
+	{
+		int b = p[0];
+		int g = p[1];
+		int r = p[2];
+
+		int d_rg = ABS(r - g);
+		int y = (r + g) - ((b + d_rg) * 2);
+		if (y < 0) y = 0;
+		if (y > 255) y = 255;
+		yellow_histogram[y]++;
+
+		int w = y;
+		if (b >= white_minimum_blue)
+		{
+			int v = ((r + g + b) / 3) - b - r - ((d_rg - ABS(r - b) - ABS(g - b)) * 10);
+			if (v <= 0) w = r;
+		}
+		yellow[x] = (unsigned char)y;
+		white[x] = (unsigned char)w;
+	}
+}
+
+/*!
+ * \brief removes weak yellow responses from both planes.  A weak response
+ *        remains in the white plane only where the pixel passed the white
+ *        test, which is recognised because the red value stored there never
+ *        equals a non-zero yellow response.
+ * \param yellow yellow responses
+ * \param white white responses
+ * \param pixels number of pixels
+ * \param minimum_yellow non-zero yellow responses below this value are removed
+ */
+void platedetection::ColourFilterThreshold(
+    unsigned char* yellow,
+    unsigned char* white,
+    int pixels,
+    int minimum_yellow)
+{
+	if (minimum_yellow <= 1) return;
+	int maximum_removed = minimum_yellow - 1;
+	if (maximum_removed > 255) maximum_removed = 255;
+
+	int i = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	__m128i limit = _mm_set1_epi8((char)maximum_removed);
+	for (; i + 16 <= pixels; i += 16)
+	{
+		__m128i y = _mm_loadu_si128((const __m128i*)&yellow[i]);
+		__m128i w = _mm_loadu_si128((const __m128i*)&white[i]);
+		__m128i weak = _mm_andnot_si128(
+		    _mm_cmpeq_epi8(y, zero),
+		    _mm_cmpeq_epi8(_mm_min_epu8(y, limit), y));
+		__m128i weak_white = _mm_and_si128(weak, _mm_cmpeq_epi8(w, y));
+		_mm_storeu_si128((__m128i*)&yellow[i], _mm_andnot_si128(weak, y));
+		_mm_storeu_si128((__m128i*)&white[i], _mm_andnot_si128(weak_white, w));
+	}
+#endif
+	for (; i < pixels; i++)
+	{
+		int y = yellow[i];
+		if ((y > 0) && (y <= maximum_removed))
+		{
+			yellow[i] = 0;
+			if (white[i] == y) white[i] = 0;
+		}
+	}
+}
+
+/*!
+ * \brief applies yellow and white colour filters in a single pass over the
+ *        image, producing a separate mono image for each plate colour
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param yellow returned response to yellow plates, one byte per pixel
+ * \param white returned response to white plates, one byte per pixel
+ */
+void platedetection::ColourFilter(
+    const image_view &img,
+    unsigned char* yellow,
+    unsigned char* white)
+{
+	int img_width = img.width;
+	int img_height = img.height;
+	int row_bytes = img_width * img.channels;
+
+	// the histogram for white plates is taken over the first (width x height) bytes of the image
+	int histogram[256];
 	memset(histogram, 0, 256*sizeof(int));
-	for (int i = (img_width * img_height)-1; i >= 0; i--)
-		histogram[img_colour[i]]++;
+	int remaining = img_width * img_height;
+	for (int y = 0; (y < img_height) && (remaining > 0); y++)
+	{
+		unsigned char* row = imageview::Row(img, y);
+		int bytes = row_bytes;
+		if (bytes > remaining) bytes = remaining;
+		for (int i = bytes-1; i >= 0; i--)
+			histogram[row[i]]++;
+		remaining -= bytes;
+	}
 
 	float MeanDark = 0;
 	float MeanLight = 0;
 	float DarkRatio = 0;
 	float threshold =
-		thresholding::GetGlobalThreshold(histogram, 255, 0, temp_histogram, MeanDark, MeanLight, DarkRatio);
+		thresholding::GetGlobalThreshold(histogram, 255, MeanDark, MeanLight, DarkRatio);
 
+	// white plate pixels have a blue value above this
 	float threshold_upper = MeanLight - ((MeanLight - threshold)* 0.2f);
+	int white_minimum_blue = 256;
+	if (threshold_upper < 0)
+		white_minimum_blue = 0;
+	else
+		if (threshold_upper < 256) white_minimum_blue = (int)floor(threshold_upper) + 1;
 
-	processimage::yellowFilter(img_colour, img_width, img_height, filtered);
-
-	for (int i = (img_width * img_height*3)-3; i >= 0; i-=3)
+	// yellow and white responses, and the histogram of yellow responses
+	memset(histogram, 0, 256*sizeof(int));
+	for (int y = 0; y < img_height; y++)
+		ColourFilterRow(
+		    imageview::Row(img, y), img_width, img.channels,
+		    white_minimum_blue,
+		    &yellow[y * img_width], &white[y * img_width],
+		    histogram);
+	histogram[0] = 0;
+
+	threshold = thresholding::GetGlobalThreshold(histogram, 256, MeanDark, MeanLight, DarkRatio);
+	int minimum_yellow = 0;
+	if (threshold > 0)
 	{
-		if (img_colour[i] > threshold_upper)
-		{
-			int r = img_colour[i + 2];
-			int g = img_colour[i + 1];
-			int b = img_colour[i];
-			int v = ((r+g+b)/3) - b - r - ((ABS(r - g) - ABS(r - b) - ABS(g - b))*10);
-			if (v < 0) v = 0;
-			if (v > 255) v = 255;
-			if (v == 0)
-			    filtered[i + 1] = (unsigned char)r;
-		}
+		if (threshold < 256)
+			minimum_yellow = (int)ceil(threshold);
+		else
+			minimum_yellow = 256;
 	}
-
-	delete[] histogram;
-	delete[] temp_histogram;
+	ColourFilterThreshold(yellow, white, img_width * img_height, minimum_yellow);
 }
 
 void platedetection::MergeRectangles(std::vector<polygon2D*> &rectangles)
@@ -180,7 +536,34 @@ void platedetection::ExtractPlateImages(
     std::vector<int> &plate_image_height,
     std::vector<unsigned char*> &plate_images)
 {
-	int pixels = (img_width * img_height * 3) - 3;
+	ExtractPlateImages(
+	    imageview::Create(img_colour, img_width, img_height, 3),
+	    plates,
+	    plate_image_width,
+	    plate_image_height,
+	    plate_images);
+}
+
+/*!
+ * \brief extracts mono images for each candidate number plate
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param plates candidate number plate perimeters
+ * \param plate_image_width a specified fixed width for all extracted images
+ * \param plate_image_height height values for the extracted number plate images
+ * \param plate_image extracted mono images
+ */
+void platedetection::ExtractPlateImages(
+    const image_view &img,
+    std::vector<polygon2D*> &plates,
+    int plate_image_width,
+    std::vector<int> &plate_image_height,
+    std::vector<unsigned char*> &plate_images)
+{
+	int img_width = img.width;
+	int img_height = img.height;
+
+	// pixels beyond this index were outside of the packed image bounds check
+	int last_pixel = img_width * img_height - 2;
 
 	for (int p = 0; p < (int)plates.size(); p++)
 	{
@@ -234,16 +617,154 @@ void platedetection::ExtractPlateImages(
 
 			for (int x = 0; x < plate_image_width; x++, n++, image_x += mult_0, image_y += mult_1)
 			{
-                int n2 = ((((int)image_y * img_width) + (int)image_x) * 3) + 2;
-                if ((n2 >-1) && (n2 < pixels))
+                int n2 = ((int)image_y * img_width) + (int)image_x;
+                if ((n2 > -1) && (n2 <= last_pixel))
                 {
-                    plate_image[n] = img_colour[n2];
+                    plate_image[n] = imageview::Row(img, n2 / img_width)[((n2 % img_width) * img.channels) + 2];
                 }
 			}
 		}
 	}
 }
 
+/*!
+ * \brief arguments and results for a single plate colour pass of Find
+ */
+struct platedetection_pass
+{
+	int img_width;
+	int img_height;
+	int plate_colour;
+	bool debug;
+	DetectionContext *context;
+
+	std::vector<polygon2D*> plates;
+	std::vector<unsigned char*> debug_images;
+	int debug_image_width;
+	int debug_image_height;
+};
+
+/*!
+ * \brief searches for plates of a single colour within the colour filtered image
+ *
+ * The colour filter writes its response for this plate colour directly
+ * into the mono image buffer of the context.
+ * Each plate colour uses its own buffers and edge detector within the
+ * context, so the passes for different colours may run concurrently.
+ * \param passes array of platedetection_pass, indexed by plate colour
+ * \param index index of the pass to be processed, which is its plate colour
+ */
+void platedetection::FindPlateColour(void* passes, int index)
+{
+	platedetection_pass* pass = &((platedetection_pass*)passes)[index];
+	int img_width = pass->img_width;
+	int img_height = pass->img_height;
+	int plate_colour = pass->plate_colour;
+	bool debug = pass->debug;
+	DetectionContext *context = pass->context;
+
+	unsigned char* mono_img = context->mono_img[plate_colour];
+    unsigned char* erosion_dilation_buffer = context->erosion_dilation_buffer[plate_colour];
+	CannyEdgeDetector *edge_detector = context->edge_detector[plate_colour];
+
+	context->Clear(plate_colour, img_width, img_height);
+
+	std::vector<polygon2D*> rectangles;
+	float maximum_aspect_ratio = 200.0f / 33.0f;
+	int maximum_groups = 45;
+	int bestfit_tries = 3;
+	int step_sizes[] = { 12, 4 };
+	int no_of_step_sizes = 2;
+	int grouping_radius_percent[] = { 0, 10, 40, 60 };
+	int grouping_radius_percent_levels = 4;
+	int erosion_dilation[] = { 1, 3 };
+	int erosion_dilation_levels = 2;
+	int accuracy_level = 0;
+	int perimeter_detection_method = 1;
+	int compression[] = { 7000, 6000, 5000 };
+	int no_of_compressions = 3;
+	int minimum_volume_percent = 3;
+	int maximum_volume_percent = 20;
+	bool use_perimeter_fitting = true;
+	int perimeter_fit_threshold = 120;
+	std::vector<int> &edges = context->edges[plate_colour];
+	std::vector<float> &orientation = context->orientation[plate_colour];
+	std::vector<std::vector<int> > &dominant_edges = context->dominant_edges[plate_colour];
+	std::vector<std::vector<std::vector<int> > > &side_edges = context->side_edges[plate_colour];
+
+	shapes::DetectRectangles(
+		mono_img, img_width, img_height, 1,
+		grouping_radius_percent,
+		grouping_radius_percent_levels,
+		erosion_dilation,
+		erosion_dilation_levels,
+		false,
+		accuracy_level,
+		maximum_aspect_ratio,
+		debug,
+		0,
+		perimeter_detection_method,
+		compression,
+		no_of_compressions,
+		minimum_volume_percent,
+		maximum_volume_percent,
+		use_perimeter_fitting,
+		perimeter_fit_threshold,
+		bestfit_tries,
+		step_sizes,
+		no_of_step_sizes,
+		maximum_groups,
+		edges,
+		orientation,
+		dominant_edges,
+		side_edges,
+		pass->debug_image_width,
+		pass->debug_image_height,
+		edge_detector,
+		rectangles,
+		pass->debug_images,
+		erosion_dilation_buffer);
+
+	for (int i = 0; i < (int)rectangles.size(); i++)
+	{
+		float tx = img_width;
+		float ty = img_height;
+		float bx = 0;
+		float by = 0;
+		for (int vertex = 0; vertex < 4; vertex++)
+		{
+			if (rectangles[i]->x_points[vertex] < tx) tx = rectangles[i]->x_points[vertex];
+			if (rectangles[i]->y_points[vertex] < ty) ty = rectangles[i]->y_points[vertex];
+			if (rectangles[i]->x_points[vertex] > bx) bx = rectangles[i]->x_points[vertex];
+			if (rectangles[i]->y_points[vertex] > by) by = rectangles[i]->y_points[vertex];
+		}
+		int w = bx - tx;
+		int h = by - ty;
+		if (w > h)
+		{
+		    pass->plates.push_back(rectangles[i]);
+		}
+		else
+		{
+			delete rectangles[i];
+			rectangles[i] = NULL;
+		}
+	}
+}
+
+/*!
+ * \brief detects number plates within the given colour image
+ * \param img_colour colour image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param plates returned number plate perimeters
+ * \param debug save extra debugging data
+ * \param debug_images returned debugging images
+ * \param debug_image_width width of the debugging images
+ * \param debug_image_height height of the debugging images
+ * \param filtered_image_filename optional filename to save the colour filtered image
+ * \return true if any plates were found
+ */
 bool platedetection::Find(
     unsigned char *img_colour,
     int img_width, int img_height,
@@ -254,119 +775,175 @@ bool platedetection::Find(
 	int &debug_image_height,
 	std::string filtered_image_filename)
 {
+	DetectionContext *context = new DetectionContext();
+	bool found = Find(
+	    img_colour,
+	    img_width, img_height,
+	    plates,
+	    debug,
+	    debug_images,
+	    debug_image_width,
+	    debug_image_height,
+	    filtered_image_filename,
+	    context);
+	delete context;
+	return(found);
+}
+
+/*!
+ * \brief detects number plates within the given colour image
+ * \param img_colour colour image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param plates returned number plate perimeters
+ * \param debug save extra debugging data
+ * \param debug_images returned debugging images
+ * \param debug_image_width width of the debugging images
+ * \param debug_image_height height of the debugging images
+ * \param filtered_image_filename optional filename to save the colour filtered image
+ * \param context buffers and edge detector reused between calls
+ * \return true if any plates were found
+ */
+bool platedetection::Find(
+    unsigned char *img_colour,
+    int img_width, int img_height,
+    std::vector<polygon2D*> &plates,
+    bool debug,
+    std::vector<unsigned char*> &debug_images,
+	int &debug_image_width,
+	int &debug_image_height,
+	std::string filtered_image_filename,
+	DetectionContext *context)
+{
+	return(Find(
+	    imageview::Create(img_colour, img_width, img_height, 3),
+	    plates,
+	    debug,
+	    debug_images,
+	    debug_image_width,
+	    debug_image_height,
+	    filtered_image_filename,
+	    context));
+}
+
+/*!
+ * \brief detects number plates within the given colour image
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param plates returned number plate perimeters
+ * \param debug save extra debugging data
+ * \param debug_images returned debugging images
+ * \param debug_image_width width of the debugging images
+ * \param debug_image_height height of the debugging images
+ * \param filtered_image_filename optional filename to save the colour filtered image, at the detection width if one is set
+ * \param context buffers and edge detector reused between calls, including the detection width
+ * \return true if any plates were found
+ */
+bool platedetection::Find(
+    const image_view &img,
+    std::vector<polygon2D*> &plates,
+    bool debug,
+    std::vector<unsigned char*> &debug_images,
+	int &debug_image_width,
+	int &debug_image_height,
+	std::string filtered_image_filename,
+	DetectionContext *context)
+{
+	int img_width = img.width;
+	int img_height = img.height;
     bool found = false;
 
-	unsigned char* filtered = new unsigned char[img_width * img_height * 3];
-	unsigned char* mono_img = new unsigned char[img_width * img_height];
-    unsigned char* edges_image = new unsigned char[img_width * img_height];
-    unsigned char* erosion_dilation_buffer = new unsigned char[img_width * img_height];
-    int* downsampling_buffer0 = new int[img_width * img_height];
-    int* downsampling_buffer1 = new int[img_width * img_height];
-	CannyEdgeDetector *edge_detector = new CannyEdgeDetector();
+	double stage_start = profiler::Start();
+
+	// reduce large images to the detection width before filtering, since
+	// shape detection only operates at that resolution
+	image_view detection_img = img;
+	if ((context->detection_width > 0) && (img.width > context->detection_width))
+	{
+		img_width = context->detection_width;
+		img_height = img.height * img_width / img.width;
+		if (img_height < 1) img_height = 1;
+		if (context->detection_frame_size < img_width * img_height * 3)
+		{
+			if (context->detection_frame != NULL) delete[] context->detection_frame;
+			context->detection_frame_size = img_width * img_height * 3;
+			context->detection_frame = new unsigned char[context->detection_frame_size];
+		}
+		if (context->detection_sums_length < img.width * img.channels)
+		{
+			if (context->detection_sums != NULL) delete[] context->detection_sums;
+			context->detection_sums_length = img.width * img.channels;
+			context->detection_sums = new int[context->detection_sums_length];
+		}
+		processimage::downSample(img, img_width, img_height, context->detection_sums, context->detection_frame);
+		detection_img = imageview::Create(context->detection_frame, img_width, img_height, 3);
+	}
+
+    context->Allocate(img_width, img_height);
+	unsigned char* yellow = context->mono_img[PLATE_YELLOW];
+	unsigned char* white = context->mono_img[PLATE_WHITE];
 
 	// apply colour filters
-	platedetection::ColourFilter(img_colour, img_width, img_height, filtered);
+	platedetection::ColourFilter(detection_img, yellow, white);
+	profiler::Stop(PROFILE_COLOUR_FILTER, stage_start);
 
 	if (filtered_image_filename != "")
 	{
-        Bitmap* bmp = new Bitmap(filtered, img_width, img_height, 3);
-        bmp->SavePPM(filtered_image_filename.c_str());
-        delete bmp;
+		unsigned char* filtered = context->filtered;
+		for (int i = 0, n = 0; i < img_width * img_height; i++, n += 3)
+		{
+			filtered[n] = yellow[i];
+			filtered[n + 1] = white[i];
+			filtered[n + 2] = yellow[i];
+		}
+        Bitmap::SavePPM(filtered_image_filename.c_str(), filtered, img_width, img_height);
 	}
 
+	platedetection_pass passes[DETECTION_PASSES];
 	for (int plate_colour = PLATE_YELLOW; plate_colour <= PLATE_WHITE; plate_colour++)
 	{
-		for (int i = 0; i < img_width * img_height; i++)
-			mono_img[i] = filtered[(i*3) + plate_colour];
-
-		std::vector<polygon2D*> rectangles;
-		std::vector<unsigned char*> temp_debug_images;
-		float maximum_aspect_ratio = 200.0f / 33.0f;
-		int maximum_groups = 45;
-		int bestfit_tries = 3;
-		int step_sizes[] = { 12, 4 };
-		int no_of_step_sizes = 2;
-		int grouping_radius_percent[] = { 0, 10, 40, 60 };
-		int grouping_radius_percent_levels = 4;
-		int erosion_dilation[] = { 1, 3 };
-		int erosion_dilation_levels = 2;
-		int accuracy_level = 0;
-		int perimeter_detection_method = 1;
-		int compression[] = { 7000, 6000, 5000 };
-		int no_of_compressions = 3;
-		int minimum_volume_percent = 3;
-		int maximum_volume_percent = 20;
-		bool use_perimeter_fitting = true;
-		int perimeter_fit_threshold = 120;
-		std::vector<int> edges;
-		std::vector<float> orientation;
-		std::vector<std::vector<int> > dominant_edges;
-		std::vector<std::vector<std::vector<int> > > side_edges;
-
-		shapes::DetectRectangles(
-			mono_img, img_width, img_height, 1,
-			grouping_radius_percent,
-			grouping_radius_percent_levels,
-			erosion_dilation,
-			erosion_dilation_levels,
-			false,
-			accuracy_level,
-			maximum_aspect_ratio,
-			debug,
-			0,
-			perimeter_detection_method,
-			compression,
-			no_of_compressions,
-			minimum_volume_percent,
-			maximum_volume_percent,
-			use_perimeter_fitting,
-			perimeter_fit_threshold,
-			bestfit_tries,
-			step_sizes,
-			no_of_step_sizes,
-			maximum_groups,
-			edges,
-			orientation,
-			dominant_edges,
-			side_edges,
-			edges_image,
-			debug_image_width,
-			debug_image_height,
-			edge_detector,
-			rectangles,
-			temp_debug_images,
-			erosion_dilation_buffer,
-			downsampling_buffer0,
-			downsampling_buffer1);
-
-
-		for (int i = 0; i < (int)temp_debug_images.size(); i++)
-			debug_images.push_back(temp_debug_images[i]);
-
-		for (int i = 0; i < (int)rectangles.size(); i++)
+		platedetection_pass &pass = passes[plate_colour];
+		pass.img_width = img_width;
+		pass.img_height = img_height;
+		pass.plate_colour = plate_colour;
+		pass.debug = debug;
+		pass.debug_image_width = 0;
+		pass.debug_image_height = 0;
+		pass.context = context;
+	}
+
+	// the passes share this thread with a worker which persists in the context
+	if (context->concurrent_passes)
+	{
+		if (context->pass_pool == NULL) context->pass_pool = new ThreadPool(DETECTION_PASSES);
+		context->pass_pool->Run(DETECTION_PASSES, FindPlateColour, passes);
+	}
+	else
+	{
+		for (int plate_colour = PLATE_YELLOW; plate_colour <= PLATE_WHITE; plate_colour++)
+			FindPlateColour(passes, plate_colour);
+	}
+
+	// combine the results in the same order as a sequential search
+	for (int plate_colour = PLATE_YELLOW; plate_colour <= PLATE_WHITE; plate_colour++)
+	{
+		platedetection_pass &pass = passes[plate_colour];
+		for (int i = 0; i < (int)pass.debug_images.size(); i++)
+			debug_images.push_back(pass.debug_images[i]);
+		for (int i = 0; i < (int)pass.plates.size(); i++)
 		{
-			float tx = img_width;
-			float ty = img_height;
-			float bx = 0;
-			float by = 0;
-			for (int vertex = 0; vertex < 4; vertex++)
-			{
-				if (rectangles[i]->x_points[vertex] < tx) tx = rectangles[i]->x_points[vertex];
-				if (rectangles[i]->y_points[vertex] < ty) ty = rectangles[i]->y_points[vertex];
-				if (rectangles[i]->x_points[vertex] > bx) bx = rectangles[i]->x_points[vertex];
-				if (rectangles[i]->y_points[vertex] > by) by = rectangles[i]->y_points[vertex];
-			}
-			int w = bx - tx;
-			int h = by - ty;
-			if (w > h)
+			// return the plates in full resolution coordinates
+			if (img_width < img.width)
 			{
-			    plates.push_back(rectangles[i]);
-			}
-			else
-			{
-				delete rectangles[i];
-				rectangles[i] = NULL;
+				polygon2D* scaled = pass.plates[i]->Scale(img_width, img_height, img.width, img.height);
+				delete pass.plates[i];
+				pass.plates[i] = scaled;
 			}
+			plates.push_back(pass.plates[i]);
+		}
+		if (pass.debug_image_width > 0)
+		{
+			debug_image_width = pass.debug_image_width;
+			debug_image_height = pass.debug_image_height;
 		}
 	}
 
@@ -387,14 +964,6 @@ bool platedetection::Find(
 
 	MergeRectangles(plates);
 
-	delete edge_detector;
-	delete[] mono_img;
-	delete[] filtered;
-    delete[] edges_image;
-    delete[] erosion_dilation_buffer;
-    delete[] downsampling_buffer0;
-    delete[] downsampling_buffer1;
-
     if ((int)plates.size() > 0) found = true;
 
 	return(found);
@@ -33,11 +33,38 @@
 #include <vector>
 #include "../common.h"
 #include "../utils/Image.h"
+#include "../utils/imageview.h"
 #include "../utils/polygon.h"
 #include "../shapes/shapes.h"
+#include "detectioncontext.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 class platedetection
 {
+private:
+	static void FindPlateColour(void* passes, int index);
+
+	static void ColourFilterRow(
+	    const unsigned char* row,
+	    int width,
+	    int channels,
+	    int white_minimum_blue,
+	    unsigned char* yellow,
+	    unsigned char* white,
+	    int* yellow_histogram);
+
+	static void ColourFilterThreshold(
+	    unsigned char* yellow,
+	    unsigned char* white,
+	    int pixels,
+	    int minimum_yellow);
+
 public:
 	static void MergeRectangles(std::vector<polygon2D*> &rectangles);
 
@@ -46,6 +73,15 @@ public:
 	    int img_width, int img_height,
 	    unsigned char* filtered);
 
+	static void ColourFilter(
+	    const image_view &img,
+	    unsigned char* filtered);
+
+	static void ColourFilter(
+	    const image_view &img,
+	    unsigned char* yellow,
+	    unsigned char* white);
+
 	static bool Find(
 		    unsigned char *img_colour,
 		    int img_width, int img_height,
@@ -56,6 +92,27 @@ public:
 			int &debug_image_height,
 			std::string filtered_image_filename);
 
+	static bool Find(
+		    unsigned char *img_colour,
+		    int img_width, int img_height,
+		    std::vector<polygon2D*> &plates,
+		    bool debug,
+		    std::vector<unsigned char*> &debug_images,
+			int &debug_image_width,
+			int &debug_image_height,
+			std::string filtered_image_filename,
+			DetectionContext *context);
+
+	static bool Find(
+		    const image_view &img,
+		    std::vector<polygon2D*> &plates,
+		    bool debug,
+		    std::vector<unsigned char*> &debug_images,
+			int &debug_image_width,
+			int &debug_image_height,
+			std::string filtered_image_filename,
+			DetectionContext *context);
+
 	static void ExtractPlateImages(
 	    unsigned char *img_colour,
 	    int img_width, int img_height,
@@ -64,6 +121,13 @@ public:
 	    std::vector<int> &plate_image_height,
 	    std::vector<unsigned char*> &plate_images);
 
+	static void ExtractPlateImages(
+	    const image_view &img,
+	    std::vector<polygon2D*> &plates,
+	    int plate_image_width,
+	    std::vector<int> &plate_image_height,
+	    std::vector<unsigned char*> &plate_images);
+
 };
 
 #endif /* PLATEDETECTION_H_ */
@@ -160,6 +160,15 @@ void platereader::Erode(
 			    result = new unsigned char[character_image_width * character_image_height];
 		    }
 		    processimage::Erode(eroded, character_image_width, character_image_height, buffer, 1, result);
+
+		    // clear the outermost pixels, so that the occupancy always falls
+		    memset(result, 0, character_image_width);
+		    memset(&result[(character_image_height - 1) * character_image_width], 0, character_image_width);
+		    for (int y = 1; y < character_image_height - 1; y++)
+		    {
+		    	result[y * character_image_width] = 0;
+		    	result[(y * character_image_width) + character_image_width - 1] = 0;
+		    }
 		    memcpy(eroded, result, character_image_width * character_image_height * sizeof(unsigned char));
 		}
 		else finished = true;
@@ -173,8 +182,6 @@ void platereader::Erode(
 
 /*!
  * \brief trims excess from the given character image
- * \param plate_image_width width of the number plate
- * \param plate_image_height height of the number plate
  * \param number_plate binary image
  * \param threshold_percent threshold used for border
  * \param tx
@@ -183,15 +190,15 @@ void platereader::Erode(
  * \param by
  */
 void platereader::Trim(
-    int plate_image_width,
-    int plate_image_height,
-    unsigned char* number_plate,
+    const bit_image &number_plate,
     float threshold_percent,
     int &tx,
     int &ty,
     int &bx,
     int &by)
 {
+    if ((bx <= tx) || (by <= ty)) return;
+
     int max_crop_x = (bx - tx) * 40 / 100;
     int max_crop_y = (by - ty) * 40 / 100;
 
@@ -203,23 +210,13 @@ void platereader::Trim(
     // top
     for (int y = ty; y < ty + max_crop_y; y++)
     {
-    	int occupancy = 0;
-    	for (int x = tx; x < bx; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] == 0) occupancy++;
-    	}
+    	int occupancy = (bx - tx) - bitimage::CountRow(number_plate, y, tx, bx);
 		if (occupancy*100/(bx - tx) > 98) temp_ty = y;
     }
 
     for (int y = temp_ty; y < ty + max_crop_y; y++)
     {
-    	int occupancy = 0;
-    	for (int x = tx; x < bx; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
+    	int occupancy = bitimage::CountRow(number_plate, y, tx, bx);
 		if (occupancy*100/(bx-tx) > threshold_percent)
 			break;
 		else
@@ -228,26 +225,18 @@ void platereader::Trim(
 
     // bottom
     int start_y = by;
+    if (start_y >= number_plate.height) start_y = number_plate.height - 1;
     int end_y = by - 1 - max_crop_y;
     for (int y = start_y; y > end_y; y--)
     {
-    	int occupancy = 0;
-    	for (int x = tx; x < bx; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] == 0) occupancy++;
-    	}
+    	int occupancy = (bx - tx) - bitimage::CountRow(number_plate, y, tx, bx);
 		if (occupancy*100/(bx-tx) > 98) temp_by = y;
     }
     start_y = temp_by;
+    if (start_y >= number_plate.height) start_y = number_plate.height - 1;
     for (int y = start_y; y > end_y; y--)
     {
-    	int occupancy = 0;
-    	for (int x = tx; x < bx; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
+    	int occupancy = bitimage::CountRow(number_plate, y, tx, bx);
 		if (occupancy*100/(bx-tx) > threshold_percent)
 			break;
 		else
@@ -257,22 +246,12 @@ void platereader::Trim(
     // left
     for (int x = tx; x < tx+max_crop_x; x++)
     {
-    	int occupancy = 0;
-    	for (int y = ty; y < by; y++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] == 0) occupancy++;
-    	}
+    	int occupancy = (by - ty) - bitimage::CountColumn(number_plate, x, ty, by);
 		if (occupancy*100/(by-ty) > 98) temp_tx = x;
     }
     for (int x = temp_tx; x < max_crop_x; x++)
     {
-    	int occupancy = 0;
-    	for (int y = ty; y < by; y++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
+    	int occupancy = bitimage::CountColumn(number_plate, x, ty, by);
 		if (occupancy*100/(by-ty) > threshold_percent)
 			break;
 		else
@@ -281,26 +260,18 @@ void platereader::Trim(
 
     // right
     int start_x = bx;
+    if (start_x >= number_plate.width) start_x = number_plate.width - 1;
     int end_x = bx - 1 - max_crop_x;
     for (int x = start_x; x > end_x; x--)
     {
-    	int occupancy = 0;
-    	for (int y = ty; y < by; y++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] == 0) occupancy++;
-    	}
+    	int occupancy = (by - ty) - bitimage::CountColumn(number_plate, x, ty, by);
 		if (occupancy*100/(by-ty) > 98) temp_bx = x;
     }
     start_x = temp_bx;
+    if (start_x >= number_plate.width) start_x = number_plate.width - 1;
     for (int x = start_x; x > end_x; x--)
     {
-    	int occupancy = 0;
-    	for (int y = ty; y < by; y++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
+    	int occupancy = bitimage::CountColumn(number_plate, x, ty, by);
 		if (occupancy*100/(by-ty) > threshold_percent)
 			break;
 		else
@@ -315,34 +286,24 @@ void platereader::Trim(
 
 /*!
  * \brief use to remove any vertical excess from the binarised number plate image
- * \param plate_image_width number plate image width
- * \param plate_image_height number plate image height
- * \param number_plate image data
+ * \param number_plate binary image
  * \param top_y returned top y coordinate
  * \param bottom_y returned bottom y coordinate
  */
 void platereader::VerticalCrop(
-    int plate_image_width,
-    int plate_image_height,
-    unsigned char* number_plate,
+    const bit_image &number_plate,
     int &top_y,
     int &bottom_y)
 {
-    int max_crop = plate_image_height * 10 / 100;
+    int plate_image_width = number_plate.width;
+    int max_crop = number_plate.height * 10 / 100;
     int min_occupancy = plate_image_width * 20 / 100;
 
     int start_y = top_y;
     top_y = 0;
     for (int y = start_y; y < start_y+max_crop; y++)
     {
-    	int occupancy = 0;
-    	for (int x = 0; x < plate_image_width; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
-
-    	if (occupancy < min_occupancy)
+    	if (bitimage::CountRow(number_plate, y, 0, plate_image_width) < min_occupancy)
     	{
     		top_y = y;
     		break;
@@ -351,14 +312,7 @@ void platereader::VerticalCrop(
     int end_y = bottom_y;
     for (int y = end_y; y > end_y - max_crop; y--)
     {
-    	int occupancy = 0;
-    	for (int x = 0; x < plate_image_width; x++)
-    	{
-    		int n = (y * plate_image_width) + x;
-    		if (number_plate[n] > 0) occupancy++;
-    	}
-
-    	if (occupancy < min_occupancy)
+    	if (bitimage::CountRow(number_plate, y, 0, plate_image_width) < min_occupancy)
     	{
     		bottom_y = y;
     		break;
@@ -371,7 +325,7 @@ void platereader::VerticalCrop(
  * \param minimum_character_width_percent the minimum width of a character as a percentage of the plate image width
  * \param plate_image_width width of the number plate image
  * \param plate_image_height height of each number plate image
- * \param binary_images binarised number plate images
+ * \param binary_images binarised number plate images, in which dark pixels are 255
  * \param characters returned character images
  * \param characters_dimensions dimensions of each character image
  * \param characters_positions position of each character within the number plate image
@@ -384,14 +338,58 @@ void platereader::SeparateCharacters(
     std::vector<std::vector<unsigned char*> > &characters,
     std::vector<std::vector<int> > &characters_dimensions,
     std::vector<std::vector<int> > &characters_positions)
+{
+	std::vector<bit_image*> packed_images;
+    for (int p = 0; p < (int)binary_images.size(); p++)
+    	packed_images.push_back(bitimage::Pack(binary_images[p], plate_image_width, plate_image_height[p]));
+
+    SeparateCharacters(
+    	minimum_character_width_percent,
+    	plate_image_width,
+    	plate_image_height,
+    	packed_images,
+    	characters,
+    	characters_dimensions,
+    	characters_positions);
+
+    for (int p = 0; p < (int)packed_images.size(); p++)
+    	bitimage::Free(packed_images[p]);
+}
+
+/*!
+ * \brief Returns a set of images, one for each character
+ * \param minimum_character_width_percent the minimum width of a character as a percentage of the plate image width
+ * \param plate_image_width width of the number plate image
+ * \param plate_image_height height of each number plate image
+ * \param binary_images bit packed binarised number plate images
+ * \param characters returned character images
+ * \param characters_dimensions dimensions of each character image
+ * \param characters_positions position of each character within the number plate image
+ */
+void platereader::SeparateCharacters(
+	float minimum_character_width_percent,
+	int plate_image_width,
+	std::vector<int> plate_image_height,
+    std::vector<bit_image*> &binary_images,
+    std::vector<std::vector<unsigned char*> > &characters,
+    std::vector<std::vector<int> > &characters_dimensions,
+    std::vector<std::vector<int> > &characters_positions)
 {
 	int* interval = new int[plate_image_width];
 	int* separate = new int[plate_image_width];
+
+	// histogram of intervals, which are at most the height of a plate
+	int max_plate_image_height = 0;
+	for (int p = 0; p < (int)binary_images.size(); p++)
+	{
+		if (plate_image_height[p] > max_plate_image_height) max_plate_image_height = plate_image_height[p];
+	}
+	int* histogram = new int[max_plate_image_height + 2];
 	int minimum_character_width_pixels = (int)(plate_image_width * minimum_character_width_percent / 100);
 
     for (int p = 0; p < (int)binary_images.size(); p++)
     {
-    	unsigned char* number_plate = binary_images[p];
+    	const bit_image &number_plate = *binary_images[p];
 
     	int height = plate_image_height[p];
 
@@ -409,12 +407,7 @@ void platereader::SeparateCharacters(
     		int max_occupancy = 0;
     		for (int y = ty; y <= by; y++)
     		{
-    			int occupancy = 0;
-    			for (int x = 0; x < plate_image_width; x++)
-    			{
-    				int n = (y * plate_image_width) + x;
-    				if (number_plate[n] == 0) occupancy++;
-    			}
+    			int occupancy = plate_image_width - bitimage::CountRow(number_plate, y, 0, plate_image_width);
     			if (occupancy > max_occupancy)
     			{
     				max_occupancy = occupancy;
@@ -449,30 +442,19 @@ void platereader::SeparateCharacters(
 
 			float average_character_height = 0;
 			float average_character_height_hits = 0;
-			VerticalCrop(plate_image_width, height, number_plate, top_y, bottom_y);
+			VerticalCrop(number_plate, top_y, bottom_y);
 
-			memset(interval, 0, plate_image_width * sizeof(int));
 			memset(separate, 0, plate_image_width * sizeof(int));
 
 			for (int x = 0; x < plate_image_width; x++)
-			{
-				for (int y = top_y; y <= bottom_y; y++)
-				{
-					int n = (y * plate_image_width) + x;
-					if (number_plate[n] == 0) interval[x]++;
-				}
-			}
+				interval[x] = (bottom_y + 1 - top_y) - bitimage::CountColumn(number_plate, x, top_y, bottom_y + 1);
 
-			int* histogram = new int[bottom_y-top_y+2];
 			memset(histogram, 0, (bottom_y-top_y+2) * sizeof(int));
-			int* histogram_buffer = new int[bottom_y-top_y+2];
 			float MeanDark = 0;
 			float MeanLight = 0;
 			float DarkRatio = 0;
 			for (int x = 0; x < plate_image_width; x++) histogram[interval[x]]++;
-			thresholding::GetGlobalThreshold(histogram, bottom_y-top_y+2, 0, histogram_buffer, MeanDark, MeanLight, DarkRatio);
-			delete[] histogram;
-			delete[] histogram_buffer;
+			thresholding::GetGlobalThreshold(histogram, bottom_y-top_y+2, MeanDark, MeanLight, DarkRatio);
 
 			//int max = (int)(MeanLight * 110/100);
 			int max = (int)(MeanLight * 100/100);
@@ -556,18 +538,13 @@ void platereader::SeparateCharacters(
 							}
 
 							for (int t = 0; t < 2; t++)
-								Trim(plate_image_width, height, number_plate, 5, tx, ty, bx, by);
+								Trim(number_plate, 5, tx, ty, bx, by);
+
+							// ignore characters which were trimmed away entirely
+							if ((bx <= tx) || (by <= ty)) continue;
 
 							unsigned char *ch = new unsigned char[(bx-tx)*(by-ty)];
-							int n = 0;
-							for (int yyy = ty; yyy < by; yyy++)
-							{
-								for (int xxx = tx; xxx < bx; xxx++, n++)
-								{
-									int n2 = (yyy * plate_image_width) + xxx;
-									ch[n] = number_plate[n2];
-								}
-							}
+							bitimage::Unpack(number_plate, tx, ty, bx, by, ch);
 
 							Erode(bx-tx, by-ty, ch, 50);
 
@@ -636,6 +613,7 @@ void platereader::SeparateCharacters(
     	characters_positions.push_back(chars_positions);
     }
 
+    delete[] histogram;
     delete[] separate;
     delete[] interval;
 }
@@ -653,41 +631,126 @@ void platereader::Binarise(
     std::vector<unsigned char*> &plate_images,
     std::vector<unsigned char*> &binary_images)
 {
-	// allocate histogram buffers
-	int* histogram = new int[256];
-	int* temp_histogram_buffer = new int[256];
+	int histogram[256];
 
-	float MeanDark = 0;
-	float MeanLight = 0;
-	float DarkRatio = 0;
     for (int p = 0; p < (int)plate_images.size(); p++)
     {
-    	// number plate image
-    	unsigned char* number_plate = plate_images[p];
+    	binary_images.push_back(
+    	    Binarise(imageview::Create(plate_images[p], plate_image_width, plate_image_height[p], 1),
+    	             histogram));
+    }
+}
 
-    	// update the histogram
-    	memset(histogram, 0, 256 * sizeof(int));
-    	for (int i = (plate_image_width * plate_image_height[p])-1; i >= 0; i--)
-    		histogram[number_plate[i]]++;
+/*!
+ * \brief converts a grey number plate image into a binarised version
+ * \param plate_image number plate image, which may be a region of a larger image.
+ *        For colour images the red channel is used.
+ * \return tightly packed binary image, in which dark pixels become 255
+ */
+unsigned char* platereader::Binarise(
+    const image_view &plate_image)
+{
+	int histogram[256];
+	return(Binarise(plate_image, histogram));
+}
+
+/*!
+ * \brief converts grey images for each number plate into bit packed binarised versions
+ * \param plate_image_width width of the number plate image
+ * \param plate_image_height height of each number plate image
+ * \param plate_images number plate images
+ * \param binary_images returned binary number plate images, to be freed with bitimage::Free
+ */
+void platereader::Binarise(
+	int plate_image_width,
+	std::vector<int> plate_image_height,
+    std::vector<unsigned char*> &plate_images,
+    std::vector<bit_image*> &binary_images)
+{
+	int histogram[256];
 
-    	// find the black/white threshold from the histogram
-    	unsigned char black_white_threshold = (unsigned char)thresholding::GetGlobalThreshold(histogram, 256, 0, temp_histogram_buffer, MeanDark, MeanLight, DarkRatio);
+    for (int p = 0; p < (int)plate_images.size(); p++)
+    {
+    	image_view plate_image = imageview::Create(plate_images[p], plate_image_width, plate_image_height[p], 1);
+    	int black_white_threshold = Threshold(plate_image, histogram);
 
-    	// binarise the image
-    	unsigned char* edges = new unsigned char[plate_image_width * plate_image_height[p]];
-    	memset(edges, 0, plate_image_width * plate_image_height[p] * sizeof(unsigned char));
-    	for (int i = (plate_image_width * plate_image_height[p])-1; i >= 0; i--)
+    	bit_image* binary_image = bitimage::Create(plate_image_width, plate_image_height[p]);
+    	for (int y = 0; y < plate_image.height; y++)
     	{
-    	    if (number_plate[i] < black_white_threshold)
-    	    {
-    	        edges[i] = 255;
-    	    }
+    		unsigned char* row = imageview::Row(plate_image, y);
+    		unsigned int* words = &binary_image->rows[y * binary_image->row_words];
+    		for (int x = 0; x < plate_image_width; x++)
+    			if (row[x] < black_white_threshold) words[x / BIT_IMAGE_WORD_BITS] |= 1u << (x % BIT_IMAGE_WORD_BITS);
     	}
-
-    	binary_images.push_back(edges);
+    	bitimage::UpdateColumns(binary_image);
+    	binary_images.push_back(binary_image);
     }
+}
 
-    // free histogram buffers
-    delete[] histogram;
-    delete[] temp_histogram_buffer;
+/*!
+ * \brief returns the black/white threshold of a grey number plate image
+ * \param plate_image number plate image.  For colour images the red channel is used.
+ * \param histogram buffer of 256 elements
+ * \return threshold, below which pixels are dark
+ */
+int platereader::Threshold(
+    const image_view &plate_image,
+    int* histogram)
+{
+	int plate_image_width = plate_image.width;
+	int plate_image_height = plate_image.height;
+	int channel = 0;
+	if (plate_image.channels > 2) channel = 2;
+
+	float MeanDark = 0;
+	float MeanLight = 0;
+	float DarkRatio = 0;
+
+	// update the histogram
+	memset(histogram, 0, 256 * sizeof(int));
+	for (int y = plate_image_height-1; y >= 0; y--)
+	{
+		unsigned char* row = imageview::Row(plate_image, y);
+		for (int x = ((plate_image_width-1) * plate_image.channels) + channel; x >= 0; x -= plate_image.channels)
+			histogram[row[x]]++;
+	}
+
+	// find the black/white threshold from the histogram
+	return((unsigned char)thresholding::GetGlobalThreshold(histogram, 256, MeanDark, MeanLight, DarkRatio));
+}
+
+/*!
+ * \brief converts a grey number plate image into a binarised version
+ * \param plate_image number plate image
+ * \param histogram buffer of 256 elements
+ * \return tightly packed binary image
+ */
+unsigned char* platereader::Binarise(
+    const image_view &plate_image,
+    int* histogram)
+{
+	int plate_image_width = plate_image.width;
+	int plate_image_height = plate_image.height;
+	int channel = 0;
+	if (plate_image.channels > 2) channel = 2;
+
+	int black_white_threshold = Threshold(plate_image, histogram);
+
+	// binarise the image
+	unsigned char* edges = new unsigned char[plate_image_width * plate_image_height];
+	memset(edges, 0, plate_image_width * plate_image_height * sizeof(unsigned char));
+	int i = 0;
+	for (int y = 0; y < plate_image_height; y++)
+	{
+		unsigned char* row = imageview::Row(plate_image, y);
+		for (int x = channel; x < plate_image_width * plate_image.channels; x += plate_image.channels, i++)
+		{
+		    if (row[x] < black_white_threshold)
+		    {
+		        edges[i] = 255;
+		    }
+		}
+	}
+
+	return(edges);
 }
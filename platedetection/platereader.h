@@ -35,12 +35,21 @@
 #include <vector>
 #include "../common.h"
 #include "../utils/Image.h"
+#include "../utils/imageview.h"
+#include "../utils/bitimage.h"
 #include "../utils/polygon.h"
 #include "../shapes/shapes.h"
 
 class platereader
 {
 private:
+	static int Threshold(
+	    const image_view &plate_image,
+	    int* histogram);
+
+	static unsigned char* Binarise(
+	    const image_view &plate_image,
+	    int* histogram);
 
 public:
 
@@ -56,9 +65,7 @@ public:
 	    int minimum_occupancy_percent);
 
 	static void Trim(
-	    int plate_image_width,
-	    int plate_image_height,
-	    unsigned char* number_plate,
+	    const bit_image &number_plate,
 	    float threshold_percent,
 	    int &tx,
 	    int &ty,
@@ -66,9 +73,7 @@ public:
 	    int &by);
 
 	static void VerticalCrop(
-	    int plate_image_width,
-	    int plate_image_height,
-	    unsigned char* number_plate,
+	    const bit_image &number_plate,
 	    int &top_y,
 	    int &bottom_y);
 
@@ -81,12 +86,30 @@ public:
 	    std::vector<std::vector<int> > &characters_dimensions,
 	    std::vector<std::vector<int> > &characters_positions);
 
+	static void SeparateCharacters(
+		float minimum_character_width_percent,
+		int plate_image_width,
+		std::vector<int> plate_image_height,
+	    std::vector<bit_image*> &binary_images,
+	    std::vector<std::vector<unsigned char*> > &characters,
+	    std::vector<std::vector<int> > &characters_dimensions,
+	    std::vector<std::vector<int> > &characters_positions);
+
 	static void Binarise(
 		int plate_image_width,
 		std::vector<int> plate_image_height,
 	    std::vector<unsigned char*> &plate_images,
 	    std::vector<unsigned char*> &binary_images);
 
+	static void Binarise(
+		int plate_image_width,
+		std::vector<int> plate_image_height,
+	    std::vector<unsigned char*> &plate_images,
+	    std::vector<bit_image*> &binary_images);
+
+	static unsigned char* Binarise(
+	    const image_view &plate_image);
+
 	static void Resample(
 		std::vector<int> &character_image_dimensions,
 	    std::vector<unsigned char*> &character_images,
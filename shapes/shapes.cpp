@@ -360,15 +360,12 @@ void shapes::DetectSquaresInsideCircles(
     int maximum_groups,
     std::vector<float>& circles,
     std::vector<int>& edges,
-    unsigned char* edges_image,
     int& edges_image_width,
     int& edges_image_height,
     CannyEdgeDetector *edge_detector,
     std::vector<polygon2D*>& squares,
     std::vector<unsigned char*>& debug_images,
-    unsigned char* erosion_dilation_buffer,
-    int* downsampling_buffer0,
-    int* downsampling_buffer1)
+    unsigned char* erosion_dilation_buffer)
 {
     squares.erase(squares.begin(), squares.end());
 
@@ -424,14 +421,11 @@ void shapes::DetectSquaresInsideCircles(
             orientation,
             dominant_edges,
             side_edges,
-            edges_image,
             edges_image_width, edges_image_height,
             edge_detector,
             squares,
             debug_images,
-            erosion_dilation_buffer,
-            downsampling_buffer0,
-            downsampling_buffer1);
+            erosion_dilation_buffer);
 
         for (int j = 0; j < (int)edges.size(); j += 2)
         {
@@ -704,15 +698,12 @@ void shapes::DetectRectangles(
     std::vector<float>& orientation,
     std::vector<std::vector<int> >& dominant_edges,
     std::vector<std::vector<std::vector<int> > >& side_edges,
-    unsigned char* edges_image,
     int& edges_image_width,
     int& edges_image_height,
     CannyEdgeDetector *edge_detector,
     std::vector<polygon2D*>& rectangles,
     std::vector<unsigned char*>& debug_images,
-    unsigned char* erosion_dilation_buffer,
-    int* downsampling_buffer0,
-    int* downsampling_buffer1)
+    unsigned char* erosion_dilation_buffer)
 {
     int downsampled_width = img_width;
     switch (accuracy_level)
@@ -744,12 +735,10 @@ void shapes::DetectRectangles(
         dominant_edges,
         side_edges,
         edge_detector,
-        edges_image, edges_image_width, edges_image_height,
+        edges_image_width, edges_image_height,
         rectangles,
         debug_images,
-        erosion_dilation_buffer,
-        downsampling_buffer0,
-        downsampling_buffer1);
+        erosion_dilation_buffer);
 }
 
 /*!
@@ -803,15 +792,12 @@ void shapes::DetectSquares(
     std::vector<float>& orientation,
     std::vector<std::vector<int> >& dominant_edges,
     std::vector<std::vector<std::vector<int> > >& side_edges,
-    unsigned char* edges_image,
     int& edges_image_width,
     int& edges_image_height,
     CannyEdgeDetector *edge_detector,
     std::vector<polygon2D*>& squares,
     std::vector<unsigned char*>& debug_images,
-    unsigned char* erosion_dilation_buffer,
-    int* downsampling_buffer0,
-    int* downsampling_buffer1)
+    unsigned char* erosion_dilation_buffer)
 {
     int downsampled_width = img_width;
 
@@ -859,12 +845,10 @@ void shapes::DetectSquares(
         dominant_edges,
         side_edges,
         edge_detector,
-        edges_image, edges_image_width, edges_image_height,
+        edges_image_width, edges_image_height,
         squares,
         debug_images,
-        erosion_dilation_buffer,
-        downsampling_buffer0,
-        downsampling_buffer1);
+        erosion_dilation_buffer);
 }
 
 /*!
@@ -929,14 +913,11 @@ void shapes::DetectSquares(
     std::vector<std::vector<int> >& dominant_edges,
     std::vector<std::vector<std::vector<int> > >& side_edges,
     CannyEdgeDetector *edge_detector,
-    unsigned char* edges_image,
     int& edges_image_width,
     int& edges_image_height,
     std::vector<polygon2D*>& squares,
     std::vector<unsigned char*>& debug_images,
-    unsigned char* erosion_dilation_buffer,
-    int* downsampling_buffer0,
-    int* downsampling_buffer1)
+    unsigned char* erosion_dilation_buffer)
  {
     int original_img_width = img_width;
 
@@ -958,7 +939,7 @@ void shapes::DetectSquares(
         {
             // if the desired downsampled width  an exact multiple of the
             // original width then use a simple downsampling method
-            processimage::downSample(img_colour, img_width, img_height, bytes_per_pixel, factor, downsampling_buffer0, downsampling_buffer1, img);
+            processimage::downSample(img_colour, img_width, img_height, bytes_per_pixel, factor, img);
         }
         else
         {
@@ -1004,7 +985,6 @@ void shapes::DetectSquares(
         dominant_edges,
         side_edges,
         edge_detector,
-        edges_image,
         squares,
         debug_images,
         erosion_dilation_buffer);
@@ -1382,6 +1362,35 @@ void shapes::SortPerimeters(
 
 
 
+/*!
+ * \brief stores a mono debugging image.  If a DebugSink has been installed
+ *        the image is passed to it, otherwise a colour copy is added to the list.
+ * \param img_mono mono image, which remains owned by the caller
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param name short description of the image
+ * \param debug_images list of debugging images
+ */
+void shapes::AddDebugImage(
+    unsigned char* img_mono,
+    int img_width,
+    int img_height,
+    std::string name,
+    std::vector<unsigned char*>& debug_images)
+{
+    DebugSink *debug_sink = DebugSink::Current();
+    if (debug_sink != NULL)
+    {
+        debug_sink->Copy(img_mono, img_width, img_height, 1, name);
+    }
+    else
+    {
+        unsigned char *img_debug_colour = new unsigned char[img_width * img_height * 3];
+        processimage::colourImage(img_mono, img_width, img_height, img_debug_colour);
+        debug_images.push_back(img_debug_colour);
+    }
+}
+
 /*!
  * \brief detects square shapes within the given mono image
  * \param img_mono mono image data
@@ -1442,7 +1451,6 @@ void shapes::DetectSquaresMono(
     std::vector<std::vector<int> >& dominant_edges,
     std::vector<std::vector<std::vector<int> > >& side_edges,
     CannyEdgeDetector *edge_detector,
-    unsigned char* edges_image,
     std::vector<polygon2D*>& square_shapes,
     std::vector<unsigned char*>& debug_images,
     unsigned char* erosion_dilation_buffer)
@@ -1505,13 +1513,13 @@ void shapes::DetectSquaresMono(
         }
     }
 
+    // debugging images go to the installed sink if there is one, otherwise they are returned
+    DebugSink *debug_sink = NULL;
+    if (debug) debug_sink = DebugSink::Current();
+
     // for debugging purposes store the original image
     if (debug)
-    {
-        unsigned char *img_debug_colour = new unsigned char[img_width * img_height * 3];
-        processimage::colourImage(img_mono, img_width, img_height, img_debug_colour);
-        debug_images.push_back(img_debug_colour);
-    }
+        AddDebugImage(img_mono, img_width, img_height, "mono", debug_images);
 
     int image_border = img_width * image_border_percent / 100;
 
@@ -1525,6 +1533,8 @@ void shapes::DetectSquaresMono(
     //  each erosion/dilation level
     for (int erosion_dilation_level = 0; erosion_dilation_level < erosion_dilation_levels; erosion_dilation_level++)
     {
+        double stage_start = profiler::Start();
+
         // erode
         if (erosion_dilation[erosion_dilation_level] > 0)
         {
@@ -1577,25 +1587,20 @@ void shapes::DetectSquaresMono(
             previous_eroded = false;
             previous_dilated = false;
         }
+        profiler::Stop(PROFILE_ERODE_DILATE, stage_start);
 
         // for debugging purposes store the image after erosion / dilation
         if (debug)
-        {
-            unsigned char *img_debug_colour = new unsigned char[img_width * img_height * 3];
-            processimage::colourImage(img_mono2, img_width, img_height, img_debug_colour);
-            debug_images.push_back(img_debug_colour);
-        }
+            AddDebugImage(img_mono2, img_width, img_height, "eroded_dilated", debug_images);
 
         // detect edges with canny algorithm
-        edges_image = edge_detector->Update(img_mono2, img_width, img_height, 1);
+        stage_start = profiler::Start();
+        edge_detector->Update(img_mono2, img_width, img_height, 1);
+        profiler::Stop(PROFILE_CANNY, stage_start);
 
         // for debugging purposes store the edges image
         if (debug)
-        {
-            unsigned char *img_debug_colour = new unsigned char[img_width * img_height * 3];
-            processimage::colourImage(edges_image, img_width, img_height, img_debug_colour);
-            debug_images.push_back(img_debug_colour);
-        }
+            AddDebugImage(edge_detector->EdgesImage(), img_width, img_height, "edges", debug_images);
 
         // connect edges which are a short distance apart
         edge_detector->ConnectBrokenEdges(connect_edges_radius, img_width, img_height, 1);
@@ -1627,6 +1632,7 @@ void shapes::DetectSquaresMono(
         {
             // group edges together into objects
             std::vector<std::vector<int> > groups;
+            stage_start = profiler::Start();
             GetGroups(
                 edge_detector->edges,
                 img_width, img_height, image_border,
@@ -1639,17 +1645,21 @@ void shapes::DetectSquaresMono(
                 line_segment_map_buffer,
                 step_sizes,
                 no_of_step_sizes);
+            profiler::Stop(PROFILE_GROUPS, stage_start);
 
             int no_of_groups = (int)groups.size();
 
             if ((no_of_groups > 0) && (no_of_groups < maximum_groups))
             {
                 // for debugging purposes show the detected groups
-                if (debug)
+                if ((debug) && ((debug_sink == NULL) || (debug_sink->Accepting())))
                 {
                     unsigned char *img_debug_colour = new unsigned char[img_width * img_height * 3];
                     ShowGroups(groups, img_width, img_height, img_debug_colour);
-                    debug_images.push_back(img_debug_colour);
+                    if (debug_sink != NULL)
+                        debug_sink->Add(img_debug_colour, img_width, img_height, 3, "groups");
+                    else
+                        debug_images.push_back(img_debug_colour);
                 }
 
                 // get the set of edges with aspect ratio closest to square
@@ -1661,21 +1671,20 @@ void shapes::DetectSquaresMono(
                     squares);
 
                 unsigned char *img_debug_squares = NULL;
-                if (debug)
+                if ((debug) && ((debug_sink == NULL) || (debug_sink->Accepting())))
                 {
                     img_debug_squares = new unsigned char[img_width * img_height * 3];
 
                     for (int i = (img_width * img_height * 3)-1; i >= 0; i--)
                         img_debug_squares[i] = (unsigned char)255;
-
-                    debug_images.push_back(img_debug_squares);
                 }
 
+                stage_start = profiler::Start();
                 int detected_squares = (int)squares.size();
                 for (int i = detected_squares - 1; i >= 0; i--)
                 {
                     // display the square-looking areas under consideration
-                    if (debug)
+                    if (img_debug_squares != NULL)
                     {
                         // use different colours to distinguish each square region
                         unsigned char r=0, g=0, b=0;
@@ -1903,10 +1912,14 @@ void shapes::DetectSquaresMono(
 						}
                     }
                 }
+                profiler::Stop(PROFILE_PERIMETERS, stage_start);
 
-                if (debug)
+                if (img_debug_squares != NULL)
                 {
-                    debug_images.push_back(img_debug_squares);
+                    if (debug_sink != NULL)
+                        debug_sink->Add(img_debug_squares, img_width, img_height, 3, "squares");
+                    else
+                        debug_images.push_back(img_debug_squares);
                 }
 
             }
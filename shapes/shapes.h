@@ -37,6 +37,8 @@
 #include "../utils/processimage.h"
 #include "../utils/thresholding.h"
 #include "../utils/bitmap.h"
+#include "../utils/profiler.h"
+#include "../utils/debugsink.h"
 #include "../edgedetection/CannyEdgeDetector.h"
 #include "../hypergraph/hypergraph.h"
 
@@ -60,13 +62,13 @@ class shapes
     	static void SortPerimeters(std::vector<polygon2D*> perimeters, std::vector<float> orientation);
         static void BinarizeSimple(unsigned char* img, int img_width, int img_height, int vertical_integration_percent, bool colour, unsigned char* binary_image);
         static void RemoveSurroundingBlob(unsigned char* img, int img_width, int img_height, bool black_on_white, bool colour_image);
-        static void DetectSquaresInsideCircles(unsigned char* img, int img_width, int img_height, int bytes_per_pixel, int circular_ROI_radius, int perimeter_detection_method, bool square_black_on_white, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<float>& circles, std::vector<int>& edges, unsigned char* edges_image, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer, int* downsampling_buffer0, int* downsampling_buffer1);
+        static void DetectSquaresInsideCircles(unsigned char* img, int img_width, int img_height, int bytes_per_pixel, int circular_ROI_radius, int perimeter_detection_method, bool square_black_on_white, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<float>& circles, std::vector<int>& edges, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
         static void DetectCircle(unsigned char* img, int img_width, int img_height, int bytes_per_pixel, int circular_ROI_radius, std::vector<float>& circles);
         static void DetectCircleMono(unsigned char* mono_img, int img_width, int img_height, int circular_ROI_radius, std::vector<float>& circles);
-        static void DetectRectangles(unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, int accuracy_level, float maximum_aspect_ratio, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, unsigned char* edges_image, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& rectangles, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer, int* downsampling_buffer0, int* downsampling_buffer1);
-        static void DetectSquares   (unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, int accuracy_level, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, unsigned char* edges_image, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer, int* downsampling_buffer0, int* downsampling_buffer1);
-        static void DetectSquares   (unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, bool ignore_periphery, int image_border_percent, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, float minimum_aspect_ratio, float maximum_aspect_ratio, int downsampled_width, bool squares_only, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, CannyEdgeDetector *edge_detector, unsigned char* edges_image, int& edges_image_width, int& edges_image_height, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer, int* downsampling_buffer0, int* downsampling_buffer1);
-        static void DetectSquaresMono(unsigned char* mono_img, int img_width, int img_height, bool ignore_periphery, int image_border_percent, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, bool use_original_image, float minimum_aspect_ratio, float maximum_aspect_ratio, bool squares_only, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, CannyEdgeDetector *edge_detector, unsigned char* edges_image, std::vector<polygon2D*>& square_shapes, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
+        static void DetectRectangles(unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, int accuracy_level, float maximum_aspect_ratio, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& rectangles, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
+        static void DetectSquares   (unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, int accuracy_level, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, int& edges_image_width, int& edges_image_height, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
+        static void DetectSquares   (unsigned char* img_colour, int img_width, int img_height, int bytes_per_pixel, bool ignore_periphery, int image_border_percent, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, float minimum_aspect_ratio, float maximum_aspect_ratio, int downsampled_width, bool squares_only, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, CannyEdgeDetector *edge_detector, int& edges_image_width, int& edges_image_height, std::vector<polygon2D*>& squares, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
+        static void DetectSquaresMono(unsigned char* mono_img, int img_width, int img_height, bool ignore_periphery, int image_border_percent, int* grouping_radius_percent, int grouping_radius_percent_levels, int* erosion_dilation, int erosion_dilation_levels, bool black_on_white, bool use_original_image, float minimum_aspect_ratio, float maximum_aspect_ratio, bool squares_only, bool debug, int circular_ROI_radius, int perimeter_detection_method, int* compression, int no_of_compressions, int minimum_volume_percent, int maximum_volume_percent, bool use_perimeter_fitting, int perimeter_fit_threshold, int bestfit_tries, int* step_sizes, int no_of_step_sizes, int maximum_groups, std::vector<int>& edges, std::vector<float>& orientation, std::vector<std::vector<int> >& dominant_edges, std::vector<std::vector<std::vector<int> > >& side_edges, CannyEdgeDetector *edge_detector, std::vector<polygon2D*>& square_shapes, std::vector<unsigned char*>& debug_images, unsigned char* erosion_dilation_buffer);
         static void GetValidGroups(std::vector<std::vector<int> > &groups, int img_width, int img_height, int minimum_size_percent, std::vector<std::vector<int> >& results);
         static void GetAspectRange(std::vector<std::vector<int> > &groups, int img_width, int img_height, float minimum_aspect, float maximum_aspect, int minimum_size_percent, bool squares_only, std::vector<std::vector<int> >& results);
         static void GetGroups(std::vector<int> &edges, int img_width, int img_height, int image_border, int minimum_size_percent, bool squares_only, float max_rectangular_aspect, bool ignore_periphery, int grouping_radius_percent, int* compression, int no_of_compressions, std::vector<std::vector<int> >& groups, int* line_segment_map_buffer, int* step_sizes, int no_of_step_sizes);
@@ -121,6 +123,7 @@ class shapes
         static float BestFitLine(std::vector<int> &edges, float max_deviation, int baseline_length_pixels, float& x0, float& y0, float& x1, float& y1);
         void RotateEdges(std::vector<int> &edges, int centre_x, int centre_y, float rotate_angle, std::vector<int>& rotated);
         static void MostSquare(std::vector<polygon2D*> &square_shapes, std::vector<float>& orientation, int max_squares);
+        static void AddDebugImage(unsigned char* img_mono, int img_width, int img_height, std::string name, std::vector<unsigned char*>& debug_images);
 
         static void GetPeripheralEdges(
         	std::vector<int> &edges,
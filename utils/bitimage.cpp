@@ -0,0 +1,198 @@
+/*
+    bit packed binary images
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitimage.h"
+
+/*!
+ * \brief returns the number of set bits in the given word
+ */
+static inline int PopCount(
+    unsigned int v)
+{
+#ifdef __GNUC__
+	return(__builtin_popcount(v));
+#else
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return((int)((((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24));
+#endif
+}
+
+/*!
+ * \brief returns an empty image, in which no pixels are set
+ * \param width width of the image
+ * \param height height of the image
+ */
+bit_image* bitimage::Create(
+    int width, int height)
+{
+	bit_image* img = new bit_image;
+	img->width = width;
+	img->height = height;
+	img->row_words = (width + BIT_IMAGE_WORD_BITS - 1) / BIT_IMAGE_WORD_BITS;
+	img->column_words = (height + BIT_IMAGE_WORD_BITS - 1) / BIT_IMAGE_WORD_BITS;
+	img->rows = new unsigned int[img->row_words * height];
+	img->columns = new unsigned int[img->column_words * width];
+	memset(img->rows, 0, img->row_words * height * sizeof(unsigned int));
+	memset(img->columns, 0, img->column_words * width * sizeof(unsigned int));
+	return(img);
+}
+
+/*!
+ * \brief frees an image returned by Create or Pack
+ * \param img image to be freed, which may be NULL
+ */
+void bitimage::Free(
+    bit_image* img)
+{
+	if (img == NULL) return;
+	delete[] img->rows;
+	delete[] img->columns;
+	delete img;
+}
+
+/*!
+ * \brief packs a mono image, in which non-zero pixels are set
+ * \param img mono image
+ * \param width width of the image
+ * \param height height of the image
+ * \return packed image
+ */
+bit_image* bitimage::Pack(
+    const unsigned char* img,
+    int width, int height)
+{
+	bit_image* result = Create(width, height);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &img[y * width];
+		unsigned int* words = &result->rows[y * result->row_words];
+		for (int x = 0; x < width; x++)
+			if (row[x] != 0) words[x / BIT_IMAGE_WORD_BITS] |= 1u << (x % BIT_IMAGE_WORD_BITS);
+	}
+	UpdateColumns(result);
+	return(result);
+}
+
+/*!
+ * \brief fills the stored columns from the stored rows.  This should be called
+ *        after the rows have been written directly.
+ * \param img image to be updated
+ */
+void bitimage::UpdateColumns(
+    bit_image* img)
+{
+	memset(img->columns, 0, img->column_words * img->width * sizeof(unsigned int));
+	for (int y = 0; y < img->height; y++)
+	{
+		const unsigned int* words = &img->rows[y * img->row_words];
+		unsigned int* column = &img->columns[y / BIT_IMAGE_WORD_BITS];
+		unsigned int bit = 1u << (y % BIT_IMAGE_WORD_BITS);
+		for (int w = 0; w < img->row_words; w++)
+		{
+			// visit only the set pixels
+			unsigned int v = words[w];
+			while (v != 0)
+			{
+				int x = (w * BIT_IMAGE_WORD_BITS) + PopCount((v & (0u - v)) - 1);
+				column[x * img->column_words] |= bit;
+				v &= v - 1;
+			}
+		}
+	}
+}
+
+/*!
+ * \brief returns the number of set bits within a range of a bit string
+ * \param words bit string
+ * \param start first bit
+ * \param end last bit (exclusive)
+ */
+int bitimage::Count(
+    const unsigned int* words,
+    int start, int end)
+{
+	if (end <= start) return(0);
+
+	int first = start / BIT_IMAGE_WORD_BITS;
+	int last = (end - 1) / BIT_IMAGE_WORD_BITS;
+	unsigned int first_mask = 0xFFFFFFFFu << (start % BIT_IMAGE_WORD_BITS);
+	unsigned int last_mask = 0xFFFFFFFFu >> (BIT_IMAGE_WORD_BITS - 1 - ((end - 1) % BIT_IMAGE_WORD_BITS));
+
+	if (first == last) return(PopCount(words[first] & first_mask & last_mask));
+
+	int occupancy = PopCount(words[first] & first_mask);
+	for (int w = first + 1; w < last; w++)
+		occupancy += PopCount(words[w]);
+	return(occupancy + PopCount(words[last] & last_mask));
+}
+
+/*!
+ * \brief returns the number of set pixels within part of a row
+ * \param img image
+ * \param y row
+ * \param start_x first x coordinate
+ * \param end_x last x coordinate (exclusive)
+ */
+int bitimage::CountRow(
+    const bit_image &img,
+    int y,
+    int start_x, int end_x)
+{
+	return(Count(&img.rows[y * img.row_words], start_x, end_x));
+}
+
+/*!
+ * \brief returns the number of set pixels within part of a column
+ * \param img image
+ * \param x column
+ * \param start_y first y coordinate
+ * \param end_y last y coordinate (exclusive)
+ */
+int bitimage::CountColumn(
+    const bit_image &img,
+    int x,
+    int start_y, int end_y)
+{
+	return(Count(&img.columns[x * img.column_words], start_y, end_y));
+}
+
+/*!
+ * \brief unpacks a region into a mono image, in which set pixels become 255
+ * \param img image
+ * \param tx top left x coordinate
+ * \param ty top left y coordinate
+ * \param bx bottom right x coordinate (exclusive)
+ * \param by bottom right y coordinate (exclusive)
+ * \param result returned mono image of (bx - tx) * (by - ty) pixels
+ */
+void bitimage::Unpack(
+    const bit_image &img,
+    int tx, int ty,
+    int bx, int by,
+    unsigned char* result)
+{
+	int n = 0;
+	for (int y = ty; y < by; y++)
+	{
+		const unsigned int* words = &img.rows[y * img.row_words];
+		for (int x = tx; x < bx; x++, n++)
+			result[n] = ((words[x / BIT_IMAGE_WORD_BITS] >> (x % BIT_IMAGE_WORD_BITS)) & 1) ? 255 : 0;
+	}
+}
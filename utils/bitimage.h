@@ -0,0 +1,88 @@
+/*
+    bit packed binary images
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITIMAGE_H_
+#define BITIMAGE_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// number of pixels held in each word
+#define BIT_IMAGE_WORD_BITS     32
+
+/*!
+ * \brief binary image with one bit per pixel.  The bits are stored twice,
+ *        row by row and column by column, so that the occupancy of any
+ *        part of a row or a column can be counted a word at a time.
+ */
+struct bit_image
+{
+	int width;
+	int height;
+
+	// number of words in each stored row, and in each stored column
+	int row_words;
+	int column_words;
+
+	// bit x of row y is bit (x % 32) of rows[(y * row_words) + (x / 32)]
+	unsigned int* rows;
+
+	// bit y of column x is bit (y % 32) of columns[(x * column_words) + (y / 32)]
+	unsigned int* columns;
+};
+
+class bitimage
+{
+private:
+	static int Count(
+	    const unsigned int* words,
+	    int start, int end);
+
+public:
+	static bit_image* Create(
+	    int width, int height);
+
+	static void Free(
+	    bit_image* img);
+
+	static bit_image* Pack(
+	    const unsigned char* img,
+	    int width, int height);
+
+	static void UpdateColumns(
+	    bit_image* img);
+
+	static int CountRow(
+	    const bit_image &img,
+	    int y,
+	    int start_x, int end_x);
+
+	static int CountColumn(
+	    const bit_image &img,
+	    int x,
+	    int start_y, int end_y);
+
+	static void Unpack(
+	    const bit_image &img,
+	    int tx, int ty,
+	    int bx, int by,
+	    unsigned char* result);
+};
+
+#endif /* BITIMAGE_H_ */
@@ -22,6 +22,7 @@
 Bitmap::Bitmap()
 {
     Data = NULL;
+    owns_data = true;
     Width = 0;
     Height = 0;
     bytes_per_pixel = 0;
@@ -30,6 +31,7 @@ Bitmap::Bitmap()
 Bitmap::Bitmap(int Width, int Height)
 {
     Data = NULL;
+    owns_data = true;
     bytes_per_pixel = 0;
     Allocate(Width, Height);
 }
@@ -37,6 +39,7 @@ Bitmap::Bitmap(int Width, int Height)
 Bitmap::Bitmap(unsigned char *bmp, int Width, int Height, int BytesPerPixel)
 {
     Data = NULL;
+    owns_data = true;
     bytes_per_pixel = 0;
     Allocate(Width, Height);
 
@@ -65,6 +68,7 @@ Bitmap::~Bitmap()
 Bitmap::Bitmap(Bitmap &B)
 {
     Data = NULL;
+    owns_data = true;
     bytes_per_pixel = 0;
     Allocate(B.Width, B.Height);
     memcpy(Data, B.Data, Width * Height * 3);
@@ -73,6 +77,7 @@ Bitmap::Bitmap(Bitmap &B)
 Bitmap::Bitmap(Bitmap &B, int x, int y, int Width, int Height)
 {
     Data = NULL;
+    owns_data = true;
     bytes_per_pixel = 0;
     Allocate(Width, Height);
     memcpy(Data, B.Data, Width * Height * 3);
@@ -87,7 +92,7 @@ Bitmap& Bitmap::operator = (const Bitmap &B)
 
 void Bitmap::FreeMemory()
 {
-    if(Data != NULL)
+    if ((Data != NULL) && (owns_data))
         delete[] Data;
 
     Data = NULL;
@@ -101,49 +106,54 @@ void Bitmap::Allocate(int Width, int Height)
     this->Width = Width;
     this->Height = Height;
     Data = new unsigned char[Width * Height * 3];
+    owns_data = true;
 }
 
 void Bitmap::Save(const char *filename)
 {
-    BITMAPFILEHEADER    bmfh;  //stores information about the file format
-    BITMAPINFOHEADER    bmih;  //stores information about the bitmap
-    std::FILE           *file; //stores file pointer
-
-    //create bitmap file header
-    ((unsigned char *)&bmfh.bfType)[0] = 'B';
-    ((unsigned char *)&bmfh.bfType)[1] = 'M';
-    bmfh.bfSize = 54 + Height * Width * 4;
-    bmfh.bfReserved1 = 0;
-    bmfh.bfReserved2 = 0;
-    bmfh.bfOffBits = 54;
-
-    //create bitmap information header
-    //bmih.biSize = 40;
-    bmih.biWidth = Width;
-    bmih.biHeight = Height;
-    bmih.biPlanes = 1;
-    bmih.biBitCount = 32;
-    bmih.biCompression = 0;
-    bmih.biSizeImage = 0;
-    bmih.biXPelsPerMeter = 3800;
-    bmih.biYPelsPerMeter = 3800;
-    bmih.biClrUsed = 0;
-    bmih.biClrImportant = 0;
-
+    // the header is assembled byte by byte, since the BITMAPFILEHEADER and
+    // BITMAPINFOHEADER structs are neither packed nor 32 bit on all platforms
+    unsigned char header[54];
+    unsigned int file_size = 54 + (Height * Width * 4);
+    unsigned int offset = 54;
+    unsigned int info_size = 40;
+    int width = Width;
+    int height = Height;
+    unsigned short planes = 1;
+    unsigned short bpp = 32;
+    unsigned int pixels_per_metre = 3800;
+    memset(header, 0, 54);
+    header[0] = 'B';
+    header[1] = 'M';
+    memcpy(&header[2], &file_size, 4);
+    memcpy(&header[10], &offset, 4);
+    memcpy(&header[14], &info_size, 4);
+    memcpy(&header[18], &width, 4);
+    memcpy(&header[22], &height, 4);
+    memcpy(&header[26], &planes, 2);
+    memcpy(&header[28], &bpp, 2);
+    memcpy(&header[38], &pixels_per_metre, 4);
+    memcpy(&header[42], &pixels_per_metre, 4);
+
+    // rows are stored bottom first
     unsigned char *Data2 = new unsigned char[Width * Height * 4];
-    int n = 0;
-    for (int i = 0; i < Width * Height * 4; i += 4, n += 3)
+    int i = 0;
+    for (int y = Height - 1; y >= 0; y--)
     {
-        Data2[i] = Data[n];
-        Data2[i+1] = Data[n+1];
-        Data2[i+2] = Data[n+2];
+        int n = y * Width * 3;
+        for (int x = 0; x < Width; x++, i += 4, n += 3)
+        {
+            Data2[i] = Data[n];
+            Data2[i+1] = Data[n+1];
+            Data2[i+2] = Data[n+2];
+            Data2[i+3] = 0;
+        }
     }
 
     //save all header and bitmap information into file
-    file = fopen(filename, "wb");
+    std::FILE *file = fopen(filename, "wb");
     assert(file != NULL);
-    fwrite(&bmfh, sizeof(BITMAPFILEHEADER), 1, file);
-    fwrite(&bmih, sizeof(BITMAPINFOHEADER), 1, file);
+    fwrite(header, 1, 54, file);
     fwrite(Data2, 4, Width * Height, file);
     fclose(file);
 
@@ -157,172 +167,345 @@ void Bitmap::Save(const char *filename)
  */
 bool Bitmap::FromFile(std::string filename)
 {
-	bool loaded = false;
-    unsigned int uival;
-    unsigned short usval, bpp;
-    unsigned int size, compression;
-    int header_size;
-    ifstream inf;
-
-    inf.open(filename.c_str(), ios::binary);
-    if (!inf.good())
-    {
-        cout << "File not found: " << filename << endl;
-    }
-    else
-    {
-		if (Data != NULL) delete[] Data;
+	unsigned char* buffer = NULL;
+	int buffer_size = 0;
+	bool loaded = FromFile(filename, buffer, buffer_size);
+	if (loaded)
+	{
+		// this bitmap now owns the buffer
+		owns_data = true;
+	}
+	else
+	{
+		if (buffer != NULL) delete[] buffer;
+	}
+	return(loaded);
+}
 
-		// Move to header size position
-		inf.seekg( 14 );
-		inf.read( (char *) &header_size, 4);
+/*!
+ * \brief decodes a jpeg image at full resolution into a buffer supplied by the caller
+ * \param file_data contents of the jpeg file
+ * \param length length of the file in bytes
+ * \param buffer image buffer, which is enlarged if it is too small for the image
+ * \param buffer_size size of the buffer in bytes, updated if the buffer is enlarged
+ * \return true if the image was decoded
+ */
+bool Bitmap::FromJpeg(
+    const unsigned char* file_data,
+    int length,
+    unsigned char* &buffer,
+    int &buffer_size)
+{
+	JpegDecoder jpeg;
+	if (!jpeg.Load(file_data, length)) return(false);
+
+	// the decoder rejects frames larger than JPEG_MAX_PIXELS, so this fits an int
+	long long size = (long long)jpeg.Width * (long long)jpeg.Height * 3;
+	if (buffer_size < size)
+	{
+		if (buffer != NULL) delete[] buffer;
+		buffer_size = (int)size;
+		buffer = new unsigned char[buffer_size];
+	}
+
+	if (!jpeg.Decode(1, buffer)) return(false);
+
+	Data = buffer;
+	owns_data = false;
+	Width = jpeg.Width;
+	Height = jpeg.Height;
+	bytes_per_pixel = 3;
+	return(true);
+}
+
+/*!
+ * \brief loads a bitmap image from file into a buffer supplied by the caller.
+ *        The file is memory mapped, and the rows are flipped to top first
+ *        order and 32 bit pixels reduced to 24 bit in a single pass.
+ *        The buffer remains owned by the caller, and Data points into it
+ *        until the next load.  Baseline jpeg files are also accepted, and
+ *        are decoded at full resolution.
+ * \param filename bitmap file name
+ * \param buffer image buffer, which is enlarged if it is too small for the image
+ * \param buffer_size size of the buffer in bytes, updated if the buffer is enlarged
+ * \return true if the file was loaded correctly
+ */
+bool Bitmap::FromFile(
+    std::string filename,
+    unsigned char* &buffer,
+    int &buffer_size)
+{
+	bool loaded = false;
 
-		if (header_size != 40)
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat file_status;
+	if ((fd < 0) || (fstat(fd, &file_status) != 0))
+	{
+		cout << "File not found: " << filename << endl;
+		if (fd >= 0) close(fd);
+		return(false);
+	}
+
+	int file_length_bytes = (int)file_status.st_size;
+	if (file_length_bytes < 2)
+	{
+		cout << "Malformed bitmap " << filename << endl;
+		close(fd);
+		return(false);
+	}
+
+	unsigned char* file_data =
+		(unsigned char*)mmap(NULL, file_length_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file_data == MAP_FAILED)
+	{
+		cout << "Cannot map " << filename << endl;
+		return(false);
+	}
+	madvise(file_data, file_length_bytes, MADV_SEQUENTIAL);
+
+	FreeMemory();
+
+	if (JpegDecoder::IsJpeg(file_data, file_length_bytes))
+	{
+		loaded = FromJpeg(file_data, file_length_bytes, buffer, buffer_size);
+		munmap(file_data, file_length_bytes);
+		return(loaded);
+	}
+
+	if (file_length_bytes < 54)
+	{
+		cout << "Malformed bitmap " << filename << endl;
+		munmap(file_data, file_length_bytes);
+		return(false);
+	}
+
+	// header fields are little endian and not necessarily aligned
+	int offset = 0;
+	int header_size = 0;
+	int width = 0;
+	int height = 0;
+	unsigned short planes = 0;
+	unsigned short bpp = 0;
+	unsigned int compression = 0;
+	memcpy(&offset, file_data + 10, 4);
+	memcpy(&header_size, file_data + 14, 4);
+	memcpy(&width, file_data + 18, 4);
+	memcpy(&height, file_data + 22, 4);
+	memcpy(&planes, file_data + 26, 2);
+	memcpy(&bpp, file_data + 28, 2);
+	memcpy(&compression, file_data + 30, 4);
+
+	if (header_size != 40)
+	{
+		cout << "Malformed bitmap header " << header_size << " bytes (should be 40)" << endl;
+	}
+	else
+	{
+		if (planes != 1)
 		{
-			cout << "Malformed bitmap header " << header_size << " bytes (should be 40)" << endl;
+			cout << "Invalid plane number" << endl;
 		}
 		else
 		{
-			inf.read( (char *) &uival, 4);
-			//cout << "width = " << uival << endl;
-			Width = uival;
-			inf.read( (char *) &uival, 4);
-			//cout << "height = " << uival << endl;
-			Height = uival;
-
-			// read plane number
-			inf.read((char *) &usval, 2);
-			if (usval != 1)
+			if ((bpp != 32) && (bpp != 24) && (bpp != 8))
 			{
-				cout << "Invalid plane number" << endl;
+				cout << "Invalid number of bits per pixel" << endl;
 			}
 			else
 			{
-				// read bpp number
-				inf.read((char *) &bpp, 2);
-				if ((bpp != 32) && (bpp != 24) && (bpp != 8))
+				if (compression != 0)
 				{
-					cout << "Invalid number of bits per pixel" << endl;
+					switch(compression)
+					{
+						case 1:
+						{
+							cout << "8 bit run length encoded bitmaps are not supported" << endl;
+							break;
+						}
+						case 2:
+						{
+							cout << "4 bit run length encoded bitmaps are not supported" << endl;
+							break;
+						}
+						case 3:
+						{
+							cout << "Bitmaps with masks are not supported" << endl;
+							break;
+						}
+					}
 				}
 				else
 				{
-					bytes_per_pixel = bpp / 8;
+					// a negative height indicates that the rows are stored top first
+					bool bottom_up = true;
+					if (height < 0)
+					{
+						height = -height;
+						bottom_up = false;
+					}
 
-					inf.read( (char *) &uival, 4);
-					compression = uival;
+					// calculate stride length using this peculiar formula,
+					// in 64 bits so that the declared dimensions cannot overflow
+					long long stride = (((long long)width * bpp) + 31) & ~31LL;
+					stride >>= 3;
+					long long size = (long long)height * stride;
 
-					if (compression != 0)
+					// the pixel data must fit within the file after the header
+					if ((width <= 0) || (height <= 0) || (size > file_length_bytes - 54))
 					{
-						switch(compression)
-						{
-							case 1:
-							{
-								cout << "8 bit run length encoded bitmaps are not supported" << endl;
-								break;
-							}
-							case 2:
-							{
-								cout << "4 bit run length encoded bitmaps are not supported" << endl;
-								break;
-							}
-							case 3:
-							{
-								cout << "Bitmaps with masks are not supported" << endl;
-								break;
-							}
-						}
-
+						cout << "Malformed bitmap " << filename << endl;
 					}
 					else
 					{
-						// calculate stride length using this peculiar formula
-						int stride = ((Width * bpp + 31) & ~31) >> 3;
-
-						// allocate buffer
-						size = Height * stride;
-						Data = new unsigned char[size];
-
-						inf.seekg(0, std::ios::end);
-						int file_length_bytes = inf.tellg();
+						// pixel data normally follows the header, otherwise
+						// assume that it is at the end of the file
+						if ((offset < 54) || (offset + size > file_length_bytes))
+							offset = file_length_bytes - (int)size;
 
-						// Skip to the end end of the header
-						inf.seekg( file_length_bytes - size, std::ios::beg );
+						int input_bytes_per_pixel = bpp / 8;
+						bytes_per_pixel = input_bytes_per_pixel;
+						if (bytes_per_pixel == 4) bytes_per_pixel = 3;
+						int row_bytes = width * bytes_per_pixel;
 
-						// Read values
-						inf.read((char*) Data , size);
-
-						if (bpp == 24)
+						if (buffer_size < height * row_bytes)
 						{
-							/*
-							for (int i = 0; i < (int)size; i += bytes_per_pixel)
-							{
-								// bgr -> rgb
-								int temp = Data[i];
-								Data[i] = Data[i+2];
-								Data[i+2] = temp;
-							}
-							*/
+							if (buffer != NULL) delete[] buffer;
+							buffer_size = height * row_bytes;
+							buffer = new unsigned char[buffer_size];
 						}
 
-						if (bpp == 32)
+						unsigned char* pixels = file_data + offset;
+						for (int y = 0; y < height; y++)
 						{
-							unsigned char *new_Data = new unsigned char[Width * Height * 3];
-							int n = 0;
-							for (int i = 0; i < (int)size; i += 4)
+							unsigned char* src = pixels + ((bottom_up ? (height - 1 - y) : y) * stride);
+							unsigned char* dest = buffer + (y * row_bytes);
+							if (input_bytes_per_pixel == 4)
 							{
-								// bgr -> rgb
-								new_Data[n++] = Data[i+2];
-								new_Data[n++] = Data[i+1];
-								new_Data[n++] = Data[i];
+								// BGRA -> BGR
+								for (int x = 0; x < width; x++, src += 4, dest += 3)
+								{
+									dest[0] = src[0];
+									dest[1] = src[1];
+									dest[2] = src[2];
+								}
 							}
-							delete[] Data;
-							Data = new_Data;
-							bytes_per_pixel = 3;
-						}
-
-						//flip
-						unsigned char *temp_data = new unsigned char[Height * stride];
-						memcpy(temp_data, Data, Width * Height * bytes_per_pixel);
-						int n = 0;
-						int n2 = 0;
-
-						for (int y  = 0; y < Height; y++)
-						{
-							n2 = (Height - 1 - y) * stride;
-							for (int x = 0; x < Width; x++, n += bytes_per_pixel, n2 += bytes_per_pixel)
+							else
 							{
-								for (int col = 0; col < bytes_per_pixel; col++)
-									Data[n + col] = temp_data[n2 + col];
+								memcpy(dest, src, row_bytes);
 							}
 						}
-						delete[] temp_data;
 
+						Data = buffer;
+						owns_data = false;
+						Width = width;
+						Height = height;
 						loaded = true;
 					}
 				}
 			}
 		}
+	}
 
-		inf.close();
+	munmap(file_data, file_length_bytes);
+	return(loaded);
+}
+
+/*!
+ * \brief writes a binary netpbm image using a single buffered write
+ * \param filename file to be saved
+ * \param img image data, either BGR or mono
+ * \param width width of the image
+ * \param height height of the image
+ * \param channels 3 for a colour (P6) image or 1 for a grey (P5) image
+ * \return true if the file was written
+ */
+bool Bitmap::SaveNetpbm(
+    const char *filename,
+    unsigned char *img,
+    int width,
+    int height,
+    int channels)
+{
+    char header[64];
+    int header_bytes = sprintf(header, "P%d\n%d %d\n255\n", (channels == 3) ? 6 : 5, width, height);
+    int pixels = width * height;
+    int total_bytes = header_bytes + (pixels * channels);
+
+    unsigned char *buffer = new unsigned char[total_bytes];
+    memcpy(buffer, header, header_bytes);
+
+    unsigned char *dest = &buffer[header_bytes];
+    if (channels == 3)
+    {
+        // netpbm stores RGB
+        for (int n = 0; n < pixels * 3; n += 3)
+        {
+            dest[n] = img[n+2];
+            dest[n+1] = img[n+1];
+            dest[n+2] = img[n];
+        }
     }
-    return(loaded);
+    else memcpy(dest, img, pixels);
+
+    bool saved = false;
+    std::FILE *file = fopen(filename, "wb");
+    if (file != NULL)
+    {
+        saved = ((int)fwrite(buffer, 1, total_bytes, file) == total_bytes);
+        fclose(file);
+    }
+
+    delete[] buffer;
+    return(saved);
+}
+
+/*!
+ * \brief saves a colour image in binary PPM (P6) format
+ * \param filename file to be saved
+ * \param img BGR image data
+ * \param width width of the image
+ * \param height height of the image
+ * \return true if the file was written
+ */
+bool Bitmap::SavePPM(const char *filename, unsigned char *img, int width, int height)
+{
+    return(SaveNetpbm(filename, img, width, height, 3));
+}
+
+/*!
+ * \brief saves a mono image in binary PGM (P5) format
+ * \param filename file to be saved
+ * \param img mono image data
+ * \param width width of the image
+ * \param height height of the image
+ * \return true if the file was written
+ */
+bool Bitmap::SavePGM(const char *filename, unsigned char *img, int width, int height)
+{
+    return(SaveNetpbm(filename, img, width, height, 1));
 }
 
 void Bitmap::SavePPM(const char *filename)
+{
+    SaveNetpbm(filename, Data, Width, Height, 3);
+}
+
+void Bitmap::SavePPMText(const char *filename)
 {
     //PPM is a very simple ASCII format
     std::ofstream file(filename);
-    file << "P3" << endl;
-    file << "# PPM saved to " << filename << endl;
-    file << Width << ' ' << Height << endl;
-    file << 255 << endl;    //maximum value of a component
+    file << "P3" << '\n';
+    file << "# PPM saved to " << filename << '\n';
+    file << Width << ' ' << Height << '\n';
+    file << 255 << '\n';    //maximum value of a component
 
     int n = 0;
     for(int y = 0; y < Height; y++)
     {
         for(int x = 0; x < Width; x++)
         {
-            file << int(Data[n+2]) << ' ' << int(Data[n+1]) << ' ' << int(Data[n]) << endl;
+            file << int(Data[n+2]) << ' ' << int(Data[n+1]) << ' ' << int(Data[n]) << '\n';
             n += 3;
         }
     }
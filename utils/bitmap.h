@@ -27,6 +27,11 @@
 #include <string>
 #include <cstring>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "jpegdecoder.h"
 using namespace std;
 
 typedef struct BITMAPFILEHEADER
@@ -56,6 +61,12 @@ typedef struct BITMAPINFOHEADER
 
 class Bitmap
 {
+private:
+    bool owns_data;     // false if Data belongs to a buffer supplied by the caller
+
+    static bool SaveNetpbm(const char *filename, unsigned char *img, int width, int height, int channels);
+    bool FromJpeg(const unsigned char *file_data, int length, unsigned char* &buffer, int &buffer_size);
+
 public:
     int Width, Height;
 
@@ -79,8 +90,12 @@ public:
 
     //File Functions
     void Save(const char *filename); //saves bitmap to filename in *.BMP format
-    void SavePPM(const char *filename); //saves bitmap to filename in *.PPM format
-    bool FromFile(std::string filename); //loads bitmap from filename in 24 or 8 bit *.BMP format
+    void SavePPM(const char *filename); //saves bitmap to filename in binary *.PPM (P6) format
+    void SavePPMText(const char *filename); //saves bitmap to filename in ASCII *.PPM (P3) format
+    static bool SavePPM(const char *filename, unsigned char *img, int width, int height); //saves a BGR image in binary *.PPM (P6) format
+    static bool SavePGM(const char *filename, unsigned char *img, int width, int height); //saves a mono image in binary *.PGM (P5) format
+    bool FromFile(std::string filename); //loads bitmap from filename in 24 or 8 bit *.BMP or baseline *.JPG format
+    bool FromFile(std::string filename, unsigned char* &buffer, int &buffer_size); //loads into a reusable buffer
 
     unsigned char* Data;    // raw image data
     int bytes_per_pixel;
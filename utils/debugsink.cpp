@@ -0,0 +1,311 @@
+/*
+    asynchronous output of debugging images
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "debugsink.h"
+
+DebugSink* DebugSink::current = NULL;
+
+/*!
+ * \brief installs the sink to which debugging images are sent
+ * \param sink the sink, or NULL to return debugging images to the caller
+ */
+void DebugSink::Set(DebugSink* sink)
+{
+	current = sink;
+}
+
+/*!
+ * \brief returns the installed sink, or NULL if there is none
+ */
+DebugSink* DebugSink::Current()
+{
+	return(current);
+}
+
+/*!
+ * \brief adds a copy of an image which remains owned by the caller
+ * \param img image data, BGR if channels is 3 or mono if channels is 1
+ * \param width width of the image
+ * \param height height of the image
+ * \param channels bytes per pixel
+ * \param name short description of the image
+ */
+void DebugSink::Copy(
+    const unsigned char* img,
+    int width, int height,
+    int channels,
+    std::string name)
+{
+	if (!Accepting()) return;
+	unsigned char* copy = new unsigned char[width * height * channels];
+	memcpy(copy, img, width * height * channels);
+	Add(copy, width, height, channels, name);
+}
+
+/*!
+ * \brief constructor, which starts the writer thread
+ * \param prefix prepended to the filename of each image, which may include a directory
+ * \param decimation keep every nth pixel horizontally and vertically, or 1 to keep all pixels
+ * \param maximum_per_second maximum number of images written per second, or zero for no limit
+ * \param queue_length maximum number of images waiting to be written
+ */
+DebugImageWriter::DebugImageWriter(
+    std::string prefix,
+    int decimation,
+    int maximum_per_second,
+    int queue_length)
+{
+	this->prefix = prefix;
+	this->decimation = decimation;
+	if (this->decimation < 1) this->decimation = 1;
+	this->maximum_per_second = maximum_per_second;
+	this->queue_length = queue_length;
+	if (this->queue_length < 1) this->queue_length = 1;
+
+	writing = false;
+	stopping = false;
+	frame_number = 0;
+	written = 0;
+	dropped = 0;
+	rate_second = 0;
+	rate_count = 0;
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&frame_added, NULL);
+	pthread_cond_init(&frame_written, NULL);
+	pthread_create(&writer, NULL, WriterThread, this);
+}
+
+/*!
+ * \brief writes any images still queued, then stops the writer thread
+ */
+DebugImageWriter::~DebugImageWriter()
+{
+	if (Current() == this) Set(NULL);
+
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&frame_added);
+	pthread_mutex_unlock(&mutex);
+	pthread_join(writer, NULL);
+
+	pthread_cond_destroy(&frame_written);
+	pthread_cond_destroy(&frame_added);
+	pthread_mutex_destroy(&mutex);
+}
+
+/*!
+ * \brief applies the rate limit.  The mutex must be held.
+ * \param consume count an accepted image against the limit
+ * \return true if an image may be accepted
+ */
+bool DebugImageWriter::Admit(bool consume)
+{
+	if (stopping) return(false);
+	if ((int)queue.size() >= queue_length) return(false);
+	if (maximum_per_second <= 0) return(true);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec != rate_second)
+	{
+		rate_second = now.tv_sec;
+		rate_count = 0;
+	}
+	if (rate_count >= maximum_per_second) return(false);
+	if (consume) rate_count++;
+	return(true);
+}
+
+bool DebugImageWriter::Accepting()
+{
+	pthread_mutex_lock(&mutex);
+	bool accepting = Admit(false);
+	pthread_mutex_unlock(&mutex);
+	return(accepting);
+}
+
+/*!
+ * \brief queues an image for writing, or discards it if it is not admitted
+ */
+void DebugImageWriter::Enqueue(
+    unsigned char* img,
+    int width, int height,
+    int channels,
+    std::string name,
+    bool decimated)
+{
+	pthread_mutex_lock(&mutex);
+	if (!Admit(true))
+	{
+		dropped++;
+		pthread_mutex_unlock(&mutex);
+		delete[] img;
+		return;
+	}
+
+	std::stringstream s_filename;
+	s_filename << prefix << std::setw(6) << std::setfill('0') << frame_number << "_" << name;
+	if (channels == 1)
+		s_filename << ".pgm";
+	else
+		s_filename << ".ppm";
+	frame_number++;
+
+	debug_frame frame;
+	frame.img = img;
+	frame.width = width;
+	frame.height = height;
+	frame.channels = channels;
+	frame.filename = s_filename.str();
+	frame.decimated = decimated;
+	queue.push_back(frame);
+	pthread_cond_signal(&frame_added);
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief takes ownership of an image, which is decimated when it is written
+ */
+void DebugImageWriter::Add(
+    unsigned char* img,
+    int width, int height,
+    int channels,
+    std::string name)
+{
+	Enqueue(img, width, height, channels, name, (decimation == 1));
+}
+
+/*!
+ * \brief copies only the pixels which will be written, so that the
+ *        full resolution image is not duplicated
+ */
+void DebugImageWriter::Copy(
+    const unsigned char* img,
+    int width, int height,
+    int channels,
+    std::string name)
+{
+	if (!Accepting())
+	{
+		pthread_mutex_lock(&mutex);
+		dropped++;
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	int decimated_width = (width + decimation - 1) / decimation;
+	int decimated_height = (height + decimation - 1) / decimation;
+	unsigned char* copy = new unsigned char[decimated_width * decimated_height * channels];
+	int n = 0;
+	for (int y = 0; y < height; y += decimation)
+	{
+		const unsigned char* row = &img[y * width * channels];
+		for (int x = 0; x < width; x += decimation)
+			for (int c = 0; c < channels; c++, n++)
+				copy[n] = row[(x * channels) + c];
+	}
+
+	Enqueue(copy, decimated_width, decimated_height, channels, name, true);
+}
+
+void* DebugImageWriter::WriterThread(void* writer)
+{
+	((DebugImageWriter*)writer)->Write();
+	return(NULL);
+}
+
+/*!
+ * \brief writes queued images until stopped and the queue is empty
+ */
+void DebugImageWriter::Write()
+{
+	pthread_mutex_lock(&mutex);
+	while (true)
+	{
+		while ((queue.size() == 0) && (!stopping))
+			pthread_cond_wait(&frame_added, &mutex);
+		if (queue.size() == 0) break;
+
+		debug_frame frame = queue.front();
+		queue.pop_front();
+		writing = true;
+		pthread_mutex_unlock(&mutex);
+
+		int width = frame.width;
+		int height = frame.height;
+		if (!frame.decimated)
+		{
+			// decimate in place, since each pixel moves towards the start of the buffer
+			int n = 0;
+			for (int y = 0; y < height; y += decimation)
+				for (int x = 0; x < width; x += decimation)
+					for (int c = 0; c < frame.channels; c++, n++)
+						frame.img[n] = frame.img[(((y * width) + x) * frame.channels) + c];
+			width = (width + decimation - 1) / decimation;
+			height = (height + decimation - 1) / decimation;
+		}
+
+		if (frame.channels == 1)
+			Bitmap::SavePGM(frame.filename.c_str(), frame.img, width, height);
+		else
+			Bitmap::SavePPM(frame.filename.c_str(), frame.img, width, height);
+		delete[] frame.img;
+
+		pthread_mutex_lock(&mutex);
+		writing = false;
+		written++;
+		pthread_cond_broadcast(&frame_written);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief waits until all queued images have been written
+ */
+void DebugImageWriter::Flush()
+{
+	pthread_mutex_lock(&mutex);
+	while ((queue.size() > 0) || (writing))
+		pthread_cond_wait(&frame_written, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief returns the number of images written so far
+ */
+int DebugImageWriter::Written()
+{
+	pthread_mutex_lock(&mutex);
+	int count = written;
+	pthread_mutex_unlock(&mutex);
+	return(count);
+}
+
+/*!
+ * \brief returns the number of images discarded by the rate limit or because the queue was full
+ */
+int DebugImageWriter::Dropped()
+{
+	pthread_mutex_lock(&mutex);
+	int count = dropped;
+	pthread_mutex_unlock(&mutex);
+	return(count);
+}
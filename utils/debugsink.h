@@ -0,0 +1,143 @@
+/*
+    asynchronous output of debugging images
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DEBUGSINK_H_
+#define DEBUGSINK_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include "bitmap.h"
+
+// default number of images waiting to be written before further images are dropped
+#define DEBUG_SINK_QUEUE_LENGTH  16
+
+/*!
+ * \brief receives debugging images produced during detection
+ *
+ * When a sink has been installed with Set, shapes::DetectSquaresMono sends
+ * its debugging images to it rather than returning them to the caller.
+ * Implementations must be safe to call from several threads at once.
+ */
+class DebugSink
+{
+private:
+	static DebugSink* current;
+
+public:
+	virtual ~DebugSink() {}
+
+	static void Set(DebugSink* sink);
+	static DebugSink* Current();
+
+	/*!
+	 * \brief returns false if an image added now would be discarded, so that
+	 *        producers can avoid creating it
+	 */
+	virtual bool Accepting() = 0;
+
+	/*!
+	 * \brief takes ownership of an image allocated with new[]
+	 * \param img image data, BGR if channels is 3 or mono if channels is 1
+	 * \param width width of the image
+	 * \param height height of the image
+	 * \param channels bytes per pixel
+	 * \param name short description of the image
+	 */
+	virtual void Add(unsigned char* img, int width, int height, int channels, std::string name) = 0;
+
+	virtual void Copy(const unsigned char* img, int width, int height, int channels, std::string name);
+};
+
+/*!
+ * \brief an image waiting to be written by DebugImageWriter
+ */
+struct debug_frame
+{
+	unsigned char* img;
+	int width;
+	int height;
+	int channels;
+	std::string filename;
+
+	// false if the image is still to be decimated
+	bool decimated;
+};
+
+/*!
+ * \brief writes debugging images as PPM or PGM files on a background thread
+ *
+ * Images are optionally decimated, keeping every nth pixel in each
+ * direction, and limited to a maximum number per second.  Images which
+ * exceed the rate limit, or which arrive while the queue is full, are
+ * discarded rather than delaying detection.
+ */
+class DebugImageWriter : public DebugSink
+{
+private:
+	std::string prefix;
+	int decimation;
+	int maximum_per_second;
+	int queue_length;
+
+	std::deque<debug_frame> queue;
+	bool writing;
+	bool stopping;
+	int frame_number;
+	int written;
+	int dropped;
+
+	// images accepted within the current second
+	time_t rate_second;
+	int rate_count;
+
+	pthread_t writer;
+	pthread_mutex_t mutex;
+	pthread_cond_t frame_added;
+	pthread_cond_t frame_written;
+
+	static void* WriterThread(void* writer);
+	void Write();
+	bool Admit(bool consume);
+	void Enqueue(unsigned char* img, int width, int height, int channels, std::string name, bool decimated);
+
+public:
+	DebugImageWriter(
+	    std::string prefix,
+	    int decimation,
+	    int maximum_per_second,
+	    int queue_length);
+	~DebugImageWriter();
+
+	bool Accepting();
+	void Add(unsigned char* img, int width, int height, int channels, std::string name);
+	void Copy(const unsigned char* img, int width, int height, int channels, std::string name);
+
+	void Flush();
+	int Written();
+	int Dropped();
+};
+
+#endif /* DEBUGSINK_H_ */
@@ -0,0 +1,310 @@
+/*
+    watches a directory for new image files
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "directorywatcher.h"
+
+DirectoryWatcher::DirectoryWatcher()
+{
+	fd = -1;
+	recursive = false;
+	buffer = new char[DIRECTORY_WATCHER_BUFFER];
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	Stop();
+	delete[] buffer;
+}
+
+/*!
+ * \brief starts watching a directory
+ * \param directory the directory to be watched
+ * \param recursive also watch subdirectories, including any created later
+ * \return false if the directory could not be watched
+ */
+bool DirectoryWatcher::Start(
+    std::string directory,
+    bool recursive)
+{
+	Stop();
+
+	this->directory = directory;
+	this->recursive = recursive;
+
+	fd = inotify_init();
+	if (fd < 0)
+	{
+		cout << "Error " << errno << " initialising inotify" << endl;
+		return(false);
+	}
+
+	if (!AddWatch(""))
+	{
+		Stop();
+		return(false);
+	}
+
+	if (recursive)
+	{
+		// watch the existing subdirectories, but not the images already within them
+		std::vector<std::string> subdirectories;
+		subdirectories.push_back("");
+		for (int i = 0; i < (int)subdirectories.size(); i++)
+		{
+			std::string path = directory;
+			if (subdirectories[i] != "") path += "/" + subdirectories[i];
+			DIR *dp = opendir(path.c_str());
+			if (dp == NULL) continue;
+			struct dirent *dirp;
+			while ((dirp = readdir(dp)) != NULL)
+			{
+				std::string name = dirp->d_name;
+				if ((name == ".") || (name == "..")) continue;
+				if (imagefiles::IsDirectory(path, dirp))
+				{
+					std::string relative = name;
+					if (subdirectories[i] != "") relative = subdirectories[i] + "/" + name;
+					if (AddWatch(relative)) subdirectories.push_back(relative);
+				}
+			}
+			closedir(dp);
+		}
+	}
+	return(true);
+}
+
+/*!
+ * \brief stops watching
+ */
+void DirectoryWatcher::Stop()
+{
+	if (fd >= 0) close(fd);
+	fd = -1;
+	watches.clear();
+	listed.clear();
+}
+
+/*!
+ * \brief adds an inotify watch for the given subdirectory
+ * \param relative subdirectory relative to the watched directory, or empty for the directory itself
+ * \return false if the watch could not be added
+ */
+bool DirectoryWatcher::AddWatch(std::string relative)
+{
+	std::string path = directory;
+	if (relative != "") path += "/" + relative;
+
+	int wd = inotify_add_watch(
+	    fd, path.c_str(),
+	    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+	    IN_DELETE_SELF | IN_MOVE_SELF);
+	if (wd < 0)
+	{
+		cout << "Error " << errno << " watching " << path << endl;
+		return(false);
+	}
+	watches[wd] = relative;
+	return(true);
+}
+
+/*!
+ * \brief watches a subdirectory which has appeared, and any within it.
+ *        Images which were written before the watches were added are
+ *        found by listing the subdirectory.
+ * \param relative subdirectory relative to the watched directory
+ * \param filenames list to which the images found are added
+ */
+void DirectoryWatcher::AddSubdirectory(
+    std::string relative,
+    std::vector<std::string> &filenames)
+{
+	if (!AddWatch(relative)) return;
+
+	std::string path = directory + "/" + relative;
+	DIR *dp = opendir(path.c_str());
+	if (dp == NULL) return;
+	std::vector<std::string> subdirectories;
+	struct dirent *dirp;
+	while ((dirp = readdir(dp)) != NULL)
+	{
+		std::string name = dirp->d_name;
+		if ((name == ".") || (name == "..")) continue;
+		if (imagefiles::IsDirectory(path, dirp))
+		{
+			subdirectories.push_back(relative + "/" + name);
+		}
+		else
+		{
+			if (imagefiles::IsImage(name))
+			{
+				// the image may still be open for writing, in which case
+				// the event when it is closed reports it again
+				directory_watcher_file file;
+				filenames.push_back(relative + "/" + name);
+				if (Status(relative + "/" + name, file))
+					listed[relative + "/" + name] = file;
+			}
+		}
+	}
+	closedir(dp);
+
+	for (int i = 0; i < (int)subdirectories.size(); i++)
+		AddSubdirectory(subdirectories[i], filenames);
+}
+
+/*!
+ * \brief returns the size and modification time of an image
+ * \param relative filename relative to the watched directory
+ * \param file returned size and modification time
+ * \return false if the file could not be found
+ */
+bool DirectoryWatcher::Status(
+    std::string relative,
+    directory_watcher_file &file)
+{
+	struct stat file_status;
+	if (stat((directory + "/" + relative).c_str(), &file_status) != 0) return(false);
+	file.size = file_status.st_size;
+	file.modified = file_status.st_mtim;
+	return(true);
+}
+
+/*!
+ * \brief forgets the listed images at or below the given path, which has
+ *        been removed or moved away
+ * \param relative file or subdirectory relative to the watched directory
+ */
+void DirectoryWatcher::Forget(
+    std::string relative)
+{
+	listed.erase(relative);
+	std::string prefix = relative + "/";
+	std::map<std::string, directory_watcher_file>::iterator it = listed.lower_bound(prefix);
+	while ((it != listed.end()) && (it->first.compare(0, prefix.size(), prefix) == 0))
+		listed.erase(it++);
+}
+
+/*!
+ * \brief waits for new images
+ * \param filenames returned images, relative to the watched directory, in the order in which they arrived
+ * \param timeout_mSec maximum time to wait in milliseconds, or -1 to wait indefinitely
+ * \return false if the directory is no longer being watched
+ */
+bool DirectoryWatcher::Next(
+    std::vector<std::string> &filenames,
+    int timeout_mSec)
+{
+	filenames.clear();
+	if (fd < 0) return(false);
+
+	while ((int)filenames.size() == 0)
+	{
+		struct pollfd descriptor;
+		descriptor.fd = fd;
+		descriptor.events = POLLIN;
+		descriptor.revents = 0;
+		int ready = poll(&descriptor, 1, timeout_mSec);
+		if (ready < 0)
+		{
+			if (errno == EINTR) continue;
+			return(false);
+		}
+		if (ready == 0) return(true);
+
+		int length = (int)read(fd, buffer, DIRECTORY_WATCHER_BUFFER);
+		if (length <= 0)
+		{
+			if ((length < 0) && (errno == EINTR)) continue;
+			return(false);
+		}
+
+		int i = 0;
+		while (i < length)
+		{
+			struct inotify_event *event = (struct inotify_event*)&buffer[i];
+			i += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				cout << "Too many files arrived at once in " << directory << ", some may have been missed" << endl;
+				continue;
+			}
+
+			std::map<int, std::string>::iterator watch = watches.find(event->wd);
+			if (watch == watches.end()) continue;
+
+			if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			{
+				if (watch->second == "")
+				{
+					cout << directory << " is no longer available" << endl;
+					Stop();
+					return((int)filenames.size() > 0);
+				}
+				if (event->mask & IN_IGNORED)
+				{
+					Forget(watch->second);
+					watches.erase(watch);
+				}
+				continue;
+			}
+
+			if (event->len == 0) continue;
+			std::string name = event->name;
+			std::string relative = name;
+			if (watch->second != "") relative = watch->second + "/" + name;
+
+			if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				Forget(relative);
+				continue;
+			}
+
+			if (event->mask & IN_ISDIR)
+			{
+				if ((recursive) && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+					AddSubdirectory(relative, filenames);
+			}
+			else
+			{
+				if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+					(imagefiles::IsImage(name)))
+				{
+					// skip the event for an image already returned by listing
+					// its subdirectory, unless it has changed since then
+					bool unchanged = false;
+					std::map<std::string, directory_watcher_file>::iterator previous = listed.find(relative);
+					if (previous != listed.end())
+					{
+						directory_watcher_file file;
+						if (Status(relative, file))
+							unchanged =
+								(file.size == previous->second.size) &&
+								(file.modified.tv_sec == previous->second.modified.tv_sec) &&
+								(file.modified.tv_nsec == previous->second.modified.tv_nsec);
+						listed.erase(previous);
+					}
+					if (!unchanged) filenames.push_back(relative);
+				}
+			}
+		}
+	}
+	return(true);
+}
@@ -0,0 +1,92 @@
+/*
+    watches a directory for new image files
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DIRECTORYWATCHER_H_
+#define DIRECTORYWATCHER_H_
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/stat.h>
+#include "imagefiles.h"
+using namespace std;
+
+// size of the buffer into which inotify events are read
+#define DIRECTORY_WATCHER_BUFFER  65536
+
+/*!
+ * \brief size and modification time of an image when it was reported
+ */
+struct directory_watcher_file
+{
+	off_t size;
+	struct timespec modified;
+};
+
+/*!
+ * \brief reports image files as they are written into a directory,
+ *        and optionally into any of its subdirectories, using inotify
+ *
+ * A file is reported once it has been closed after writing, or once it has
+ * been moved into the directory, so that partially written files are not
+ * returned.  Subdirectories created while watching are watched in turn, and
+ * any images which arrived in them before the watch was added are found by
+ * listing the new subdirectory.  Filenames are relative to the directory.
+ */
+class DirectoryWatcher
+{
+private:
+	int fd;
+	std::string directory;
+	bool recursive;
+
+	// subdirectory, relative to the watched directory, for each watch descriptor
+	std::map<int, std::string> watches;
+
+	// images returned by listing new subdirectories, with their size and
+	// modification time when listed.  A later event for the same file is
+	// only ignored if the file has not changed since it was returned.
+	// Entries are removed on that event, or when the file disappears.
+	std::map<std::string, directory_watcher_file> listed;
+
+	char* buffer;
+
+	bool AddWatch(std::string relative);
+	void AddSubdirectory(std::string relative, std::vector<std::string> &filenames);
+	bool Status(std::string relative, directory_watcher_file &file);
+	void Forget(std::string relative);
+
+public:
+	DirectoryWatcher();
+	~DirectoryWatcher();
+
+	bool Start(std::string directory, bool recursive);
+	void Stop();
+	bool Next(std::vector<std::string> &filenames, int timeout_mSec);
+	int Listed() { return((int)listed.size()); }
+};
+
+#endif /* DIRECTORYWATCHER_H_ */
@@ -0,0 +1,308 @@
+/*
+    reading a continuous sequence of frames from a stream
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "framestream.h"
+
+FrameStream::FrameStream()
+{
+	file = NULL;
+	close_file = false;
+	format = FRAMESTREAM_RAW_BGR24;
+	chroma = Y4M_CHROMA_420;
+	frame_bytes = 0;
+	raw = NULL;
+	Data = NULL;
+	Width = 0;
+	Height = 0;
+}
+
+FrameStream::~FrameStream()
+{
+	Close();
+}
+
+/*!
+ * \brief opens a stream of frames
+ * \param filename file or named pipe to read from, or "-" for stdin
+ * \param width width of raw BGR frames, or zero if the stream is in y4m format
+ * \param height height of raw BGR frames, or zero if the stream is in y4m format
+ * \return true if the stream was opened
+ */
+bool FrameStream::Open(
+    std::string filename,
+    int width,
+    int height)
+{
+	bool opened = false;
+
+	Close();
+
+	if (filename == "-")
+	{
+		file = stdin;
+		close_file = false;
+	}
+	else
+	{
+		file = fopen(filename.c_str(), "rb");
+		close_file = true;
+	}
+
+	if (file == NULL)
+	{
+		cout << "Cannot open stream " << filename << endl;
+	}
+	else
+	{
+		if ((width > 0) && (height > 0))
+		{
+			if ((long long)width * (long long)height > FRAMESTREAM_MAX_PIXELS)
+			{
+				cout << "Frame size " << width << "x" << height << " is too large" << endl;
+			}
+			else
+			{
+				format = FRAMESTREAM_RAW_BGR24;
+				Width = width;
+				Height = height;
+				frame_bytes = Width * Height * 3;
+				opened = true;
+			}
+		}
+		else
+		{
+			format = FRAMESTREAM_Y4M;
+			opened = ReadY4MHeader();
+			if (opened)
+			{
+				int chroma_width = (Width + 1) / 2;
+				int chroma_height = (Height + 1) / 2;
+				switch(chroma)
+				{
+				    case Y4M_CHROMA_420: { frame_bytes = (Width * Height) + (chroma_width * chroma_height * 2); break; }
+				    case Y4M_CHROMA_444: { frame_bytes = Width * Height * 3; break; }
+				    case Y4M_CHROMA_MONO: { frame_bytes = Width * Height; break; }
+				}
+				raw = new unsigned char[frame_bytes];
+			}
+		}
+
+		if (opened)
+			Data = new unsigned char[Width * Height * 3];
+		else
+			Close();
+	}
+
+	return(opened);
+}
+
+/*!
+ * \brief closes the stream and releases buffers
+ */
+void FrameStream::Close()
+{
+	if ((file != NULL) && (close_file)) fclose(file);
+	file = NULL;
+	if (raw != NULL) delete[] raw;
+	raw = NULL;
+	if (Data != NULL) delete[] Data;
+	Data = NULL;
+}
+
+/*!
+ * \brief reads a single line of text, excluding the terminating newline
+ * \param line returned text
+ * \return true if a complete line was read
+ */
+bool FrameStream::ReadLine(std::string &line)
+{
+	line = "";
+	int c = fgetc(file);
+	while ((c != EOF) && (c != '\n'))
+	{
+		line += (char)c;
+		c = fgetc(file);
+	}
+	return(c == '\n');
+}
+
+/*!
+ * \brief parses the y4m stream header
+ * \return true if the header describes a supported stream
+ */
+bool FrameStream::ReadY4MHeader()
+{
+	bool valid = false;
+	std::string header;
+
+	if (!ReadLine(header))
+	{
+		cout << "Stream ended before a y4m header was found" << endl;
+	}
+	else
+	{
+		if (header.substr(0, 9) != "YUV4MPEG2")
+		{
+			cout << "Not a y4m stream.  Use --width and --height for raw BGR frames" << endl;
+		}
+		else
+		{
+			Width = 0;
+			Height = 0;
+			chroma = Y4M_CHROMA_420;
+			valid = true;
+
+			size_t start = 9;
+			while (start < header.size())
+			{
+				size_t end = header.find(' ', start + 1);
+				if (end == std::string::npos) end = header.size();
+				std::string token = header.substr(start + 1, end - start - 1);
+				if (token.size() > 0)
+				{
+					std::string value = token.substr(1);
+					switch(token[0])
+					{
+					    case 'W': { Width = atoi(value.c_str()); break; }
+					    case 'H': { Height = atoi(value.c_str()); break; }
+					    case 'C':
+					    {
+					    	if (value.substr(0, 3) == "420")
+					    		chroma = Y4M_CHROMA_420;
+					    	else if (value.substr(0, 3) == "444")
+					    		chroma = Y4M_CHROMA_444;
+					    	else if (value.substr(0, 4) == "mono")
+					    		chroma = Y4M_CHROMA_MONO;
+					    	else
+					    	{
+					    		cout << "Unsupported y4m colour space " << value << endl;
+					    		valid = false;
+					    	}
+					    	break;
+					    }
+					}
+				}
+				start = end;
+			}
+
+			if ((Width <= 0) || (Height <= 0) ||
+				((long long)Width * (long long)Height > FRAMESTREAM_MAX_PIXELS))
+			{
+				cout << "Invalid y4m frame size " << Width << "x" << Height << endl;
+				valid = false;
+			}
+		}
+	}
+	return(valid);
+}
+
+/*!
+ * \brief converts the current y4m frame into BGR
+ */
+void FrameStream::ConvertY4M()
+{
+	unsigned char* luma = raw;
+	int n = 0;
+
+	if (chroma == Y4M_CHROMA_MONO)
+	{
+		for (int i = 0; i < Width * Height; i++, n += 3)
+		{
+			Data[n] = luma[i];
+			Data[n + 1] = luma[i];
+			Data[n + 2] = luma[i];
+		}
+		return;
+	}
+
+	int chroma_width = Width;
+	int chroma_shift = 0;
+	int chroma_pixels = Width * Height;
+	if (chroma == Y4M_CHROMA_420)
+	{
+		chroma_width = (Width + 1) / 2;
+		chroma_shift = 1;
+		chroma_pixels = chroma_width * ((Height + 1) / 2);
+	}
+	unsigned char* u_plane = luma + (Width * Height);
+	unsigned char* v_plane = u_plane + chroma_pixels;
+
+	// ITU-R BT.601 studio range to RGB, in 8 bit fixed point
+	for (int y = 0; y < Height; y++)
+	{
+		int chroma_row = (y >> chroma_shift) * chroma_width;
+		for (int x = 0; x < Width; x++, n += 3)
+		{
+			int c = luma[(y * Width) + x] - 16;
+			int i = chroma_row + (x >> chroma_shift);
+			int d = u_plane[i] - 128;
+			int e = v_plane[i] - 128;
+
+			int r = ((298 * c) + (409 * e) + 128) >> 8;
+			int g = ((298 * c) - (100 * d) - (208 * e) + 128) >> 8;
+			int b = ((298 * c) + (516 * d) + 128) >> 8;
+			if (r < 0) r = 0;
+			if (r > 255) r = 255;
+			if (g < 0) g = 0;
+			if (g > 255) g = 255;
+			if (b < 0) b = 0;
+			if (b > 255) b = 255;
+
+			Data[n] = (unsigned char)b;
+			Data[n + 1] = (unsigned char)g;
+			Data[n + 2] = (unsigned char)r;
+		}
+	}
+}
+
+/*!
+ * \brief reads the next frame into Data, blocking until it is available
+ * \return false at the end of the stream
+ */
+bool FrameStream::ReadFrame()
+{
+	bool success = false;
+	if (file != NULL)
+	{
+		if (format == FRAMESTREAM_RAW_BGR24)
+		{
+			success = (fread(Data, 1, frame_bytes, file) == (size_t)frame_bytes);
+		}
+		else
+		{
+			std::string frame_header;
+			if (ReadLine(frame_header))
+			{
+				if (frame_header.substr(0, 5) != "FRAME")
+				{
+					cout << "Malformed y4m frame header" << endl;
+				}
+				else
+				{
+					if (fread(raw, 1, frame_bytes, file) == (size_t)frame_bytes)
+					{
+						ConvertY4M();
+						success = true;
+					}
+				}
+			}
+		}
+	}
+	return(success);
+}
@@ -0,0 +1,73 @@
+/*
+    reading a continuous sequence of frames from a stream
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMESTREAM_H_
+#define FRAMESTREAM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#define FRAMESTREAM_RAW_BGR24   0
+#define FRAMESTREAM_Y4M         1
+
+#define Y4M_CHROMA_420          0
+#define Y4M_CHROMA_444          1
+#define Y4M_CHROMA_MONO         2
+
+// largest frame accepted, so that frame sizes in bytes fit an int
+#define FRAMESTREAM_MAX_PIXELS  (8192 * 8192)
+
+/*!
+ * \brief reads frames from stdin, a named pipe or a file
+ *
+ * Two formats are supported: raw 24 bit BGR frames of a known size,
+ * and YUV4MPEG2 (y4m) streams which are converted to BGR.
+ * Frames are returned top row first, in the same layout as Bitmap::Data.
+ */
+class FrameStream
+{
+private:
+	FILE* file;
+	bool close_file;
+	int format;
+	int chroma;
+	int frame_bytes;
+	unsigned char* raw;
+
+	bool ReadLine(std::string &line);
+	bool ReadY4MHeader();
+	void ConvertY4M();
+
+public:
+	int Width, Height;
+	unsigned char* Data;    // BGR image data for the current frame
+
+	FrameStream();
+	~FrameStream();
+
+	bool Open(std::string filename, int width, int height);
+	bool ReadFrame();
+	void Close();
+};
+
+#endif /* FRAMESTREAM_H_ */
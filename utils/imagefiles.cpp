@@ -0,0 +1,123 @@
+/*
+    listing of image files within a directory
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "imagefiles.h"
+
+/*!
+ * \brief returns true if the filename has a bitmap or jpeg extension
+ * \param filename name of the file
+ */
+bool imagefiles::IsImage(std::string filename)
+{
+	const char* extensions[] = { ".bmp", ".BMP", ".jpg", ".JPG", ".jpeg", ".JPEG" };
+
+	for (int i = 0; i < 6; i++)
+	{
+		int length = (int)strlen(extensions[i]);
+		if (((int)filename.size() > length) &&
+			(filename.compare(filename.size() - length, length, extensions[i]) == 0))
+			return(true);
+	}
+	return(false);
+}
+
+/*!
+ * \brief returns true if a directory entry is itself a directory.  The type
+ *        given by readdir is used where the file system supplies it, so that
+ *        files do not need to be examined individually.
+ * \param dir directory containing the entry
+ * \param entry the directory entry
+ */
+bool imagefiles::IsDirectory(
+    std::string dir,
+    struct dirent *entry)
+{
+	if (entry->d_type == DT_DIR) return(true);
+	if (entry->d_type != DT_UNKNOWN) return(false);
+
+	struct stat file_status;
+	std::string path = dir + "/" + entry->d_name;
+	if (stat(path.c_str(), &file_status) != 0) return(false);
+	return(S_ISDIR(file_status.st_mode));
+}
+
+/*!
+ * \brief returns a sorted list of the image files within a directory
+ * \param dir directory
+ * \param recursive also include images within subdirectories
+ * \param filenames returned filenames, relative to the directory
+ * \return false if the directory could not be opened
+ */
+bool imagefiles::List(
+    std::string dir,
+    bool recursive,
+    std::vector<std::string> &filenames)
+{
+	filenames.clear();
+	bool opened = List(dir, "", recursive, filenames);
+	std::sort(filenames.begin(), filenames.end());
+	return(opened);
+}
+
+/*!
+ * \brief adds the image files within a directory to a list
+ * \param dir top level directory
+ * \param relative subdirectory being searched, relative to the top level directory, or empty
+ * \param recursive also include images within subdirectories
+ * \param filenames list to which filenames are added, relative to the top level directory
+ * \return false if the directory could not be opened
+ */
+bool imagefiles::List(
+    std::string dir,
+    std::string relative,
+    bool recursive,
+    std::vector<std::string> &filenames)
+{
+	std::string path = dir;
+	if (relative != "") path += "/" + relative;
+
+	DIR *dp = opendir(path.c_str());
+	if (dp == NULL)
+	{
+		cout << "Error " << errno << " opening " << path << endl;
+		return(false);
+	}
+
+	struct dirent *dirp;
+	while ((dirp = readdir(dp)) != NULL)
+	{
+		std::string filename = dirp->d_name;
+		if ((filename == ".") || (filename == "..")) continue;
+
+		std::string relative_filename = filename;
+		if (relative != "") relative_filename = relative + "/" + filename;
+
+		if ((recursive) && (IsDirectory(path, dirp)))
+		{
+			List(dir, relative_filename, recursive, filenames);
+		}
+		else
+		{
+			if (IsImage(filename)) filenames.push_back(relative_filename);
+		}
+	}
+	closedir(dp);
+	return(true);
+}
@@ -0,0 +1,60 @@
+/*
+    listing of image files within a directory
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef IMAGEFILES_H_
+#define IMAGEFILES_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+/*!
+ * \brief finds the bitmap and jpeg images within a directory
+ */
+class imagefiles
+{
+private:
+	static bool List(
+	    std::string dir,
+	    std::string relative,
+	    bool recursive,
+	    std::vector<std::string> &filenames);
+
+public:
+	static bool IsImage(std::string filename);
+
+	static bool IsDirectory(
+	    std::string dir,
+	    struct dirent *entry);
+
+	static bool List(
+	    std::string dir,
+	    bool recursive,
+	    std::vector<std::string> &filenames);
+};
+
+#endif /* IMAGEFILES_H_ */
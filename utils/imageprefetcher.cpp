@@ -0,0 +1,188 @@
+/*
+    asynchronous image prefetching
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imageprefetcher.h"
+
+/*!
+ * \brief starts loading the given files
+ * \param filenames files to be loaded, in the order that they will be returned
+ * \param queue_depth maximum number of images held in memory
+ * \param no_of_readers number of threads loading images
+ */
+ImagePrefetcher::ImagePrefetcher(
+    std::vector<std::string> &filenames,
+    int queue_depth,
+    int no_of_readers)
+{
+	if (queue_depth < 1) queue_depth = 1;
+	if (no_of_readers < 1) no_of_readers = 1;
+	if (no_of_readers > queue_depth) no_of_readers = queue_depth;
+
+	this->filenames = filenames;
+	this->queue_depth = queue_depth;
+	this->no_of_readers = no_of_readers;
+	next_to_load = 0;
+	next_to_return = 0;
+	stopping = false;
+
+	slots = new prefetch_slot[queue_depth];
+	for (int i = 0; i < queue_depth; i++)
+	{
+		slots[i].state = PREFETCH_EMPTY;
+		slots[i].index = -1;
+		slots[i].loaded = false;
+		slots[i].bmp = new Bitmap();
+		slots[i].buffer = NULL;
+		slots[i].buffer_size = 0;
+		slots[i].is_jpeg = false;
+		slots[i].jpeg = new JpegDecoder();
+	}
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&slot_freed, NULL);
+	pthread_cond_init(&slot_ready, NULL);
+
+	readers = new pthread_t[no_of_readers];
+	for (int t = 0; t < no_of_readers; t++)
+		pthread_create(&readers[t], NULL, ReaderThread, this);
+}
+
+/*!
+ * \brief stops the reader threads and frees all images
+ */
+ImagePrefetcher::~ImagePrefetcher()
+{
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&slot_freed);
+	pthread_mutex_unlock(&mutex);
+
+	for (int t = 0; t < no_of_readers; t++)
+		pthread_join(readers[t], NULL);
+	delete[] readers;
+
+	for (int i = 0; i < queue_depth; i++)
+	{
+		delete slots[i].bmp;
+		delete slots[i].jpeg;
+		if (slots[i].buffer != NULL) delete[] slots[i].buffer;
+	}
+	delete[] slots;
+
+	pthread_cond_destroy(&slot_ready);
+	pthread_cond_destroy(&slot_freed);
+	pthread_mutex_destroy(&mutex);
+}
+
+void* ImagePrefetcher::ReaderThread(void* prefetcher)
+{
+	((ImagePrefetcher*)prefetcher)->Load();
+	return(NULL);
+}
+
+/*!
+ * \brief loads files into empty slots until all files have been loaded
+ */
+void ImagePrefetcher::Load()
+{
+	while (true)
+	{
+		pthread_mutex_lock(&mutex);
+		prefetch_slot* slot = NULL;
+		while ((!stopping) && (next_to_load < (int)filenames.size()))
+		{
+			for (int i = 0; i < queue_depth; i++)
+			{
+				if (slots[i].state == PREFETCH_EMPTY)
+				{
+					slot = &slots[i];
+					break;
+				}
+			}
+			if (slot != NULL) break;
+			pthread_cond_wait(&slot_freed, &mutex);
+		}
+		if (slot == NULL)
+		{
+			pthread_mutex_unlock(&mutex);
+			break;
+		}
+		slot->state = PREFETCH_LOADING;
+		slot->index = next_to_load++;
+		pthread_mutex_unlock(&mutex);
+
+		slot->is_jpeg = JpegDecoder::IsJpeg(filenames[slot->index]);
+		if (slot->is_jpeg)
+			slot->loaded = slot->jpeg->Load(filenames[slot->index]);
+		else
+			slot->loaded = slot->bmp->FromFile(filenames[slot->index], slot->buffer, slot->buffer_size);
+
+		pthread_mutex_lock(&mutex);
+		slot->state = PREFETCH_READY;
+		pthread_cond_broadcast(&slot_ready);
+		pthread_mutex_unlock(&mutex);
+	}
+}
+
+/*!
+ * \brief waits for the next image in filename order
+ * \return slot containing the image, which should be passed to Release
+ *         once it is no longer needed, or NULL if no files remain
+ */
+prefetch_slot* ImagePrefetcher::Next()
+{
+	pthread_mutex_lock(&mutex);
+	if (next_to_return >= (int)filenames.size())
+	{
+		pthread_mutex_unlock(&mutex);
+		return(NULL);
+	}
+	int index = next_to_return++;
+
+	prefetch_slot* slot = NULL;
+	while (slot == NULL)
+	{
+		for (int i = 0; i < queue_depth; i++)
+		{
+			if ((slots[i].index == index) && (slots[i].state == PREFETCH_READY))
+			{
+				slot = &slots[i];
+				break;
+			}
+		}
+		if (slot == NULL) pthread_cond_wait(&slot_ready, &mutex);
+	}
+	slot->state = PREFETCH_IN_USE;
+	pthread_mutex_unlock(&mutex);
+
+	return(slot);
+}
+
+/*!
+ * \brief returns a slot to the queue so that another file can be loaded into it
+ * \param slot slot returned by Next
+ */
+void ImagePrefetcher::Release(prefetch_slot* slot)
+{
+	pthread_mutex_lock(&mutex);
+	slot->state = PREFETCH_EMPTY;
+	slot->index = -1;
+	pthread_cond_broadcast(&slot_freed);
+	pthread_mutex_unlock(&mutex);
+}
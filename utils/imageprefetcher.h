@@ -0,0 +1,97 @@
+/*
+    asynchronous image prefetching
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPREFETCHER_H_
+#define IMAGEPREFETCHER_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "bitmap.h"
+#include "jpegdecoder.h"
+
+// state of each slot within the queue
+#define PREFETCH_EMPTY      0
+#define PREFETCH_LOADING    1
+#define PREFETCH_READY      2
+#define PREFETCH_IN_USE     3
+
+/*!
+ * \brief an image held within the prefetch queue
+ */
+struct prefetch_slot
+{
+	int state;
+
+	// index of the file within the list, or -1 if the slot is empty
+	int index;
+
+	// false if the file could not be loaded
+	bool loaded;
+
+	// Data points into buffer, which is reused by later files
+	Bitmap* bmp;
+	unsigned char* buffer;
+	int buffer_size;
+
+	// jpeg files are only entropy decoded into jpeg, rather than bmp,
+	// so that they can be rendered at whatever scale is needed
+	bool is_jpeg;
+	JpegDecoder* jpeg;
+};
+
+/*!
+ * \brief loads bitmaps on one or more reader threads ahead of the thread
+ *        which processes them
+ *
+ * At most queue_depth images are held at any time, including those which
+ * have been returned by Next and not yet released.  Images are returned
+ * in the same order as the list of filenames.
+ */
+class ImagePrefetcher
+{
+private:
+	std::vector<std::string> filenames;
+	prefetch_slot* slots;
+	int queue_depth;
+	int next_to_load;
+	int next_to_return;
+	bool stopping;
+
+	pthread_t* readers;
+	int no_of_readers;
+	pthread_mutex_t mutex;
+	pthread_cond_t slot_freed;
+	pthread_cond_t slot_ready;
+
+	static void* ReaderThread(void* prefetcher);
+	void Load();
+
+public:
+	ImagePrefetcher(
+	    std::vector<std::string> &filenames,
+	    int queue_depth,
+	    int no_of_readers);
+	~ImagePrefetcher();
+
+	prefetch_slot* Next();
+	void Release(prefetch_slot* slot);
+};
+
+#endif /* IMAGEPREFETCHER_H_ */
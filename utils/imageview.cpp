@@ -0,0 +1,109 @@
+/*
+    strided image views
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "imageview.h"
+
+/*!
+ * \brief returns a view of a tightly packed image with the top row first
+ * \param data image data
+ * \param width width of the image
+ * \param height height of the image
+ * \param channels bytes per pixel
+ */
+image_view imageview::Create(
+    unsigned char* data,
+    int width, int height,
+    int channels)
+{
+	return(Create(data, width, height, width * channels, channels, IMAGE_VIEW_TOP_DOWN));
+}
+
+/*!
+ * \brief returns a view of an image with an arbitrary row stride
+ * \param data first byte of the first row stored in memory
+ * \param width width of the image
+ * \param height height of the image
+ * \param stride number of bytes between the starts of consecutive stored rows
+ * \param channels bytes per pixel
+ * \param row_order IMAGE_VIEW_TOP_DOWN or IMAGE_VIEW_BOTTOM_UP
+ */
+image_view imageview::Create(
+    unsigned char* data,
+    int width, int height,
+    int stride,
+    int channels,
+    int row_order)
+{
+	image_view img;
+	img.data = data;
+	img.width = width;
+	img.height = height;
+	img.stride = stride;
+	img.channels = channels;
+	img.row_order = row_order;
+	return(img);
+}
+
+/*!
+ * \brief returns a view of a rectangular region without copying any pixels
+ * \param img image containing the region
+ * \param tx top left x coordinate
+ * \param ty top left y coordinate
+ * \param bx bottom right x coordinate (exclusive)
+ * \param by bottom right y coordinate (exclusive)
+ * \return view of the region, clipped to the image
+ */
+image_view imageview::SubImage(
+    const image_view &img,
+    int tx, int ty,
+    int bx, int by)
+{
+	if (tx < 0) tx = 0;
+	if (ty < 0) ty = 0;
+	if (bx > img.width) bx = img.width;
+	if (by > img.height) by = img.height;
+	if (bx < tx) bx = tx;
+	if (by < ty) by = ty;
+
+	image_view sub = img;
+	sub.width = bx - tx;
+	sub.height = by - ty;
+
+	// the first stored row of a bottom up region is its lowest row
+	int first_row = ty;
+	if (img.row_order == IMAGE_VIEW_BOTTOM_UP)
+		first_row = img.height - by;
+
+	sub.data = img.data + (first_row * img.stride) + (tx * img.channels);
+	return(sub);
+}
+
+/*!
+ * \brief returns the given row, counting from the top of the image
+ * \param img image
+ * \param y row index
+ */
+unsigned char* imageview::Row(
+    const image_view &img,
+    int y)
+{
+	if (img.row_order == IMAGE_VIEW_BOTTOM_UP)
+		y = img.height - 1 - y;
+	return(img.data + (y * img.stride));
+}
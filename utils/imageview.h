@@ -0,0 +1,77 @@
+/*
+    strided image views
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEVIEW_H_
+#define IMAGEVIEW_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// order in which rows are stored in memory
+#define IMAGE_VIEW_TOP_DOWN     0
+#define IMAGE_VIEW_BOTTOM_UP    1
+
+/*!
+ * \brief image data which is not owned by the view, such as a padded
+ *        bitmap, a region of a larger image or a camera buffer
+ */
+struct image_view
+{
+	// first byte of the first row stored in memory
+	unsigned char* data;
+
+	int width;
+	int height;
+
+	// number of bytes from the start of one stored row to the next
+	int stride;
+
+	// bytes per pixel
+	int channels;
+
+	// IMAGE_VIEW_TOP_DOWN or IMAGE_VIEW_BOTTOM_UP
+	int row_order;
+};
+
+class imageview
+{
+public:
+	static image_view Create(
+	    unsigned char* data,
+	    int width, int height,
+	    int channels);
+
+	static image_view Create(
+	    unsigned char* data,
+	    int width, int height,
+	    int stride,
+	    int channels,
+	    int row_order);
+
+	static image_view SubImage(
+	    const image_view &img,
+	    int tx, int ty,
+	    int bx, int by);
+
+	static unsigned char* Row(
+	    const image_view &img,
+	    int y);
+};
+
+#endif /* IMAGEVIEW_H_ */
@@ -0,0 +1,886 @@
+/*
+    baseline jpeg decoder
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "jpegdecoder.h"
+
+// position of each zig-zag ordered coefficient within the 8x8 block
+static const int jpeg_zigzag[64] = {
+	 0,  1,  8, 16,  9,  2,  3, 10,
+	17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+JpegDecoder::JpegDecoder()
+{
+	Width = 0;
+	Height = 0;
+	no_of_components = 0;
+	restart_interval = 0;
+	max_h = 1;
+	max_v = 1;
+	mcus_x = 0;
+	mcus_y = 0;
+	data = NULL;
+	data_length = 0;
+	position = 0;
+	bit_buffer = 0;
+	bit_count = 0;
+	for (int i = 0; i < JPEG_MAX_COMPONENTS; i++)
+	{
+		components[i].coefficients = NULL;
+		planes[i] = NULL;
+		planes_size[i] = 0;
+	}
+	for (int i = 0; i < JPEG_HUFFMAN_TABLES; i++)
+	{
+		dc_tables[i].defined = false;
+		ac_tables[i].defined = false;
+	}
+	memset(quant_tables, 0, sizeof(quant_tables));
+
+	// basis functions for each output size, sampled at the centre of each output pixel
+	for (int level = 0; level < 4; level++)
+	{
+		int n = 1 << level;
+		for (int x = 0; x < n; x++)
+		{
+			for (int u = 0; u < n; u++)
+			{
+				float c = (u == 0) ? (float)(1.0 / sqrt(2.0)) : 1.0f;
+				basis[level][(x * n) + u] = 0.5f * c * (float)cos(((2 * x) + 1) * u * M_PI / (2.0 * n));
+			}
+		}
+	}
+}
+
+JpegDecoder::~JpegDecoder()
+{
+	Free();
+	for (int i = 0; i < JPEG_MAX_COMPONENTS; i++)
+		if (planes[i] != NULL) delete[] planes[i];
+}
+
+/*!
+ * \brief releases the coefficients of the current image
+ */
+void JpegDecoder::Free()
+{
+	for (int i = 0; i < JPEG_MAX_COMPONENTS; i++)
+	{
+		if (components[i].coefficients != NULL)
+		{
+			delete[] components[i].coefficients;
+			components[i].coefficients = NULL;
+		}
+	}
+	no_of_components = 0;
+	Width = 0;
+	Height = 0;
+}
+
+/*!
+ * \brief returns true if the data begins with a jpeg start of image marker
+ * \param file_data contents of the file
+ * \param length length of the data in bytes
+ */
+bool JpegDecoder::IsJpeg(const unsigned char* file_data, int length)
+{
+	return((length >= 2) && (file_data[0] == 0xFF) && (file_data[1] == 0xD8));
+}
+
+/*!
+ * \brief returns true if the file begins with a jpeg start of image marker
+ * \param filename name of the file
+ */
+bool JpegDecoder::IsJpeg(std::string filename)
+{
+	unsigned char header[2] = { 0, 0 };
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == NULL) return(false);
+	int bytes = (int)fread(header, 1, 2, file);
+	fclose(file);
+	return(IsJpeg(header, bytes));
+}
+
+/*!
+ * \brief loads and entropy decodes a jpeg file
+ * \param filename name of the file
+ * \return true if the image was decoded
+ */
+bool JpegDecoder::Load(std::string filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	struct stat file_status;
+	if ((fd < 0) || (fstat(fd, &file_status) != 0) || (file_status.st_size == 0))
+	{
+		cout << "File not found: " << filename << endl;
+		if (fd >= 0) close(fd);
+		return(false);
+	}
+
+	int file_length_bytes = (int)file_status.st_size;
+	unsigned char* file_data =
+		(unsigned char*)mmap(NULL, file_length_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file_data == MAP_FAILED)
+	{
+		cout << "Cannot map " << filename << endl;
+		return(false);
+	}
+	madvise(file_data, file_length_bytes, MADV_SEQUENTIAL);
+
+	bool loaded = Load(file_data, file_length_bytes);
+
+	munmap(file_data, file_length_bytes);
+	return(loaded);
+}
+
+/*!
+ * \brief parses and entropy decodes a jpeg image held in memory.  The data
+ *        is not needed once this returns.
+ * \param file_data contents of a jpeg file
+ * \param length length of the data in bytes
+ * \return true if the image was decoded
+ */
+bool JpegDecoder::Load(const unsigned char* file_data, int length)
+{
+	Free();
+	restart_interval = 0;
+	for (int i = 0; i < JPEG_HUFFMAN_TABLES; i++)
+	{
+		dc_tables[i].defined = false;
+		ac_tables[i].defined = false;
+	}
+
+	if (!IsJpeg(file_data, length))
+	{
+		cout << "Not a jpeg image" << endl;
+		return(false);
+	}
+
+	data = file_data;
+	data_length = length;
+	position = 2;
+	bool scanned = false;
+	bool ok = true;
+
+	while ((ok) && (position < data_length - 1))
+	{
+		// markers may be preceded by any number of fill bytes
+		if (data[position] != 0xFF)
+		{
+			position++;
+			continue;
+		}
+		int marker = data[position + 1];
+		position += 2;
+		if ((marker == 0xFF) || (marker == 0x00))
+		{
+			position--;
+			continue;
+		}
+		if (marker == 0xD9) break;
+		if ((marker >= 0xD0) && (marker <= 0xD7)) continue;
+
+		if (position + 2 > data_length)
+		{
+			ok = false;
+			break;
+		}
+		int segment_length = (data[position] << 8) | data[position + 1];
+		if ((segment_length < 2) || (position + segment_length > data_length))
+		{
+			cout << "Truncated jpeg segment" << endl;
+			ok = false;
+			break;
+		}
+		const unsigned char* segment = &data[position + 2];
+		segment_length -= 2;
+		position += segment_length + 2;
+
+		switch (marker)
+		{
+			case 0xC0:
+			case 0xC1:
+			{
+				ok = ReadFrameHeader(segment, segment_length);
+				break;
+			}
+			case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+			case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+			{
+				cout << "Only baseline jpeg images are supported" << endl;
+				ok = false;
+				break;
+			}
+			case 0xC4:
+			{
+				ok = ReadHuffmanTables(segment, segment_length);
+				break;
+			}
+			case 0xDB:
+			{
+				ok = ReadQuantisationTables(segment, segment_length);
+				break;
+			}
+			case 0xDD:
+			{
+				if (segment_length >= 2)
+					restart_interval = (segment[0] << 8) | segment[1];
+				break;
+			}
+			case 0xDA:
+			{
+				// the scan data follows the header, and ends at the next marker
+				ok = ReadScan(segment, segment_length);
+				scanned = ok;
+				break;
+			}
+		}
+	}
+
+	data = NULL;
+	data_length = 0;
+
+	if ((!ok) || (!scanned))
+	{
+		Free();
+		return(false);
+	}
+	return(true);
+}
+
+/*!
+ * \brief reads the SOF0/SOF1 segment and allocates the coefficient buffers
+ */
+bool JpegDecoder::ReadFrameHeader(const unsigned char* segment, int length)
+{
+	Free();
+	if (length < 6) return(false);
+	if (segment[0] != 8)
+	{
+		cout << "Only 8 bit jpeg images are supported" << endl;
+		return(false);
+	}
+	Height = (segment[1] << 8) | segment[2];
+	Width = (segment[3] << 8) | segment[4];
+	no_of_components = segment[5];
+	if ((Width == 0) || (Height == 0) ||
+		((no_of_components != 1) && (no_of_components != 3)) ||
+		(length < 6 + (no_of_components * 3)))
+	{
+		cout << "Unsupported jpeg frame" << endl;
+		no_of_components = 0;
+		return(false);
+	}
+	if ((long long)Width * (long long)Height > JPEG_MAX_PIXELS)
+	{
+		cout << "Jpeg frame is too large (" << Width << "x" << Height << ")" << endl;
+		no_of_components = 0;
+		return(false);
+	}
+
+	max_h = 1;
+	max_v = 1;
+	for (int c = 0; c < no_of_components; c++)
+	{
+		jpeg_component &component = components[c];
+		component.id = segment[6 + (c * 3)];
+		component.h = segment[7 + (c * 3)] >> 4;
+		component.v = segment[7 + (c * 3)] & 15;
+		component.quant_table = segment[8 + (c * 3)] & 3;
+		if ((component.h < 1) || (component.h > 4) ||
+			(component.v < 1) || (component.v > 4))
+		{
+			no_of_components = 0;
+			return(false);
+		}
+		if (component.h > max_h) max_h = component.h;
+		if (component.v > max_v) max_v = component.v;
+	}
+
+	mcus_x = (Width + (8 * max_h) - 1) / (8 * max_h);
+	mcus_y = (Height + (8 * max_v) - 1) / (8 * max_v);
+	for (int c = 0; c < no_of_components; c++)
+	{
+		jpeg_component &component = components[c];
+		if ((max_h % component.h != 0) || (max_v % component.v != 0))
+		{
+			cout << "Unsupported jpeg sampling factors" << endl;
+			no_of_components = 0;
+			return(false);
+		}
+		component.blocks_x = mcus_x * component.h;
+		component.blocks_y = mcus_y * component.v;
+		long long coefficients = (long long)component.blocks_x * (long long)component.blocks_y * 64;
+		component.coefficients = new short[coefficients];
+		memset(component.coefficients, 0, coefficients * sizeof(short));
+	}
+	return(true);
+}
+
+/*!
+ * \brief reads a DHT segment, which may contain several tables
+ */
+bool JpegDecoder::ReadHuffmanTables(const unsigned char* segment, int length)
+{
+	int i = 0;
+	while (i + 17 <= length)
+	{
+		int table_class = segment[i] >> 4;
+		int table_index = segment[i] & 15;
+		if (table_index >= JPEG_HUFFMAN_TABLES) return(false);
+		jpeg_huffman &table = (table_class == 0) ? dc_tables[table_index] : ac_tables[table_index];
+		table.defined = false;
+
+		int counts[17];
+		int total = 0;
+		for (int l = 1; l <= 16; l++)
+		{
+			counts[l] = segment[i + l];
+			total += counts[l];
+		}
+		i += 17;
+		if ((total > 256) || (i + total > length)) return(false);
+		memcpy(table.values, &segment[i], total);
+		i += total;
+
+		// canonical codes, as described in annex C of the standard
+		memset(table.lookup, 0, sizeof(table.lookup));
+		int code = 0;
+		int k = 0;
+		for (int l = 1; l <= 16; l++)
+		{
+			// too many codes of this length to be distinct
+			if (code + counts[l] > (1 << l))
+			{
+				cout << "Corrupt jpeg huffman table" << endl;
+				return(false);
+			}
+			table.valptr[l] = k;
+			table.mincode[l] = code;
+			for (int n = 0; n < counts[l]; n++, k++, code++)
+			{
+				if (l <= JPEG_LOOKUP_BITS)
+				{
+					int shift = JPEG_LOOKUP_BITS - l;
+					for (int fill = 0; fill < (1 << shift); fill++)
+						table.lookup[(code << shift) | fill] = (unsigned short)((l << 8) | table.values[k]);
+				}
+			}
+			table.maxcode[l] = (counts[l] > 0) ? code - 1 : -1;
+			code <<= 1;
+		}
+		table.maxcode[17] = 0x7FFFFFFF;
+		table.defined = true;
+	}
+	return(true);
+}
+
+/*!
+ * \brief reads a DQT segment, which may contain several tables
+ */
+bool JpegDecoder::ReadQuantisationTables(const unsigned char* segment, int length)
+{
+	int i = 0;
+	while (i < length)
+	{
+		int precision = segment[i] >> 4;
+		int table_index = segment[i] & 15;
+		i++;
+		if (table_index >= JPEG_QUANT_TABLES) return(false);
+		if (i + (64 * (precision + 1)) > length) return(false);
+		for (int k = 0; k < 64; k++)
+		{
+			if (precision == 0)
+				quant_tables[table_index][jpeg_zigzag[k]] = segment[i++];
+			else
+			{
+				quant_tables[table_index][jpeg_zigzag[k]] = (unsigned short)((segment[i] << 8) | segment[i + 1]);
+				i += 2;
+			}
+		}
+	}
+	return(true);
+}
+
+/*!
+ * \brief loads bytes of entropy coded data into the bit buffer.  Stuffed
+ *        zero bytes are removed, and zeros are supplied once a marker is reached.
+ */
+void JpegDecoder::FillBits()
+{
+	while (bit_count <= 24)
+	{
+		unsigned int byte = 0;
+		if (position < data_length)
+		{
+			byte = data[position];
+			if (byte == 0xFF)
+			{
+				int next = (position + 1 < data_length) ? data[position + 1] : 0xD9;
+				if (next == 0x00)
+					position += 2;
+				else
+					byte = 0;
+			}
+			else position++;
+		}
+		bit_buffer |= byte << (24 - bit_count);
+		bit_count += 8;
+	}
+}
+
+/*!
+ * \brief returns the given number of bits from the entropy coded data
+ */
+int JpegDecoder::GetBits(int bits)
+{
+	if (bits == 0) return(0);
+	if (bit_count < bits) FillBits();
+	int value = (int)(bit_buffer >> (32 - bits));
+	bit_buffer <<= bits;
+	bit_count -= bits;
+	return(value);
+}
+
+/*!
+ * \brief decodes one huffman coded value
+ */
+int JpegDecoder::DecodeHuffman(jpeg_huffman &table)
+{
+	if (bit_count < 16) FillBits();
+
+	int entry = table.lookup[bit_buffer >> (32 - JPEG_LOOKUP_BITS)];
+	if (entry != 0)
+	{
+		int bits = entry >> 8;
+		bit_buffer <<= bits;
+		bit_count -= bits;
+		return(entry & 255);
+	}
+
+	// codes longer than the lookup table
+	int code = (int)(bit_buffer >> (32 - JPEG_LOOKUP_BITS));
+	int l = JPEG_LOOKUP_BITS;
+	while ((l < 16) && (code > table.maxcode[l]))
+	{
+		l++;
+		code = (int)(bit_buffer >> (32 - l));
+	}
+	if (code > table.maxcode[l])
+	{
+		// corrupt data
+		bit_buffer <<= 16;
+		bit_count -= 16;
+		return(0);
+	}
+	int index = table.valptr[l] + code - table.mincode[l];
+	if ((index < 0) || (index > 255))
+	{
+		// corrupt data
+		bit_buffer <<= 16;
+		bit_count -= 16;
+		return(0);
+	}
+	bit_buffer <<= l;
+	bit_count -= l;
+	return(table.values[index]);
+}
+
+/*!
+ * \brief decodes the quantised coefficients of one 8x8 block
+ * \param component component to which the block belongs
+ * \param block returned coefficients in natural order
+ * \return false if the data is corrupt
+ */
+bool JpegDecoder::DecodeBlock(jpeg_component &component, short* block)
+{
+	// 8 bit samples give DC differences of at most 11 bits
+	int s = DecodeHuffman(dc_tables[component.dc_table]);
+	if (s > 11) return(false);
+	int diff = GetBits(s);
+	if ((s > 0) && (diff < (1 << (s - 1)))) diff -= (1 << s) - 1;
+	component.dc_prediction += diff;
+	if ((component.dc_prediction < -32768) || (component.dc_prediction > 32767))
+		return(false);
+	block[0] = (short)component.dc_prediction;
+
+	jpeg_huffman &ac = ac_tables[component.ac_table];
+	int k = 1;
+	while (k < 64)
+	{
+		int rs = DecodeHuffman(ac);
+		int r = rs >> 4;
+		s = rs & 15;
+		if (s == 0)
+		{
+			if (r != 15) break;
+			k += 16;
+		}
+		else
+		{
+			// and AC coefficients of at most 10 bits
+			if (s > 10) return(false);
+			k += r;
+			if (k > 63) break;
+			int value = GetBits(s);
+			if (value < (1 << (s - 1))) value -= (1 << s) - 1;
+			block[jpeg_zigzag[k]] = (short)value;
+			k++;
+		}
+	}
+	return(true);
+}
+
+/*!
+ * \brief skips the restart marker which follows each restart interval
+ */
+void JpegDecoder::Restart()
+{
+	bit_buffer = 0;
+	bit_count = 0;
+	while ((position < data_length - 1) &&
+		   (!((data[position] == 0xFF) && (data[position + 1] >= 0xD0) && (data[position + 1] <= 0xD7))))
+		position++;
+	if (position < data_length - 1) position += 2;
+	for (int c = 0; c < no_of_components; c++)
+		components[c].dc_prediction = 0;
+}
+
+/*!
+ * \brief reads a SOS segment and entropy decodes the scan which follows it
+ */
+bool JpegDecoder::ReadScan(const unsigned char* segment, int length)
+{
+	if ((no_of_components == 0) || (length < 1)) return(false);
+	int scan_components = segment[0];
+	if ((scan_components < 1) || (scan_components > no_of_components) ||
+		(length < 1 + (scan_components * 2)))
+		return(false);
+
+	jpeg_component* scan[JPEG_MAX_COMPONENTS];
+	for (int i = 0; i < scan_components; i++)
+	{
+		int id = segment[1 + (i * 2)];
+		scan[i] = NULL;
+		for (int c = 0; c < no_of_components; c++)
+			if (components[c].id == id) scan[i] = &components[c];
+		if (scan[i] == NULL) return(false);
+		scan[i]->dc_table = (segment[2 + (i * 2)] >> 4) & 3;
+		scan[i]->ac_table = segment[2 + (i * 2)] & 3;
+		if ((!dc_tables[scan[i]->dc_table].defined) ||
+			(!ac_tables[scan[i]->ac_table].defined))
+		{
+			cout << "Missing jpeg huffman table" << endl;
+			return(false);
+		}
+		scan[i]->dc_prediction = 0;
+	}
+
+	bit_buffer = 0;
+	bit_count = 0;
+
+	if (scan_components == 1)
+	{
+		// a non-interleaved scan covers only the blocks within the image
+		jpeg_component &component = *scan[0];
+		int component_width = ((Width * component.h) + max_h - 1) / max_h;
+		int component_height = ((Height * component.v) + max_v - 1) / max_v;
+		int blocks_x = (component_width + 7) / 8;
+		int blocks_y = (component_height + 7) / 8;
+		int count = 0;
+		for (int by = 0; by < blocks_y; by++)
+		{
+			for (int bx = 0; bx < blocks_x; bx++)
+			{
+				if ((restart_interval > 0) && (count > 0) && (count % restart_interval == 0))
+					Restart();
+				if (!DecodeBlock(component, &component.coefficients[((by * component.blocks_x) + bx) * 64]))
+				{
+					cout << "Corrupt jpeg data" << endl;
+					return(false);
+				}
+				count++;
+			}
+		}
+	}
+	else
+	{
+		int count = 0;
+		for (int my = 0; my < mcus_y; my++)
+		{
+			for (int mx = 0; mx < mcus_x; mx++)
+			{
+				if ((restart_interval > 0) && (count > 0) && (count % restart_interval == 0))
+					Restart();
+				for (int i = 0; i < scan_components; i++)
+				{
+					jpeg_component &component = *scan[i];
+					for (int v = 0; v < component.v; v++)
+					{
+						int by = (my * component.v) + v;
+						for (int h = 0; h < component.h; h++)
+						{
+							int bx = (mx * component.h) + h;
+							if (!DecodeBlock(component, &component.coefficients[((by * component.blocks_x) + bx) * 64]))
+							{
+								cout << "Corrupt jpeg data" << endl;
+								return(false);
+							}
+						}
+					}
+				}
+				count++;
+			}
+		}
+	}
+
+	// continue parsing from the marker which ends the scan
+	bit_buffer = 0;
+	bit_count = 0;
+	while ((position < data_length - 1) &&
+		   (!((data[position] == 0xFF) && (data[position + 1] != 0x00) &&
+		      ((data[position + 1] < 0xD0) || (data[position + 1] > 0xD7)))))
+		position++;
+	return(true);
+}
+
+/*!
+ * \brief inverse DCT of one block, using only the lowest size x size
+ *        frequencies so that the block is reduced by a factor of 8/size
+ * \param block quantised coefficients in natural order
+ * \param quant quantisation table in natural order
+ * \param size width and height of the output (1, 2, 4 or 8)
+ * \param output top left output pixel
+ * \param output_stride bytes per output row
+ */
+void JpegDecoder::InverseDCT(
+    const short* block,
+    const unsigned short* quant,
+    int size,
+    unsigned char* output,
+    int output_stride)
+{
+	if (size == 1)
+	{
+		int value = (int)floorf((block[0] * quant[0] / 8.0f) + 128.5f);
+		if (value < 0) value = 0;
+		if (value > 255) value = 255;
+		output[0] = (unsigned char)value;
+		return;
+	}
+
+	int level = (size == 2) ? 1 : ((size == 4) ? 2 : 3);
+	const float* b = basis[level];
+
+	float dequantised[64];
+	float rows[64];
+	for (int v = 0; v < size; v++)
+		for (int u = 0; u < size; u++)
+			dequantised[(v * size) + u] = (float)(block[(v * 8) + u] * quant[(v * 8) + u]);
+
+	// transform each row of frequencies
+	for (int v = 0; v < size; v++)
+	{
+		const float* f = &dequantised[v * size];
+		for (int x = 0; x < size; x++)
+		{
+			const float* bx = &b[x * size];
+			float sum = 0;
+			for (int u = 0; u < size; u++)
+				sum += f[u] * bx[u];
+			rows[(v * size) + x] = sum;
+		}
+	}
+
+	// then each column
+	for (int y = 0; y < size; y++)
+	{
+		const float* by = &b[y * size];
+		unsigned char* out = &output[y * output_stride];
+		for (int x = 0; x < size; x++)
+		{
+			float sum = 0;
+			for (int v = 0; v < size; v++)
+				sum += rows[(v * size) + x] * by[v];
+			int value = (int)floorf(sum + 128.5f);
+			if (value < 0) value = 0;
+			if (value > 255) value = 255;
+			out[x] = (unsigned char)value;
+		}
+	}
+}
+
+/*!
+ * \brief returns the largest scale at which the image is at least the given width
+ * \param minimum_width minimum width of the scaled image
+ * \return 1, 2, 4 or 8
+ */
+int JpegDecoder::ScaleForWidth(int minimum_width)
+{
+	int scale = 1;
+	while ((scale < 8) && ((Width + (scale * 2) - 1) / (scale * 2) >= minimum_width))
+		scale *= 2;
+	return(scale);
+}
+
+/*!
+ * \brief returns the dimensions of the image decoded at the given scale
+ * \param scale 1, 2, 4 or 8
+ * \param width returned width
+ * \param height returned height
+ */
+void JpegDecoder::ScaledSize(int scale, int &width, int &height)
+{
+	width = (Width + scale - 1) / scale;
+	height = (Height + scale - 1) / scale;
+}
+
+/*!
+ * \brief decodes the whole image at the given scale
+ * \param scale 1, 2, 4 or 8
+ * \param result BGR image of the size returned by ScaledSize
+ * \return true if the image was decoded
+ */
+bool JpegDecoder::Decode(int scale, unsigned char* result)
+{
+	int width = 0;
+	int height = 0;
+	ScaledSize(scale, width, height);
+	return(Decode(scale, 0, 0, width, height, result));
+}
+
+/*!
+ * \brief decodes a region of the image at the given scale.  Only the blocks
+ *        which overlap the region are transformed.
+ * \param scale 1, 2, 4 or 8
+ * \param tx top left x coordinate within the scaled image
+ * \param ty top left y coordinate within the scaled image
+ * \param bx bottom right x coordinate within the scaled image (exclusive)
+ * \param by bottom right y coordinate within the scaled image (exclusive)
+ * \param result BGR image of size (bx-tx) x (by-ty)
+ * \return true if the region was decoded
+ */
+bool JpegDecoder::Decode(int scale, int tx, int ty, int bx, int by, unsigned char* result)
+{
+	if ((no_of_components == 0) ||
+		((scale != 1) && (scale != 2) && (scale != 4) && (scale != 8)))
+		return(false);
+
+	int width = 0;
+	int height = 0;
+	ScaledSize(scale, width, height);
+	if ((tx < 0) || (ty < 0) || (bx > width) || (by > height) || (bx <= tx) || (by <= ty))
+		return(false);
+
+	int block_size = 8 / scale;
+	int plane_x[JPEG_MAX_COMPONENTS];
+	int plane_y[JPEG_MAX_COMPONENTS];
+	int plane_width[JPEG_MAX_COMPONENTS];
+	int ratio_x[JPEG_MAX_COMPONENTS];
+	int ratio_y[JPEG_MAX_COMPONENTS];
+
+	// transform the blocks of each component which overlap the region
+	for (int c = 0; c < no_of_components; c++)
+	{
+		jpeg_component &component = components[c];
+		ratio_x[c] = max_h / component.h;
+		ratio_y[c] = max_v / component.v;
+		int block_tx = (tx / ratio_x[c]) / block_size;
+		int block_ty = (ty / ratio_y[c]) / block_size;
+		int block_bx = ((bx - 1) / ratio_x[c]) / block_size;
+		int block_by = ((by - 1) / ratio_y[c]) / block_size;
+		if (block_bx >= component.blocks_x) block_bx = component.blocks_x - 1;
+		if (block_by >= component.blocks_y) block_by = component.blocks_y - 1;
+
+		plane_x[c] = block_tx * block_size;
+		plane_y[c] = block_ty * block_size;
+		plane_width[c] = (block_bx - block_tx + 1) * block_size;
+		int plane_height = (block_by - block_ty + 1) * block_size;
+		long long plane_size = (long long)plane_width[c] * (long long)plane_height;
+		if (planes_size[c] < plane_size)
+		{
+			if (planes[c] != NULL) delete[] planes[c];
+			planes_size[c] = (int)plane_size;
+			planes[c] = new unsigned char[planes_size[c]];
+		}
+
+		const unsigned short* quant = quant_tables[component.quant_table];
+		for (int y = block_ty; y <= block_by; y++)
+		{
+			for (int x = block_tx; x <= block_bx; x++)
+			{
+				InverseDCT(
+				    &component.coefficients[((y * component.blocks_x) + x) * 64],
+				    quant,
+				    block_size,
+				    &planes[c][(((y - block_ty) * block_size) * plane_width[c]) + ((x - block_tx) * block_size)],
+				    plane_width[c]);
+			}
+		}
+	}
+
+	// colour conversion, replicating subsampled chroma
+	int n = 0;
+	for (int y = ty; y < by; y++)
+	{
+		const unsigned char* luma_row = &planes[0][((y / ratio_y[0]) - plane_y[0]) * plane_width[0]];
+		if (no_of_components == 1)
+		{
+			for (int x = tx; x < bx; x++, n += 3)
+			{
+				unsigned char luma = luma_row[(x / ratio_x[0]) - plane_x[0]];
+				result[n] = luma;
+				result[n + 1] = luma;
+				result[n + 2] = luma;
+			}
+			continue;
+		}
+
+		const unsigned char* cb_row = &planes[1][((y / ratio_y[1]) - plane_y[1]) * plane_width[1]];
+		const unsigned char* cr_row = &planes[2][((y / ratio_y[2]) - plane_y[2]) * plane_width[2]];
+		for (int x = tx; x < bx; x++, n += 3)
+		{
+			int luma = luma_row[(x / ratio_x[0]) - plane_x[0]] << 16;
+			int cb = cb_row[(x / ratio_x[1]) - plane_x[1]] - 128;
+			int cr = cr_row[(x / ratio_x[2]) - plane_x[2]] - 128;
+
+			// JFIF conversion in 16 bit fixed point
+			int r = (luma + (91881 * cr) + 32768) >> 16;
+			int g = (luma - (22554 * cb) - (46802 * cr) + 32768) >> 16;
+			int b = (luma + (116130 * cb) + 32768) >> 16;
+			if (r < 0) r = 0;
+			if (r > 255) r = 255;
+			if (g < 0) g = 0;
+			if (g > 255) g = 255;
+			if (b < 0) b = 0;
+			if (b > 255) b = 255;
+			result[n] = (unsigned char)b;
+			result[n + 1] = (unsigned char)g;
+			result[n + 2] = (unsigned char)r;
+		}
+	}
+	return(true);
+}
@@ -0,0 +1,152 @@
+/*
+    baseline jpeg decoder
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPEGDECODER_H_
+#define JPEGDECODER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <string>
+using namespace std;
+
+#define JPEG_MAX_COMPONENTS     3
+#define JPEG_HUFFMAN_TABLES     4
+#define JPEG_QUANT_TABLES       4
+
+// number of bits decoded by a single table lookup
+#define JPEG_LOOKUP_BITS        9
+
+// largest frame which will be decoded, in pixels
+#define JPEG_MAX_PIXELS         (8192 * 8192)
+
+/*!
+ * \brief a huffman table from a DHT segment
+ */
+struct jpeg_huffman
+{
+	bool defined;
+	unsigned char values[256];
+	int mincode[17];
+	int maxcode[18];
+	int valptr[17];
+
+	// (code length << 8) | value for codes of up to JPEG_LOOKUP_BITS bits, or zero
+	unsigned short lookup[1 << JPEG_LOOKUP_BITS];
+};
+
+/*!
+ * \brief a colour component of the frame and its quantised DCT coefficients
+ */
+struct jpeg_component
+{
+	int id;
+	int h, v;
+	int quant_table;
+	int dc_table;
+	int ac_table;
+
+	// blocks covering the padded component, in natural coefficient order
+	int blocks_x, blocks_y;
+	short* coefficients;
+
+	int dc_prediction;
+};
+
+/*!
+ * \brief decodes baseline (sequential huffman) jpeg images
+ *
+ * Loading parses the file and entropy decodes it into DCT coefficients.
+ * Any region of the image can then be rendered at full size or at 1/2,
+ * 1/4 or 1/8 scale, in which case only the low frequency coefficients are
+ * transformed, so that the full resolution image is never produced.
+ * Output is BGR, three bytes per pixel with the top row first, in the same
+ * layout as Bitmap::Data.
+ */
+class JpegDecoder
+{
+private:
+	jpeg_component components[JPEG_MAX_COMPONENTS];
+	int no_of_components;
+	jpeg_huffman dc_tables[JPEG_HUFFMAN_TABLES];
+	jpeg_huffman ac_tables[JPEG_HUFFMAN_TABLES];
+	unsigned short quant_tables[JPEG_QUANT_TABLES][64];
+	int max_h, max_v;
+	int mcus_x, mcus_y;
+	int restart_interval;
+
+	// entropy decoder state
+	const unsigned char* data;
+	int data_length;
+	int position;
+	unsigned int bit_buffer;
+	int bit_count;
+
+	// inverse DCT basis functions for output blocks of 1, 2, 4 and 8 pixels
+	float basis[4][64];
+
+	// planes of the region being rendered, one per component
+	unsigned char* planes[JPEG_MAX_COMPONENTS];
+	int planes_size[JPEG_MAX_COMPONENTS];
+
+	void Free();
+	bool ReadFrameHeader(const unsigned char* segment, int length);
+	bool ReadHuffmanTables(const unsigned char* segment, int length);
+	bool ReadQuantisationTables(const unsigned char* segment, int length);
+	bool ReadScan(const unsigned char* segment, int length);
+
+	void FillBits();
+	int GetBits(int bits);
+	int DecodeHuffman(jpeg_huffman &table);
+	bool DecodeBlock(jpeg_component &component, short* block);
+	void Restart();
+
+	void InverseDCT(
+	    const short* block,
+	    const unsigned short* quant,
+	    int size,
+	    unsigned char* output,
+	    int output_stride);
+
+public:
+	int Width, Height;
+
+	JpegDecoder();
+	~JpegDecoder();
+
+	static bool IsJpeg(const unsigned char* file_data, int length);
+	static bool IsJpeg(std::string filename);
+
+	bool Load(std::string filename);
+	bool Load(const unsigned char* file_data, int length);
+
+	int ScaleForWidth(int minimum_width);
+	void ScaledSize(int scale, int &width, int &height);
+
+	bool Decode(int scale, unsigned char* result);
+	bool Decode(int scale, int tx, int ty, int bx, int by, unsigned char* result);
+};
+
+#endif /* JPEGDECODER_H_ */
@@ -1,578 +1,1017 @@
-/*
-    image processing functions
-    Copyright (C) 2009 Bob Mottram
-    fuzzgun@gmail.com
-
-    This program is free software: you can redistribute it and/or modify
-    it under the terms of the GNU General Public License as published by
-    the Free Software Foundation, either version 3 of the License, or
-    (at your option) any later version.
-
-    This program is distributed in the hope that it will be useful,
-    but WITHOUT ANY WARRANTY; without even the implied warranty of
-    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-    GNU General Public License for more details.
-
-    You should have received a copy of the GNU General Public License
-    along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-
-#include "processimage.h"
-
-// ********** public methods **********
-
-/*!
- * \brief apply a yellow filter to the image
- * \param img colour image data
- * \param img_width width of the image
- * \param img_height height of the image
+/*
+    image processing functions
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "processimage.h"
+
+
+// ********** public methods **********
+
+/*!
+ * \brief apply a yellow filter to the image
+ * \param img colour image data
+ * \param img_width width of the image
+ * \param img_height height of the image
  * \param filtered returned filtered image
- */
-void processimage::yellowFilter(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    unsigned char* filtered)
-{
-	// clear the filtered image
-	memset(filtered, 0, img_width * img_height * 3 * sizeof(unsigned char));
-
-	int* histogram = new int[256];
-	int* temp_buffer = new int[256];
-	memset(histogram, 0, 256*sizeof(int));
-
-	// apply filter
-	for (int i = (img_width * img_height * 3)-3; i >= 0; i -= 3)
-	{
-		int r = img[i+2];
-		int g = img[i+1];
-		int b = img[i];
-
-		int v = r - g;
-		if (v < 0) v = -v;
-        int yellow = (int)((r + g) - ((b + v)*2));
-        if (yellow > 0)
-        {
-        	if (yellow > 255) yellow = 255;
-        	if (yellow < 0) yellow = 0;
-
-        	unsigned char y = (unsigned char)yellow;
-        	filtered[i] = y;
-        	filtered[i+1] = y;
-        	filtered[i+2] = y;
-
-            histogram[yellow]++;
-        }
-	}
-	float MeanDark = 0;
-	float MeanLight = 0;
-	float DarkRatio = 0;
-	float threshold = thresholding::GetGlobalThreshold(histogram, 256, 0, temp_buffer, MeanDark, MeanLight, DarkRatio);
-
-	for (int i = (img_width * img_height * 3)-3; i >= 0; i -= 3)
-	{
-        if (filtered[i] > 0)
-        {
-        	if (filtered[i] < threshold)
-        	{
-        	    filtered[i] = 0;
-        	    filtered[i + 1] = 0;
-        	    filtered[i + 2] = 0;
-        	}
-        }
-	}
-
-	delete[] histogram;
-	delete[] temp_buffer;
-}
-
-
-/*!
- * \brief convert a mono image to a colour image
- * \param img_mono mono image data
- * \param img_width image width
- * \param img_height image height
- * \param output optional colour image buffer
- * \return colour image data
- */
-void processimage::colourImage(
-    unsigned char* img_mono,
-    int img_width,
-    int img_height,
-    unsigned char* colour_image)
-{
-    int n = 0;
-    for (int i = 0; i < img_width * img_height; i++)
-    {
-        unsigned char b = img_mono[i];
-        colour_image[n++] = b;
-        colour_image[n++] = b;
-        colour_image[n++] = b;
-    }
-}
-
-/*!
- * \brief convert the given colour image to mono
- * \param img_colour
- * \param img_width
- * \param img_height
+ */
+void processimage::yellowFilter(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    unsigned char* filtered)
+{
+	yellowFilter(imageview::Create(img, img_width, img_height, 3), filtered);
+}
+
+/*!
+ * \brief apply a yellow filter to the image
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param filtered returned filtered image, tightly packed with three bytes per pixel
+ */
+void processimage::yellowFilter(
+    const image_view &img,
+    unsigned char* filtered)
+{
+	int img_width = img.width;
+	int img_height = img.height;
+
+	// clear the filtered image
+	memset(filtered, 0, img_width * img_height * 3 * sizeof(unsigned char));
+
+	int histogram[256];
+	memset(histogram, 0, 256*sizeof(int));
+
+	// apply filter
+	for (int yy = img_height-1; yy >= 0; yy--)
+	{
+		unsigned char* row = imageview::Row(img, yy);
+		int i = ((yy * img_width) + img_width - 1) * 3;
+		for (int x = (img_width-1) * img.channels; x >= 0; x -= img.channels, i -= 3)
+		{
+			int r = row[x+2];
+			int g = row[x+1];
+			int b = row[x];
+
+			int v = r - g;
+			if (v < 0) v = -v;
+	        int yellow = (int)((r + g) - ((b + v)*2));
+	        if (yellow > 0)
+	        {
+	        	if (yellow > 255) yellow = 255;
+	        	if (yellow < 0) yellow = 0;
+
+	        	unsigned char y = (unsigned char)yellow;
+	        	filtered[i] = y;
+	        	filtered[i+1] = y;
+	        	filtered[i+2] = y;
+
+	            histogram[yellow]++;
+	        }
+		}
+	}
+	float MeanDark = 0;
+	float MeanLight = 0;
+	float DarkRatio = 0;
+	float threshold = thresholding::GetGlobalThreshold(histogram, 256, MeanDark, MeanLight, DarkRatio);
+
+	for (int i = (img_width * img_height * 3)-3; i >= 0; i -= 3)
+	{
+        if (filtered[i] > 0)
+        {
+        	if (filtered[i] < threshold)
+        	{
+        	    filtered[i] = 0;
+        	    filtered[i + 1] = 0;
+        	    filtered[i + 2] = 0;
+        	}
+        }
+	}
+}
+
+
+/*!
+ * \brief convert a mono image to a colour image
+ * \param img_mono mono image data
+ * \param img_width image width
+ * \param img_height image height
+ * \param output optional colour image buffer
+ * \return colour image data
+ */
+void processimage::colourImage(
+    unsigned char* img_mono,
+    int img_width,
+    int img_height,
+    unsigned char* colour_image)
+{
+    int n = 0;
+    for (int i = 0; i < img_width * img_height; i++)
+    {
+        unsigned char b = img_mono[i];
+        colour_image[n++] = b;
+        colour_image[n++] = b;
+        colour_image[n++] = b;
+    }
+}
+
+/*!
+ * \brief convert the given colour image to mono
+ * \param img_colour
+ * \param img_width
+ * \param img_height
+ * \param conversion_type method for converting to mono
+ * \param mono_image output mono image
+ * \return
+ */
+void processimage::monoImage(
+    unsigned char* img_colour,
+    int img_width,
+    int img_height,
+    int conversion_type,
+    unsigned char* mono_image)
+{
+	monoImage(imageview::Create(img_colour, img_width, img_height, 3), conversion_type, mono_image);
+}
+
+/*!
+ * \brief convert one row of a colour image to mono, for any number of channels
+ * \param row first byte of the row, in BGR order
+ * \param width number of pixels in the row
+ * \param channels bytes per pixel
+ * \param conversion_type method for converting to mono
+ * \param mono returned mono row
+ */
+void processimage::monoRow(
+    const unsigned char* row,
+    int width,
+    int channels,
+    int conversion_type,
+    unsigned char* mono)
+{
+    int tot = 0;
+    int luminence = 0;
+
+    for (int i = 0, n = 0; i < width * channels; i += channels, n++)
+    {
+        switch (conversion_type)
+        {
+            case 0: // magnitude
+                {
+                    tot = 0;
+                    for (int col = 0; col < 3; col++)
+                        tot += row[i + col];
+
+                    mono[n] = (unsigned char)(tot * 0.3333333333f);
+                    break;
+                }
+            case 1: // luminance
+                {
+                    luminence = ((row[i + 2] * 299) +
+                                 (row[i + 1] * 587) +
+                                 (row[i] * 114)) / 1000;
+                    //if (luminence > 255) luminence = 255;
+                    mono[n] = (unsigned char)luminence;
+                    break;
+                }
+        }
+    }
+}
+
+#ifdef __SSE2__
+/*!
+ * \brief integer division by 1000 of four values in the range 0-255000.
+ *        The single precision estimate is never more than one too small,
+ *        and is corrected using the remainder.
+ */
+static inline __m128i DivideBy1000SSE2(__m128i v)
+{
+	__m128i q = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(0.001f)));
+	__m128i remainder = _mm_sub_epi32(v, _mm_madd_epi16(q, _mm_set1_epi32(1000)));
+	return(_mm_sub_epi32(q, _mm_cmpgt_epi32(remainder, _mm_set1_epi32(999))));
+}
+
+/*!
+ * \brief interleaves the bytes of registers k and k + 3.  Five rounds
+ *        separate 32 pixels in BGR order into planes.
+ */
+static inline void InterleaveSSE2(__m128i* c)
+{
+	__m128i d0 = _mm_unpacklo_epi8(c[0], c[3]);
+	__m128i d1 = _mm_unpackhi_epi8(c[0], c[3]);
+	__m128i d2 = _mm_unpacklo_epi8(c[1], c[4]);
+	__m128i d3 = _mm_unpackhi_epi8(c[1], c[4]);
+	__m128i d4 = _mm_unpacklo_epi8(c[2], c[5]);
+	__m128i d5 = _mm_unpackhi_epi8(c[2], c[5]);
+	c[0] = d0;
+	c[1] = d1;
+	c[2] = d2;
+	c[3] = d3;
+	c[4] = d4;
+	c[5] = d5;
+}
+
+/*!
+ * \brief mono values for eight pixels held as 16 bit values
+ *
+ * The magnitude is divided by three using a multiplication by 21846 / 65536,
+ * which is exact for sums up to 765.
+ */
+static inline __m128i MonoSSE2(
+    __m128i b, __m128i g, __m128i r,
+    int conversion_type)
+{
+	if (conversion_type == 0)
+		return(_mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(b, g), r), _mm_set1_epi16(21846)));
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i coefficients_rg = _mm_set1_epi32((587 << 16) | 299);
+	__m128i coefficient_b = _mm_set1_epi32(114);
+	__m128i lo = _mm_add_epi32(
+	    _mm_madd_epi16(_mm_unpacklo_epi16(r, g), coefficients_rg),
+	    _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), coefficient_b));
+	__m128i hi = _mm_add_epi32(
+	    _mm_madd_epi16(_mm_unpackhi_epi16(r, g), coefficients_rg),
+	    _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), coefficient_b));
+	return(_mm_packs_epi32(DivideBy1000SSE2(lo), DivideBy1000SSE2(hi)));
+}
+#endif
+
+/*!
+ * \brief convert one row of an image with the given number of channels to mono
+ * \param row first byte of the row, in BGR order
+ * \param width number of pixels in the row
+ * \param conversion_type method for converting to mono
+ * \param mono returned mono row
+ */
+template <int CHANNELS>
+void processimage::monoRow(
+    const unsigned char* row,
+    int width,
+    int conversion_type,
+    unsigned char* mono)
+{
+	if (CHANNELS == 1)
+	{
+		memcpy(mono, row, width);
+		return;
+	}
+	if ((conversion_type != 0) && (conversion_type != 1)) return;
+
+	int x = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	if (CHANNELS == 3)
+	{
+		// blocks of 32 pixels are separated into planes by five rounds of
+		// byte interleaving between registers holding bytes i and i + 48
+		for (; x + 32 <= width; x += 32)
+		{
+			const unsigned char* p = &row[x * 3];
+			__m128i c[6];
+			for (int k = 0; k < 6; k++)
+				c[k] = _mm_loadu_si128((const __m128i*)(p + (k * 16)));
+			for (int round = 0; round < 5; round++)
+				InterleaveSSE2(c);
+
+			// c[0..1] blue, c[2..3] green, c[4..5] red
+			for (int k = 0; k < 2; k++)
+			{
+				__m128i lo = MonoSSE2(
+				    _mm_unpacklo_epi8(c[k], zero), _mm_unpacklo_epi8(c[k + 2], zero), _mm_unpacklo_epi8(c[k + 4], zero),
+				    conversion_type);
+				__m128i hi = MonoSSE2(
+				    _mm_unpackhi_epi8(c[k], zero), _mm_unpackhi_epi8(c[k + 2], zero), _mm_unpackhi_epi8(c[k + 4], zero),
+				    conversion_type);
+				_mm_storeu_si128((__m128i*)&mono[x + (k * 16)], _mm_packus_epi16(lo, hi));
+			}
+		}
+	}
+	if (CHANNELS == 4)
+	{
+		// each 32 bit lane holds one pixel
+		__m128i mask = _mm_set1_epi32(0xff);
+		for (; x + 16 <= width; x += 16)
+		{
+			__m128i b[2], g[2], r[2];
+			for (int k = 0; k < 2; k++)
+			{
+				__m128i v0 = _mm_loadu_si128((const __m128i*)&row[(x + (k * 8)) * 4]);
+				__m128i v1 = _mm_loadu_si128((const __m128i*)&row[(x + (k * 8) + 4) * 4]);
+				b[k] = _mm_packs_epi32(_mm_and_si128(v0, mask), _mm_and_si128(v1, mask));
+				g[k] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v0, 8), mask), _mm_and_si128(_mm_srli_epi32(v1, 8), mask));
+				r[k] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(v0, 16), mask), _mm_and_si128(_mm_srli_epi32(v1, 16), mask));
+			}
+			__m128i lo = MonoSSE2(b[0], g[0], r[0], conversion_type);
+			__m128i hi = MonoSSE2(b[1], g[1], r[1], conversion_type);
+			_mm_storeu_si128((__m128i*)&mono[x], _mm_packus_epi16(lo, hi));
+		}
+	}
+#endif
+
+	monoRow(&row[x * CHANNELS], width - x, CHANNELS, conversion_type, &mono[x]);
+}
+
+/*!
+ * \brief convert the given image to mono
+ * \param img image with one byte per pixel, or three or more in BGR order
+ * \param conversion_type method for converting to mono
+ * \param mono_image output mono image, tightly packed
+ */
+void processimage::monoImage(
+    const image_view &img,
+    int conversion_type,
+    unsigned char* mono_image)
+{
+	monoImage(img, conversion_type, true, mono_image);
+}
+
+/*!
+ * \brief convert the given image to mono
+ * \param img image with one byte per pixel, or three or more in BGR order
  * \param conversion_type method for converting to mono
- * \param mono_image output mono image
- * \return
- */
-void processimage::monoImage(
-    unsigned char* img_colour,
-    int img_width,
-    int img_height,
-    int conversion_type,
-    unsigned char* mono_image)
-{
-    int n = 0;
-    int tot = 0;
-    int luminence = 0;
-
-    for (int i = 0; i < img_width * img_height * 3; i += 3, n++)
-    {
-        switch (conversion_type)
-        {
-            case 0: // magnitude
-                {
-                    tot = 0;
-                    for (int col = 0; col < 3; col++)
-                        tot += img_colour[i + col];
-
-                    mono_image[n] = (unsigned char)(tot * 0.3333333333f);
-                    break;
-                }
-            case 1: // luminance
-                {
-                    luminence = ((img_colour[i + 2] * 299) +
-                                 (img_colour[i + 1] * 587) +
-                                 (img_colour[i] * 114)) / 1000;
-                    //if (luminence > 255) luminence = 255;
-                    mono_image[n] = (unsigned char)luminence;
-                    break;
-                }
-        }
-    }
-}
-
-/*!
- * \brief sub-sample a mono image
- * \param img image pixel data (one byte per pixel)
- * \param img_width width of the image
- * \param img_height height of the image
- * \return
- */
-void processimage::downSample(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    int bytes_per_pixel,
-    int new_width,
+ * \param vectorise use the vectorised kernels, which give the same result as the scalar ones
+ * \param mono_image output mono image, tightly packed
+ */
+void processimage::monoImage(
+    const image_view &img,
+    int conversion_type,
+    bool vectorise,
+    unsigned char* mono_image)
+{
+    for (int y = 0; y < img.height; y++)
+    {
+    	unsigned char* row = imageview::Row(img, y);
+    	unsigned char* mono = &mono_image[y * img.width];
+
+    	if (img.channels == 1)
+    		monoRow<1>(row, img.width, conversion_type, mono);
+    	else if (vectorise && (img.channels == 3))
+    		monoRow<3>(row, img.width, conversion_type, mono);
+    	else if (vectorise && (img.channels == 4))
+    		monoRow<4>(row, img.width, conversion_type, mono);
+    	else
+    		monoRow(row, img.width, img.channels, conversion_type, mono);
+    }
+}
+
+/*!
+ * \brief sub-sample a mono image
+ * \param img image pixel data (one byte per pixel)
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \return
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    int bytes_per_pixel,
+    int new_width,
     int new_height,
-    unsigned char *result)
-{
-    if (!((new_width == img_width) && (new_height == img_height)))
-    {
+    unsigned char *result)
+{
+    if (!((new_width == img_width) && (new_height == img_height)))
+    {
         int n = 0;
-        int pixels = img_width * img_height * bytes_per_pixel;
-
-        for (int y = 0; y < new_height; y++)
-        {
-            int yy = y * (img_height - 1) / new_height;
-            for (int x = 0; x < new_width; x++)
-            {
-                int xx = x * (img_width - 1) / new_width;
-                int n2 = ((yy * img_width) + xx) * bytes_per_pixel;
-                if (n2 < pixels - bytes_per_pixel) result[n] = img[n2];
-                n++;
-            }
-        }
-    }
-    else
-    {
-        memcpy(result, img, img_width * img_height * bytes_per_pixel);
-    }
-}
-
-/*!
- * \brief sub-sample a mono image
- * \param img image pixel data (one byte per pixel)
- * \param img_width width of the image
- * \param img_height height of the image
- * \param bytes_per_pixel
- * \param new_width
- * \param new_height
- * \param new_bytes_per_pixel
- * \return
- */
-void processimage::downSample(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    int bytes_per_pixel,
-    int new_width,
-    int new_height,
-    int new_bytes_per_pixel,
-    unsigned char *result)
-{
-    bool convert_to_mono = false;
-    if ((bytes_per_pixel == 3) && (new_bytes_per_pixel == 1))
-        convert_to_mono = true;
-
-    bool same_bytes_per_pixel = false;
-    if (bytes_per_pixel == new_bytes_per_pixel)
-        same_bytes_per_pixel = true;
-
-    bool convert_to_colour = false;
-    if ((bytes_per_pixel == 1) && (new_bytes_per_pixel == 3))
-        convert_to_colour = true;
-
-    int n = 0;
-    int pixels = img_width * img_height * bytes_per_pixel;
-
-    for (int y = 0; y < new_height; y++)
-    {
-        int yy = y * (img_height - 1) / new_height;
-        for (int x = 0; x < new_width; x++)
-        {
-            int xx = x * (img_width - 1) / new_width;
-
-            if (convert_to_mono)
-            {
-                int n2 = ((yy * img_width) + xx) * bytes_per_pixel;
-                if (n2 < pixels - bytes_per_pixel) result[n] = img[n2];
-                n++;
-            }
-            if (same_bytes_per_pixel)
-            {
-                if (bytes_per_pixel == 1)
-                {
-                    int n2 = (yy * img_width) + xx;
-                    result[n++] = img[n2++];
-                }
-                else
-                {
-                    int n2 = ((yy * img_width) + xx) * bytes_per_pixel;
-                    for (int col = 0; col < bytes_per_pixel; col++)
-                        result[n++] = img[n2++];
-                }
-            }
-            if (convert_to_colour)
-            {
-                int n2 = (yy * img_width) + xx;
-                if (n2 < pixels - 1)
-                {
-                    result[n++] = img[n2];
-                    result[n++] = img[n2];
-                    result[n++] = img[n2];
-                }
-            }
-        }
-    }
-}
-
-/*!
- * \brief sub-sample a mono image to half its original size
- * \param img image data (one byte per pixel)
- * \param img_width width of the image
- * \param img_height height of the image
- * \return image of half the size
- */
-void processimage::downSample(
-    unsigned char* img,
-    int img_width,
-    int img_height,
+        int pixels = img_width * img_height * bytes_per_pixel;
+
+        // the sampled column x * (img_width - 1) / new_width is stepped
+        // along each row, carrying the remainder
+        int step = (img_width - 1) / new_width;
+        int remainder = (img_width - 1) % new_width;
+
+        for (int y = 0; y < new_height; y++)
+        {
+            int yy = y * (img_height - 1) / new_height;
+            int row = yy * img_width * bytes_per_pixel;
+            int xx = 0;
+            int carry = 0;
+            for (int x = 0; x < new_width; x++)
+            {
+                int n2 = row + (xx * bytes_per_pixel);
+                if (n2 < pixels - bytes_per_pixel) result[n] = img[n2];
+                n++;
+
+                xx += step;
+                carry += remainder;
+                if (carry >= new_width)
+                {
+                    carry -= new_width;
+                    xx++;
+                }
+            }
+        }
+    }
+    else
+    {
+        memcpy(result, img, img_width * img_height * bytes_per_pixel);
+    }
+}
+
+/*!
+ * \brief sub-sample a mono image
+ * \param img image pixel data (one byte per pixel)
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel
+ * \param new_width
+ * \param new_height
+ * \param new_bytes_per_pixel
+ * \return
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
     int bytes_per_pixel,
-    unsigned char *result)
-{
-    int new_width = img_width / 2;
-    int new_height = img_height / 2;
-
-    int pixels = img_width * img_height;
-
-    if (bytes_per_pixel == 1)
-    {
-        int yy = 0;
-        int stride = img_width;
-        for (int y = 0; y < new_height-1; y++)
-        {
-            int n = y * new_width;
-            int xx = yy * stride;
-            int xx2 = xx + stride;
-            for (int x = 0; x < new_width-1; x++)
-            {
-                if (xx2 + 1 < pixels)
-                {
-                    float v = img[xx] + img[xx + 1] +
-                              img[xx2] + img[xx2 + 1];
-
-                    result[n] = (unsigned char)(v * 0.25f);
-                }
-                n++;
-                xx += 2;
-                xx2 += 2;
-            }
-            yy += 2;
-        }
-    }
-    else
-    {
-        pixels *= 3;
-
-        int yy = 0;
-        int stride = img_width * 3;
-        for (int y = 0; y < new_height-1; y++)
-        {
-            int n = y * new_width * 3;
-            int xx = yy * stride;
-            int xx2 = xx + stride;
-            for (int x = 0; x < new_width-1; x++)
-            {
-                if (xx2 + 3 < pixels)
-                {
-                    for (int col = 0; col < 3; col++)
-                    {
-                        float v = img[xx + col] + img[xx + 3 + col] +
-                                  img[xx2 + col] + img[xx2 + 3 + col];
-
-                        result[n + col] = (unsigned char)(v * 0.25f);
-                    }
-                }
-                n += 3;
-                xx += 6;
-                xx2 += 6;
-            }
-            yy += 2;
-        }
-    }
-}
-
-
-/*!
- * \brief sub-sample a mono image by a certain factor
- * \param img mono image data (one byte per pixel)
- * \param img_width width of the image
- * \param img_height height of the image
- * \param bytes_per_pixel number of bytes per pixel
- * \param buffer temporary buffer used for downsampling
+    int new_width,
+    int new_height,
+    int new_bytes_per_pixel,
+    unsigned char *result)
+{
+    bool convert_to_mono = false;
+    if ((bytes_per_pixel == 3) && (new_bytes_per_pixel == 1))
+        convert_to_mono = true;
+
+    bool same_bytes_per_pixel = false;
+    if (bytes_per_pixel == new_bytes_per_pixel)
+        same_bytes_per_pixel = true;
+
+    bool convert_to_colour = false;
+    if ((bytes_per_pixel == 1) && (new_bytes_per_pixel == 3))
+        convert_to_colour = true;
+
+    int n = 0;
+    int pixels = img_width * img_height * bytes_per_pixel;
+
+    // the sampled column x * (img_width - 1) / new_width is stepped
+    // along each row, carrying the remainder
+    int step = (img_width - 1) / new_width;
+    int remainder = (img_width - 1) % new_width;
+
+    for (int y = 0; y < new_height; y++)
+    {
+        int yy = y * (img_height - 1) / new_height;
+        int xx = 0;
+        int carry = 0;
+        for (int x = 0; x < new_width; x++)
+        {
+
+            if (convert_to_mono)
+            {
+                int n2 = ((yy * img_width) + xx) * bytes_per_pixel;
+                if (n2 < pixels - bytes_per_pixel) result[n] = img[n2];
+                n++;
+            }
+            if (same_bytes_per_pixel)
+            {
+                if (bytes_per_pixel == 1)
+                {
+                    int n2 = (yy * img_width) + xx;
+                    result[n++] = img[n2++];
+                }
+                else
+                {
+                    int n2 = ((yy * img_width) + xx) * bytes_per_pixel;
+                    for (int col = 0; col < bytes_per_pixel; col++)
+                        result[n++] = img[n2++];
+                }
+            }
+            if (convert_to_colour)
+            {
+                int n2 = (yy * img_width) + xx;
+                if (n2 < pixels - 1)
+                {
+                    result[n++] = img[n2];
+                    result[n++] = img[n2];
+                    result[n++] = img[n2];
+                }
+            }
+
+            xx += step;
+            carry += remainder;
+            if (carry >= new_width)
+            {
+                carry -= new_width;
+                xx++;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief reduces an image by an integer factor, averaging each block of pixels.
+ *        As with the original kernels the last row and column of the result
+ *        are not written.
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel number of bytes per pixel
  * \param factor downsampling factor
- * \param result downsampled result
- */
-void processimage::downSample(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    int bytes_per_pixel,
-    int factor,
-    int *buffer0,
-    int *buffer1,
-    unsigned char *result)
-{
-    if (factor <= 2)
-    {
-        if (factor == 2)
-        {
-            // do a single downsample (half original image size)
-            downSample(img, img_width, img_height, bytes_per_pixel, result);
-        }
-    }
-    else
-    {
-        // do multiple downsamples
-        // note here that we sum pixels and then divide at
-        // the end for greater accuracy
-        int pixels = img_width * img_height;
-        int *img2 = buffer0; //new int[pixels];
-        for (int i = pixels - 1; i >= 0; i--) img2[i] = img[i];
-
-        int target_img_width = img_width / factor;
-
-        int* img3 = buffer1;
-        int *temp_img = NULL;
-        int grouped_pixels = 2;
-        while (img_width > target_img_width)
-        {
-            if (temp_img != NULL) delete[] temp_img;
-            //img3 = buffer1; //new int[(img_width/2)*(img_height/2)];
-            downSampleSum(img2, img_width, img_height, bytes_per_pixel, img3);
-            img_width /= 2;
-            img_height /= 2;
-            temp_img = img2;
-            img2 = img3;
-            img3 = temp_img;
-            grouped_pixels *= grouped_pixels;
-        }
-
-        // divide the summed pixel values
-        float divisor = 1.0f / grouped_pixels;
-        for (int i = (img_width * img_height) - 1; i >= 0; i--) result[i] = (unsigned char)((float)img2[i] * divisor);
-
-        //if (temp_img != NULL)
-        //    delete[] temp_img;
-        //else
-        //    delete[] img2;
-
-        //if (img3 != NULL) delete[] img3;
-    }
-}
-
-
-
-/*!
- * \brief mirror the given image
- * \param bmp image data
- * \param wdth width of the image
- * \param hght height of the image
- * \param bytes_per_pixel number of bytes per pixel
- * \param mirrored mirrored version
- */
-void processimage::Mirror(
-    unsigned char* bmp,
-    int wdth,
-    int hght,
+ * \param result downsampled result with the same number of bytes per pixel
+ */
+void processimage::downSampleBy(
+    const unsigned char* img,
+    int img_width,
+    int img_height,
     int bytes_per_pixel,
-    unsigned char* mirrored)
-{
-    //unsigned char* mirrored = new unsigned char[wdth * hght * bytes_per_pixel];
-
-    for (int y = 0; y < hght; y++)
-    {
-        int n0 = (y * wdth);
-        for (int x = 0; x < wdth; x++)
-        {
-            int n1 = (n0 + x) * bytes_per_pixel;
-            int x2 = wdth - 1 - x;
-            int n2 = (n0 + x2) * bytes_per_pixel;
-            for (int col = 0; col < bytes_per_pixel; col++)
-                mirrored[n2 + col] = bmp[n1 + col];
-        }
-    }
-}
-
-/*!
- * \brief flip the given image
- * \param bmp image data
- * \param wdth width of the image
- * \param hght height of the image
- * \param bytes_per_pixel number of bytes per pixel
- * \return flipped varesion
- */
-void processimage::Flip(
-    unsigned char* bmp,
-    int wdth,
-    int hght,
+    int factor,
+    unsigned char* result)
+{
+    int new_width = img_width / factor;
+    int new_height = img_height / factor;
+    int stride = img_width * bytes_per_pixel;
+    int area = factor * factor;
+
+    for (int y = 0; y < new_height - 1; y++)
+    {
+        unsigned char* output = &result[y * new_width * bytes_per_pixel];
+        for (int x = 0; x < new_width - 1; x++)
+        {
+            const unsigned char* block = &img[(y * factor * stride) + (x * factor * bytes_per_pixel)];
+            for (int col = 0; col < bytes_per_pixel; col++, output++)
+            {
+                int v = 0;
+                for (int yy = 0; yy < factor; yy++)
+                    for (int xx = 0; xx < factor; xx++)
+                        v += block[(yy * stride) + (xx * bytes_per_pixel) + col];
+                *output = (unsigned char)(v / area);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief reduces an image with the given number of channels by a factor of
+ *        two or four, averaging each block of pixels.  The last row and column
+ *        of the result are not written.
+ *
+ * The rows of each block are summed into 16 bit totals, and the totals of
+ * neighbouring pixels are then added using loads offset by one pixel.  Only
+ * the sums at the start of each block are kept.  Each row is processed
+ * DOWNSAMPLE_CHUNK_BLOCKS blocks at a time, so the totals fit on the stack.
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param result downsampled result with the same number of channels
+ */
+template <int CHANNELS, int FACTOR>
+void processimage::downSampleBy(
+    const unsigned char* img,
+    int img_width,
+    int img_height,
+    unsigned char* result)
+{
+	int new_width = img_width / FACTOR;
+	int new_height = img_height / FACTOR;
+	int stride = img_width * CHANNELS;
+	int block_bytes = FACTOR * CHANNELS;
+	int shift = (FACTOR == 2) ? 2 : 4;
+	if ((new_width < 2) || (new_height < 2)) return;
+
+	// bytes of each input row which fall within the written blocks
+	int span = (new_width - 1) * block_bytes;
+	int chunk = DOWNSAMPLE_CHUNK_BLOCKS * block_bytes;
+	unsigned short sums[(DOWNSAMPLE_CHUNK_BLOCKS * FACTOR * CHANNELS) + 16];
+	unsigned char averages[(DOWNSAMPLE_CHUNK_BLOCKS * FACTOR * CHANNELS) + 16];
+
+	for (int y = 0; y < new_height - 1; y++)
+	{
+		for (int start = 0; start < span; start += chunk)
+		{
+			const unsigned char* row = &img[(y * FACTOR * stride) + start];
+			int length = span - start;
+			if (length > chunk) length = chunk;
+
+			// vertical sums, followed by zeros read by the offset loads
+			int i = 0;
+#ifdef __SSE2__
+			__m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= length; i += 16)
+			{
+				__m128i lo = zero;
+				__m128i hi = zero;
+				for (int j = 0; j < FACTOR; j++)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i*)&row[(j * stride) + i]);
+					lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+					hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+				}
+				_mm_storeu_si128((__m128i*)&sums[i], lo);
+				_mm_storeu_si128((__m128i*)&sums[i + 8], hi);
+			}
+#endif
+			for (; i < length; i++)
+			{
+				int v = 0;
+				for (int j = 0; j < FACTOR; j++)
+					v += row[(j * stride) + i];
+				sums[i] = (unsigned short)v;
+			}
+			memset(&sums[length], 0, 16 * sizeof(unsigned short));
+
+			// horizontal sums, divided by the block area
+			i = 0;
+#ifdef __SSE2__
+			for (; i + 8 <= length; i += 8)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)&sums[i]);
+				for (int j = 1; j < FACTOR; j++)
+					v = _mm_add_epi16(v, _mm_loadu_si128((const __m128i*)&sums[i + (j * CHANNELS)]));
+				v = _mm_srli_epi16(v, shift);
+				_mm_storel_epi64((__m128i*)&averages[i], _mm_packus_epi16(v, v));
+			}
+#endif
+			for (i -= i % block_bytes; i < length; i += block_bytes)
+			{
+				for (int col = 0; col < CHANNELS; col++)
+				{
+					int v = 0;
+					for (int j = 0; j < FACTOR; j++)
+						v += sums[i + col + (j * CHANNELS)];
+					averages[i + col] = (unsigned char)(v >> shift);
+				}
+			}
+
+			unsigned char* output = &result[((y * new_width) + (start / block_bytes)) * CHANNELS];
+			for (int x = 0; x < length / block_bytes; x++)
+				for (int col = 0; col < CHANNELS; col++)
+					output[(x * CHANNELS) + col] = averages[(x * block_bytes) + col];
+		}
+	}
+}
+
+/*!
+ * \brief sub-sample an image to half its original size
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \param result image of half the size with the same number of bytes per pixel
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
     int bytes_per_pixel,
-    unsigned char* flipped)
-{
-    //unsigned char* flipped = new unsigned char[wdth * hght * bytes_per_pixel];
-
-    for (int y = 0; y < hght; y++)
-    {
-        int n0 = (y * wdth);
-        for (int x = 0; x < wdth; x++)
-        {
-            int n1 = (n0 + x) * bytes_per_pixel;
-            int n2 = (((hght - 1 - y) * wdth) + x) * bytes_per_pixel;
-            for (int col = 0; col < bytes_per_pixel; col++)
-                flipped[n2 + col] = bmp[n1 + col];
-        }
-    }
-}
-
-
-/*!
- * \brief Dilate
- * \param width
- * \param height
- * \param bytes_per_pixel
- * \param radius
- * \return
- */
-/*
-void processimage::Dilate(
-    unsigned char* bmp,
-    int width,
-    int height,
-    int bytes_per_pixel,
-    int radius,
-    unsigned char* result)
-{
-    int intensity = 0;
-    int max_intensity = 0;
+    unsigned char *result)
+{
+	downSample(img, img_width, img_height, bytes_per_pixel, true, result);
+}
+
+/*!
+ * \brief sub-sample an image to half its original size
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \param vectorise use the vectorised kernels, which give the same result as the scalar ones
+ * \param result image of half the size with the same number of bytes per pixel
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    int bytes_per_pixel,
+    bool vectorise,
+    unsigned char *result)
+{
+	if (vectorise)
+	{
+		switch (bytes_per_pixel)
+		{
+		    case 1: { downSampleBy<1, 2>(img, img_width, img_height, result); return; }
+		    case 3: { downSampleBy<3, 2>(img, img_width, img_height, result); return; }
+		    case 4: { downSampleBy<4, 2>(img, img_width, img_height, result); return; }
+		}
+	}
+	downSampleBy(img, img_width, img_height, bytes_per_pixel, 2, result);
+}
+
+/*!
+ * \brief reduces a colour image to the given size by averaging the area under each output pixel
+ *
+ * Every input pixel is read exactly once.  Input rows are first summed
+ * vertically into a row of totals, which is then reduced horizontally
+ * once per output row, so that the inner loop over the full resolution
+ * image is a simple sequential add.  The new size should not be larger
+ * than the original.
+ * \param img colour image with three or more bytes per pixel in BGR order
+ * \param new_width width of the result
+ * \param new_height height of the result
+ * \param sums buffer of at least img.width * img.channels ints, used for the row totals
+ * \param result returned image, tightly packed with three bytes per pixel
+ */
+void processimage::downSample(
+    const image_view &img,
+    int new_width,
+    int new_height,
+    int* sums,
+    unsigned char* result)
+{
+	int row_bytes = img.width * img.channels;
+
+	// input columns x * img.width / new_width onwards are summed into
+	// output column x, stepped along the row carrying the remainder
+	int step = img.width / new_width;
+	int remainder = img.width % new_width;
+
+	int yy = 0;
+	for (int y = 0; y < new_height; y++)
+	{
+		int yy_end = (y + 1) * img.height / new_height;
+		if (yy_end <= yy) yy_end = yy + 1;
+		if (yy_end > img.height) yy_end = img.height;
+		int rows = yy_end - yy;
+
+		memset(sums, 0, row_bytes * sizeof(int));
+		for (; yy < yy_end; yy++)
+		{
+			unsigned char* row = imageview::Row(img, yy);
+			int i = 0;
+#ifdef __SSE2__
+			__m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= row_bytes; i += 16)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)&row[i]);
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				__m128i* s = (__m128i*)&sums[i];
+				_mm_storeu_si128(s, _mm_add_epi32(_mm_loadu_si128(s), _mm_unpacklo_epi16(lo, zero)));
+				_mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo, zero)));
+				_mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi, zero)));
+				_mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi, zero)));
+			}
+#endif
+			for (; i < row_bytes; i++)
+				sums[i] += row[i];
+		}
+
+		unsigned char* output = &result[y * new_width * 3];
+		int column_start = 0;
+		int column_end = 0;
+		int carry = 0;
+		for (int x = 0; x < new_width; x++, output += 3)
+		{
+			column_start = column_end;
+			column_end += step;
+			carry += remainder;
+			if (carry >= new_width)
+			{
+				carry -= new_width;
+				column_end++;
+			}
+
+			int b = 0, g = 0, r = 0;
+			int n = column_start * img.channels;
+			for (int xx = column_start; xx < column_end; xx++, n += img.channels)
+			{
+				b += sums[n];
+				g += sums[n + 1];
+				r += sums[n + 2];
+			}
+			int area = rows * (column_end - column_start);
+			if (area > 0)
+			{
+				output[0] = (unsigned char)((b + (area / 2)) / area);
+				output[1] = (unsigned char)((g + (area / 2)) / area);
+				output[2] = (unsigned char)((r + (area / 2)) / area);
+			}
+			else
+			{
+				output[0] = output[1] = output[2] = 0;
+			}
+		}
+	}
+}
+
+/*!
+ * \brief sub-sample an image by a certain factor
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \param factor downsampling factor
+ * \param result downsampled result
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    int bytes_per_pixel,
+    int factor,
+    unsigned char *result)
+{
+	downSample(img, img_width, img_height, bytes_per_pixel, factor, true, result);
+}
+
+/*!
+ * \brief sub-sample an image by a certain factor
+ * \param img image data
+ * \param img_width width of the image
+ * \param img_height height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \param factor downsampling factor
+ * \param vectorise use the vectorised kernels, which give the same result as the scalar ones
+ * \param result downsampled result
+ */
+void processimage::downSample(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    int bytes_per_pixel,
+    int factor,
+    bool vectorise,
+    unsigned char *result)
+{
+    if (factor < 2) return;
+
+    if (factor == 2)
+    {
+        // do a single downsample (half original image size)
+        downSample(img, img_width, img_height, bytes_per_pixel, vectorise, result);
+        return;
+    }
+
+    if ((factor == 4) && vectorise)
+    {
+		switch (bytes_per_pixel)
+		{
+		    case 1: { downSampleBy<1, 4>(img, img_width, img_height, result); return; }
+		    case 3: { downSampleBy<3, 4>(img, img_width, img_height, result); return; }
+		    case 4: { downSampleBy<4, 4>(img, img_width, img_height, result); return; }
+		}
+    }
+    downSampleBy(img, img_width, img_height, bytes_per_pixel, factor, result);
+}
+
+/*!
+ * \brief mirror the given image
+ * \param bmp image data
+ * \param wdth width of the image
+ * \param hght height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \param mirrored mirrored version
+ */
+void processimage::Mirror(
+    unsigned char* bmp,
+    int wdth,
+    int hght,
+    int bytes_per_pixel,
+    unsigned char* mirrored)
+{
+    //unsigned char* mirrored = new unsigned char[wdth * hght * bytes_per_pixel];
+
+    for (int y = 0; y < hght; y++)
+    {
+        int n0 = (y * wdth);
+        for (int x = 0; x < wdth; x++)
+        {
+            int n1 = (n0 + x) * bytes_per_pixel;
+            int x2 = wdth - 1 - x;
+            int n2 = (n0 + x2) * bytes_per_pixel;
+            for (int col = 0; col < bytes_per_pixel; col++)
+                mirrored[n2 + col] = bmp[n1 + col];
+        }
+    }
+}
+
+/*!
+ * \brief flip the given image
+ * \param bmp image data
+ * \param wdth width of the image
+ * \param hght height of the image
+ * \param bytes_per_pixel number of bytes per pixel
+ * \return flipped varesion
+ */
+void processimage::Flip(
+    unsigned char* bmp,
+    int wdth,
+    int hght,
+    int bytes_per_pixel,
+    unsigned char* flipped)
+{
+    //unsigned char* flipped = new unsigned char[wdth * hght * bytes_per_pixel];
+
+    for (int y = 0; y < hght; y++)
+    {
+        int n0 = (y * wdth);
+        for (int x = 0; x < wdth; x++)
+        {
+            int n1 = (n0 + x) * bytes_per_pixel;
+            int n2 = (((hght - 1 - y) * wdth) + x) * bytes_per_pixel;
+            for (int col = 0; col < bytes_per_pixel; col++)
+                flipped[n2 + col] = bmp[n1 + col];
+        }
+    }
+}
+
+
+/*!
+ * \brief Dilate
+ * \param width
+ * \param height
+ * \param bytes_per_pixel
+ * \param radius
+ * \return
+ */
+/*
+void processimage::Dilate(
+    unsigned char* bmp,
+    int width,
+    int height,
+    int bytes_per_pixel,
+    int radius,
+    unsigned char* result)
+{
+    int intensity = 0;
+    int max_intensity = 0;
     int n, n2, n3;
-    int pixels = width * height * bytes_per_pixel;
-
+    int pixels = width * height * bytes_per_pixel;
+
     unsigned char *source = new unsigned char[pixels];
     memcpy(source, bmp, pixels);
-
-    int r = 1;
-
-    for (int j = 0; j < radius; j++)
-    {
-        for (int y = 0; y < height; y++)
-        {
-            for (int x = 0; x < width; x++)
-            {
-                int best_n = 0;
-                max_intensity = 0;
-
-                for (int yy = y - r; yy <= y + r; yy++)
-                {
-                    if ((yy > -1) && (yy < height))
-                    {
-                        n2 = yy * width * bytes_per_pixel;
-                        for (int xx = x - r; xx <= x + r; xx++)
-                        {
-                            if ((xx > -1) && (xx < width))
-                            {
-                                n3 = n2 + (xx * bytes_per_pixel);
-
-                                // get the intensity value of this pixel
-                                intensity = 0;
-                                for (int i = 0; i < bytes_per_pixel; i++)
-                                    intensity += source[n3 + i];
-
-                                //  this the biggest intensity ?
-                                if (intensity > max_intensity)
-                                {
-                                    max_intensity = intensity;
-                                    best_n = n3;
-                                }
-
-                            }
-                        }
-                    }
-                }
-
-                // result pixel
-                n = (((y * width) + x) * bytes_per_pixel);
-                for (int i = 0; i < bytes_per_pixel; i++)
-                    result[n + i] = source[best_n + i];
-            }
-        }
-
+
+    int r = 1;
+
+    for (int j = 0; j < radius; j++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                int best_n = 0;
+                max_intensity = 0;
+
+                for (int yy = y - r; yy <= y + r; yy++)
+                {
+                    if ((yy > -1) && (yy < height))
+                    {
+                        n2 = yy * width * bytes_per_pixel;
+                        for (int xx = x - r; xx <= x + r; xx++)
+                        {
+                            if ((xx > -1) && (xx < width))
+                            {
+                                n3 = n2 + (xx * bytes_per_pixel);
+
+                                // get the intensity value of this pixel
+                                intensity = 0;
+                                for (int i = 0; i < bytes_per_pixel; i++)
+                                    intensity += source[n3 + i];
+
+                                //  this the biggest intensity ?
+                                if (intensity > max_intensity)
+                                {
+                                    max_intensity = intensity;
+                                    best_n = n3;
+                                }
+
+                            }
+                        }
+                    }
+                }
+
+                // result pixel
+                n = (((y * width) + x) * bytes_per_pixel);
+                for (int i = 0; i < bytes_per_pixel; i++)
+                    result[n + i] = source[best_n + i];
+            }
+        }
+
         if (j < radius-1)
-            memcpy(source, result, pixels);
-    }
-    delete[] source;
-}
-*/
-
-/*!
- * \brief ErodeDilate
- * \param width
- * \param height
- * \param radius
- */
-void processimage::ErodeDilate(
-    unsigned char* bmp_mono,
-    int width,
-    int height,
-    int radius,
-    unsigned char* result_erode,
-    unsigned char* result_dilate)
+            memcpy(source, result, pixels);
+    }
+    delete[] source;
+}
+*/
+
+/*!
+ * \brief ErodeDilate
+ * \param width
+ * \param height
+ * \param radius
+ */
+void processimage::ErodeDilate(
+    unsigned char* bmp_mono,
+    int width,
+    int height,
+    int radius,
+    unsigned char* result_erode,
+    unsigned char* result_dilate)
 {
 	int pixels = width * height;
     unsigned char *source_erode = new unsigned char[pixels];
@@ -580,424 +1019,504 @@ void processimage::ErodeDilate(
 
     unsigned char *source_dilate = new unsigned char[pixels];
     memcpy(source_dilate, bmp_mono, pixels);
-
-    for (int r = 0; r < radius; r++)
-    {
-        int n = 0;
-        for (int y = 0; y < height; y++)
-        {
-            for (int x = 0; x < width; x++)
-            {
-                for (int i = 0; i < 2; i++)
-                {
-                    if (i == 0)
-                    {
-                        if (x > 0)
-                        {
-                            // left
-                            if (source_dilate[n - 1] > source_dilate[n])
-                                result_dilate[n] = source_dilate[n - 1];
-                            else
-                                result_dilate[n] = source_dilate[n];
-
-                            // top left
-                            if (y > 0)
-                                if (source_dilate[n - width - 1] > result_dilate[n]) result_dilate[n] = source_dilate[n - width - 1];
-
-                            // bottom left
-                            if (y < height - 1)
-                                if (source_dilate[n + width - 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + width - 1];
-                        }
-
-                        if (x < width - 1)
-                        {
-                            // right
-                            if (source_dilate[n + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + 1];
-
-                            // top right
-                            if (y > 0)
-                                if (source_dilate[n - width + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n - width + 1];
-
-                            // bottom right
-                            if (y < height - 1)
-                                if (source_dilate[n + width + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + width + 1];
-                        }
-
-                        // above
-                        if (y > 0)
-                            if (source_dilate[n - width] > result_dilate[n]) result_dilate[n] = source_dilate[n - width];
-
-                        // below
-                        if (y < height - 1)
-                            if (source_dilate[n + width] > result_dilate[n]) result_dilate[n] = source_dilate[n + width];
-                    }
-                    else
-                    {
-                        if (x > 0)
-                        {
-                            if (source_erode[n - 1] < source_erode[n])
-                                result_erode[n] = source_erode[n - 1];
-                            else
-                                result_erode[n] = source_erode[n];
-
-                            if (y > 0)
-                                if (source_erode[n - width - 1] < result_erode[n]) result_erode[n] = source_erode[n - width - 1];
-                            if (y < height - 1)
-                                if (source_erode[n + width - 1] < result_erode[n]) result_erode[n] = source_erode[n + width - 1];
-                        }
-
-                        if (x < width - 1)
-                        {
-                            if (source_erode[n + 1] < result_erode[n]) result_erode[n] = source_erode[n + 1];
-
-                            if (y > 0)
-                                if (source_erode[n - width + 1] < result_erode[n]) result_erode[n] = source_erode[n - width + 1];
-                            if (y < height - 1)
-                                if (source_erode[n + width + 1] < result_erode[n]) result_erode[n] = source_erode[n + width + 1];
-                        }
-
-                        if (y > 0)
-                            if (source_erode[n - width] < result_erode[n]) result_erode[n] = source_erode[n - width];
-                        if (y < height - 1)
-                            if (source_erode[n + width] < result_erode[n]) result_erode[n] = source_erode[n + width];
-                    }
-
-                }
-
-                n++;
-            }
-        }
-
+
+    for (int r = 0; r < radius; r++)
+    {
+        int n = 0;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                for (int i = 0; i < 2; i++)
+                {
+                    if (i == 0)
+                    {
+                        if (x > 0)
+                        {
+                            // left
+                            if (source_dilate[n - 1] > source_dilate[n])
+                                result_dilate[n] = source_dilate[n - 1];
+                            else
+                                result_dilate[n] = source_dilate[n];
+
+                            // top left
+                            if (y > 0)
+                                if (source_dilate[n - width - 1] > result_dilate[n]) result_dilate[n] = source_dilate[n - width - 1];
+
+                            // bottom left
+                            if (y < height - 1)
+                                if (source_dilate[n + width - 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + width - 1];
+                        }
+
+                        if (x < width - 1)
+                        {
+                            // right
+                            if (source_dilate[n + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + 1];
+
+                            // top right
+                            if (y > 0)
+                                if (source_dilate[n - width + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n - width + 1];
+
+                            // bottom right
+                            if (y < height - 1)
+                                if (source_dilate[n + width + 1] > result_dilate[n]) result_dilate[n] = source_dilate[n + width + 1];
+                        }
+
+                        // above
+                        if (y > 0)
+                            if (source_dilate[n - width] > result_dilate[n]) result_dilate[n] = source_dilate[n - width];
+
+                        // below
+                        if (y < height - 1)
+                            if (source_dilate[n + width] > result_dilate[n]) result_dilate[n] = source_dilate[n + width];
+                    }
+                    else
+                    {
+                        if (x > 0)
+                        {
+                            if (source_erode[n - 1] < source_erode[n])
+                                result_erode[n] = source_erode[n - 1];
+                            else
+                                result_erode[n] = source_erode[n];
+
+                            if (y > 0)
+                                if (source_erode[n - width - 1] < result_erode[n]) result_erode[n] = source_erode[n - width - 1];
+                            if (y < height - 1)
+                                if (source_erode[n + width - 1] < result_erode[n]) result_erode[n] = source_erode[n + width - 1];
+                        }
+
+                        if (x < width - 1)
+                        {
+                            if (source_erode[n + 1] < result_erode[n]) result_erode[n] = source_erode[n + 1];
+
+                            if (y > 0)
+                                if (source_erode[n - width + 1] < result_erode[n]) result_erode[n] = source_erode[n - width + 1];
+                            if (y < height - 1)
+                                if (source_erode[n + width + 1] < result_erode[n]) result_erode[n] = source_erode[n + width + 1];
+                        }
+
+                        if (y > 0)
+                            if (source_erode[n - width] < result_erode[n]) result_erode[n] = source_erode[n - width];
+                        if (y < height - 1)
+                            if (source_erode[n + width] < result_erode[n]) result_erode[n] = source_erode[n + width];
+                    }
+
+                }
+
+                n++;
+            }
+        }
+
         if (r < radius - 1)
         {
 	        memcpy(source_erode, result_erode, pixels);
 	        memcpy(source_dilate, result_dilate, pixels);
-        }
-    }
-    delete[] source_erode;
-    delete[] source_dilate;
-}
-
-/*!
- * \brief Opening
- * \param width
- * \param height
- * \param radius
- * \return
- */
-void processimage::Opening(
-    unsigned char* bmp,
-    int width,
-    int height,
-    unsigned char* buffer,
-    int radius,
-    unsigned char* result)
-{
-	unsigned char *img1 = new unsigned char[width * height];
-    Erode(bmp, width, height, buffer, radius, img1);
-    Dilate(img1, width, height, buffer, radius, result);
-    delete[] img1;
-}
-
-/*!
- * \brief Closing
- * \param width
- * \param height
- * \param radius
- * \return
- */
-void processimage::Closing(
-    unsigned char* bmp,
-    int width,
-    int height,
-    unsigned char* buffer,
-    int radius,
-    unsigned char* result)
-{
-	unsigned char *img1 = new unsigned char[width * height];
-    Dilate(bmp, width, height, buffer, radius, img1);
-    Erode(img1, width, height, buffer, radius, result);
-    delete[] img1;
-}
-
-/*!
- * \brief Dilate
- * \param width
- * \param height
- * \param radius
- * \return
- */
-void processimage::Dilate(
-    unsigned char* bmp,
-    int width,
-    int height,
-    unsigned char* buffer,
-    int radius,
-    unsigned char* result)
-{
-    int pixels = width * height;
-
-    memcpy(buffer, bmp, pixels);
-
-    int n;
-    unsigned char v;
-    int min = width + 1;
-    int max = pixels - width - 1;
-    for (int r = 0; r < radius; r++)
-    {
-        for (int i = min; i < max; i++)
-        {
-            v = buffer[i];
-
-            // same row
-            if (buffer[i - 1] > v) v = buffer[i - 1];
-            if (buffer[i + 1] > v) v = buffer[i + 1];
-
-            // row above
-            n = i - width - 1;
-            if (buffer[n] > v) v = buffer[n];
-            n++;
-            if (buffer[n] > v) v = buffer[n];
-            n++;
-            if (buffer[n] > v) v = buffer[n];
-
-            // row below
-            n = i + width - 1;
-            if (buffer[n] > v) v = buffer[n];
-            n++;
-            if (buffer[n] > v) v = buffer[n];
-            n++;
-            if (buffer[n] > v) v = buffer[n];
-
-            result[i] = v;
-        }
-
-        if (r < radius - 1)
-	        memcpy(buffer, result, pixels);
-    }
-}
-
-/*!
- * \brief Erode
- * \param width
- * \param height
- * \param radius
- * \return
- */
-void processimage::Erode(
-    unsigned char* bmp,
-    int width,
-    int height,
-    unsigned char* buffer,
-    int radius,
-    unsigned char* result)
+        }
+    }
+    delete[] source_erode;
+    delete[] source_dilate;
+}
+
+#ifdef __SSE2__
+static inline __m128i SelectSSE2(__m128i a, __m128i b, bool maximum)
 {
-	int pixels = width * height;
-
-    memcpy(buffer, bmp, pixels);
-
-    int n;
-    unsigned char v;
-    int min = width + 1;
-    int max = pixels - width - 1;
-    for (int r = 0; r < radius; r++)
-    {
-        for (int i = min; i < max; i++)
-        {
-            v = buffer[i];
-
-            // same row
-            if (buffer[i - 1] < v) v = buffer[i - 1];
-            if (buffer[i + 1] < v) v = buffer[i + 1];
-
-            // row above
-            n = i - width - 1;
-            if (buffer[n] < v) v = buffer[n];
-            n++;
-            if (buffer[n] < v) v = buffer[n];
-            n++;
-            if (buffer[n] < v) v = buffer[n];
-
-            // row below
-            n = i + width - 1;
-            if (buffer[n] < v) v = buffer[n];
-            n++;
-            if (buffer[n] < v) v = buffer[n];
-            n++;
-            if (buffer[n] < v) v = buffer[n];
-
-            result[i] = v;
-        }
-
-        if (r < radius - 1)
-        {
-	        memcpy(buffer, result, pixels);
-        }
-    }
-}
-
-
-/*!
- * \brief returns a sub image from a larger image
- * \param img large image
- * \param img_width width of the large image
- * \param img_height height of the large image
- * \param bytes_per_pixel bytes per pixel
- * \param tx sub image top left x
- * \param ty sub image top left y
- * \param bx sub image bottom right x
- * \param by sub image bottom right y
- * \return
- */
-void processimage::createSubImage(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    int bytes_per_pixel,
-    int tx,
-    int ty,
-    int bx,
+	return(maximum ? _mm_max_epu8(a, b) : _mm_min_epu8(a, b));
+}
+#endif
+
+/*!
+ * \brief elementwise minimum or maximum of two rows
+ * \param a first row
+ * \param b second row
+ * \param length number of bytes
+ * \param result returned row, which may be the same as either input
+ */
+template <bool MAXIMUM>
+static inline void SelectRows(
+    const unsigned char* a,
+    const unsigned char* b,
+    int length,
+    unsigned char* result)
+{
+	int i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= length; i += 16)
+		_mm_storeu_si128((__m128i*)&result[i],
+		    SelectSSE2(_mm_loadu_si128((const __m128i*)&a[i]), _mm_loadu_si128((const __m128i*)&b[i]), MAXIMUM));
+#endif
+	for (; i < length; i++)
+		result[i] = MAXIMUM ? ((a[i] > b[i]) ? a[i] : b[i]) : ((a[i] < b[i]) ? a[i] : b[i]);
+}
+
+/*!
+ * \brief minimum or maximum within a square window using the van Herk /
+ *        Gil-Werman algorithm, with a cost per pixel which does not depend
+ *        upon the radius.
+ *
+ * The filter is separable.  Each row is divided into blocks of the
+ * window size, within which running values are taken forwards and
+ * backwards, so that any window spanning two blocks is the combination
+ * of one value from each.  The backward values go into the buffer and
+ * the forward values into the result, so no memory is needed beyond
+ * the buffer and the result.  The vertical
+ * pass does the same with whole rows, which are combined using SIMD,
+ * keeping its running row in the first row of the buffer.  Pixels beyond
+ * the image do not take part, so windows at the border are clipped.
+ * \param bmp mono image
+ * \param width width of the image
+ * \param height height of the image
+ * \param buffer holds the horizontal pass, the same size as the image
+ * \param radius radius of the window
+ * \param result returned image, which may be the same as bmp
+ */
+template <bool MAXIMUM>
+void processimage::rankFilter(
+    const unsigned char* bmp,
+    int width,
+    int height,
+    unsigned char* buffer,
+    int radius,
+    unsigned char* result)
+{
+	if ((radius < 1) || (width < 1) || (height < 1)) return;
+
+	unsigned char neutral = MAXIMUM ? 0 : 255;
+	int window = (radius * 2) + 1;
+
+	// horizontal pass.  Index p of the padded row is pixel p - radius,
+	// or neutral beyond the image.
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* row = &bmp[y * width];
+		unsigned char* output = &buffer[y * width];
+
+		// backwards within each block, the last of which may extend beyond the outputs
+		for (int block = ((width - 1) / window) * window; block >= 0; block -= window)
+		{
+			unsigned char value = neutral;
+			int p = block + window - 1;
+			for (; p >= width; p--)
+			{
+				int x = p - radius;
+				if ((x >= 0) && (x < width))
+					value = MAXIMUM ? ((row[x] > value) ? row[x] : value) : ((row[x] < value) ? row[x] : value);
+			}
+			int start = (block > radius) ? block : radius;
+			for (; p >= start; p--)
+			{
+				unsigned char v = row[p - radius];
+				value = MAXIMUM ? ((v > value) ? v : value) : ((v < value) ? v : value);
+				output[p] = value;
+			}
+			for (; p >= block; p--)
+				output[p] = value;
+		}
+
+		// then forwards, radius * 2 ahead of the output.  Index radius * 2
+		// is within the first block, and the blocks which follow start
+		// at outputs 1, window + 1 and so on.  The running values go into
+		// the result row, which trails the pixels still to be read even
+		// when filtering in place.
+		unsigned char* forward = &result[y * width];
+		unsigned char value = neutral;
+		for (int x = 0; (x < radius) && (x < width); x++)
+			value = MAXIMUM ? ((row[x] > value) ? row[x] : value) : ((row[x] < value) ? row[x] : value);
+		int x = 0;
+		int block_start = 1;
+		while (x < width)
+		{
+			if (x == block_start)
+			{
+				value = neutral;
+				block_start += window;
+			}
+			int end = (block_start < width) ? block_start : width;
+			int inside = (end < width - radius) ? end : (width - radius);
+			for (; x < inside; x++)
+			{
+				unsigned char v = row[x + radius];
+				value = MAXIMUM ? ((v > value) ? v : value) : ((v < value) ? v : value);
+				forward[x] = value;
+			}
+			for (; x < end; x++)
+				forward[x] = value;
+		}
+		SelectRows<MAXIMUM>(forward, output, width, output);
+	}
+
+	// vertical pass.  Row p of the padded image is row p - radius of the
+	// horizontal pass, or neutral beyond the image.  Backwards within each
+	// block into the result, the last row also covering the rest of its block.
+	int last_block_end = (((height - 1) / window) * window) + window - 1;
+	for (int p = height - 1; p >= 0; p--)
+	{
+		int y = p - radius;
+		unsigned char* output = &result[p * width];
+		bool block_end = ((p % window == window - 1) || (p == height - 1));
+		if (y >= 0)
+		{
+			if (block_end)
+				memcpy(output, &buffer[y * width], width);
+			else
+				SelectRows<MAXIMUM>(&buffer[y * width], &output[width], width, output);
+		}
+		else
+		{
+			if (block_end)
+				memset(output, neutral, width);
+			else
+				memcpy(output, &output[width], width);
+		}
+		if (p == height - 1)
+		{
+			for (int q = p + 1; (q <= last_block_end) && (q - radius < height); q++)
+				if (q - radius >= 0)
+					SelectRows<MAXIMUM>(&buffer[(q - radius) * width], output, width, output);
+		}
+	}
+
+	// then forwards, radius * 2 rows ahead of the output.  Row zero of the
+	// horizontal pass is not needed again, so it holds the running row.
+	unsigned char* forward = buffer;
+	for (int y = 1; (y <= radius) && (y < height); y++)
+		SelectRows<MAXIMUM>(&buffer[y * width], forward, width, forward);
+	for (int y = 0; y < height; y++)
+	{
+		if (y > 0)
+		{
+			int p = y + (radius * 2);
+			int row = y + radius;
+			if (p % window == 0)
+			{
+				if (row < height)
+					memcpy(forward, &buffer[row * width], width);
+				else
+					memset(forward, neutral, width);
+			}
+			else
+			{
+				if (row < height)
+					SelectRows<MAXIMUM>(&buffer[row * width], forward, width, forward);
+			}
+		}
+		SelectRows<MAXIMUM>(&result[y * width], forward, width, &result[y * width]);
+	}
+}
+
+/*!
+ * \brief Opening
+ * \param width
+ * \param height
+ * \param buffer temporary buffer the same size as the image
+ * \param radius
+ * \return
+ */
+void processimage::Opening(
+    unsigned char* bmp,
+    int width,
+    int height,
+    unsigned char* buffer,
+    int radius,
+    unsigned char* result)
+{
+    Erode(bmp, width, height, buffer, radius, result);
+    Dilate(result, width, height, buffer, radius, result);
+}
+
+/*!
+ * \brief Closing
+ * \param width
+ * \param height
+ * \param buffer temporary buffer the same size as the image
+ * \param radius
+ * \return
+ */
+void processimage::Closing(
+    unsigned char* bmp,
+    int width,
+    int height,
+    unsigned char* buffer,
+    int radius,
+    unsigned char* result)
+{
+    Dilate(bmp, width, height, buffer, radius, result);
+    Erode(result, width, height, buffer, radius, result);
+}
+
+/*!
+ * \brief Dilate, taking the maximum within a square of side (radius * 2) + 1
+ * \param width
+ * \param height
+ * \param buffer temporary buffer the same size as the image
+ * \param radius
+ * \param result dilated image, which may be the same as bmp
+ */
+void processimage::Dilate(
+    unsigned char* bmp,
+    int width,
+    int height,
+    unsigned char* buffer,
+    int radius,
+    unsigned char* result)
+{
+	rankFilter<true>(bmp, width, height, buffer, radius, result);
+}
+
+/*!
+ * \brief Erode, taking the minimum within a square of side (radius * 2) + 1
+ * \param width
+ * \param height
+ * \param buffer temporary buffer the same size as the image
+ * \param radius
+ * \param result eroded image, which may be the same as bmp
+ */
+void processimage::Erode(
+    unsigned char* bmp,
+    int width,
+    int height,
+    unsigned char* buffer,
+    int radius,
+    unsigned char* result)
+{
+	rankFilter<false>(bmp, width, height, buffer, radius, result);
+}
+
+
+/*!
+ * \brief returns a sub image from a larger image
+ * \param img large image
+ * \param img_width width of the large image
+ * \param img_height height of the large image
+ * \param bytes_per_pixel bytes per pixel
+ * \param tx sub image top left x
+ * \param ty sub image top left y
+ * \param bx sub image bottom right x
+ * \param by sub image bottom right y
+ * \return
+ */
+void processimage::createSubImage(
+    unsigned char* img,
+    int img_width,
+    int img_height,
+    int bytes_per_pixel,
+    int tx,
+    int ty,
+    int bx,
     int by,
-    unsigned char* subimage)
-{
-	int pixels = img_width * img_height * bytes_per_pixel;
-    int sub_width = bx - tx;
-    int sub_height = by - ty;
-    for (int y = 0; y < sub_height; y++)
-    {
-        for (int x = 0; x < sub_width; x++)
-        {
-            int n1 = ((y * sub_width) + x) * bytes_per_pixel;
-            int n2 = (((y+ty) * img_width) + (x+tx)) * bytes_per_pixel;
-
-            if ((n2 > -1) && (n2 < pixels - 3))
-            {
-                for (int col = 0; col < bytes_per_pixel; col++)
-                    subimage[n1 + col] = img[n2 + col];
-            }
-        }
-    }
-}
-
-/*!
- * \brief returns a sub image from a larger image
- * \param img large image
- * \param img_width width of the large image
- * \param img_height height of the large image
- * \param bytes_per_pixel bytes per pixel
- * \param tx sub image top left x
- * \param ty sub image top left y
- * \param bx sub image bottom right x
+    unsigned char* subimage)
+{
+	int pixels = img_width * img_height * bytes_per_pixel;
+    int sub_width = bx - tx;
+    int sub_height = by - ty;
+    for (int y = 0; y < sub_height; y++)
+    {
+        for (int x = 0; x < sub_width; x++)
+        {
+            int n1 = ((y * sub_width) + x) * bytes_per_pixel;
+            int n2 = (((y+ty) * img_width) + (x+tx)) * bytes_per_pixel;
+
+            if ((n2 > -1) && (n2 < pixels - 3))
+            {
+                for (int col = 0; col < bytes_per_pixel; col++)
+                    subimage[n1 + col] = img[n2 + col];
+            }
+        }
+    }
+}
+
+/*!
+ * \brief returns a sub image from a larger image
+ * \param img large image
+ * \param img_width width of the large image
+ * \param img_height height of the large image
+ * \param bytes_per_pixel bytes per pixel
+ * \param tx sub image top left x
+ * \param ty sub image top left y
+ * \param bx sub image bottom right x
  * \param by sub image bottom right y
- * \param subimage cropped image
- */
-void processimage::cropImage(
-    unsigned char* img,
-    int img_width,
-    int img_height,
-    int bytes_per_pixel,
-    int tx,
-    int ty,
-    int bx,
-    int by,
-    unsigned char* subimage)
-{
-    int sub_width = bx - tx;
-    int sub_height = by - ty;
-	int pixels = img_width * img_height * bytes_per_pixel;
-
-    for (int y = 0; y < sub_height; y++)
-    {
-        for (int x = 0; x < sub_width; x++)
-        {
-            int n1 = ((y * sub_width) + x) * bytes_per_pixel;
-            int n2 = (((y + ty) * img_width) + (x + tx)) * bytes_per_pixel;
-
-            if ((n2 > -1) && (n2 < pixels - bytes_per_pixel))
-            {
-                for (int col = 0; col < bytes_per_pixel; col++)
-                    subimage[n1 + col] = img[n2 + col];
-            }
-        }
-    }
-}
-
-
-/*!
- * \brief returns TRUE if the given image  blank
- * \param img image data to be examined
- * \param step_size step size with which to sample the image
- * \return true if the image  blank
- */
-bool processimage::IsBlank(
-    unsigned char* img, int img_width, int img_height, int bytes_per_pixel,
-    int step_size)
-{
-	int pixels = img_width * img_height * bytes_per_pixel;
-    bool is_blank = true;
-    int i = 0;
-    while ((i < pixels) && (is_blank))
-    {
-        if (img[i] > 0) is_blank = false;
-        i += step_size;
-    }
-    return (is_blank);
-}
-
-
-
-// ********** private methods **********
-
-
-
-/*!
- * \brief sub-sample a mono image to half its original size, summing pixel values
- * \param img image data (one byte per pixel)
- * \param img_width width of the image
- * \param img_height height of the image
- * \param bytes_per_pixel number of bytes per pixel
- * \return image of half the size
- */
-void processimage::downSampleSum(
-    int* img,
-    int img_width,
-    int img_height,
+ * \param subimage cropped image
+ */
+void processimage::cropImage(
+    unsigned char* img,
+    int img_width,
+    int img_height,
     int bytes_per_pixel,
-    int *result)
-{
-    int new_width = img_width / 2;
-    int new_height = img_height / 2;
-
-    if (!((new_width == img_width) && (new_height == img_height)))
-    {
-        if (bytes_per_pixel == 1)
-        {
-            // mono image
-            int yy = 0;
-            //int stride = img_width;
-            int tot_pixels = img_width * img_height;
-            for (int y = 0; y < new_height - 1; y++)
-            {
-                int n = y * new_width;
-                int xx = yy * img_width;
-                int xx2 = xx + img_width;
-                for (int x = 0; x < new_width - 1; x++)
-                {
-                    if (xx2 + 1 < tot_pixels)
-                    {
-                        int v = img[xx] + img[xx + 1] +
-                                img[xx2] + img[xx2 + 1];
-
-                        result[n] = v;
-                    }
-                    n++;
-                    xx += 2;
-                    xx2 += 2;
-                }
-                yy += 2;
-            }
-        }
-    }
-
-}
-
+    int tx,
+    int ty,
+    int bx,
+    int by,
+    unsigned char* subimage)
+{
+    int sub_width = bx - tx;
+    int sub_height = by - ty;
+	int pixels = img_width * img_height * bytes_per_pixel;
+
+    for (int y = 0; y < sub_height; y++)
+    {
+        for (int x = 0; x < sub_width; x++)
+        {
+            int n1 = ((y * sub_width) + x) * bytes_per_pixel;
+            int n2 = (((y + ty) * img_width) + (x + tx)) * bytes_per_pixel;
+
+            if ((n2 > -1) && (n2 < pixels - bytes_per_pixel))
+            {
+                for (int col = 0; col < bytes_per_pixel; col++)
+                    subimage[n1 + col] = img[n2 + col];
+            }
+        }
+    }
+}
+
+/*!
+ * \brief copies a region of the given image into a tightly packed buffer
+ * \param img image, which may be a region of a larger image
+ * \param tx top left x coordinate
+ * \param ty top left y coordinate
+ * \param bx bottom right x coordinate (exclusive)
+ * \param by bottom right y coordinate (exclusive)
+ * \param subimage returned image of size (bx-tx) x (by-ty), with pixels outside of the image left unchanged
+ */
+void processimage::cropImage(
+    const image_view &img,
+    int tx,
+    int ty,
+    int bx,
+    int by,
+    unsigned char* subimage)
+{
+	int sub_row_bytes = (bx - tx) * img.channels;
+	image_view region = imageview::SubImage(img, tx, ty, bx, by);
+	int offset_x = 0;
+	int offset_y = 0;
+	if (tx < 0) offset_x = -tx;
+	if (ty < 0) offset_y = -ty;
+
+    for (int y = 0; y < region.height; y++)
+    {
+    	memcpy(&subimage[((y + offset_y) * sub_row_bytes) + (offset_x * img.channels)],
+    	       imageview::Row(region, y),
+    	       region.width * img.channels);
+    }
+}
+
+
+/*!
+ * \brief returns TRUE if the given image  blank
+ * \param img image data to be examined
+ * \param step_size step size with which to sample the image
+ * \return true if the image  blank
+ */
+bool processimage::IsBlank(
+    unsigned char* img, int img_width, int img_height, int bytes_per_pixel,
+    int step_size)
+{
+	int pixels = img_width * img_height * bytes_per_pixel;
+    bool is_blank = true;
+    int i = 0;
+    while ((i < pixels) && (is_blank))
+    {
+        if (img[i] > 0) is_blank = false;
+        i += step_size;
+    }
+    return (is_blank);
+}
@@ -0,0 +1,230 @@
+/*
+    per-stage latency measurement
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "profiler.h"
+
+bool profiler::enabled = false;
+pthread_mutex_t profiler::mutex = PTHREAD_MUTEX_INITIALIZER;
+int profiler::calls[PROFILE_STAGES];
+double profiler::total[PROFILE_STAGES];
+float profiler::reservoir[PROFILE_STAGES][PROFILE_RESERVOIR];
+unsigned int profiler::random_state = 2463534242u;
+const char* profiler::stage_names[PROFILE_STAGES] = {
+	"Read",
+	"Find",
+	"ColourFilter",
+	"ErodeDilate",
+	"Canny",
+	"GetGroups",
+	"PerimeterFitting",
+	"ExtractPlateImages",
+	"Binarise",
+	"SeparateCharacters",
+	"RemoveStragglers",
+	"Resample",
+	"RecognizeCharacters",
+	"JpegDecode"
+};
+
+/*!
+ * \brief turns timing on or off
+ * \param enable true to record durations
+ */
+void profiler::Enable(bool enable)
+{
+	enabled = enable;
+}
+
+/*!
+ * \brief discards all recorded durations
+ */
+void profiler::Clear()
+{
+	pthread_mutex_lock(&mutex);
+	for (int stage = 0; stage < PROFILE_STAGES; stage++)
+	{
+		calls[stage] = 0;
+		total[stage] = 0;
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief returns the current time, to be passed to Stop at the end of the stage
+ * \return time in milliseconds, or zero if timing is disabled
+ */
+double profiler::Start()
+{
+	if (!enabled) return(0);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return((now.tv_sec * 1000.0) + (now.tv_nsec / 1000000.0));
+}
+
+/*!
+ * \brief records the time elapsed since Start was called.  Once the
+ *        reservoir for the stage is full, each new duration replaces
+ *        a random one with a probability which keeps every call
+ *        equally likely to be retained.
+ * \param stage the stage being timed, eg. PROFILE_CANNY
+ * \param start_time value returned by Start
+ */
+void profiler::Stop(
+    int stage,
+    double start_time)
+{
+	if (!enabled) return;
+
+	float elapsed = (float)(Start() - start_time);
+	pthread_mutex_lock(&mutex);
+	int n = calls[stage]++;
+	total[stage] += elapsed;
+	if (n < PROFILE_RESERVOIR)
+	{
+		reservoir[stage][n] = elapsed;
+	}
+	else
+	{
+		// xorshift, so that the global rand sequence is left alone
+		random_state ^= random_state << 13;
+		random_state ^= random_state >> 17;
+		random_state ^= random_state << 5;
+		unsigned int index = random_state % (unsigned int)(n + 1);
+		if (index < PROFILE_RESERVOIR) reservoir[stage][index] = elapsed;
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief returns the number of durations recorded for the given stage
+ * \param stage the stage
+ */
+int profiler::Samples(int stage)
+{
+	pthread_mutex_lock(&mutex);
+	int samples = calls[stage];
+	pthread_mutex_unlock(&mutex);
+	return(samples);
+}
+
+/*!
+ * \brief copies the retained durations for the given stage
+ * \param stage the stage
+ * \param samples array of at least PROFILE_RESERVOIR durations to be filled
+ * \return number of durations copied
+ */
+int profiler::Retained(
+    int stage,
+    float* samples)
+{
+	int n = calls[stage];
+	if (n > PROFILE_RESERVOIR) n = PROFILE_RESERVOIR;
+	memcpy(samples, reservoir[stage], n * sizeof(float));
+	return(n);
+}
+
+/*!
+ * \brief returns a percentile of the recorded durations for the given stage
+ * \param stage the stage
+ * \param percentile percentile in the range 0-100
+ * \return duration in milliseconds
+ */
+float profiler::Percentile(
+    int stage,
+    float percentile)
+{
+	float samples[PROFILE_RESERVOIR];
+	pthread_mutex_lock(&mutex);
+	int n = Retained(stage, samples);
+	pthread_mutex_unlock(&mutex);
+
+	std::sort(samples, samples + n);
+	return(SortedPercentile(samples, n, percentile));
+}
+
+/*!
+ * \brief returns a percentile of the given samples using the nearest rank
+ * \param samples durations
+ * \param percentile percentile in the range 0-100
+ * \return percentile value, or zero if there are no samples
+ */
+float profiler::Percentile(
+    std::vector<float> samples,
+    float percentile)
+{
+	std::sort(samples.begin(), samples.end());
+	return(SortedPercentile(samples.empty() ? NULL : &samples[0], (int)samples.size(), percentile));
+}
+
+/*!
+ * \brief returns a percentile of samples which are already sorted, using the nearest rank
+ * \param sorted durations in ascending order
+ * \param samples number of durations
+ * \param percentile percentile in the range 0-100
+ * \return percentile value, or zero if there are no samples
+ */
+float profiler::SortedPercentile(
+    const float* sorted,
+    int samples,
+    float percentile)
+{
+	float result = 0;
+	if (samples > 0)
+	{
+		int rank = (int)(percentile * samples / 100.0f + 0.5f) - 1;
+		if (rank < 0) rank = 0;
+		if (rank >= samples) rank = samples - 1;
+		result = sorted[rank];
+	}
+	return(result);
+}
+
+/*!
+ * \brief writes a table of latency percentiles for each stage
+ * \param out stream to write to
+ */
+void profiler::Report(std::ostream &out)
+{
+	char line[128];
+	sprintf(line, "%-20s %8s %10s %10s %10s %10s", "stage (mSec)", "calls", "mean", "p50", "p95", "p99");
+	out << line << std::endl;
+
+	float samples[PROFILE_RESERVOIR];
+	for (int stage = 0; stage < PROFILE_STAGES; stage++)
+	{
+		pthread_mutex_lock(&mutex);
+		int stage_calls = calls[stage];
+		double stage_total = total[stage];
+		int n = Retained(stage, samples);
+		pthread_mutex_unlock(&mutex);
+
+		if (stage_calls > 0)
+		{
+			// sorted once for all three percentiles
+			std::sort(samples, samples + n);
+			sprintf(line, "%-20s %8d %10.3f %10.3f %10.3f %10.3f",
+			        stage_names[stage], stage_calls, stage_total / stage_calls,
+			        SortedPercentile(samples, n, 50),
+			        SortedPercentile(samples, n, 95),
+			        SortedPercentile(samples, n, 99));
+			out << line << std::endl;
+		}
+	}
+}
@@ -0,0 +1,90 @@
+/*
+    per-stage latency measurement
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// stages of the anpr::Read pipeline
+#define PROFILE_READ              0
+#define PROFILE_FIND              1
+#define PROFILE_COLOUR_FILTER     2
+#define PROFILE_ERODE_DILATE      3
+#define PROFILE_CANNY             4
+#define PROFILE_GROUPS            5
+#define PROFILE_PERIMETERS        6
+#define PROFILE_EXTRACT           7
+#define PROFILE_BINARISE          8
+#define PROFILE_SEPARATE          9
+#define PROFILE_STRAGGLERS       10
+#define PROFILE_RESAMPLE         11
+#define PROFILE_OCR              12
+#define PROFILE_DECODE           13
+#define PROFILE_STAGES           14
+
+// durations retained per stage for estimating percentiles
+#define PROFILE_RESERVOIR      1024
+
+/*!
+ * \brief records the duration of each stage of the pipeline
+ *
+ * Timing is disabled by default, in which case Start and Stop return
+ * immediately without reading the clock.  Durations are measured
+ * with the monotonic clock in milliseconds.  Stages which run inside
+ * loops record one sample per call.  The number of calls and their
+ * total are exact, while percentiles come from a uniform random sample
+ * of up to PROFILE_RESERVOIR durations, so memory use does not grow
+ * with the number of calls.
+ */
+class profiler
+{
+private:
+	static bool enabled;
+	static pthread_mutex_t mutex;
+	static int calls[PROFILE_STAGES];
+	static double total[PROFILE_STAGES];
+	static float reservoir[PROFILE_STAGES][PROFILE_RESERVOIR];
+	static unsigned int random_state;
+	static const char* stage_names[PROFILE_STAGES];
+
+	static int Retained(int stage, float* samples);
+	static float SortedPercentile(const float* sorted, int samples, float percentile);
+
+public:
+	static void Enable(bool enable);
+	static bool Enabled() { return(enabled); }
+	static void Clear();
+
+	static double Start();
+	static void Stop(int stage, double start_time);
+
+	static int Samples(int stage);
+	static float Percentile(int stage, float percentile);
+	static float Percentile(std::vector<float> samples, float percentile);
+	static void Report(std::ostream &out);
+};
+
+#endif /* PROFILER_H_ */
@@ -0,0 +1,161 @@
+/*
+    pool of worker threads
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadpool.h"
+
+/*!
+ * \brief starts the worker threads
+ * \param no_of_threads number of threads which run jobs, including the caller of Run
+ */
+ThreadPool::ThreadPool(
+    int no_of_threads)
+{
+	if (no_of_threads < 1) no_of_threads = 1;
+
+	stopping = false;
+	job = NULL;
+	job_argument = NULL;
+	no_of_jobs = 0;
+	next_job = 0;
+	jobs_completed = 0;
+	batch = 0;
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&batch_started, NULL);
+	pthread_cond_init(&batch_completed, NULL);
+
+	// only the workers which started are counted, and the caller runs
+	// whatever jobs they do not
+	this->no_of_threads = no_of_threads;
+	workers = new pthread_t[no_of_threads];
+	no_of_workers = 0;
+	for (int t = 0; t < no_of_threads - 1; t++)
+	{
+		if (pthread_create(&workers[no_of_workers], NULL, WorkerThread, this) == 0)
+			no_of_workers++;
+	}
+}
+
+/*!
+ * \brief stops the worker threads
+ */
+ThreadPool::~ThreadPool()
+{
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&batch_started);
+	pthread_mutex_unlock(&mutex);
+
+	for (int t = 0; t < no_of_workers; t++)
+		pthread_join(workers[t], NULL);
+	delete[] workers;
+
+	pthread_cond_destroy(&batch_completed);
+	pthread_cond_destroy(&batch_started);
+	pthread_mutex_destroy(&mutex);
+}
+
+/*!
+ * \brief returns the number of threads requested when the pool was created,
+ *        including the caller of Run.  Fewer may run jobs if some could not be started.
+ */
+int ThreadPool::Threads()
+{
+	return(no_of_threads);
+}
+
+void* ThreadPool::WorkerThread(void* pool)
+{
+	((ThreadPool*)pool)->Work();
+	return(NULL);
+}
+
+/*!
+ * \brief runs jobs from each batch until the pool is stopped
+ */
+void ThreadPool::Work()
+{
+	pthread_mutex_lock(&mutex);
+	unsigned int last_batch = 0;
+	while (true)
+	{
+		while ((!stopping) && (batch == last_batch))
+			pthread_cond_wait(&batch_started, &mutex);
+		if (stopping) break;
+		last_batch = batch;
+		RunJobs();
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*!
+ * \brief runs jobs from the current batch until none remain.
+ *        The mutex is held on entry and on return.
+ */
+void ThreadPool::RunJobs()
+{
+	while (next_job < no_of_jobs)
+	{
+		int index = next_job++;
+		void (*current_job)(void*, int) = job;
+		void* argument = job_argument;
+		pthread_mutex_unlock(&mutex);
+
+		current_job(argument, index);
+
+		pthread_mutex_lock(&mutex);
+		jobs_completed++;
+		if (jobs_completed == no_of_jobs)
+			pthread_cond_broadcast(&batch_completed);
+	}
+}
+
+/*!
+ * \brief runs job(argument, index) for every index from 0 to no_of_jobs - 1,
+ *        and returns when all of them have completed
+ * \param no_of_jobs number of jobs in the batch
+ * \param job function which runs one job
+ * \param argument passed to every job
+ */
+void ThreadPool::Run(
+    int no_of_jobs,
+    void (*job)(void* argument, int index),
+    void* argument)
+{
+	if (no_of_workers == 0)
+	{
+		for (int index = 0; index < no_of_jobs; index++)
+			job(argument, index);
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+	this->job = job;
+	job_argument = argument;
+	this->no_of_jobs = no_of_jobs;
+	next_job = 0;
+	jobs_completed = 0;
+	batch++;
+	pthread_cond_broadcast(&batch_started);
+
+	RunJobs();
+	while (jobs_completed < no_of_jobs)
+		pthread_cond_wait(&batch_completed, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,69 @@
+/*
+    pool of worker threads
+    Copyright (C) 2009 Bob Mottram
+    fuzzgun@gmail.com
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/*!
+ * \brief threads which are started once and then reused to run batches of
+ *        numbered jobs, such as the bands of an image
+ *
+ * Run returns once every job in the batch has completed, so consecutive
+ * batches act as barriers.  The calling thread also runs jobs, so a pool
+ * of n threads has n - 1 workers.
+ */
+class ThreadPool
+{
+private:
+	pthread_t* workers;
+	int no_of_workers;
+	int no_of_threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t batch_started;
+	pthread_cond_t batch_completed;
+	bool stopping;
+
+	// the current batch
+	void (*job)(void* argument, int index);
+	void* job_argument;
+	int no_of_jobs;
+	int next_job;
+	int jobs_completed;
+	unsigned int batch;
+
+	static void* WorkerThread(void* pool);
+	void Work();
+	void RunJobs();
+
+public:
+	ThreadPool(int no_of_threads);
+	~ThreadPool();
+
+	int Threads();
+
+	void Run(
+	    int no_of_jobs,
+	    void (*job)(void* argument, int index),
+	    void* argument);
+};
+
+#endif /* THREADPOOL_H_ */
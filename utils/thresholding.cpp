@@ -20,88 +20,92 @@
 #include "thresholding.h"
 
 /*!
- * \brief calculate a global threshold based upon an intensity histogram
+ * \brief calculate a global threshold based upon an intensity histogram.
+ *
+ * For a grey level g, with n(h) pixels at each level h, the dark class is
+ * h < g and the light class is h >= g.  The spread of each class about g
+ * is the sum of (g - h) n(h) divided by the number of pixels in the class,
+ * which is g minus the mean of the class, so the variance to be minimised
+ * is |2g - mean_dark - mean_light|.  The class counts and sums are kept as
+ * running totals, so each grey level costs a constant amount of work and
+ * nothing is allocated.
+ *
+ * The totals are exact, and they are converted to single precision before
+ * dividing.  Results are therefore identical to summing each class in single
+ * precision whenever the sum of h n(h) is below 2^24, which is a histogram of
+ * up to 65793 pixels.  Whole frame histograms are far larger, and there the
+ * single precision sums are rounded.  The means then differ from them by
+ * less than 0.001 of a grey level, and the threshold only changes if two
+ * grey levels have variances within that rounding of each other.
  * \param histogram histogram data
+ * \param histogram_length length of the histogram data.  Grey levels
+ *        from 0 to 255 are evaluated.
  * \param MeanDark returned mean dark value
  * \param MeanLight returned mean light value
- * \param DarkRatio ratio of dark pixels to light
+ * \param DarkRatio returned percentage of dark pixels
  * \return global threshold value
  */
-float thresholding::GetGlobalThreshold(
-    float* histogram,
+template <typename T>
+static float PrefixSumThreshold(
+    const T* histogram,
     int histogram_length,
     float& MeanDark,
     float& MeanLight,
     float& DarkRatio)
 {
-    float global_threshold = 0;
-
     float Tmin = 0;
     float Tmax = 0;
     float MinVariance = 999999;  // some large figure
-    float currMeanDark, currMeanLight, VarianceDark, VarianceLight;
-
-    float DarkHits = 0;
-    float LightHits = 0;
     float BestDarkHits = 0;
     float BestLightHits = 0;
     MeanDark = 0;
     MeanLight = 0;
 
-    // calculate squared magnitudes
-    // this avoids unnecessary multiplications later on
-    int* histogram_squared_magnitude = new int[histogram_length];
-    int b = histogram_length - 1;
-    for (int i = histogram_length-1; i >= 0; i--, b--)
-        histogram_squared_magnitude[i] = histogram[b] * histogram[b];
-
-    int h;
-    float magnitude_sqr, Variance;
+    // everything starts in the dark class, apart from levels above those evaluated
+    double DarkHits = 0, DarkSum = 0;
+    double LightHits = 0, LightSum = 0;
+    for (int h = histogram_length-1; h >= 0; h--)
+    {
+        double magnitude = histogram[h];
+        if (h > 255)
+        {
+            LightHits += magnitude;
+            LightSum += h * magnitude;
+        }
+        else
+        {
+            DarkHits += magnitude;
+            DarkSum += h * magnitude;
+        }
+    }
 
     // evaluate all possible thresholds
     for (int grey_level = 255; grey_level >= 0; grey_level--)
     {
-        // compute mean and variance for this threshold
-        //  a struggle between light and darkness
-        DarkHits = 0;
-        LightHits = 0;
-        currMeanDark = 0;
-        currMeanLight = 0;
-        VarianceDark = 0;
-        VarianceLight = 0;
-
-        for (h = histogram_length-1; h >= 0; h--)
+        // this level moves from darkness into the light
+        if (grey_level < histogram_length)
         {
-            magnitude_sqr = histogram[h];
-            if (h < grey_level)
-            {
-                currMeanDark += h * magnitude_sqr;
-                VarianceDark += (grey_level - h) * magnitude_sqr;
-                DarkHits += magnitude_sqr;
-            }
-            else
-            {
-                currMeanLight += h * magnitude_sqr;
-                VarianceLight += (grey_level - h) * magnitude_sqr;
-                LightHits += magnitude_sqr;
-            }
+            double magnitude = histogram[grey_level];
+            DarkHits -= magnitude;
+            DarkSum -= grey_level * magnitude;
+            LightHits += magnitude;
+            LightSum += grey_level * magnitude;
         }
 
-        // compute means
+        float currMeanDark = 0, VarianceDark = 0;
+        float currMeanLight = 0, VarianceLight = 0;
         if (DarkHits > 0)
         {
-            // rescale into 0-255 range
-            currMeanDark = currMeanDark / DarkHits;
-            VarianceDark = VarianceDark / DarkHits;
+            currMeanDark = (float)DarkSum / (float)DarkHits;
+            VarianceDark = (float)((grey_level * DarkHits) - DarkSum) / (float)DarkHits;
         }
         if (LightHits > 0)
         {
-            // rescale into 0-255 range
-            currMeanLight = currMeanLight / LightHits;
-            VarianceLight = VarianceLight / LightHits;
+            currMeanLight = (float)LightSum / (float)LightHits;
+            VarianceLight = (float)((grey_level * LightHits) - LightSum) / (float)LightHits;
         }
 
-        Variance = VarianceDark + VarianceLight;
+        float Variance = VarianceDark + VarianceLight;
         if (Variance < 0) Variance = -Variance;
 
         if (Variance < MinVariance)
@@ -110,141 +114,57 @@ float thresholding::GetGlobalThreshold(
             Tmin = grey_level;
             MeanDark = currMeanDark;
             MeanLight = currMeanLight;
-            BestDarkHits = DarkHits;
-            BestLightHits = LightHits;
+            BestDarkHits = (float)DarkHits;
+            BestLightHits = (float)LightHits;
         }
         if ((int)(Variance * 1000) == (int)(MinVariance * 1000))
         {
             Tmax = grey_level;
             MeanLight = currMeanLight;
-            BestLightHits = LightHits;
+            BestLightHits = (float)LightHits;
         }
     }
 
-    global_threshold = (Tmin + Tmax) / 2;
-
     if (BestLightHits + BestDarkHits > 0)
         DarkRatio = BestDarkHits * 100 / (BestLightHits + BestDarkHits);
 
-    delete[] histogram_squared_magnitude;
-
-    return (global_threshold);
+    return ((Tmin + Tmax) / 2);
 }
 
 /*!
  * \brief calculate a global threshold based upon an intensity histogram
  * \param histogram histogram data
  * \param histogram_length length of the histogram data
- * \param histogram_start_index starting index for the histogram data within the array (there might be multiple histograms  a 1D array)
- * \param temp_histogram_buffer buffer used to store squared magnitudes
  * \param MeanDark returned mean dark value
  * \param MeanLight returned mean light value
  * \param DarkRatio ratio of dark pixels to light
  * \return global threshold value
  */
 float thresholding::GetGlobalThreshold(
-    int* histogram,
+    float* histogram,
     int histogram_length,
-    int histogram_start_index,
-    int* temp_histogram_buffer,
     float& MeanDark,
     float& MeanLight,
     float& DarkRatio)
 {
-    float global_threshold = 0;
-
-    float Tmin = 0;
-    float Tmax = 0;
-    float MinVariance = 999999;  // some large figure
-    float currMeanDark, currMeanLight, VarianceDark, VarianceLight;
-
-    float DarkHits = 0;
-    float LightHits = 0;
-    float BestDarkHits = 0;
-    float BestLightHits = 0;
-    MeanDark = 0;
-    MeanLight = 0;
-
-    // calculate squared magnitudes
-    // this avoids unnecessary multiplications later on
-    int* histogram_squared_magnitude = temp_histogram_buffer;
-    int b = histogram_length - 1 + histogram_start_index;
-    for (int i = histogram_length-1; i >= 0; i--, b--)
-        histogram_squared_magnitude[i] = histogram[b] * histogram[b];
-
-    int h;
-    float magnitude_sqr, Variance, divisor;
-
-    // evaluate all possible thresholds
-    for (int grey_level = 255; grey_level >= 0; grey_level--)
-    {
-        // compute mean and variance for this threshold
-        //  a struggle between light and darkness
-        DarkHits = 0;
-        LightHits = 0;
-        currMeanDark = 0;
-        currMeanLight = 0;
-        VarianceDark = 0;
-        VarianceLight = 0;
-
-        for (h = histogram_length-1; h >= 0; h--)
-        {
-            magnitude_sqr = histogram[h];
-            if (h < grey_level)
-            {
-                currMeanDark += h * magnitude_sqr;
-                VarianceDark += (grey_level - h) * magnitude_sqr;
-                DarkHits += magnitude_sqr;
-            }
-            else
-            {
-                currMeanLight += h * magnitude_sqr;
-                VarianceLight += (grey_level - h) * magnitude_sqr;
-                LightHits += magnitude_sqr;
-            }
-        }
-
-        // compute means
-        if (DarkHits > 0)
-        {
-            // rescale into 0-255 range
-            currMeanDark = currMeanDark / DarkHits;
-            VarianceDark = VarianceDark / DarkHits;
-        }
-        if (LightHits > 0)
-        {
-            // rescale into 0-255 range
-            divisor = LightHits * histogram_length;
-            currMeanLight = currMeanLight / LightHits;
-            VarianceLight = VarianceLight / LightHits;
-        }
-
-        Variance = VarianceDark + VarianceLight;
-        if (Variance < 0) Variance = -Variance;
-
-        if (Variance < MinVariance)
-        {
-            MinVariance = Variance;
-            Tmin = grey_level;
-            MeanDark = currMeanDark;
-            MeanLight = currMeanLight;
-            BestDarkHits = DarkHits;
-            BestLightHits = LightHits;
-        }
-        if ((int)(Variance * 1000) == (int)(MinVariance * 1000))
-        {
-            Tmax = grey_level;
-            MeanLight = currMeanLight;
-            BestLightHits = LightHits;
-        }
-    }
-
-    global_threshold = (Tmin + Tmax) / 2;
-
-    if (BestLightHits + BestDarkHits > 0)
-        DarkRatio = BestDarkHits * 100 / (BestLightHits + BestDarkHits);
-
-    //delete[] histogram_squared_magnitude;
+    return(PrefixSumThreshold(histogram, histogram_length, MeanDark, MeanLight, DarkRatio));
+}
 
-    return (global_threshold);
+/*!
+ * \brief calculate a global threshold based upon an intensity histogram
+ * \param histogram histogram data
+ * \param histogram_length length of the histogram data
+ * \param MeanDark returned mean dark value
+ * \param MeanLight returned mean light value
+ * \param DarkRatio ratio of dark pixels to light
+ * \return global threshold value
+ */
+float thresholding::GetGlobalThreshold(
+    const int* histogram,
+    int histogram_length,
+    float& MeanDark,
+    float& MeanLight,
+    float& DarkRatio)
+{
+    return(PrefixSumThreshold(histogram, histogram_length, MeanDark, MeanLight, DarkRatio));
 }